@@ -0,0 +1,141 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "batch.h"
+#include "linechunks.h"
+// Engine
+#include "parser.h"
+#include "parsercontext.h"
+#include "exceptions.h"
+// STL
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+// Time measurement
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+using namespace std;
+
+// Number of lines evaluated by one thread at once
+static const size_t CHUNK_SIZE = 1024;
+
+
+/*!
+    \class BatchProcessor
+    \brief Evaluates chunks of input lines.
+
+    Every line is an independent expression evaluated in a copy of the
+    initial context, so results don't depend on how lines are split
+    between threads. Results are written one per line.
+*/
+class BatchProcessor : public LineProcessor
+{
+public:
+    /// Constructs processor which evaluates lines in copies of \a context.
+    explicit BatchProcessor(const ParserContext & context) : mContext(context) { }
+
+    void process(const tstring * lines, size_t count, tstring & output);
+
+private:
+    const ParserContext & mContext;
+    Parser mParser;
+};
+
+/*!
+    Evaluates \a count \a lines and appends results to \a output.
+*/
+void BatchProcessor::process(const tstring * lines, size_t count, tstring & output)
+{
+    tstringstream out;
+    tstring line;
+
+    for (size_t i = 0; i < count; ++i) {
+        line = lines[i];
+        trim(line);
+        if (!line.empty()) {
+            mParser.setContext(mContext);
+            mParser.setExpression(line);
+            try {
+                ParserContext & context = mParser.parse();
+                context.result().toStream(out, context.numberFormat());
+            } catch (MaxCalcException & ex) {
+                out << ex.toString() << _T('.');
+            }
+        }
+        out << _T('\n');
+    }
+    output += out.str();
+}
+
+/*!
+    Returns current time in seconds.
+*/
+static double currentTime()
+{
+#if defined(_WIN32)
+    return GetTickCount() / 1000.0;
+#else
+    timeval time;
+    gettimeofday(&time, 0);
+    return time.tv_sec + time.tv_usec / 1000000.0;
+#endif
+}
+
+/*!
+    Evaluates expressions read from \a in (one per line) and writes results
+    into \a out in the same order; empty lines produce empty lines.
+
+    Lines are evaluated independently in chunks by \a jobs threads while
+    the next chunks are being read. Number of expressions and throughput
+    are reported to standard error.
+
+    Returns 0.
+*/
+int runBatch(tistream & in, tostream & out, int jobs)
+{
+    double startTime = currentTime();
+    ParserContext context;
+
+    if (jobs < 1) jobs = 1;
+    vector<LineProcessor *> processors;
+    for (int i = 0; i < jobs; ++i) {
+        processors.push_back(new BatchProcessor(context));
+    }
+
+    size_t total = processLineChunks(in, out, CHUNK_SIZE, processors);
+
+    for (int i = 0; i < jobs; ++i) {
+        delete processors[i];
+    }
+
+    double seconds = currentTime() - startTime;
+    cerr << "Evaluated " << total << " expressions in " << seconds << " s";
+    if (seconds > 0) {
+        cerr << " (" << (size_t)(total / seconds) << " expressions/s)";
+    }
+    cerr << " using " << jobs << (jobs == 1 ? " thread." : " threads.") << endl;
+
+    return 0;
+}
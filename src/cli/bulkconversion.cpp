@@ -0,0 +1,133 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "bulkconversion.h"
+#include "linechunks.h"
+// Engine
+#include "unitconversion.h"
+#include "bigdecimal.h"
+#include "exceptions.h"
+// STL
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Number of lines converted by one thread at once
+static const size_t CHUNK_SIZE = 4096;
+// Size of buffer for formatted numbers
+static const size_t NUMBER_BUFFER_SIZE = 256;
+
+
+/*!
+    \class ConversionProcessor
+    \brief Converts chunks of input lines.
+
+    Every line must contain one number. Results are written one per line;
+    lines which can not be converted produce error messages.
+*/
+class ConversionProcessor : public LineProcessor
+{
+public:
+    ConversionProcessor(const UnitConversion::Converter & converter,
+                        const BigDecimalFormat & format)
+        : mConverter(converter), mFormat(format)
+    {
+    }
+
+    void process(const tstring * lines, size_t count, tstring & output);
+
+private:
+    const UnitConversion::Converter & mConverter;
+    const BigDecimalFormat & mFormat;
+};
+
+/*!
+    Converts \a count \a lines and appends results to \a output.
+*/
+void ConversionProcessor::process(const tstring * lines, size_t count, tstring & output)
+{
+    tchar buffer[NUMBER_BUFFER_SIZE];
+    tstring line;
+
+    for (size_t i = 0; i < count; ++i) {
+        line = lines[i];
+        trim(line);
+        if (!line.empty()) {
+            try {
+                BigDecimal result = mConverter.convert(BigDecimal(line));
+                size_t length = result.toBuffer(buffer, NUMBER_BUFFER_SIZE, mFormat);
+                if (length < NUMBER_BUFFER_SIZE) {
+                    output.append(buffer, length);
+                } else {
+                    output += result.toTString(mFormat);
+                }
+            } catch (MaxCalcException & ex) {
+                output += ex.toString();
+                output += _T('.');
+            }
+        }
+        output += _T('\n');
+    }
+}
+
+/*!
+    Converts numbers read from \a in (one per line) and writes results into
+    \a out in the same order.
+
+    \a conversion has 'unit1->unit2' format. The conversion is resolved once;
+    numbers are converted in chunks by \a jobs threads while the next chunks
+    are being read.
+
+    Returns 0 on success or 1 if \a conversion is incorrect (the error
+    message is written to the standard error stream).
+*/
+int runBulkConversion(const tstring & conversion, tistream & in,
+                      tostream & out, int jobs)
+{
+    size_t arrow = conversion.find(_T("->"));
+    tstring unit1 = conversion.substr(0, arrow);
+    tstring unit2 = (arrow == tstring::npos) ? tstring() : conversion.substr(arrow + 2);
+    trim(unit1);
+    trim(unit2);
+
+    try {
+        UnitConversion::Converter converter(unit1, unit2);
+        BigDecimalFormat format;
+
+        if (jobs < 1) jobs = 1;
+        vector<LineProcessor *> processors;
+        for (int i = 0; i < jobs; ++i) {
+            processors.push_back(new ConversionProcessor(converter, format));
+        }
+
+        processLineChunks(in, out, CHUNK_SIZE, processors);
+
+        for (int i = 0; i < jobs; ++i) {
+            delete processors[i];
+        }
+    } catch (MaxCalcException & ex) {
+        tcerr << ex.toString() << _T('.') << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -8,10 +8,20 @@ CONFIG += debug_and_release warn_on console precompile_header
 
 HEADERS += pch.h \
            simpleini.h \
-           ConvertUTF.h
+           batch.h \
+           ConvertUTF.h \
+           bulkconversion.h \
+           csvmap.h \
+           daemon.h \
+           linechunks.h
 
 SOURCES += main.cpp \
-           ConvertUTF.cpp
+           ConvertUTF.cpp \
+           batch.cpp \
+           bulkconversion.cpp \
+           csvmap.cpp \
+           daemon.cpp \
+           linechunks.cpp
 
 PRECOMPILED_HEADER = pch.h
 
@@ -33,8 +43,10 @@ CONFIG(release, debug|release) {
 }
 
 win32:maxcalc_gettext:LIBS += -L../intl_win -lintl
+unix:LIBS += -lpthread
 
 maxcalc_unicode:DEFINES += MAXCALC_UNICODE
+maxcalc_utf8:DEFINES += MAXCALC_UTF8
 maxcalc_gettext:DEFINES += MAXCALC_GETTEXT
 maxcalc_portable:DEFINES += MAXCALC_PORTABLE
 win32:DEFINES += _CRT_SECURE_NO_WARNINGS
@@ -0,0 +1,336 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "csvmap.h"
+#include "thread.h"
+// Engine
+#include "parser.h"
+#include "parsercontext.h"
+#include "constants.h"
+#include "exceptions.h"
+#include "mappedfile.h"
+// STL
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Approximate size of part of the file evaluated by one thread at once
+static const size_t CHUNK_BYTES = 1 << 20;
+// Name of the added column
+static const tchar * RESULT_COLUMN = _T("result");
+
+
+/*!
+    Converts 8-bit \a size bytes at \a data read from a file to tstring.
+*/
+static tstring fromFile(const char * data, size_t size)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return stringToWideString(string(data, size));
+#else
+    return tstring(data, size);
+#endif
+}
+
+/*!
+    Splits CSV line [\a begin, \a end) into \a fields.
+
+    Fields may be quoted with '"' (quotes inside are doubled); spaces around
+    fields are removed.
+*/
+static void splitLine(const char * begin, const char * end, vector<string> & fields)
+{
+    fields.clear();
+    const char * pos = begin;
+    while (true) {
+        string field;
+        while (pos < end && (*pos == ' ' || *pos == '\t')) ++pos;
+        if (pos < end && *pos == '"') {
+            for (++pos; pos < end; ++pos) {
+                if (*pos == '"') {
+                    if (pos + 1 < end && pos[1] == '"') ++pos;
+                    else { ++pos; break; }
+                }
+                field += *pos;
+            }
+            while (pos < end && *pos != ',') ++pos;
+        } else {
+            const char * start = pos;
+            while (pos < end && *pos != ',') ++pos;
+            const char * last = pos;
+            while (last > start && (last[-1] == ' ' || last[-1] == '\t')) --last;
+            field.assign(start, last);
+        }
+        fields.push_back(field);
+        if (pos >= end) break;
+        ++pos;  // Skip comma
+    }
+}
+
+/*!
+    Appends \a field to \a line quoting it if it contains commas or quotes.
+*/
+static void appendField(tstring & line, const tstring & field)
+{
+    if (field.find_first_of(_T(",\"")) == tstring::npos) {
+        line += field;
+        return;
+    }
+    line += _T('"');
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == _T('"')) line += _T('"');
+        line += field[i];
+    }
+    line += _T('"');
+}
+
+/*!
+    Returns lowercase identifiers used in \a expression (unit conversions
+    in brackets are skipped).
+*/
+static set<tstring> findIdentifiers(const tstring & expression)
+{
+    set<tstring> identifiers;
+    bool inBrackets = false;
+    size_t pos = 0;
+    while (pos < expression.size()) {
+        tchar c = expression[pos];
+        if (c == _T('[')) inBrackets = true;
+        else if (c == _T(']')) inBrackets = false;
+        if (!inBrackets && (c == _T('_') || istalpha(c))) {
+            size_t start = pos;
+            while (pos < expression.size() && (expression[pos] == _T('_') ||
+                   istalpha(expression[pos]) || istdigit(expression[pos]))) {
+                ++pos;
+            }
+            tstring identifier = expression.substr(start, pos - start);
+            identifiers.insert(strToLower(identifier));
+        } else {
+            ++pos;
+        }
+    }
+    return identifiers;
+}
+
+
+/*!
+    \class CsvChunk
+    \brief Evaluates expression for rows of a part of CSV file in a separate
+    thread.
+
+    Columns used in the expression are bound to variables of the chunk's
+    parser. The expression is parsed once; for each row only values of
+    the variables are changed (see Variables::setValue()).
+*/
+class CsvChunk : public Thread
+{
+public:
+    CsvChunk(const tstring & expression, const vector<tstring> & columns,
+             const set<tstring> & identifiers);
+
+    /// Sets rows [\a begin, \a end) to be evaluated.
+    void setRows(const char * begin, const char * end)
+    {
+        mBegin = begin;
+        mEnd = end;
+    }
+
+    /// Returns rows with results (valid after wait() returns).
+    const tstring & output() const { return mOutput; }
+
+protected:
+    void run();
+
+private:
+    Parser mParser;
+    vector<size_t> mColumns;                ///< Indexes of bound columns.
+    vector<tstring> mNames;                 ///< Names of bound columns.
+    vector<Variables::Symbol> mSymbols;     ///< Variables of bound columns.
+    const char * mBegin;
+    const char * mEnd;
+    tstring mOutput;
+
+    tstring evaluate(const vector<string> & fields);
+};
+
+/*!
+    Constructs chunk which evaluates \a expression binding \a columns which
+    are among \a identifiers of the expression.
+*/
+CsvChunk::CsvChunk(const tstring & expression, const vector<tstring> & columns,
+                   const set<tstring> & identifiers)
+    : mBegin(0), mEnd(0)
+{
+    ParserContext & context = mParser.context();
+    context.numberFormat().precision = Constants::MAX_IO_PRECISION;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (identifiers.count(columns[i]) != 0) {
+            mColumns.push_back(i);
+            mNames.push_back(columns[i]);
+            mSymbols.push_back(context.variables().intern(columns[i]));
+        }
+    }
+    mParser.setExpression(expression);
+}
+
+/*!
+    Evaluates rows and appends results to them.
+*/
+void CsvChunk::run()
+{
+    vector<string> fields;
+    mOutput.clear();
+
+    const char * line = mBegin;
+    while (line < mEnd) {
+        const char * end = line;
+        while (end < mEnd && *end != '\n') ++end;
+        const char * next = (end < mEnd) ? end + 1 : end;
+        if (end > line && end[-1] == '\r') --end;
+
+        if (end > line) {
+            splitLine(line, end, fields);
+            mOutput += fromFile(line, end - line);
+            mOutput += _T(',');
+            appendField(mOutput, evaluate(fields));
+        }
+        mOutput += _T('\n');
+        line = next;
+    }
+}
+
+/*!
+    Binds \a fields of a row to variables and evaluates the expression.
+
+    Returns result or error message.
+*/
+tstring CsvChunk::evaluate(const vector<string> & fields)
+{
+    try {
+        Variables & vars = mParser.context().variables();
+        for (size_t i = 0; i < mColumns.size(); ++i) {
+            if (mColumns[i] >= fields.size()) {
+                return _T("Missing column '") + mNames[i] + _T("'.");
+            }
+            const string & field = fields[mColumns[i]];
+            vars.setValue(mSymbols[i], BigDecimal(fromFile(field.data(), field.size())));
+        }
+
+        ParserContext & context = mParser.parse();
+        return context.result().toTString(context.numberFormat());
+    } catch (MaxCalcException & ex) {
+        return ex.toString() + _T('.');
+    }
+}
+
+/*!
+    Returns end of the chunk which starts at \a begin: position after the
+    first newline after CHUNK_BYTES bytes or \a end.
+*/
+static const char * chunkEnd(const char * begin, const char * end)
+{
+    if ((size_t)(end - begin) <= CHUNK_BYTES) return end;
+    const char * pos = begin + CHUNK_BYTES;
+    while (pos < end && *pos != '\n') ++pos;
+    return (pos < end) ? pos + 1 : end;
+}
+
+/*!
+    Evaluates \a expression for every row of CSV file \a inputPath and
+    writes the rows with the result added as the last column into \a out.
+
+    The first row contains names of columns; columns used in the expression
+    are bound to variables with the same names. The file is memory-mapped
+    and split into chunks at line boundaries which are evaluated by \a jobs
+    threads; rows are written in the same order. Pages which are already
+    processed are discarded, so memory use doesn't depend on file size.
+    Quoted fields must not contain newlines.
+
+    Returns 0 on success or 1 if the file cannot be read.
+*/
+int runCsvMap(const tstring & expression, const char * inputPath,
+              tostream & out, int jobs)
+{
+    MappedFile file;
+    if (!file.open(inputPath)) {
+        cerr << "Cannot open file '" << inputPath << "'." << endl;
+        return 1;
+    }
+    if (file.size() == 0) return 0;
+    file.sequentialAccess();
+
+    const char * data = (const char *)file.data();
+    const char * end = data + file.size();
+
+    // Header
+    const char * headerEnd = data;
+    while (headerEnd < end && *headerEnd != '\n') ++headerEnd;
+    const char * rows = (headerEnd < end) ? headerEnd + 1 : end;
+    if (headerEnd > data && headerEnd[-1] == '\r') --headerEnd;
+
+    vector<string> fields;
+    splitLine(data, headerEnd, fields);
+    vector<tstring> columns;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        tstring name = fromFile(fields[i].data(), fields[i].size());
+        columns.push_back(strToLower(name));
+    }
+
+    tstring header = fromFile(data, headerEnd - data);
+    header += _T(',');
+    header += RESULT_COLUMN;
+    out << header << _T('\n');
+
+    set<tstring> identifiers = findIdentifiers(expression);
+    if (jobs < 1) jobs = 1;
+    vector<CsvChunk *> chunks;
+    for (int i = 0; i < jobs; ++i) {
+        chunks.push_back(new CsvChunk(expression, columns, identifiers));
+    }
+
+    const char * begin = rows;
+    while (begin < end) {
+        const char * roundBegin = begin;
+        int started = 0;
+        for (; started < jobs && begin < end; ++started) {
+            const char * chunkLast = chunkEnd(begin, end);
+            chunks[started]->setRows(begin, chunkLast);
+            chunks[started]->start();
+            begin = chunkLast;
+        }
+
+        for (int i = 0; i < started; ++i) {
+            chunks[i]->wait();
+            const tstring & output = chunks[i]->output();
+            out.write(output.data(), (streamsize)output.size());
+        }
+
+        file.discard(roundBegin - data, begin - roundBegin);
+    }
+    out.flush();
+
+    for (int i = 0; i < jobs; ++i) {
+        delete chunks[i];
+    }
+    return 0;
+}
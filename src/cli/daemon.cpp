@@ -0,0 +1,804 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "daemon.h"
+#include "thread.h"
+// Engine
+#include "parser.h"
+#include "parsercontext.h"
+#include "commandparser.h"
+#include "exceptions.h"
+#include "mutex.h"
+#include "operationbudget.h"
+#include "shareddata.h"
+// STL
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+// Unix domain sockets
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*!
+    \file daemon.cpp
+    \brief Evaluation daemon and its client.
+
+    The daemon listens on a Unix domain socket and evaluates expressions
+    in named sessions, each of which has its own parser context (variables,
+    result and settings). Requests and responses are lines of UTF-8 text:
+
+    \code
+    request:  <id> <session> <expression or command>
+    response: <id> <result or error message>
+    \endcode
+
+    Clients may send many requests without waiting for responses. Requests
+    of one session are evaluated in order they were received; different
+    sessions are evaluated in parallel by a pool of worker threads, so
+    responses to requests of different sessions may come in any order and
+    are matched by id. Newlines and backslashes in responses (e.g. output
+    of #var) are escaped as "\n" and "\\".
+
+    The daemon protects itself from misbehaving clients: each evaluation has
+    a time limit, requests longer than MAX_REQUEST_LENGTH close the
+    connection, a client which doesn't read responses is disconnected after
+    SEND_TIMEOUT, and sessions idle for SESSION_TIMEOUT are removed.
+*/
+
+#if !defined(_WIN32)
+
+// Size of buffer for reading from sockets
+static const size_t READ_BUFFER_SIZE = 65536;
+// Maximum number of pending connections
+static const int LISTEN_BACKLOG = 64;
+// Maximum length of request line
+static const size_t MAX_REQUEST_LENGTH = 1024 * 1024;
+// Time limit of evaluation of a request in milliseconds
+static const unsigned long REQUEST_TIME_LIMIT = 10000;
+// Time a client may not accept responses in milliseconds
+static const int SEND_TIMEOUT = 10000;
+// Maximum number of sessions
+static const size_t MAX_SESSIONS = 1024;
+// Time after which idle sessions are removed in seconds
+static const time_t SESSION_TIMEOUT = 30 * 60;
+// Interval of checks for idle sessions in milliseconds
+static const int EXPIRY_INTERVAL = 60 * 1000;
+// Set by signal handlers to stop the daemon
+static volatile sig_atomic_t sStopRequested = 0;
+
+/*!
+    Converts UTF-8 encoded \a str received from a socket to tstring.
+*/
+static tstring fromWire(const string & str)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return stringToWideString(str);
+#else
+    return str;
+#endif
+}
+
+/*!
+    Converts \a str to UTF-8 encoded string sent to a socket.
+*/
+static string toWire(const tstring & str)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return wideStringToString(str);
+#else
+    return str;
+#endif
+}
+
+/*!
+    Escapes newlines and backslashes in \a str so it fits in one line.
+*/
+static string escapeLine(const string & str)
+{
+    string result;
+    result.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '\\') result += "\\\\";
+        else if (str[i] == '\n') result += "\\n";
+        else result += str[i];
+    }
+    return result;
+}
+
+/*!
+    Reverts escapeLine().
+*/
+static string unescapeLine(const string & str)
+{
+    string result;
+    result.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '\\' && i + 1 < str.size()) {
+            ++i;
+            result += (str[i] == 'n') ? '\n' : str[i];
+        } else {
+            result += str[i];
+        }
+    }
+    return result;
+}
+
+/*!
+    Writes all \a size bytes of \a data to socket \a fd.
+
+    If the socket is non-blocking, waits at most \a timeout milliseconds
+    (-1 means forever) each time the socket doesn't accept more data.
+
+    Returns false if the socket is closed or the time is out.
+*/
+static bool writeAll(int fd, const char * data, size_t size, int timeout = -1)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd output;
+            output.fd = fd;
+            output.events = POLLOUT;
+            output.revents = 0;
+            int ready = poll(&output, 1, timeout);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+            continue;
+        }
+        if (written <= 0) return false;
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+/*!
+    Fills \a address with Unix socket \a path.
+
+    Returns false if the path is too long.
+*/
+static bool makeAddress(sockaddr_un & address, const char * path)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path);
+    return true;
+}
+
+
+/*!
+    \class Connection
+    \brief Connection of a client to the daemon.
+
+    Requests keep references to their connection, so its socket is closed
+    after the client stops sending requests and all of them are answered.
+
+    The socket is non-blocking. If the client doesn't accept a response for
+    SEND_TIMEOUT, the connection is shut down, so the daemon stops reading
+    its requests and following responses are dropped.
+*/
+class Connection : public SharedData
+{
+public:
+    /// Constructs connection with socket \a fd.
+    explicit Connection(int fd) : mFd(fd), mBroken(false)
+    {
+        fcntl(mFd, F_SETFL, fcntl(mFd, F_GETFL) | O_NONBLOCK);
+    }
+    /// Closes the socket.
+    ~Connection() { close(mFd); }
+
+    /// Returns socket of the connection.
+    int fd() const { return mFd; }
+
+    /// Sends \a line to the client; lines sent by different threads are not mixed.
+    void send(const string & line) const
+    {
+        MutexLocker locker(mMutex);
+        if (mBroken) return;
+        if (!writeAll(mFd, line.data(), line.size(), SEND_TIMEOUT)) {
+            mBroken = true;
+            shutdown(mFd, SHUT_RDWR);
+        }
+    }
+
+private:
+    int mFd;
+    mutable bool mBroken;           ///< True if the client stopped accepting responses.
+    mutable Mutex mMutex;
+};
+
+
+/// Request waiting for evaluation.
+struct Request
+{
+    string id;                                  ///< Request id sent back with response.
+    tstring expression;                         ///< Expression or command.
+    string reply;                               ///< Response to request which is not evaluated.
+    SharedDataPointer<Connection> connection;   ///< Connection to send response to.
+};
+
+
+/// Named session with its own parser context.
+struct Session
+{
+    Session() : scheduled(false), lastUsed(time(0)) { }
+
+    Parser parser;              ///< Parser with context of the session.
+    deque<Request> requests;    ///< Requests waiting for evaluation.
+    bool scheduled;             ///< True if session is queued or evaluated by a worker.
+    time_t lastUsed;            ///< Time of the last request.
+};
+
+
+class Worker;
+
+/*!
+    \class Daemon
+    \brief Dispatches requests of sessions to worker threads.
+
+    A session with pending requests is queued once and is taken by one
+    worker at a time, which preserves order of requests in the session.
+    After evaluating a request the worker queues the session again if it
+    has more requests, so busy sessions don't starve others.
+
+    Sessions are shared by all connections (a client may continue a session
+    after reconnecting), so they are not removed on disconnect but when they
+    are idle for SESSION_TIMEOUT.
+*/
+class Daemon
+{
+public:
+    explicit Daemon(int jobs);
+    ~Daemon();
+
+    void submit(const string & line, const SharedDataPointer<Connection> & connection);
+    void reject(const string & id, const string & reply,
+                const SharedDataPointer<Connection> & connection);
+    bool processNext();
+    void expireSessions();
+
+private:
+    map<string, Session *> mSessions;   ///< Sessions by names.
+    deque<Session *> mReady;            ///< Sessions with pending requests.
+    deque<Request> mReplies;            ///< Rejected requests waiting for response.
+    vector<Worker *> mWorkers;          ///< Worker threads.
+    Mutex mMutex;                       ///< Guards sessions and queue.
+    WaitCondition mReadyCondition;      ///< Signaled when a session is queued.
+    bool mStopping;                     ///< True when workers must exit.
+    CancellationToken mCancellation;    ///< Cancels evaluations when daemon stops.
+
+    void queueReply(Request & request, const string & reply);
+    string evaluate(Parser & parser, const tstring & expression);
+};
+
+
+/*!
+    \class Worker
+    \brief Thread of daemon's pool which evaluates requests.
+*/
+class Worker : public Thread
+{
+public:
+    /// Constructs worker of \a daemon.
+    explicit Worker(Daemon & daemon) : mDaemon(daemon) { }
+
+protected:
+    /// Evaluates requests until daemon stops.
+    void run() { while (mDaemon.processNext()) { } }
+
+private:
+    Daemon & mDaemon;
+};
+
+
+/*!
+    Constructs daemon with \a jobs worker threads.
+*/
+Daemon::Daemon(int jobs) : mStopping(false)
+{
+    if (jobs < 1) jobs = 1;
+    for (int i = 0; i < jobs; ++i) {
+        mWorkers.push_back(new Worker(*this));
+        mWorkers.back()->start();
+    }
+}
+
+/*!
+    Cancels current requests, waits for workers and destroys sessions.
+    Requests which are not evaluated yet are dropped.
+*/
+Daemon::~Daemon()
+{
+    {
+        MutexLocker locker(mMutex);
+        mStopping = true;
+        mReadyCondition.wakeAll();
+    }
+    mCancellation.cancel();
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        delete mWorkers[i];
+    }
+    for (map<string, Session *>::iterator iter = mSessions.begin();
+         iter != mSessions.end(); ++iter) {
+        delete iter->second;
+    }
+}
+
+/*!
+    Parses request \a line received from \a connection and queues it.
+
+    Invalid requests are not evaluated, but their error responses are
+    queued too, so the caller never waits for a slow client.
+*/
+void Daemon::submit(const string & line, const SharedDataPointer<Connection> & connection)
+{
+    size_t idEnd = line.find(' ');
+    size_t sessionEnd = (idEnd == string::npos) ? idEnd : line.find(' ', idEnd + 1);
+    if (idEnd == 0 || sessionEnd == string::npos || sessionEnd == idEnd + 1) {
+        string id = line.substr(0, idEnd);
+        reject(id.empty() ? string("-") : id, "Invalid request.", connection);
+        return;
+    }
+
+    Request request;
+    request.id = line.substr(0, idEnd);
+    request.connection = connection;
+    request.expression = fromWire(line.substr(sessionEnd + 1));
+    string name = line.substr(idEnd + 1, sessionEnd - idEnd - 1);
+
+    MutexLocker locker(mMutex);
+    map<string, Session *>::iterator iter = mSessions.find(name);
+    if (iter == mSessions.end()) {
+        if (mSessions.size() >= MAX_SESSIONS) {
+            queueReply(request, "Too many sessions.");
+            return;
+        }
+        iter = mSessions.insert(make_pair(name, new Session)).first;
+    }
+    Session * session = iter->second;
+    session->lastUsed = time(0);
+    session->requests.push_back(request);
+    if (!session->scheduled) {
+        session->scheduled = true;
+        mReady.push_back(session);
+        mReadyCondition.wakeOne();
+    }
+}
+
+/*!
+    Queues \a reply to request \a id from \a connection which is not
+    evaluated. Replies are sent by workers like responses.
+*/
+void Daemon::reject(const string & id, const string & reply,
+                    const SharedDataPointer<Connection> & connection)
+{
+    Request request;
+    request.id = id;
+    request.connection = connection;
+    MutexLocker locker(mMutex);
+    queueReply(request, reply);
+}
+
+/*!
+    Queues \a reply to \a request which is not evaluated.
+    Must be called with locked mutex.
+*/
+void Daemon::queueReply(Request & request, const string & reply)
+{
+    request.reply = reply;
+    mReplies.push_back(request);
+    mReadyCondition.wakeOne();
+}
+
+/*!
+    Waits for a rejected request or a session with pending requests and
+    answers the request or evaluates the first request of the session.
+    Called by workers in a loop.
+
+    Returns false when the daemon is stopping.
+*/
+bool Daemon::processNext()
+{
+    Session * session = 0;
+    Request request;
+    {
+        MutexLocker locker(mMutex);
+        while (mReady.empty() && mReplies.empty() && !mStopping) {
+            mReadyCondition.wait(mMutex);
+        }
+        if (mStopping) return false;
+        if (!mReplies.empty()) {
+            request = mReplies.front();
+            mReplies.pop_front();
+        } else {
+            session = mReady.front();
+            mReady.pop_front();
+            request = session->requests.front();
+            session->requests.pop_front();
+        }
+    }
+
+    if (session == 0) {
+        request.connection->send(request.id + ' ' + request.reply + '\n');
+        return true;
+    }
+
+    // Session is not queued while it is evaluated, so it's used by this thread only
+    string result = evaluate(session->parser, request.expression);
+    request.connection->send(request.id + ' ' + escapeLine(result) + '\n');
+    request.connection = SharedDataPointer<Connection>();
+
+    MutexLocker locker(mMutex);
+    session->lastUsed = time(0);
+    if (session->requests.empty()) {
+        session->scheduled = false;
+    } else {
+        mReady.push_back(session);
+        mReadyCondition.wakeOne();
+    }
+    return true;
+}
+
+/*!
+    Removes sessions which have no requests and were not used for
+    SESSION_TIMEOUT.
+*/
+void Daemon::expireSessions()
+{
+    time_t now = time(0);
+    MutexLocker locker(mMutex);
+    map<string, Session *>::iterator iter = mSessions.begin();
+    while (iter != mSessions.end()) {
+        Session * session = iter->second;
+        if (!session->scheduled && now - session->lastUsed > SESSION_TIMEOUT) {
+            delete session;
+            mSessions.erase(iter++);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+/*!
+    Evaluates \a expression or command with \a parser and returns output.
+
+    Evaluation is limited by REQUEST_TIME_LIMIT and is cancelled when the
+    daemon stops.
+*/
+string Daemon::evaluate(Parser & parser, const tstring & expression)
+{
+    tstringstream out;
+    CommandParser commandParser(out, parser.context());
+    tstring expr = expression;
+    trim(expr);
+
+    if (expr.empty()) {
+        out << _T("Empty expression.");
+    } else if (commandParser.parse(expr) == CommandParser::NO_COMMAND) {
+        // Commands may replace the context, so limits are set every time
+        parser.context().setTimeLimit(REQUEST_TIME_LIMIT);
+        parser.context().setCancellationToken(&mCancellation);
+        parser.setExpression(expr);
+        try {
+            ParserContext & context = parser.parse();
+            context.result().toStream(out, context.numberFormat());
+        } catch (MaxCalcException & ex) {
+            out << ex.toString() << _T('.');
+        }
+    }
+
+    string result = toWire(out.str());
+    while (!result.empty() && result[result.size() - 1] == '\n') {
+        result.erase(result.size() - 1);
+    }
+    return result;
+}
+
+/*!
+    Stops the daemon on SIGINT and SIGTERM.
+*/
+static void stopDaemon(int)
+{
+    sStopRequested = 1;
+}
+
+/*!
+    Runs daemon listening on Unix socket \a socketPath with \a jobs worker
+    threads until it gets SIGINT or SIGTERM.
+
+    The socket is accessible by the current user only. Returns 0 on normal
+    exit or 1 if the socket cannot be created.
+*/
+int runDaemon(const char * socketPath, int jobs)
+{
+    sockaddr_un address;
+    if (!makeAddress(address, socketPath)) {
+        cerr << "Socket path is too long." << endl;
+        return 1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    // Socket file of a previous daemon is replaced
+    unlink(socketPath);
+    mode_t oldMask = umask(S_IRWXG | S_IRWXO);
+    int bound = bind(listener, (sockaddr *)&address, sizeof(address));
+    umask(oldMask);
+    if (bound < 0 || listen(listener, LISTEN_BACKLOG) < 0) {
+        perror(socketPath);
+        close(listener);
+        return 1;
+    }
+
+    // Without SA_RESTART poll() is interrupted by signals
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopDaemon;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    // Clients may disconnect before getting responses
+    signal(SIGPIPE, SIG_IGN);
+
+    {
+        Daemon daemon(jobs);
+        vector<pollfd> fds(1);
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        vector<SharedDataPointer<Connection> > connections(1);
+        vector<string> pending(1);
+        vector<char> buffer(READ_BUFFER_SIZE);
+        time_t lastExpiry = time(0);
+
+        while (!sStopRequested) {
+            int ready = poll(&fds[0], fds.size(), EXPIRY_INTERVAL);
+            if (time(0) - lastExpiry >= EXPIRY_INTERVAL / 1000) {
+                daemon.expireSessions();
+                lastExpiry = time(0);
+            }
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                perror("poll");
+                break;
+            }
+
+            for (size_t i = fds.size() - 1; i > 0; --i) {
+                if (fds[i].revents == 0) continue;
+                ssize_t size = read(fds[i].fd, &buffer[0], buffer.size());
+                if (size < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    continue;
+                }
+                if (size <= 0) {
+                    // Connection is closed when pending requests are answered
+                    fds.erase(fds.begin() + i);
+                    connections.erase(connections.begin() + i);
+                    pending.erase(pending.begin() + i);
+                    continue;
+                }
+
+                string & data = pending[i];
+                data.append(&buffer[0], (size_t)size);
+                size_t start = 0, end;
+                while ((end = data.find('\n', start)) != string::npos) {
+                    size_t length = end - start;
+                    if (length > 0 && data[end - 1] == '\r') --length;
+                    if (length > 0) {
+                        daemon.submit(data.substr(start, length), connections[i]);
+                    }
+                    start = end + 1;
+                }
+                data.erase(0, start);
+
+                if (data.size() > MAX_REQUEST_LENGTH) {
+                    daemon.reject("-", "Request is too long.", connections[i]);
+                    shutdown(fds[i].fd, SHUT_RD);
+                    fds.erase(fds.begin() + i);
+                    connections.erase(connections.begin() + i);
+                    pending.erase(pending.begin() + i);
+                }
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listener, 0, 0);
+                if (fd >= 0) {
+                    pollfd client;
+                    client.fd = fd;
+                    client.events = POLLIN;
+                    client.revents = 0;
+                    fds.push_back(client);
+                    connections.push_back(SharedDataPointer<Connection>(new Connection(fd)));
+                    pending.push_back(string());
+                }
+            }
+        }
+    }
+
+    close(listener);
+    unlink(socketPath);
+    return 0;
+}
+
+
+/*!
+    \class RequestSender
+    \brief Sends expressions read from a stream to the daemon.
+
+    Requests are sent by a separate thread while responses are read, so
+    the client never waits for a response before sending the next request.
+*/
+class RequestSender : public Thread
+{
+public:
+    /// Constructs sender of lines of \a in to socket \a fd for \a session.
+    RequestSender(int fd, const string & session, tistream & in)
+        : mFd(fd), mSession(session), mIn(in), mCount(0)
+    {
+    }
+
+    /// Returns number of sent requests (valid after wait() returns).
+    unsigned count() const { return mCount; }
+
+protected:
+    void run();
+
+private:
+    int mFd;
+    string mSession;
+    tistream & mIn;
+    unsigned mCount;
+};
+
+/*!
+    Sends non-empty lines as requests with consecutive ids starting with 0
+    and shuts down writing when input ends.
+*/
+void RequestSender::run()
+{
+    tstring line;
+    string request;
+    while (getline(mIn, line)) {
+        trim(line);
+        if (line.empty()) continue;
+        ostringstream id;
+        id << mCount;
+        request = id.str() + ' ' + mSession + ' ' + toWire(line) + '\n';
+        if (!writeAll(mFd, request.data(), request.size())) break;
+        ++mCount;
+    }
+    shutdown(mFd, SHUT_WR);
+}
+
+/*!
+    Sends expressions read from \a in (one per line) to daemon listening on
+    \a socketPath for evaluation in \a session and writes results into
+    \a out in the same order.
+
+    Returns 0 on success or 1 if the daemon is not available.
+*/
+int runClient(const char * socketPath, const tstring & session,
+              tistream & in, tostream & out)
+{
+    sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !makeAddress(address, socketPath) ||
+        connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        perror(socketPath);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    string sessionName = toWire(session);
+    if (sessionName.empty() || sessionName.find_first_of(" \t\r\n") != string::npos) {
+        cerr << "Invalid session name." << endl;
+        close(fd);
+        return 1;
+    }
+
+    // Daemon may close the connection while requests are sent
+    signal(SIGPIPE, SIG_IGN);
+
+    RequestSender sender(fd, sessionName, in);
+    sender.start();
+
+    // Responses of one session come in order; ids are checked anyway
+    map<unsigned long, string> early;
+    unsigned long next = 0;
+    string data;
+    vector<char> buffer(READ_BUFFER_SIZE);
+    ssize_t size;
+    while ((size = read(fd, &buffer[0], buffer.size())) != 0) {
+        if (size < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data.append(&buffer[0], (size_t)size);
+        size_t start = 0, end;
+        while ((end = data.find('\n', start)) != string::npos) {
+            string line = data.substr(start, end - start);
+            start = end + 1;
+            size_t space = line.find(' ');
+            if (space == string::npos) continue;
+            // Errors which are not responses to requests (e.g. "- Request is too long.")
+            char * idEnd;
+            unsigned long id = strtoul(line.c_str(), &idEnd, 10);
+            if (!isdigit((unsigned char)line[0]) || idEnd != line.c_str() + space) {
+                cerr << unescapeLine(line.substr(space + 1)) << endl;
+                continue;
+            }
+            early[id] = unescapeLine(line.substr(space + 1));
+            map<unsigned long, string>::iterator iter;
+            while ((iter = early.find(next)) != early.end()) {
+                out << fromWire(iter->second) << endl;
+                early.erase(iter);
+                ++next;
+            }
+        }
+        data.erase(0, start);
+    }
+
+    sender.wait();
+    close(fd);
+    return (next == sender.count()) ? 0 : 1;
+}
+
+#else // _WIN32
+
+/*!
+    Daemon mode requires Unix domain sockets.
+*/
+int runDaemon(const char *, int)
+{
+    cerr << "Daemon mode is not supported on this platform." << endl;
+    return 1;
+}
+
+/*!
+    Client mode requires Unix domain sockets.
+*/
+int runClient(const char *, const tstring &, tistream &, tostream &)
+{
+    cerr << "Client mode is not supported on this platform." << endl;
+    return 1;
+}
+
+#endif // _WIN32
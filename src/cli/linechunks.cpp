@@ -0,0 +1,132 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "linechunks.h"
+#include "thread.h"
+// STL
+#include <iostream>
+
+using namespace std;
+
+
+/*!
+    \class LineChunk
+    \brief Processes a chunk of input lines in a separate thread.
+*/
+class LineChunk : public Thread
+{
+public:
+    /// Constructs chunk which processes lines with \a processor.
+    explicit LineChunk(LineProcessor & processor)
+        : mProcessor(processor), mLines(0), mCount(0)
+    {
+    }
+
+    /// Sets \a count lines to be processed.
+    void setLines(const tstring * lines, size_t count)
+    {
+        mLines = lines;
+        mCount = count;
+    }
+
+    /// Returns results (valid after wait() returns).
+    const tstring & output() const { return mOutput; }
+
+protected:
+    /// Processes lines.
+    void run()
+    {
+        mOutput.clear();
+        mProcessor.process(mLines, mCount, mOutput);
+    }
+
+private:
+    LineProcessor & mProcessor;
+    const tstring * mLines;
+    size_t mCount;
+    tstring mOutput;
+};
+
+/*!
+    Reads at most \a lines.size() lines from \a in into \a lines.
+
+    Returns number of lines read.
+*/
+static size_t readLines(tistream & in, vector<tstring> & lines)
+{
+    size_t count = 0;
+    while (count < lines.size() && getline(in, lines[count])) {
+        ++count;
+    }
+    return count;
+}
+
+/*!
+    Reads lines from \a in, processes them and writes results into \a out
+    in the same order.
+
+    Lines are split into chunks of \a chunkSize lines which are processed
+    in parallel, one thread per object in \a processors, while the next
+    chunks are being read.
+
+    Returns number of processed lines.
+*/
+size_t processLineChunks(tistream & in, tostream & out, size_t chunkSize,
+                         const vector<LineProcessor *> & processors)
+{
+    vector<LineChunk *> chunks;
+    for (size_t i = 0; i < processors.size(); ++i) {
+        chunks.push_back(new LineChunk(*processors[i]));
+    }
+
+    // Lines are read into one buffer while lines from the other one
+    // are being processed
+    vector<tstring> lines(chunks.size() * chunkSize);
+    vector<tstring> nextLines(chunks.size() * chunkSize);
+    size_t count = readLines(in, lines);
+    size_t total = 0;
+
+    while (count > 0) {
+        size_t started = 0;
+        for (size_t first = 0; first < count; first += chunkSize, ++started) {
+            size_t size = (count - first < chunkSize) ? count - first : chunkSize;
+            chunks[started]->setLines(&lines[first], size);
+            chunks[started]->start();
+        }
+
+        size_t nextCount = readLines(in, nextLines);
+
+        for (size_t i = 0; i < started; ++i) {
+            chunks[i]->wait();
+            const tstring & output = chunks[i]->output();
+            out.write(output.data(), (streamsize)output.size());
+        }
+
+        total += count;
+        lines.swap(nextLines);
+        count = nextCount;
+    }
+    out.flush();
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        delete chunks[i];
+    }
+    return total;
+}
@@ -24,6 +24,12 @@
 #include "unitconversion.h"
 #include "unicode.h"
 #include "commandparser.h"
+// Local
+#include "batch.h"
+#include "bulkconversion.h"
+#include "csvmap.h"
+#include "daemon.h"
+#include "thread.h"
 // STL
 #include <iostream>
 #include <clocale>
@@ -31,11 +37,14 @@
 #include <cstring>
 #include <vector>
 #include <sstream>
-// For mkdir()
+#include <fstream>
+// For mkdir() and isatty()
 #if defined(_WIN32)
 #include <direct.h>
+#include <io.h>
 #else
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 // SimpleIni
 #include "simpleini.h"
@@ -58,23 +67,120 @@ static const char * PATH_SEPARATOR = "/";
 static const char * INI_NAME = "maxcalc.ini";
 static const tchar * INI_SECTION = _T("General");
 static const int INI_PATH_LENGTH = 30;
+// Size of buffer for reading batch files
+static const size_t BATCH_BUFFER_SIZE = 1 << 20;
 #if defined(MAXCALC_PORTABLE) && !defined(_WIN32)
 static char * sModulePath = 0;
 #endif
+// Exit code of command line modes
+static int sExitCode = 0;
+// Maximum number of jobs per hardware thread
+static const int MAX_JOBS_PER_THREAD = 4;
+
+/*!
+    \class ProvisionalPrinter
+    \brief Prints provisional result of progressive evaluation, so that
+    it is replaced by the final result on the same line.
+*/
+class ProvisionalPrinter : public Parser::ProgressCallback
+{
+public:
+    /// Constructs printer of results in given \a format.
+    ProvisionalPrinter(const ComplexFormat & format) : mFormat(format), mLength(0)
+    {
+        // Last digits of provisional result may be wrong
+        if (mFormat.precision > Parser::PROVISIONAL_PRECISION - 4) {
+            mFormat.precision = Parser::PROVISIONAL_PRECISION - 4;
+        }
+    }
+
+    /// Prints provisional \a result.
+    void provisionalResult(const Complex & result)
+    {
+        tstring str = result.toTString(mFormat) + _T(" ...");
+        tcout << str << flush;
+        mLength = str.length();
+    }
+
+    /// Erases printed provisional result.
+    void erase()
+    {
+        if (mLength == 0) return;
+        tcout << _T('\r') << tstring(mLength, _T(' ')) << _T('\r');
+        mLength = 0;
+    }
+
+private:
+    ComplexFormat mFormat;
+    size_t mLength;
+};
 
 /*!
     Runs \a parser and prints results to standard output.
+
+    If \a progressive is true, provisional result of a long evaluation is
+    printed first and replaced by the final result (standard output must
+    be a terminal).
 */
-void runParser(Parser & parser)
+void runParser(Parser & parser, bool progressive = false)
 {
+    ProvisionalPrinter printer(parser.context().numberFormat());
     try {
-        ParserContext & context = parser.parse();
-        tcout << context.result().toTString(context.numberFormat()).c_str();
+        ParserContext & context = progressive ?
+            parser.parseProgressive(printer) : parser.parse();
+        printer.erase();
+        context.result().toStream(tcout, context.numberFormat());
     } catch (MaxCalcException & ex) {
+        printer.erase();
         tcout << ex.toString().c_str() << _T('.');
     }
 }
 
+/*!
+    Returns true if standard input and output are a terminal.
+*/
+static bool isTerminal()
+{
+#if defined(_WIN32)
+    return _isatty(_fileno(stdin)) && _isatty(_fileno(stdout));
+#else
+    return isatty(fileno(stdin)) && isatty(fileno(stdout));
+#endif
+}
+
+/*!
+    Converts command line argument \a arg to tstring.
+*/
+static tstring argToTString(const char * arg)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return stringToWideString(arg);
+#else
+    return arg;
+#endif
+}
+
+/*!
+    Parses number of jobs \a arg of --jobs option and stores it in \a jobs.
+
+    Number of jobs is limited to a few per hardware thread. Returns false
+    and prints error if \a arg is not a positive number.
+*/
+static bool parseJobs(const char * arg, int & jobs)
+{
+    char * end = 0;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != 0 || value < 1) {
+        cerr << "Invalid number of jobs '" << arg << "'." << endl;
+        sExitCode = 1;
+        return false;
+    }
+
+    int maxJobs = MAX_JOBS_PER_THREAD * Thread::idealThreadCount();
+    jobs = value > maxJobs ? maxJobs : (int)value;
+    return true;
+}
+
 /*!
     Parse command line arguments.
 
@@ -86,22 +192,92 @@ bool parseCmdLineArgs(int argc, char ** argv)
     if (argc < 2) return false;
 
     if (argc >= 3 && strcmp(argv[1], "-c") == 0) {
-        char * expr = argv[2];
-        string str(expr);
-        tstring tstr;
-#if defined(MAXCALC_UNICODE)
-        tstr = stringToWideString(str);
-#else
-        tstr = str;
-#endif
-
         Parser parser;
-        parser.setExpression(tstr);
+        parser.setExpression(argToTString(argv[2]));
         runParser(parser);
 
         return true;
     }
 
+    // Convert numbers from standard input: --convert unit1->unit2
+    if (argc >= 3 && strcmp(argv[1], "--convert") == 0) {
+        ios_base::sync_with_stdio(false);
+        sExitCode = runBulkConversion(argToTString(argv[2]), tcin, tcout,
+            Thread::idealThreadCount());
+
+        return true;
+    }
+
+    // Evaluate expressions from file or standard input:
+    // --batch [file] [--jobs N]
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        int arg = 2;
+        const char * fileName = 0;
+        if (argc > arg && strncmp(argv[arg], "--", 2) != 0) {
+            fileName = argv[arg++];
+        }
+        int jobs = Thread::idealThreadCount();
+        if (argc > arg + 1 && strcmp(argv[arg], "--jobs") == 0) {
+            if (!parseJobs(argv[arg + 1], jobs)) return true;
+        }
+
+        ios_base::sync_with_stdio(false);
+        if (fileName == 0) {
+            sExitCode = runBatch(tcin, tcout, jobs);
+        } else {
+            vector<tchar> buffer(BATCH_BUFFER_SIZE);
+            basic_ifstream<tchar> file;
+            file.rdbuf()->pubsetbuf(&buffer[0], (streamsize)buffer.size());
+            file.open(fileName);
+            if (!file) {
+                cerr << "Cannot open file '" << fileName << "'." << endl;
+                sExitCode = 1;
+            } else {
+                sExitCode = runBatch(file, tcout, jobs);
+            }
+        }
+
+        return true;
+    }
+
+    // Evaluate expression for rows of CSV file:
+    // --map expr --input file [--jobs N]
+    if (argc >= 5 && strcmp(argv[1], "--map") == 0 &&
+        strcmp(argv[3], "--input") == 0) {
+        int jobs = Thread::idealThreadCount();
+        if (argc >= 7 && strcmp(argv[5], "--jobs") == 0) {
+            if (!parseJobs(argv[6], jobs)) return true;
+        }
+        ios_base::sync_with_stdio(false);
+        sExitCode = runCsvMap(argToTString(argv[2]), argv[4], tcout, jobs);
+
+        return true;
+    }
+
+    // Evaluate requests of clients: --daemon socket [--jobs N]
+    if (argc >= 3 && strcmp(argv[1], "--daemon") == 0) {
+        int jobs = Thread::idealThreadCount();
+        if (argc >= 5 && strcmp(argv[3], "--jobs") == 0) {
+            if (!parseJobs(argv[4], jobs)) return true;
+        }
+        sExitCode = runDaemon(argv[2], jobs);
+
+        return true;
+    }
+
+    // Evaluate expressions from standard input in daemon:
+    // --client socket [--session name]
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0) {
+        tstring session = _T("default");
+        if (argc >= 5 && strcmp(argv[3], "--session") == 0) {
+            session = argToTString(argv[4]);
+        }
+        ios_base::sync_with_stdio(false);
+        sExitCode = runClient(argv[2], session, tcin, tcout);
+
+        return true;
+    }
+
     return false;
 }
 
@@ -228,7 +404,7 @@ int main(int argc, char ** argv)
 
     // Parse command line args
     if (parseCmdLineArgs(argc, argv)) {
-        return 0;
+        return sExitCode;
     }
 
     tstring expr;
@@ -242,6 +418,10 @@ int main(int argc, char ** argv)
     CSimpleIni simpleIni;
     readSettings(&simpleIni, parser.context());
 
+    // Provisional results are replaced in place only on terminal (where
+    // result starts a new line after entered expression)
+    bool progressive = isTerminal();
+
     // Main working loop
     while (true) {
         tcout << _T("> ");
@@ -264,7 +444,7 @@ int main(int argc, char ** argv)
         }
 
         parser.setExpression(expr);
-        runParser(parser);
+        runParser(parser, progressive);
         tcout << endl;
     }
 
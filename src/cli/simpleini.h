@@ -209,7 +209,7 @@
 # pragma warning (disable: 4127 4503 4702 4786)
 #endif
 
-#ifdef MAXCALC_UNICODE
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
 #define _UNICODE
 #endif
 
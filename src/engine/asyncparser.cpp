@@ -0,0 +1,292 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "asyncparser.h"
+#include "parser.h"
+#include "thread.h"
+#include "exceptions.h"
+// STL
+#include <deque>
+
+using namespace std;
+
+
+/*!
+    \class Evaluation
+    \brief Evaluation of an expression by AsyncParser.
+
+    Evaluation is shared by AsyncParser and its caller using
+    EvaluationPointer; it works like a future: wait() blocks until the
+    evaluation is finished, and then context() contains the result and
+    variables changed by the expression. Context passed to AsyncParser is
+    not modified; it is up to the caller to apply the new context.
+
+    Progressive evaluation of a long expression calculates provisional
+    result with low precision first (see Parser::parseProgressive()); it
+    can be read by provisionalResult() before the evaluation is finished.
+
+    \sa AsyncParser
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Constructs a new evaluation of \a expr in a copy of \a context.
+    \a progressive evaluation calculates provisional result first.
+*/
+Evaluation::Evaluation(const tstring & expr, const ParserContext & context,
+                       bool progressive)
+    : mExpr(expr), mContext(context), mSucceeded(false), mCancelled(false),
+      mProgressive(progressive), mHasProvisionalResult(false), mFinished(false)
+{
+}
+
+/*!
+    Requests cancellation of the evaluation. Evaluation which is not
+    started yet is not evaluated at all; running evaluation is stopped
+    by EvaluationLimitException at the next check of the budget.
+*/
+void Evaluation::cancel() const
+{
+    mToken.cancel();
+}
+
+/*!
+    Blocks until the evaluation is finished.
+*/
+void Evaluation::wait() const
+{
+    MutexLocker locker(mMutex);
+    while (!mFinished) {
+        mFinishedCondition.wait(mMutex);
+    }
+}
+
+/*!
+    Returns true if the evaluation is finished (results can be read).
+*/
+bool Evaluation::isFinished() const
+{
+    MutexLocker locker(mMutex);
+    return mFinished;
+}
+
+/*!
+    Returns true if provisional result of progressive evaluation is
+    calculated.
+*/
+bool Evaluation::hasProvisionalResult() const
+{
+    MutexLocker locker(mMutex);
+    return mHasProvisionalResult;
+}
+
+/*!
+    Returns provisional result of progressive evaluation (valid when
+    hasProvisionalResult() is true).
+*/
+Complex Evaluation::provisionalResult() const
+{
+    MutexLocker locker(mMutex);
+    return mProvisionalResult;
+}
+
+/*!
+    Stores provisional \a result.
+*/
+void Evaluation::setProvisionalResult(const Complex & result)
+{
+    MutexLocker locker(mMutex);
+    mProvisionalResult = result;
+    mHasProvisionalResult = true;
+}
+
+/*!
+    Evaluates the expression in the calling thread and wakes up waiting
+    threads. Provisional result of progressive evaluation is passed to
+    \a progress.
+*/
+void Evaluation::run(Parser::ProgressCallback * progress)
+{
+    CancellationToken * token = mContext.cancellationToken();
+    mContext.setCancellationToken(&mToken);
+    try {
+        if (mToken.isCancelled()) {
+            throw EvaluationLimitException(EvaluationLimitException::CANCELLED);
+        }
+        Parser parser(mExpr, mContext);
+        if (mProgressive && progress != 0) parser.parseProgressive(*progress);
+        else parser.parse();
+        mContext = parser.context();
+        mSucceeded = true;
+    } catch (EvaluationLimitException & ex) {
+        mCancelled = (ex.reason() == EvaluationLimitException::CANCELLED);
+        mError = ex.toString();
+    } catch (MaxCalcException & ex) {
+        mError = ex.toString();
+    }
+    mContext.setCancellationToken(token);
+
+    MutexLocker locker(mMutex);
+    mFinished = true;
+    mFinishedCondition.wakeAll();
+}
+
+
+/*!
+    \class AsyncParser
+    \brief Evaluates expressions in a worker thread.
+
+    evaluate() returns immediately; expressions are evaluated one by one in
+    the order of evaluate() calls. Caller can wait for Evaluation, poll it
+    or receive it in Callback (which is called in the worker thread, so GUI
+    has to pass it to its thread, for example by a queued signal). Callback
+    is also notified about provisional results of progressive evaluations.
+
+    Each evaluation has its own cancellation token which replaces the token
+    of the context (time limit and operation budget of the context are
+    kept).
+
+    \sa Evaluation
+    \ingroup MaxCalcEngine
+*/
+
+// Thread which evaluates queued evaluations
+class AsyncParser::Worker : public Thread, private Parser::ProgressCallback
+{
+public:
+    Worker(Callback * callback) : mCallback(callback), mStop(false) { }
+
+    void add(const EvaluationPointer & evaluation)
+    {
+        MutexLocker locker(mMutex);
+        mQueue.push_back(evaluation);
+        mCondition.wakeOne();
+    }
+
+    void cancelAll()
+    {
+        MutexLocker locker(mMutex);
+        for (size_t i = 0; i < mQueue.size(); ++i) {
+            mQueue[i]->cancel();
+        }
+        if (!mCurrent.isNull()) mCurrent->cancel();
+    }
+
+    void stop()
+    {
+        cancelAll();
+        MutexLocker locker(mMutex);
+        mStop = true;
+        mCondition.wakeOne();
+    }
+
+    bool isBusy()
+    {
+        MutexLocker locker(mMutex);
+        return !mQueue.empty() || !mCurrent.isNull();
+    }
+
+protected:
+    void run()
+    {
+        while (true) {
+            {
+                MutexLocker locker(mMutex);
+                while (mQueue.empty() && !mStop) {
+                    mCondition.wait(mMutex);
+                }
+                // Evaluations left after stop() are cancelled and finish at once
+                if (mQueue.empty()) return;
+                mCurrent = mQueue.front();
+                mQueue.pop_front();
+            }
+
+            // Results are written only by this thread until evaluation is finished
+            const_cast<Evaluation *>(mCurrent.constData())->run(this);
+            if (mCallback) mCallback->evaluationFinished(mCurrent);
+
+            MutexLocker locker(mMutex);
+            mCurrent = EvaluationPointer();
+        }
+    }
+
+    // Stores provisional result of the current evaluation
+    void provisionalResult(const Complex & result)
+    {
+        const_cast<Evaluation *>(mCurrent.constData())->setProvisionalResult(result);
+        if (mCallback) mCallback->provisionalResultReady(mCurrent);
+    }
+
+private:
+    Callback * mCallback;
+    bool mStop;
+    Mutex mMutex;
+    WaitCondition mCondition;
+    deque<EvaluationPointer> mQueue;
+    EvaluationPointer mCurrent;
+};
+
+/*!
+    Constructs a new parser and starts its worker thread. \a callback (if
+    it is given) is called for each finished evaluation.
+*/
+AsyncParser::AsyncParser(Callback * callback)
+{
+    mWorker = new Worker(callback);
+    mWorker->start();
+}
+
+/*!
+    Cancels all evaluations and waits for the worker thread.
+*/
+AsyncParser::~AsyncParser()
+{
+    mWorker->stop();
+    mWorker->wait();
+    delete mWorker;
+}
+
+/*!
+    Queues evaluation of \a expr in a copy of \a context and returns it.
+    \a progressive evaluation calculates provisional result first.
+*/
+EvaluationPointer AsyncParser::evaluate(const tstring & expr, const ParserContext & context,
+                                        bool progressive)
+{
+    EvaluationPointer evaluation(new Evaluation(expr, context, progressive));
+    mWorker->add(evaluation);
+    return evaluation;
+}
+
+/*!
+    Cancels all queued and running evaluations.
+*/
+void AsyncParser::cancelAll()
+{
+    mWorker->cancelAll();
+}
+
+/*!
+    Returns true if there are queued or running evaluations.
+*/
+bool AsyncParser::isBusy() const
+{
+    return mWorker->isBusy();
+}
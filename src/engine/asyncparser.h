@@ -0,0 +1,111 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef ASYNCPARSER_H
+#define ASYNCPARSER_H
+
+// Local
+#include "parser.h"
+#include "parsercontext.h"
+#include "operationbudget.h"
+#include "shareddata.h"
+#include "mutex.h"
+#include "unicode.h"
+
+
+class Evaluation : public SharedData
+{
+public:
+    Evaluation(const tstring & expr, const ParserContext & context,
+               bool progressive = false);
+
+    void cancel() const;
+    void wait() const;
+    bool isFinished() const;
+    bool hasProvisionalResult() const;
+    Complex provisionalResult() const;
+
+    /// Returns evaluated expression.
+    const tstring & expression() const { return mExpr; }
+    /// Returns context after evaluation (valid when evaluation is finished).
+    const ParserContext & context() const { return mContext; }
+    /// Returns true if expression is evaluated without errors.
+    bool succeeded() const { return mSucceeded; }
+    /// Returns true if evaluation was stopped by cancel().
+    bool isCancelled() const { return mCancelled; }
+    /// Returns error message if evaluation failed.
+    const tstring & error() const { return mError; }
+
+private:
+    tstring mExpr;                      ///< Expression.
+    ParserContext mContext;             ///< Context of evaluation.
+    mutable CancellationToken mToken;   ///< Token checked during evaluation.
+    bool mSucceeded;                    ///< True if evaluation succeeded.
+    bool mCancelled;                    ///< True if evaluation was cancelled.
+    tstring mError;                     ///< Error message.
+    bool mProgressive;                  ///< True if provisional result is calculated.
+    bool mHasProvisionalResult;         ///< True if there is provisional result.
+    Complex mProvisionalResult;         ///< Provisional result.
+    bool mFinished;                     ///< True if evaluation is finished.
+    mutable Mutex mMutex;               ///< Protects mFinished and provisional result.
+    mutable WaitCondition mFinishedCondition;
+
+    void run(Parser::ProgressCallback * progress);
+    void setProvisionalResult(const Complex & result);
+
+    friend class AsyncParser;
+
+    Evaluation(const Evaluation &);
+    Evaluation & operator=(const Evaluation &);
+};
+
+typedef SharedDataPointer<Evaluation> EvaluationPointer;
+
+
+class AsyncParser
+{
+public:
+    /// Receives finished evaluations; called in the worker thread.
+    class Callback
+    {
+    public:
+        virtual ~Callback() { }
+        virtual void evaluationFinished(const EvaluationPointer & evaluation) = 0;
+        /// Called when progressive evaluation has provisional result.
+        virtual void provisionalResultReady(const EvaluationPointer & /*evaluation*/) { }
+    };
+
+    AsyncParser(Callback * callback = 0);
+    ~AsyncParser();
+
+    EvaluationPointer evaluate(const tstring & expr, const ParserContext & context,
+                               bool progressive = false);
+    void cancelAll();
+    bool isBusy() const;
+
+private:
+    class Worker;
+    Worker * mWorker;
+
+    AsyncParser(const AsyncParser &);
+    AsyncParser & operator=(const AsyncParser &);
+};
+
+
+#endif // ASYNCPARSER_H
@@ -21,11 +21,20 @@
 #include "bigdecimal.h"
 #include "exceptions.h"
 #include "constants.h"
+#include "operationbudget.h"
 #include "unicode.h"
 // STL
 #include <cassert>
+#include <cmath>
 #include <sstream>
 
+// Thread-local storage
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 
 /*!
     \defgroup MaxCalcEngine MaxCalc Engine
@@ -41,6 +50,8 @@
     
     Precision settings of BigDecimal are hard-written and defined in precision.h,
     so MaxCalcEngine has to be recompiled in order to change precision.
+    Calculations may be done with lower precision in a scope of
+    WorkingPrecision object.
 
     When converting to string, number format is specified by BigDecimalFormat class.
 
@@ -71,11 +82,47 @@
 
 
 // Macro for creating new decContext with default settings and working precision
-#define NEW_CONTEXT(context) NEW_PRECISE_CONTEXT(context, Constants::WORKING_PRECISION)
+#define NEW_CONTEXT(context) NEW_PRECISE_CONTEXT(context, WorkingPrecision::digits())
 
 // Macro for creating new decContext with default settings and max IO precision
 #define NEW_IO_CONTEXT(context) NEW_PRECISE_CONTEXT(context, Constants::MAX_IO_PRECISION)
 
+// Working precision of the current thread (0 means WORKING_PRECISION)
+static THREAD_LOCAL int sWorkingPrecision = 0;
+
+// 1E-N for working precision N of the current thread (see precisionLimit())
+static THREAD_LOCAL decNumber sPrecisionLimit;
+// Working precision of sPrecisionLimit (0 if it is not calculated yet)
+static THREAD_LOCAL int sPrecisionLimitDigits = 0;
+
+// Size of buffer for decNumberToString() output of a number rounded to any
+// precision (it never has more than DECNUMDIGITS digits)
+#define DEC_STRING_SIZE (DECNUMDIGITS + 14)
+
+// Copies decNumberToString() output to buffer of given size replacing 'E'
+// and '.' according to format; returns length of str
+template <class Char>
+static size_t emitNumber(const char * str, Char * buffer, size_t size,
+                         const BigDecimalFormat & format)
+{
+    const Char exponentChar =
+        (format.exponentCase == BigDecimalFormat::LOWER_CASE_EXPONENT) ? 'e' : 'E';
+    const Char separatorChar = format.decimalSeparatorChar();
+
+    size_t length = 0;
+    for (; str[length] != 0; ++length) {
+        if (length + 1 < size) {
+            char c = str[length];
+            buffer[length] = (c == '.') ? separatorChar :
+                             (c == 'E') ? exponentChar : (Char)c;
+        }
+    }
+    if (size > 0) {
+        buffer[length < size ? length : size - 1] = 0;
+    }
+    return length;
+}
+
 /*!
     E number.
 */
@@ -193,66 +240,38 @@ BigDecimal::BigDecimal(const double num)
 
     If \a format is not specified, the default BigDecimalFormat is used.
 
-    \sa BigDecimalFormat
+    \sa BigDecimalFormat, toBuffer()
 */
 string BigDecimal::toString(const BigDecimalFormat & format) const
 {
-    NEW_PRECISE_CONTEXT(context, format.precision);
-
-    decNumber num;
-
-    // Remove trailing zeros and round to needed precision
-    decNumberReduce(&num, &mNumber, &context);
-    checkContextStatus(context);
-
-    // To prevent "-0" output
-    if (decNumberIsZero(&num) && decNumberIsNegative(&num)) {
-        decNumberMinus(&num, &num, &context);
-        checkContextStatus(context);
-    }
-
-    // Make conversion
-    string result;
     int base = (mBase == 0) ? format.base : mBase;
     if (base == 10) {
-        char * str = new char[format.precision + 14];
-        decNumberToString(&num, str, (uint8_t)format.numberFormat);
-        result = str;
-        delete[] str;
-    } else {
-        if (isNegative() || !fractional().isZero()) {
-            throw ArithmeticException(
-                    ArithmeticException::INVALID_BASE_CONVERSION);
-        }
-        if (base < 2 || base > 36) {
-            throw ArithmeticException(ArithmeticException::INVALID_BASE);
-        }
-        BigDecimal n = *this;
-        BigDecimal b = base;
-        BigDecimal rem;
-        char digit;
-        while (!n.isZero()) {
-            rem = n % b;
-            n = div(n, b);
-            digit = rem.toInt() + (rem < 10 ? '0' : 'A' - 10);
-            result = digit + result;
-        }
-        result = b.toString() + '#' + result;
+        char str[DEC_STRING_SIZE];
+        toDecNumberString(str, format);
+        emitNumber(str, str, sizeof(str), format);
+        return str;
     }
 
-    // Replace 'E' with 'e' if needed
-    if (format.exponentCase == BigDecimalFormat::LOWER_CASE_EXPONENT) {
-        size_t expPos = result.find('E');
-        if (expPos != string::npos) result.replace(expPos, 1, "e");
+    if (isNegative() || !fractional().isZero()) {
+        throw ArithmeticException(
+                ArithmeticException::INVALID_BASE_CONVERSION);
     }
-
-    // Replace '.' with ',' if needed
-    if (format.decimalSeparator == BigDecimalFormat::COMMA_SEPARATOR) {
-        size_t expPos = result.find('.');
-        if (expPos != string::npos) result.replace(expPos, 1, ",");
+    if (base < 2 || base > 36) {
+        throw ArithmeticException(ArithmeticException::INVALID_BASE);
     }
-
-    return result;
+    string result;
+    BigDecimal n = *this;
+    BigDecimal b = base;
+    BigDecimal rem;
+    char digit;
+    while (!n.isZero()) {
+        OperationBudget::charge();
+        rem = n % b;
+        n = div(n, b);
+        digit = rem.toInt() + (rem < 10 ? '0' : 'A' - 10);
+        result = digit + result;
+    }
+    return b.toString() + '#' + result;
 }
 
 #if defined(MAXCALC_UNICODE)
@@ -280,13 +299,54 @@ wstring BigDecimal::toWideString(const BigDecimalFormat & format) const
 */
 tstring BigDecimal::toTString(const BigDecimalFormat & format) const
 {
-#if defined(MAXCALC_UNICODE)
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
     return toWideString(format);
 #else
     return toString(format);
 #endif
 }
 
+/*!
+    Writes this number to \a buffer of \a size characters using given
+    BigDecimalFormat.
+
+    The result is always terminated with zero and is truncated if it does not
+    fit into the buffer. No memory is allocated for numbers in base 10.
+
+    \returns Length of the whole result (not including terminating zero);
+    if it is not less than \a size, the result was truncated.
+    \sa BigDecimalFormat, toStream()
+*/
+size_t BigDecimal::toBuffer(tchar * buffer, size_t size,
+                            const BigDecimalFormat & format) const
+{
+    int base = (mBase == 0) ? format.base : mBase;
+    if (base == 10) {
+        char str[DEC_STRING_SIZE];
+        toDecNumberString(str, format);
+        return emitNumber(str, buffer, size, format);
+    }
+
+    // Numbers in other bases can be longer than DEC_STRING_SIZE
+    return emitNumber(toString(format).c_str(), buffer, size, BigDecimalFormat());
+}
+
+/*!
+    Writes this number to \a stream using given BigDecimalFormat.
+
+    \sa BigDecimalFormat, toBuffer()
+*/
+void BigDecimal::toStream(tostream & stream, const BigDecimalFormat & format) const
+{
+    tchar buffer[DEC_STRING_SIZE];
+    size_t length = toBuffer(buffer, DEC_STRING_SIZE, format);
+    if (length < DEC_STRING_SIZE) {
+        stream.write(buffer, (std::streamsize)length);
+    } else {
+        stream << toTString(format);
+    }
+}
+
 /*!
     Converts this number to int.
 
@@ -345,6 +405,146 @@ unsigned BigDecimal::toUInt() const
     return result;
 }
 
+/*!
+    Converts this number to double.
+
+    Numbers which are too big for double are converted to infinity and
+    numbers which are too small are converted to zero.
+*/
+double BigDecimal::toDouble() const
+{
+    char str[DEC_STRING_SIZE];
+    decNumberToString(&mNumber, str, (uint8_t)BigDecimalFormat::SCIENTIFIC_FORMAT);
+    std::istringstream stream(str);
+    double result = 0;
+    stream >> result;
+    if (stream.fail()) {
+        if (adjustedExponent() < 0) return 0;
+        result = HUGE_VAL;
+    }
+    return isNegative() ? -fabs(result) : fabs(result);
+}
+
+/*!
+    Returns adjusted exponent of this number, that is exponent of its most
+    significant digit (2 for 123.4, -2 for 0.05, 0 for zero).
+*/
+int BigDecimal::adjustedExponent() const
+{
+    if (isZero()) return 0;
+    return mNumber.digits + mNumber.exponent - 1;
+}
+
+// Size of packed number header: flags, exponent and number of digits
+static const size_t PACKED_HEADER_SIZE = 7;
+
+/*!
+    Packs this number into \a buffer which must have at least
+    MAX_PACKED_SIZE bytes.
+
+    Packed number is a byte with flags (sign, infinity, NaN), exponent as
+    4-byte and number of digits as 2-byte little-endian integers, and
+    coefficient in BCD with two digits per byte (most significant first).
+    It doesn't depend on byte order or DECDPUN, so packed numbers can be
+    written to files.
+
+    Returns number of bytes written.
+
+    \sa unpack()
+*/
+size_t BigDecimal::pack(unsigned char * buffer) const
+{
+    uint8_t digits[DECNUMDIGITS];
+    decNumberGetBCD(&mNumber, digits);
+
+    unsigned exponent = (unsigned)mNumber.exponent;
+    buffer[0] = mNumber.bits;
+    buffer[1] = (unsigned char)exponent;
+    buffer[2] = (unsigned char)(exponent >> 8);
+    buffer[3] = (unsigned char)(exponent >> 16);
+    buffer[4] = (unsigned char)(exponent >> 24);
+    buffer[5] = (unsigned char)mNumber.digits;
+    buffer[6] = (unsigned char)(mNumber.digits >> 8);
+
+    unsigned char * coefficient = buffer + PACKED_HEADER_SIZE;
+    for (int i = 0; i < mNumber.digits; i += 2) {
+        unsigned char low = (i + 1 < mNumber.digits) ? digits[i + 1] : 0;
+        *coefficient++ = (unsigned char)((digits[i] << 4) | low);
+    }
+    return coefficient - buffer;
+}
+
+/*!
+    Returns size of packed number at \a buffer or 0 if \a available bytes
+    are not enough for it or it is not a valid packed number.
+
+    The whole number is checked (flags, exponent range and every digit of
+    coefficient), so a number which passed this check is unpacked without
+    errors.
+*/
+size_t BigDecimal::packedSize(const unsigned char * buffer, size_t available)
+{
+    if (available < PACKED_HEADER_SIZE) return 0;
+    if (buffer[0] & ~(DECNEG | DECINF | DECNAN | DECSNAN)) return 0;
+    int digits = buffer[5] | (buffer[6] << 8);
+    if (digits < 1 || digits > DECNUMDIGITS) return 0;
+    size_t size = PACKED_HEADER_SIZE + (digits + 1) / 2;
+    if (size > available) return 0;
+
+    // Exponent of a number which can be produced in any working precision
+    int32_t exponent = (int32_t)((unsigned)buffer[1] |
+        ((unsigned)buffer[2] << 8) | ((unsigned)buffer[3] << 16) |
+        ((unsigned)buffer[4] << 24));
+    if (exponent < -DEC_MAX_MATH - (DECNUMDIGITS - 1) ||
+        exponent > DEC_MAX_MATH - (digits - 1)) {
+        return 0;
+    }
+
+    // Digits; padding nibble is zero and there are no leading zeros
+    const unsigned char * coefficient = buffer + PACKED_HEADER_SIZE;
+    if (digits > 1 && (coefficient[0] >> 4) == 0) return 0;
+    for (int i = 0; i < digits; i += 2, ++coefficient) {
+        if ((*coefficient >> 4) > 9) return 0;
+        if (i + 1 < digits ? (*coefficient & 0x0F) > 9 : (*coefficient & 0x0F) != 0) return 0;
+    }
+    return size;
+}
+
+/*!
+    Unpacks number packed by pack() from \a buffer. If \a size is not 0,
+    number of bytes read is stored there.
+
+    \exception ArithmeticException(CONVERSION_IMPOSSIBLE) \a buffer doesn't
+        contain valid packed number.
+*/
+BigDecimal BigDecimal::unpack(const unsigned char * buffer, size_t * size)
+{
+    size_t packed = packedSize(buffer, MAX_PACKED_SIZE);
+    if (packed == 0) {
+        throw ArithmeticException(ArithmeticException::CONVERSION_IMPOSSIBLE);
+    }
+
+    int digitCount = buffer[5] | (buffer[6] << 8);
+    uint8_t digits[DECNUMDIGITS + 1];
+    const unsigned char * coefficient = buffer + PACKED_HEADER_SIZE;
+    for (int i = 0; i < digitCount; i += 2, ++coefficient) {
+        digits[i] = *coefficient >> 4;
+        digits[i + 1] = *coefficient & 0x0F;
+    }
+
+    BigDecimal result;
+    // decNumberSetBCD() finds the most significant unit using digits
+    result.mNumber.digits = digitCount;
+    decNumberSetBCD(&result.mNumber, digits, digitCount);
+    result.mNumber.exponent = (int32_t)((unsigned)buffer[1] |
+        ((unsigned)buffer[2] << 8) | ((unsigned)buffer[3] << 16) |
+        ((unsigned)buffer[4] << 24));
+    result.mNumber.bits = buffer[0];
+
+    if (size != 0) *size = packed;
+    return result;
+}
+
 
 //****************************************************************************
 // Misc functions
@@ -484,9 +684,9 @@ BigDecimal BigDecimal::operator-() const
 /*!
     Increases this number by one (prefix increment).
 */
-BigDecimal BigDecimal::operator++()
+BigDecimal & BigDecimal::operator++()
 {
-    return (*this = *this + 1);
+    return (*this += 1);
 }
 
 /*!
@@ -502,9 +702,9 @@ BigDecimal BigDecimal::operator++(int)
 /*!
     Decreases this number by one (prefix increment).
 */
-BigDecimal BigDecimal::operator--()
+BigDecimal & BigDecimal::operator--()
 {
-    return (*this = *this - 1);
+    return (*this -= 1);
 }
 
 /*!
@@ -543,14 +743,16 @@ BigDecimal BigDecimal::operator-(const BigDecimal & num) const
 
 /*!
     Multiplies two numbers.
+
+    The multiplication itself is deferred: returned BigDecimalProduct is
+    converted to BigDecimal when needed or fused with the following addition
+    or subtraction.
+
+    \sa BigDecimalProduct
 */
-BigDecimal BigDecimal::operator*(const BigDecimal & num) const
+BigDecimalProduct BigDecimal::operator*(const BigDecimal & num) const
 {
-    NEW_CONTEXT(context);
-    decNumber result;
-    decNumberMultiply(&result, &mNumber, &num.mNumber, &context);
-    checkContextStatus(context);
-    return result;
+    return BigDecimalProduct(*this, num);
 }
 
 /*!
@@ -592,7 +794,7 @@ BigDecimal BigDecimal::operator%(const BigDecimal & num) const
 /*!
     Adds \a num to this number.
 */
-BigDecimal BigDecimal::operator+=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator+=(const BigDecimal & num)
 {
     NEW_CONTEXT(context);
     decNumberAdd(&mNumber, &mNumber, &num.mNumber, &context);
@@ -603,7 +805,7 @@ BigDecimal BigDecimal::operator+=(const BigDecimal & num)
 /*!
     Subtracts \a num from this number.
 */
-BigDecimal BigDecimal::operator-=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator-=(const BigDecimal & num)
 {
     NEW_CONTEXT(context);
     decNumberSubtract(&mNumber, &mNumber, &num.mNumber, &context);
@@ -614,7 +816,7 @@ BigDecimal BigDecimal::operator-=(const BigDecimal & num)
 /*!
     Multiplies this number by \a num.
 */
-BigDecimal BigDecimal::operator*=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator*=(const BigDecimal & num)
 {
     NEW_CONTEXT(context);
     decNumberMultiply(&mNumber, &mNumber, &num.mNumber, &context);
@@ -627,7 +829,7 @@ BigDecimal BigDecimal::operator*=(const BigDecimal & num)
 
     \exception ArithmeticException(DIVISION_BY_ZERO) Zero \a num is given.
 */
-BigDecimal BigDecimal::operator/=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator/=(const BigDecimal & num)
 {
     if (num.isZero()) {
         throw ArithmeticException(ArithmeticException::DIVISION_BY_ZERO);
@@ -644,7 +846,7 @@ BigDecimal BigDecimal::operator/=(const BigDecimal & num)
 
     \exception ArithmeticException(DIVISION_BY_ZERO) Zero \a num is given.
 */
-BigDecimal BigDecimal::operator%=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator%=(const BigDecimal & num)
 {
     if (num.isZero()) {
         throw ArithmeticException(ArithmeticException::DIVISION_BY_ZERO);
@@ -656,6 +858,22 @@ BigDecimal BigDecimal::operator%=(const BigDecimal & num)
     return *this;
 }
 
+/*!
+    Adds \a product to this number with a single rounding.
+*/
+BigDecimal & BigDecimal::operator+=(const BigDecimalProduct & product)
+{
+    return (*this = FMA(product, *this));
+}
+
+/*!
+    Subtracts \a product from this number with a single rounding.
+*/
+BigDecimal & BigDecimal::operator-=(const BigDecimalProduct & product)
+{
+    return (*this = FMA(-product, *this));
+}
+
 /*!
     Calculates digit-wise invertion of this number.
 
@@ -779,7 +997,7 @@ BigDecimal BigDecimal::operator>>(const BigDecimal & shift) const
     \exception ArithmeticException(INVALID_OPERATION_ON_FRACTIONAL_NUMBER)
         Fractional number is given.
 */
-BigDecimal BigDecimal::operator|=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator|=(const BigDecimal & num)
 {
     if (!fractional().isZero() || !num.fractional().isZero()) {
         throw ArithmeticException(ArithmeticException::INVALID_OPERATION_ON_FRACTIONAL_NUMBER);
@@ -797,7 +1015,7 @@ BigDecimal BigDecimal::operator|=(const BigDecimal & num)
     \exception ArithmeticException(INVALID_OPERATION_ON_FRACTIONAL_NUMBER)
         Fractional number is given.
 */
-BigDecimal BigDecimal::operator&=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator&=(const BigDecimal & num)
 {
     if (!fractional().isZero() || !num.fractional().isZero()) {
         throw ArithmeticException(ArithmeticException::INVALID_OPERATION_ON_FRACTIONAL_NUMBER);
@@ -815,7 +1033,7 @@ BigDecimal BigDecimal::operator&=(const BigDecimal & num)
     \exception ArithmeticException(INVALID_OPERATION_ON_FRACTIONAL_NUMBER)
         Fractional number is given.
 */
-BigDecimal BigDecimal::operator^=(const BigDecimal & num)
+BigDecimal & BigDecimal::operator^=(const BigDecimal & num)
 {
     if (!fractional().isZero() || !num.fractional().isZero()) {
         throw ArithmeticException(ArithmeticException::INVALID_OPERATION_ON_FRACTIONAL_NUMBER);
@@ -833,7 +1051,7 @@ BigDecimal BigDecimal::operator^=(const BigDecimal & num)
     \exception ArithmeticException(INVALID_OPERATION_ON_FRACTIONAL_NUMBER)
         Fractional number is given.
 */
-BigDecimal BigDecimal::operator<<=(const BigDecimal & shift)
+BigDecimal & BigDecimal::operator<<=(const BigDecimal & shift)
 {
     if (!fractional().isZero() || !shift.fractional().isZero()) {
         throw ArithmeticException(ArithmeticException::INVALID_OPERATION_ON_FRACTIONAL_NUMBER);
@@ -851,7 +1069,7 @@ BigDecimal BigDecimal::operator<<=(const BigDecimal & shift)
     \exception ArithmeticException(INVALID_OPERATION_ON_FRACTIONAL_NUMBER)
         Fractional number is given.
 */
-BigDecimal BigDecimal::operator>>=(const BigDecimal & shift)
+BigDecimal & BigDecimal::operator>>=(const BigDecimal & shift)
 {
     if (!fractional().isZero() || !shift.fractional().isZero()) {
         throw ArithmeticException(ArithmeticException::INVALID_OPERATION_ON_FRACTIONAL_NUMBER);
@@ -1035,6 +1253,13 @@ BigDecimal BigDecimal::pow(const BigDecimal & num, const BigDecimal & power)
             InvalidArgumentException::POWER_FUNCTION);
     }
 
+    // Integer power takes a few multiplications per digit of the power
+    // (powers with more than 10 digits are calculated using exp() and ln())
+    int powerDigits = power.mNumber.digits + power.mNumber.exponent;
+    if (powerDigits < 0) powerDigits = 0;
+    if (powerDigits > 10) powerDigits = 10;
+    OperationBudget::charge(1 + 4 * (unsigned long)powerDigits);
+
     NEW_CONTEXT(context);
     decNumber result;
     decNumberPower(&result, &num.mNumber, &power.mNumber, &context);
@@ -1118,6 +1343,7 @@ BigDecimal BigDecimal::factorial(const BigDecimal & num)
     const unsigned split = 10;
     unsigned limit = max / split;
     for (unsigned i = 0; i < limit; ++i) {
+        OperationBudget::charge(split + 1);
         group = 1;
         for (unsigned j = i * split + 1; j <= (i+1) * split; ++j) {
             group *= j;
@@ -1128,6 +1354,7 @@ BigDecimal BigDecimal::factorial(const BigDecimal & num)
     // Multiply last numbers which are not in any group
     limit = limit * split + 1;
     for (unsigned i = limit; i <= max; ++i) {
+        OperationBudget::charge();
         result *= i;
     }
 
@@ -1144,16 +1371,18 @@ BigDecimal BigDecimal::sin(const BigDecimal & num)
     BigDecimal result = angle, fraction = angle, count = 2;
     BigDecimal numerator = angle, denominator = 1;
     BigDecimal sqrNum = sqr(angle);
+    const BigDecimal limit = precisionLimit();
 
-    while (abs(fraction) > Constants::WORKING_PRECISION_STRING) {
+    while (abs(fraction) > limit) {
+        OperationBudget::charge();
         numerator *= sqrNum;
-        denominator *= FMA(count, count, count);
+        denominator *= count * count + count;
         count += 2;
         fraction = numerator / denominator;
         result -= fraction;
 
         numerator *= sqrNum;
-        denominator *= FMA(count, count, count);
+        denominator *= count * count + count;
         count += 2;
         fraction = numerator / denominator;
         result += fraction;
@@ -1179,16 +1408,18 @@ BigDecimal BigDecimal::cos(const BigDecimal & num)
     BigDecimal result = 1, fraction = 1, count = 1;
     BigDecimal numerator = 1, denominator = 1;
     BigDecimal sqrNum = sqr(angle);
+    const BigDecimal limit = precisionLimit();
 
-    while (abs(fraction) > Constants::WORKING_PRECISION_STRING) {
+    while (abs(fraction) > limit) {
+        OperationBudget::charge();
         numerator *= sqrNum;
-        denominator *= FMA(count, count, count);
+        denominator *= count * count + count;
         count += 2;
         fraction = numerator / denominator;
         result -= fraction;
 
         numerator *= sqrNum;
-        denominator *= FMA(count, count, count);
+        denominator *= count * count + count;
         count += 2;
         fraction = numerator / denominator;
         result += fraction;
@@ -1258,7 +1489,7 @@ BigDecimal BigDecimal::arcsin(const BigDecimal & num)
             InvalidArgumentException::ARCSINE_FUNCTION);
     }
 
-    return arctan(num / sqrt(-sqr(num) + 1));
+    return arctan(num / sqrt(BigDecimal(1) - num * num));
 }
 
 /*!
@@ -1285,13 +1516,15 @@ BigDecimal BigDecimal::arccos(const BigDecimal & num)
 BigDecimal BigDecimal::arctan(const BigDecimal & num)
 {
     if (abs(num) > BigDecimal("0.5")) {
-        return arctan(num / (sqrt(sqr(num) + 1) + 1)) * 2;
+        return arctan(num / (sqrt(num * num + 1) + 1)) * 2;
     } else {
         BigDecimal fraction = num, result = num;
         BigDecimal numerator = num, denominator = 1;
+        const BigDecimal limit = precisionLimit();
 
-        while (abs(fraction) > Constants::WORKING_PRECISION_STRING) {
-            numerator *= -num * num;
+        while (abs(fraction) > limit) {
+            OperationBudget::charge();
+            numerator *= -(num * num);
             denominator += 2;
             fraction = numerator / denominator;
             result += fraction;
@@ -1352,6 +1585,30 @@ void BigDecimal::construct(const string & str)
     mBase = 0;
 }
 
+/*!
+    Rounds this number to precision of \a format and converts it to \a str
+    using decNumberToString(); \a str must have space for DEC_STRING_SIZE
+    characters.
+*/
+void BigDecimal::toDecNumberString(char * str, const BigDecimalFormat & format) const
+{
+    NEW_PRECISE_CONTEXT(context, format.precision);
+
+    decNumber num;
+
+    // Remove trailing zeros and round to needed precision
+    decNumberReduce(&num, &mNumber, &context);
+    checkContextStatus(context);
+
+    // To prevent "-0" output
+    if (decNumberIsZero(&num) && decNumberIsNegative(&num)) {
+        decNumberMinus(&num, &num, &context);
+        checkContextStatus(context);
+    }
+
+    decNumberToString(&num, str, (uint8_t)format.numberFormat);
+}
+
 /*!
     Checks \a context.status and throws ArithmeticException if there is an error.
 */
@@ -1413,7 +1670,7 @@ void BigDecimal::rescale(decNumber & number, const int exp, decContext & context
     (http://en.wikipedia.org/wiki/Gauss%E2%80%93Legendre_algorithm).
     Calculation continies while difference between a(n) and b(n)
     is more than calculationPrecision. calculationPrecision is
-    1E-N, where N is WORKING_PRECISION.
+    1E-N, where N is working precision (see WorkingPrecision).
 
     \sa WORKING_PRECISION
     \sa http://en.wikipedia.org/wiki/Gauss%E2%80%93Legendre_algorithm
@@ -1424,8 +1681,9 @@ BigDecimal BigDecimal::pi()
     BigDecimal b = BigDecimal(1) / sqrt(2);
     BigDecimal t = BigDecimal("0.25");
     BigDecimal p = 1;
+    const BigDecimal limit = precisionLimit();
 
-    while (abs(a - b) > Constants::WORKING_PRECISION_STRING) {
+    while (abs(a - b) > limit) {
         a_old = a;
         a = (a + b) / 2;
         b = sqrt(a_old * b);
@@ -1437,17 +1695,283 @@ BigDecimal BigDecimal::pi()
 }
 
 /*!
-    Calculates multiplier1 * multiplier2 + summand
+    Returns 1E-N, where N is working precision of the current thread;
+    series are summed while their terms are bigger.
+
+    The limit is kept for each thread and is calculated again only when
+    working precision of the thread changes.
 */
-BigDecimal BigDecimal::FMA(const BigDecimal & multiplier1,
-                           const BigDecimal & multiplier2,
-                           const BigDecimal & summand)
+BigDecimal BigDecimal::precisionLimit()
+{
+    int digits = WorkingPrecision::digits();
+    if (sPrecisionLimitDigits != digits) {
+        decNumberZero(&sPrecisionLimit);
+        sPrecisionLimit.lsu[0] = 1;
+        sPrecisionLimit.exponent = -digits;
+        sPrecisionLimitDigits = digits;
+    }
+    return BigDecimal(sPrecisionLimit);
+}
+
+/*!
+    Calculates exact \a product into \a result (which has enough space to
+    hold twice as many digits as the working precision).
+*/
+void BigDecimal::multiplyExact(WideDecNumber & result,
+                               const BigDecimalProduct & product)
+{
+    NEW_PRECISE_CONTEXT(context, 2 * WorkingPrecision::digits());
+    context.emax = DEC_MAX_EMAX;
+    context.emin = DEC_MIN_EMIN;
+    decNumberMultiply(&result.number, &product.mMultiplier1.mNumber,
+        &product.mMultiplier2.mNumber, &context);
+    checkContextStatus(context);
+    if (product.mNegative) {
+        result.number.bits ^= DECNEG;
+    }
+}
+
+
+//****************************************************************************
+// Fused operations
+//****************************************************************************
+
+/*!
+    \class BigDecimalProduct
+    \brief Represents deferred product of two BigDecimal numbers.
+
+    BigDecimal::operator*() returns BigDecimalProduct instead of BigDecimal so
+    that multiply-add (a*b + c) and multiply-subtract (a*b - c, c - a*b)
+    expressions are calculated with a single rounding, and sum-of-products
+    (a*b + c*d, a*b - c*d) expressions with an intermediate sum of double
+    working precision (see BigDecimal::sumOfProducts()). In any other
+    context the product is converted to BigDecimal implicitly.
+
+    BigDecimalProduct keeps copies of its multipliers, so it may be stored
+    and calculated after the multipliers are destroyed.
+
+    \sa BigDecimal::FMA(), BigDecimal::sumOfProducts()
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Calculates the product.
+*/
+BigDecimalProduct::operator BigDecimal() const
 {
     NEW_CONTEXT(context);
     decNumber result;
-    decNumberFMA(&result, &multiplier1.mNumber, &multiplier2.mNumber,
-        &summand.mNumber, &context);
+    decNumberMultiply(&result, &mMultiplier1.mNumber, &mMultiplier2.mNumber,
+        &context);
+    if (mNegative) {
+        decNumberMinus(&result, &result, &context);
+    }
+    BigDecimal::checkContextStatus(context);
+    return result;
+}
+
+/*!
+    Calculates \a product + \a summand (or \a product - \a summand if
+    \a negateSummand is true) with a single rounding.
+*/
+BigDecimal BigDecimal::FMA(const BigDecimalProduct & product,
+                           const BigDecimal & summand,
+                           bool negateSummand)
+{
+    NEW_CONTEXT(context);
+    decNumber result;
+
+    const decNumber * multiplier = &product.mMultiplier1.mNumber;
+    const decNumber * addend = &summand.mNumber;
+    decNumber negatedMultiplier, negatedAddend;
+    if (product.mNegative) {
+        decNumberCopy(&negatedMultiplier, multiplier);
+        negatedMultiplier.bits ^= DECNEG;
+        multiplier = &negatedMultiplier;
+    }
+    if (negateSummand) {
+        decNumberCopy(&negatedAddend, addend);
+        negatedAddend.bits ^= DECNEG;
+        addend = &negatedAddend;
+    }
+
+    decNumberFMA(&result, multiplier, &product.mMultiplier2.mNumber, addend,
+        &context);
+    checkContextStatus(context);
+    return result;
+}
+
+/*!
+    Calculates \a product1 + \a product2 + \a summand.
+
+    \a product2 and \a summand are summed with double working precision,
+    and \a product1 is added to the sum by fused multiply-add. So the result
+    is rounded twice: the intermediate sum is exact for multipliers of
+    working precision unless \a summand differs from \a product2 by many
+    orders of magnitude, and the final rounding is to working precision.
+*/
+BigDecimal BigDecimal::sumOfProducts(const BigDecimalProduct & product1,
+                                     const BigDecimalProduct & product2,
+                                     const BigDecimal & summand)
+{
+    WideDecNumber accumulator;
+    multiplyExact(accumulator, product2);
+
+    if (!summand.isZero()) {
+        NEW_PRECISE_CONTEXT(wideContext, 2 * WorkingPrecision::digits());
+        wideContext.emax = DEC_MAX_EMAX;
+        wideContext.emin = DEC_MIN_EMIN;
+        decNumberAdd(&accumulator.number, &accumulator.number,
+            &summand.mNumber, &wideContext);
+        checkContextStatus(wideContext);
+    }
+
+    NEW_CONTEXT(context);
+    decNumber result;
+    const decNumber * multiplier = &product1.mMultiplier1.mNumber;
+    decNumber negatedMultiplier;
+    if (product1.mNegative) {
+        decNumberCopy(&negatedMultiplier, multiplier);
+        negatedMultiplier.bits ^= DECNEG;
+        multiplier = &negatedMultiplier;
+    }
+
+    decNumberFMA(&result, multiplier, &product1.mMultiplier2.mNumber,
+        &accumulator.number, &context);
     checkContextStatus(context);
     return result;
 }
 
+/*!
+    Calculates \a product + \a num with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator+(const BigDecimalProduct & product, const BigDecimal & num)
+{
+    return BigDecimal::FMA(product, num);
+}
+
+/*!
+    Calculates \a num + \a product with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator+(const BigDecimal & num, const BigDecimalProduct & product)
+{
+    return BigDecimal::FMA(product, num);
+}
+
+/*!
+    Calculates \a product1 + \a product2 with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator+(const BigDecimalProduct & product1,
+                     const BigDecimalProduct & product2)
+{
+    return BigDecimal::sumOfProducts(product1, product2);
+}
+
+/*!
+    Calculates \a product - \a num with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator-(const BigDecimalProduct & product, const BigDecimal & num)
+{
+    return BigDecimal::FMA(product, num, true);
+}
+
+/*!
+    Calculates \a num - \a product with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator-(const BigDecimal & num, const BigDecimalProduct & product)
+{
+    return BigDecimal::FMA(-product, num);
+}
+
+/*!
+    Calculates \a product1 - \a product2 with a single rounding.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator-(const BigDecimalProduct & product1,
+                     const BigDecimalProduct & product2)
+{
+    return BigDecimal::sumOfProducts(product1, -product2);
+}
+
+/*!
+    Multiplies \a product by \a num.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator*(const BigDecimalProduct & product, const BigDecimal & num)
+{
+    BigDecimal result = product;
+    return result *= num;
+}
+
+/*!
+    Divides \a product by \a num.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator/(const BigDecimalProduct & product, const BigDecimal & num)
+{
+    BigDecimal result = product;
+    return result /= num;
+}
+
+/*!
+    Calculates remainder of division of \a product by \a num.
+    \relates BigDecimalProduct
+*/
+BigDecimal operator%(const BigDecimalProduct & product, const BigDecimal & num)
+{
+    BigDecimal result = product;
+    return result %= num;
+}
+
+
+//****************************************************************************
+// WorkingPrecision
+//****************************************************************************
+
+/*!
+    \class WorkingPrecision
+    \brief Precision of calculations in the current thread.
+
+    By default BigDecimal calculates with WORKING_PRECISION digits. While
+    WorkingPrecision object exists, results of arithmetic operations in its
+    thread are rounded to the given number of digits and series are summed
+    to this precision, so calculations are faster but less precise.
+    Parser::parse() creates it from ParserContext::workingPrecision().
+
+    Objects may be nested; the innermost one is used.
+
+    \sa Constants::WORKING_PRECISION
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Makes working precision of this thread \a digits decimal digits
+    (limited by WORKING_PRECISION; 0 means WORKING_PRECISION) until the
+    object is destroyed.
+*/
+WorkingPrecision::WorkingPrecision(int digits) : mPrevious(sWorkingPrecision)
+{
+    if (digits < 0 || digits > Constants::WORKING_PRECISION) digits = 0;
+    sWorkingPrecision = digits;
+}
+
+/*!
+    Restores previous working precision of this thread.
+*/
+WorkingPrecision::~WorkingPrecision()
+{
+    sWorkingPrecision = mPrevious;
+}
+
+/*!
+    Returns working precision of the current thread in decimal digits.
+*/
+int WorkingPrecision::digits()
+{
+    return sWorkingPrecision != 0 ? sWorkingPrecision : Constants::WORKING_PRECISION;
+}
@@ -28,6 +28,8 @@
 using std::string;
 using std::wstring;
 
+class BigDecimalProduct;
+
 class BigDecimal
 {
 public:
@@ -62,9 +64,22 @@ public:
     wstring toWideString(const BigDecimalFormat & format = BigDecimalFormat()) const;
 #endif
     tstring toTString(const BigDecimalFormat & format = BigDecimalFormat()) const;
+    size_t toBuffer(tchar * buffer, size_t size,
+        const BigDecimalFormat & format = BigDecimalFormat()) const;
+    void toStream(tostream & stream,
+        const BigDecimalFormat & format = BigDecimalFormat()) const;
 
     int toInt() const;
     unsigned toUInt() const;
+    double toDouble() const;
+    int adjustedExponent() const;
+
+    /// Maximum size of packed number in bytes.
+    static const size_t MAX_PACKED_SIZE = 7 + (DECNUMDIGITS + 1) / 2;
+
+    size_t pack(unsigned char * buffer) const;
+    static BigDecimal unpack(const unsigned char * buffer, size_t * size = 0);
+    static size_t packedSize(const unsigned char * buffer, size_t available);
 
 
     ///////////////////////////////////////////////////////////////////////////
@@ -90,22 +105,25 @@ public:
     BigDecimal operator+() const;
     BigDecimal operator-() const;
 
-    BigDecimal operator++();
+    BigDecimal & operator++();
     BigDecimal operator++(int);
-    BigDecimal operator--();
+    BigDecimal & operator--();
     BigDecimal operator--(int);
 
     BigDecimal operator+(const BigDecimal & num) const;
     BigDecimal operator-(const BigDecimal & num) const;
-    BigDecimal operator*(const BigDecimal & num) const;
+    BigDecimalProduct operator*(const BigDecimal & num) const;
     BigDecimal operator/(const BigDecimal & num) const;
     BigDecimal operator%(const BigDecimal & num) const;
 
-    BigDecimal operator+=(const BigDecimal & num);
-    BigDecimal operator-=(const BigDecimal & num);
-    BigDecimal operator*=(const BigDecimal & num);
-    BigDecimal operator/=(const BigDecimal & num);
-    BigDecimal operator%=(const BigDecimal & num);
+    BigDecimal & operator+=(const BigDecimal & num);
+    BigDecimal & operator-=(const BigDecimal & num);
+    BigDecimal & operator*=(const BigDecimal & num);
+    BigDecimal & operator/=(const BigDecimal & num);
+    BigDecimal & operator%=(const BigDecimal & num);
+
+    BigDecimal & operator+=(const BigDecimalProduct & product);
+    BigDecimal & operator-=(const BigDecimalProduct & product);
 
     BigDecimal operator~() const;
 
@@ -115,11 +133,11 @@ public:
     BigDecimal operator<<(const BigDecimal & shift) const;
     BigDecimal operator>>(const BigDecimal & shift) const;
 
-    BigDecimal operator|=(const BigDecimal & num);
-    BigDecimal operator&=(const BigDecimal & num);
-    BigDecimal operator^=(const BigDecimal & num);
-    BigDecimal operator<<=(const BigDecimal & shift);
-    BigDecimal operator>>=(const BigDecimal & shift);
+    BigDecimal & operator|=(const BigDecimal & num);
+    BigDecimal & operator&=(const BigDecimal & num);
+    BigDecimal & operator^=(const BigDecimal & num);
+    BigDecimal & operator<<=(const BigDecimal & shift);
+    BigDecimal & operator>>=(const BigDecimal & shift);
 
     bool operator==(const BigDecimal & num) const;
     bool operator!=(const BigDecimal & num) const;
@@ -152,6 +170,11 @@ public:
     static BigDecimal arctan(const BigDecimal & num);
     static BigDecimal arccot(const BigDecimal & num);
 
+    static BigDecimal FMA(const BigDecimalProduct & product,
+        const BigDecimal & summand, bool negateSummand = false);
+    static BigDecimal sumOfProducts(const BigDecimalProduct & product1,
+        const BigDecimalProduct & product2, const BigDecimal & summand = 0);
+
 
 private:
 
@@ -162,19 +185,84 @@ private:
     // Default value is 0, which means do not override BigDecimalFormat.
     int mBase;
 
+    // decNumber with enough space for an exact product of two numbers.
+    struct WideDecNumber
+    {
+        decNumber number;
+        decNumberUnit extraUnits[DECNUMUNITS + 1];
+    };
+
     ///////////////////////////////////////////////////////////////////////////
     // Internal functions
     
     BigDecimal(const decNumber & num);
     void construct(const string & str);
+    void toDecNumberString(char * str, const BigDecimalFormat & format) const;
 
     static void checkContextStatus(const decContext & context);
     static int compare(const decNumber & n1, const decNumber & n2);
     static void rescale(decNumber & number, const int exp, decContext & context);
     
     static BigDecimal pi();
-    static BigDecimal FMA(const BigDecimal & multiplier1,
-        const BigDecimal & multiplier2, const BigDecimal & summand);
+    static BigDecimal precisionLimit();
+    static void multiplyExact(WideDecNumber & result,
+        const BigDecimalProduct & product);
+
+    friend class BigDecimalProduct;
+};
+
+
+class BigDecimalProduct
+{
+public:
+    /// Constructs a product of \a multiplier1 and \a multiplier2.
+    BigDecimalProduct(const BigDecimal & multiplier1,
+        const BigDecimal & multiplier2, bool negative = false)
+            : mMultiplier1(multiplier1), mMultiplier2(multiplier2),
+              mNegative(negative)
+    {
+    }
+
+    operator BigDecimal() const;
+
+    /// Returns negated product.
+    BigDecimalProduct operator-() const
+    {
+        return BigDecimalProduct(mMultiplier1, mMultiplier2, !mNegative);
+    }
+
+private:
+    BigDecimal mMultiplier1;            ///< First multiplier.
+    BigDecimal mMultiplier2;            ///< Second multiplier.
+    bool mNegative;                     ///< Determines if product is negated.
+
+    friend class BigDecimal;
+};
+
+BigDecimal operator+(const BigDecimalProduct & product, const BigDecimal & num);
+BigDecimal operator+(const BigDecimal & num, const BigDecimalProduct & product);
+BigDecimal operator+(const BigDecimalProduct & product1, const BigDecimalProduct & product2);
+BigDecimal operator-(const BigDecimalProduct & product, const BigDecimal & num);
+BigDecimal operator-(const BigDecimal & num, const BigDecimalProduct & product);
+BigDecimal operator-(const BigDecimalProduct & product1, const BigDecimalProduct & product2);
+BigDecimal operator*(const BigDecimalProduct & product, const BigDecimal & num);
+BigDecimal operator/(const BigDecimalProduct & product, const BigDecimal & num);
+BigDecimal operator%(const BigDecimalProduct & product, const BigDecimal & num);
+
+
+class WorkingPrecision
+{
+public:
+    explicit WorkingPrecision(int digits);
+    ~WorkingPrecision();
+
+    static int digits();
+
+private:
+    int mPrevious;      ///< Precision which was current before this one.
+
+    WorkingPrecision(const WorkingPrecision &);
+    WorkingPrecision & operator=(const WorkingPrecision &);
 };
 
 
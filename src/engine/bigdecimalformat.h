@@ -90,6 +90,21 @@ public:
     {
     }
 
+    /// Returns true if formats are the same.
+    bool operator==(const BigDecimalFormat & format) const
+    {
+        return precision == format.precision && base == format.base &&
+            numberFormat == format.numberFormat &&
+            exponentCase == format.exponentCase &&
+            decimalSeparator == format.decimalSeparator;
+    }
+
+    /// Returns true if formats are different.
+    bool operator!=(const BigDecimalFormat & format) const
+    {
+        return !(*this == format);
+    }
+
     /// Returns decimal separator as a character ('.' or ',').
     char decimalSeparatorChar() const
     {
@@ -19,12 +19,15 @@
 
 // Engine
 #include "commandparser.h"
+#include "parser.h"
 #include "unitconversion.h"
 #include "constants.h"
+#include "workspace.h"
 // STL
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <iomanip>
 #include <ostream>
 
 using namespace std;
@@ -32,6 +35,15 @@ using namespace std;
 /// Indentation used for output
 static const tchar * indent = _T("    ");
 
+/// Converts estimate \a num to string (without fractional digits)
+static tstring estimateToString(double num)
+{
+    tstringstream stream;
+    if (num < 1E+15 && num > -1E+15) stream << fixed << setprecision(0);
+    stream << num;
+    return stream.str();
+}
+
 
 /*!
     \class CommandParser
@@ -89,6 +101,9 @@ void CommandParser::printUnitConversions()
 {
     mOut << _T("Unit conversion syntax: <expression> [unit1->unit2]") << endl;
     mOut << _T("Example: 140[km->mi]") << endl;
+    mOut << _T("Numbers with units: <number>[unit], conversion: <expression>[->unit]") << endl;
+    mOut << _T("Example: (100[km] / 2[h])[->m/s]") << endl;
+    mOut << _T("Unit expressions with SI prefixes: 1[kn*m][->j], 2[mg/l], 3[m^3/s]") << endl;
 
     UnitConversion::Type type = UnitConversion::NO_TYPE;
     const UnitConversion::UnitDef * c;
@@ -114,6 +129,18 @@ void CommandParser::printUnitConversions()
             case UnitConversion::VELOCITY:
                 mOut << endl << _T("Velocity: ");
                 break;
+            case UnitConversion::VOLUME:
+                mOut << endl << _T("Volume: ");
+                break;
+            case UnitConversion::FORCE:
+                mOut << endl << _T("Force: ");
+                break;
+            case UnitConversion::PRESSURE:
+                mOut << endl << _T("Pressure: ");
+                break;
+            case UnitConversion::ENERGY:
+                mOut << endl << _T("Energy: ");
+                break;
             default:
                 mOut << endl << _T("Unknown units: ");
                 break;
@@ -135,10 +162,15 @@ void CommandParser::printUnitConversions()
 void CommandParser::printConstants()
 {
     ComplexFormat & format = mContext.numberFormat();
-    mOut << _T("e = ") << BigDecimal::E.toTString(format) << endl;
-    mOut << _T("pi = ") << BigDecimal::PI.toTString(format) << endl;
+    mOut << _T("e = ");
+    BigDecimal::E.toStream(mOut, format);
+    mOut << endl << _T("pi = ");
+    BigDecimal::PI.toStream(mOut, format);
+    mOut << endl;
     if (mContext.resultExists()) {
-        mOut << _T("res = ") << mContext.result().toTString(format) << endl;
+        mOut << _T("res = ");
+        mContext.result().toStream(mOut, format);
+        mOut << endl;
     }
 }
 
@@ -154,14 +186,17 @@ void CommandParser::printVariables()
     }
 
     if (mContext.resultExists()) {
-        mOut << _T("res = ") << mContext.result().toTString(format) << endl;
+        mOut << _T("res = ");
+        mContext.result().toStream(mOut, format);
+        mOut << endl;
     }
 
     Variables::const_iterator iter;
     Variables & vars = mContext.variables();
     for (iter = vars.begin(); iter != vars.end(); ++iter) {
-        mOut << iter->name << _T(" = ") <<
-                iter->value.toTString(format) << endl;
+        mOut << iter->name << _T(" = ");
+        iter->value.toStream(mOut, format);
+        mOut << endl;
     }
 }
 
@@ -189,6 +224,9 @@ void CommandParser::printHelp()
     mOut << indent << _T("#var - Display list of variables.") << endl;
     mOut << indent << _T("#del - Delete all variables.") << endl;
     mOut << indent << _T("#del [<var>] - Delete <var>.") << endl;
+    mOut << indent << _T("#save <file> - Save variables and result to <file>.") << endl;
+    mOut << indent << _T("#load <file> - Load variables and result from <file>.") << endl;
+    mOut << indent << _T("#cost <expr> - Estimate cost of evaluation of <expr>.") << endl;
     mOut << indent << _T("#angle - Display angle unit.") << endl;
     mOut << indent << _T("#angle rad / deg / grad - Set angle unit.") << endl;
     mOut << indent << _T("#output - Display output settings.") << endl;
@@ -229,6 +267,66 @@ void CommandParser::deleteVariables(const vector<tstring> & args)
     }
 }
 
+/*!
+    Saves variables and result of \a mContext to \a fileName.
+*/
+void CommandParser::saveWorkspace(const tstring & fileName)
+{
+    if (fileName.empty()) {
+        mOut << _T("File name is not specified.") << endl;
+        return;
+    }
+    try {
+        size_t count = Workspace::save(mContext, fileName);
+        mOut << _T("Saved ") << count << _T(" variables to '") << fileName <<
+                _T("'.") << endl;
+    } catch (MaxCalcException & ex) {
+        mOut << ex.toString() << _T('.') << endl;
+    }
+}
+
+/*!
+    Loads variables and result of \a mContext from \a fileName.
+*/
+void CommandParser::loadWorkspace(const tstring & fileName)
+{
+    if (fileName.empty()) {
+        mOut << _T("File name is not specified.") << endl;
+        return;
+    }
+    try {
+        size_t count = Workspace::load(mContext, fileName);
+        mOut << _T("Loaded ") << count << _T(" variables from '") << fileName <<
+                _T("'.") << endl;
+    } catch (MaxCalcException & ex) {
+        mOut << ex.toString() << _T('.') << endl;
+    }
+}
+
+/*!
+    Prints estimated cost of evaluation of \a expr in \a mContext.
+*/
+void CommandParser::printCost(const tstring & expr)
+{
+    if (expr.empty()) {
+        mOut << _T("Expression is not specified.") << endl;
+        return;
+    }
+    try {
+        Parser parser(expr, mContext);
+        CostEstimate cost = parser.estimateCost();
+        mOut << _T("Estimated cost:") << endl <<
+            indent << _T("Operations = ") << estimateToString(cost.operations) << _T(".") << endl <<
+            indent << _T("Peak size = ") << estimateToString(cost.peakDigits) << _T(" digits.") << endl <<
+            indent << _T("Result exponent = ") << estimateToString(cost.exponent) << _T(".") << endl;
+        if (cost.overflow) {
+            mOut << indent << _T("Result is likely to overflow.") << endl;
+        }
+    } catch (MaxCalcException & ex) {
+        mOut << ex.toString() << _T('.') << endl;
+    }
+}
+
 /*!
     Prints or changes angle unit in \a mContext according to \a args.
 */
@@ -316,6 +414,21 @@ vector<tstring> CommandParser::splitCommand(const tstring & cmd)
     return args;
 }
 
+/*!
+    Returns the rest of \a cmd after the command name in its original case
+    (file names are case-sensitive; file names and expressions may contain
+    spaces).
+*/
+tstring CommandParser::commandArgument(const tstring & cmd)
+{
+    tstring arg = cmd;
+    trim(arg);
+    size_t pos = arg.find_first_of(_T(" \t\f\v\n\r"));
+    if (pos == tstring::npos) return _T("");
+    arg.erase(0, pos);
+    return trim(arg);
+}
+
 /*!
     Converts \a str to integer number.
 
@@ -369,6 +482,12 @@ CommandParser::Result CommandParser::parse(const tstring & expr)
         printVersion(true);
     } else if (name == _T("#del") || name == _T("#delete")) {
         deleteVariables(args);
+    } else if (name == _T("#save")) {
+        saveWorkspace(commandArgument(expr));
+    } else if (name == _T("#load")) {
+        loadWorkspace(commandArgument(expr));
+    } else if (name == _T("#cost")) {
+        printCost(commandArgument(expr));
     } else if (name == _T("#angle") || name == _T("#angles")) {
         printOrChangeAngleUnit(args);
     } else if (name == _T("#output")) {
@@ -50,6 +50,7 @@ public:
 private:
     int ttoi(const tstring & str);
     std::vector<tstring> splitCommand(const tstring & cmd);
+    tstring commandArgument(const tstring & cmd);
     void printHelp();
     void printVersion(bool displayCopyright);
     void printVariables();
@@ -57,6 +58,9 @@ private:
     void printUnitConversions();
     void printFunctions();
     void deleteVariables(const vector<tstring> & args);
+    void saveWorkspace(const tstring & fileName);
+    void loadWorkspace(const tstring & fileName);
+    void printCost(const tstring & expr);
     void printOrChangeAngleUnit(const vector<tstring> & args);
     void printOrChangeOutputSettings(const vector<tstring> & args);
 };
@@ -21,6 +21,10 @@
 #include "complex.h"
 #include "exceptions.h"
 
+// STL
+#include <ostream>
+#include <vector>
+
 
 /*!
     \class Complex
@@ -197,13 +201,138 @@ wstring Complex::toWideString(const ComplexFormat & format) const
 */
 tstring Complex::toTString(const ComplexFormat & format) const
 {
-#if defined(MAXCALC_UNICODE)
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
         return toWideString(format);
 #else
         return toString(format);
 #endif
 }
 
+// Appends str to buffer of given size which already contains length
+// characters (or would contain if it was large enough); returns new length
+static size_t appendChars(const char * str, tchar * buffer, size_t size,
+                          size_t length)
+{
+    for (; *str != 0; ++str, ++length) {
+        if (length + 1 < size) {
+            buffer[length] = *str;
+        }
+    }
+    if (size > 0) {
+        buffer[length < size ? length : size - 1] = 0;
+    }
+    return length;
+}
+
+// Appends num to buffer like appendChars() does
+static size_t appendNumber(const BigDecimal & num, tchar * buffer,
+                           size_t size, size_t length,
+                           const ComplexFormat & format)
+{
+    if (length < size) {
+        return length + num.toBuffer(buffer + length, size - length, format);
+    } else {
+        return length + num.toBuffer(0, 0, format);
+    }
+}
+
+/*!
+    Writes this number to \a buffer of \a size characters using given
+    ComplexFormat.
+
+    The result is the same as toTString() returns. It is always terminated
+    with zero and is truncated if it does not fit into the buffer.
+
+    \returns Length of the whole result (not including terminating zero);
+    if it is not less than \a size, the result was truncated.
+    \sa ComplexFormat, toStream()
+*/
+size_t Complex::toBuffer(tchar * buffer, size_t size,
+                         const ComplexFormat & format) const
+{
+    size_t length = 0;
+
+    if (re.isZero()) {
+        length = appendChars("0", buffer, size, length);
+    } else {
+        length = appendNumber(re, buffer, size, length, format);
+    }
+
+    if (!im.isZero()) {
+        length = appendChars(im.isNegative() ? " - " : " + ",
+            buffer, size, length);
+        length = appendNumber(BigDecimal::abs(im).setBase(im.base()),
+            buffer, size, length, format);
+        const char imaginaryOne[] = { format.imaginaryOneChar(), 0 };
+        length = appendChars(imaginaryOne, buffer, size, length);
+    }
+
+    return length;
+}
+
+/*!
+    Writes this number to \a stream using given ComplexFormat.
+
+    Short numbers are formatted in a local buffer without memory allocation.
+
+    \sa ComplexFormat, toBuffer()
+*/
+void Complex::toStream(tostream & stream, const ComplexFormat & format) const
+{
+    tchar buffer[256];
+    size_t length = toBuffer(buffer, sizeof(buffer) / sizeof(tchar), format);
+    if (length < sizeof(buffer) / sizeof(tchar)) {
+        stream.write(buffer, (std::streamsize)length);
+    } else {
+        std::vector<tchar> longBuffer(length + 1);
+        toBuffer(&longBuffer[0], length + 1, format);
+        stream.write(&longBuffer[0], (std::streamsize)length);
+    }
+}
+
+/*!
+    Packs this number into \a buffer which must have at least
+    MAX_PACKED_SIZE bytes: real part followed by imaginary part.
+
+    Returns number of bytes written.
+
+    \sa BigDecimal::pack(), unpack()
+*/
+size_t Complex::pack(unsigned char * buffer) const
+{
+    size_t size = re.pack(buffer);
+    return size + im.pack(buffer + size);
+}
+
+/*!
+    Returns size of packed number at \a buffer or 0 if \a available bytes
+    are not enough for it or it is invalid.
+*/
+size_t Complex::packedSize(const unsigned char * buffer, size_t available)
+{
+    size_t reSize = BigDecimal::packedSize(buffer, available);
+    if (reSize == 0) return 0;
+    size_t imSize = BigDecimal::packedSize(buffer + reSize, available - reSize);
+    return (imSize == 0) ? 0 : reSize + imSize;
+}
+
+/*!
+    Unpacks number packed by pack() from \a buffer. If \a size is not 0,
+    number of bytes read is stored there.
+
+    \exception ArithmeticException(CONVERSION_IMPOSSIBLE) \a buffer doesn't
+        contain valid packed number.
+*/
+Complex Complex::unpack(const unsigned char * buffer, size_t * size)
+{
+    size_t reSize = 0, imSize = 0;
+    Complex result;
+    result.re = BigDecimal::unpack(buffer, &reSize);
+    result.im = BigDecimal::unpack(buffer + reSize, &imSize);
+    if (size != 0) *size = reSize + imSize;
+    return result;
+}
+
 //****************************************************************************
 // Misc functions
 //****************************************************************************
@@ -272,6 +401,8 @@ Complex Complex::operator-(const Complex & num) const
 
 /*!
     Multiplies two numbers.
+
+    Each part is calculated as a sum of products with a single rounding.
 */
 Complex Complex::operator*(const Complex & num) const
 {
@@ -296,29 +427,33 @@ Complex Complex::operator/(const Complex & num) const
 /*!
     Adds \a num to this.
 */
-Complex Complex::operator+=(const Complex & num)
+Complex & Complex::operator+=(const Complex & num)
 {
-    return Complex(re += num.re, im += num.im);
+    re += num.re;
+    im += num.im;
+    return *this;
 }
 
 /*!
     Subtracts \a num from this.
 */
-Complex Complex::operator-=(const Complex & num)
+Complex & Complex::operator-=(const Complex & num)
 {
-    return Complex(re -= num.re, im -= num.im);
+    re -= num.re;
+    im -= num.im;
+    return *this;
 }
 
 /*!
     Multiplies this by \a num.
 */
-Complex Complex::operator*=(const Complex & num)
+Complex & Complex::operator*=(const Complex & num)
 {
-    Complex result = Complex(re * num.re - im * num.im,
-        re * num.im + im * num.re);
-    re = result.re;
-    im = result.im;
-    return result;
+    // Both parts are evaluated before assignment since num may alias this
+    BigDecimal newRe = re * num.re - im * num.im;
+    im = re * num.im + im * num.re;
+    re = newRe;
+    return *this;
 }
 
 /*!
@@ -326,17 +461,9 @@ Complex Complex::operator*=(const Complex & num)
 
     \exception ArithmeticException(DIVISION_BY_ZERO) \a num == (0, 0) is given.
 */
-Complex Complex::operator/=(const Complex & num)
+Complex & Complex::operator/=(const Complex & num)
 {
-    BigDecimal sqrt = num.re * num.re + num.im * num.im;
-    if (sqrt.isZero()) {
-        throw ArithmeticException(ArithmeticException::DIVISION_BY_ZERO);
-    }
-    Complex result = Complex((re * num.re + im * num.im) / sqrt,
-        (im * num.re - re * num.im) / sqrt);
-    re = result.re;
-    im = result.im;
-    return result;
+    return (*this = *this / num);
 }
 
 /*!
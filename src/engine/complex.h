@@ -68,6 +68,17 @@ public:
     wstring toWideString(const ComplexFormat & format = ComplexFormat()) const;
 #endif
     tstring toTString(const ComplexFormat & format = ComplexFormat()) const;
+    size_t toBuffer(tchar * buffer, size_t size,
+        const ComplexFormat & format = ComplexFormat()) const;
+    void toStream(tostream & stream,
+        const ComplexFormat & format = ComplexFormat()) const;
+
+    /// Maximum size of packed number in bytes.
+    static const size_t MAX_PACKED_SIZE = 2 * BigDecimal::MAX_PACKED_SIZE;
+
+    size_t pack(unsigned char * buffer) const;
+    static Complex unpack(const unsigned char * buffer, size_t * size = 0);
+    static size_t packedSize(const unsigned char * buffer, size_t available);
 
     ///////////////////////////////////////////////////////////////////////////
     // Misc functions
@@ -86,10 +97,10 @@ public:
     Complex operator*(const Complex & num) const;
     Complex operator/(const Complex & num) const;
 
-    Complex operator+=(const Complex & num);
-    Complex operator-=(const Complex & num);
-    Complex operator*=(const Complex & num);
-    Complex operator/=(const Complex & num);
+    Complex & operator+=(const Complex & num);
+    Complex & operator-=(const Complex & num);
+    Complex & operator*=(const Complex & num);
+    Complex & operator/=(const Complex & num);
 
     bool operator==(const Complex & num) const;
     bool operator!=(const Complex & num) const;
@@ -59,6 +59,19 @@ struct ComplexFormat : public BigDecimalFormat
     {
     }
 
+    /// Returns true if formats are the same.
+    bool operator==(const ComplexFormat & format) const
+    {
+        return BigDecimalFormat::operator==(format) &&
+            imaginaryOne == format.imaginaryOne;
+    }
+
+    /// Returns true if formats are different.
+    bool operator!=(const ComplexFormat & format) const
+    {
+        return !(*this == format);
+    }
+
     /// Returns imaginary one as a character ('i' or 'j').
     char imaginaryOneChar() const
     {
@@ -0,0 +1,421 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "costestimate.h"
+#include "parser.h"
+#include "syntaxwalker.h"
+#include "constants.h"
+#include "exceptions.h"
+// STL
+#include <cmath>
+
+using namespace std;
+
+/*!
+    \struct CostEstimate
+    \brief Estimated cost of evaluation of an expression.
+
+    Estimate is calculated by Parser::estimateCost() without evaluation of
+    the expression, so it can be used to reject expensive expressions or to
+    evaluate them separately from cheap ones.
+
+    Operations are counted in the same units as they are charged to
+    OperationBudget (a step of a series, a group of a factorial or a digit
+    of a base conversion) plus one for each arithmetic operation and
+    function, so \a operations can be compared with
+    ParserContext::operationBudget().
+
+    \sa Parser::estimateCost(), OperationBudget
+    \ingroup MaxCalcEngine
+*/
+
+// Math constants for estimates
+static const double LOG10_E = 0.4342944819032518;
+static const double LN_10 = 2.302585092994046;
+static const double PI = 3.141592653589793;
+static const double E = 2.718281828459045;
+
+// Estimated magnitude of a number
+struct Estimate
+{
+    Estimate(double exponent_ = 0, int sign_ = 1)
+        : exponent(exponent_), sign(sign_) { }
+
+    double exponent;    // Decimal logarithm of absolute value
+    int sign;           // -1, 0 (number is zero) or 1
+
+    // Returns approximate value (can be infinite)
+    double value() const { return sign * pow(10.0, exponent); }
+
+    // Returns estimate of given value
+    static Estimate fromValue(double value)
+    {
+        if (value == 0) return Estimate(0, 0);
+        return Estimate(log10(fabs(value)), value < 0 ? -1 : 1);
+    }
+
+    // Returns estimate of given number
+    static Estimate fromNumber(const BigDecimal & num)
+    {
+        if (num.isZero()) return Estimate(0, 0);
+        double value = num.toDouble();
+        if (value == 0 || value == HUGE_VAL || value == -HUGE_VAL) {
+            return Estimate(num.adjustedExponent(), num.isNegative() ? -1 : 1);
+        }
+        return fromValue(value);
+    }
+
+    // Returns estimate of the biggest part of given complex number
+    static Estimate fromComplex(const Complex & num)
+    {
+        Estimate re = fromNumber(num.re);
+        Estimate im = fromNumber(num.im);
+        return (re.sign == 0 || (im.sign != 0 && im.exponent > re.exponent)) ? im : re;
+    }
+};
+
+// Gives meaning to the syntax of expression walked by SyntaxWalker:
+// estimates cost of evaluation instead of calculating values
+class CostEstimator
+{
+public:
+    typedef Estimate Value;
+
+    CostEstimator(Parser & parser) : mParser(parser) { }
+
+    CostEstimate estimate();
+
+    // Semantics of SyntaxWalker
+    Estimate number(const tstring * digits, bool imaginary);
+    Estimate pi() { return Estimate::fromValue(PI); }
+    Estimate e() { return Estimate::fromValue(E); }
+    Estimate previousResult();
+    Estimate variable(Parser::Token & name);
+    void assign(Parser::Token &, const Estimate &) { }
+    Estimate function(Parser::Function function, vector<Estimate> & args);
+    void negate(Estimate & num) { num.sign = -num.sign; }
+    void add(Estimate & num1, const Estimate & num2, bool subtract);
+    void multiply(Estimate & num1, const Estimate & num2);
+    void divide(Estimate & num1, const Estimate & num2);
+    Estimate power(const Estimate & num, const Estimate & power);
+    void convert(Estimate & num, const tstring & unit1, const tstring & unit2);
+
+private:
+    Parser & mParser;
+    CostEstimate mCost;
+
+    Estimate result(const Estimate & num, bool fullPrecision = false);
+    Estimate factorial(const Estimate & num);
+    Estimate convertToBase(const Estimate & num, int base);
+    Estimate toRadians(const Estimate & angle);
+
+    static double sineIterations(const Estimate & angle, bool cosine);
+    static double arctanOperations(double num);
+};
+
+// Takes into account size of intermediate result \a num; results of
+// division and functions calculated with \a fullPrecision have all digits
+// of working precision
+Estimate CostEstimator::result(const Estimate & num, bool fullPrecision)
+{
+    if (num.exponent != num.exponent || num.exponent > DEC_MAX_MATH) {
+        mCost.overflow = true;
+    }
+    double digits = Constants::WORKING_PRECISION;
+    if (!fullPrecision && num.sign != 0 && fabs(num.exponent) < digits) {
+        digits = fabs(floor(num.exponent)) + 1;
+    }
+    if (digits > mCost.peakDigits) mCost.peakDigits = digits;
+    return num;
+}
+
+// Estimates the whole expression; throws ParserException on syntax errors
+// like Parser::syntaxAnalysis()
+CostEstimate CostEstimator::estimate()
+{
+    mCost = CostEstimate();
+
+    Estimate num = SyntaxWalker<CostEstimator>(mParser, *this).walk();
+
+    mCost.exponent = (num.sign == 0) ? 0 : floor(num.exponent);
+    return mCost;
+}
+
+Estimate CostEstimator::number(const tstring * digits, bool)
+{
+    if (digits == 0) return result(Estimate());
+    return result(Estimate::fromNumber(BigDecimal(*digits)));
+}
+
+// Missing result and undefined variables are estimated as 1
+Estimate CostEstimator::previousResult()
+{
+    if (!mParser.mContext.resultExists()) return Estimate();
+    return Estimate::fromComplex(mParser.mContext.result());
+}
+
+Estimate CostEstimator::variable(Parser::Token & name)
+{
+    Variables::Symbol symbol;
+    if (!mParser.findSymbol(name, symbol) ||
+        !mParser.mContext.variables().isDefined(symbol)) {
+        return Estimate();
+    }
+    return Estimate::fromComplex(mParser.mContext.variables().value(symbol));
+}
+
+// Unit conversions are multiplications by scales of units
+void CostEstimator::convert(Estimate &, const tstring &, const tstring &)
+{
+    mCost.operations += 2;
+}
+
+// Estimates built-in \a function (see Parser::function())
+Estimate CostEstimator::function(Parser::Function function, vector<Estimate> & args)
+{
+    if (function == Parser::POW) return power(args[0], args[1]);
+
+    const Estimate & num = args[0];
+    const double value = num.value();
+    mCost.operations += 1;
+
+    switch (function) {
+    case Parser::ABS:
+        return Estimate(num.exponent, num.sign != 0);
+    case Parser::SQR:
+        return result(Estimate(num.exponent * 2, num.sign != 0));
+    case Parser::SQRT:
+        return result(Estimate(num.exponent / 2, num.sign != 0), true);
+    case Parser::FACTORIAL:
+        return factorial(num);
+    case Parser::SIN:
+    case Parser::COS: {
+        Estimate angle = toRadians(num);
+        bool cosine = (function == Parser::COS);
+        mCost.operations += sineIterations(angle, cosine);
+        if (cosine) return result(Estimate(), true);
+        return result(Estimate(angle.exponent < 0 ? angle.exponent : 0, angle.sign), true);
+    }
+    case Parser::TAN:
+    case Parser::COT: {
+        Estimate angle = toRadians(num);
+        mCost.operations += sineIterations(angle, false) +
+                            sineIterations(angle, true) + 2;
+        return result(Estimate(), true);
+    }
+    case Parser::ARCSIN:
+    case Parser::ARCCOS: {
+        // arcsin(x) = arctan(x / sqrt(1 - x*x))
+        double x = fabs(value);
+        if (x < 1) mCost.operations += arctanOperations(x / sqrt(1 - x * x)) + 4;
+        return result(Estimate(), true);
+    }
+    case Parser::ARCTAN:
+    case Parser::ARCCOT:
+        mCost.operations += arctanOperations(value);
+        return result(Estimate(), true);
+    case Parser::SINH:
+    case Parser::COSH:
+    case Parser::TANH:
+    case Parser::COTH: {
+        // Hyperbolic functions are calculated using exp()
+        mCost.operations += 4;
+        Estimate angle = toRadians(num);
+        if (function == Parser::SINH || function == Parser::COSH) {
+            if (angle.exponent > 0) {
+                return result(Estimate(fabs(angle.value()) * LOG10_E, 1), true);
+            }
+            return result(function == Parser::SINH ? angle : Estimate(), true);
+        }
+        return result(Estimate(), true);
+    }
+    case Parser::ARCSINH:
+    case Parser::ARCCOSH:
+    case Parser::ARCTANH:
+    case Parser::ARCCOTH:
+        // Inverse hyperbolic functions are calculated using ln()
+        mCost.operations += 4;
+        return result(Estimate::fromValue(num.exponent * LN_10), true);
+    case Parser::LN:
+        return result(Estimate::fromValue(num.exponent * LN_10), true);
+    case Parser::LOG2:
+        mCost.operations += 1;
+        return result(Estimate::fromValue(num.exponent * LN_10 / log(2.0)), true);
+    case Parser::LOG10:
+        mCost.operations += 1;
+        return result(Estimate::fromValue(num.exponent), true);
+    case Parser::EXP:
+        return result(Estimate(value * LOG10_E, 1), true);
+    case Parser::BIN:
+        return convertToBase(num, 2);
+    case Parser::OCT:
+        return convertToBase(num, 8);
+    case Parser::DEC:
+        return num;
+    case Parser::HEX:
+        return convertToBase(num, 16);
+    default:
+        return num;
+    }
+}
+
+void CostEstimator::add(Estimate & num1, const Estimate & num2, bool subtract)
+{
+    mCost.operations += 1;
+    if (num2.sign == 0) return;
+    if (num1.sign == 0 || num2.exponent > num1.exponent) {
+        num1 = num2;
+        if (subtract) num1.sign = -num1.sign;
+    }
+    result(num1);
+}
+
+void CostEstimator::multiply(Estimate & num1, const Estimate & num2)
+{
+    mCost.operations += 1;
+    num1 = result(Estimate(num1.exponent + num2.exponent, num1.sign * num2.sign));
+}
+
+void CostEstimator::divide(Estimate & num1, const Estimate & num2)
+{
+    mCost.operations += 1;
+    num1 = result(Estimate(num1.exponent - num2.exponent, num1.sign), true);
+}
+
+// Integer power takes a few multiplications per digit of the power
+// (see BigDecimal::pow())
+Estimate CostEstimator::power(const Estimate & num, const Estimate & power)
+{
+    double powerDigits = (power.sign == 0) ? 0 : floor(power.exponent) + 1;
+    if (powerDigits < 0) powerDigits = 0;
+    if (powerDigits > 10) powerDigits = 10;
+    mCost.operations += 1 + 4 * powerDigits;
+
+    if (power.sign == 0) return result(Estimate());
+    if (num.sign == 0 || num.exponent == 0) return result(num);
+    return result(Estimate(num.exponent * power.value(), num.sign), power.sign < 0);
+}
+
+// Factorial multiplies groups of 10 numbers (see BigDecimal::factorial());
+// size of result is found using Stirling's approximation
+Estimate CostEstimator::factorial(const Estimate & num)
+{
+    double n = floor(fabs(num.value()));
+    mCost.operations += floor(n / 10) * 11 + fmod(n, 10);
+    if (n < 2) return result(Estimate());
+    return result(Estimate((n * log(n) - n + log(2 * PI * n) / 2) * LOG10_E, 1));
+}
+
+// Conversion to other base takes a division for each digit of result
+// (see BigDecimal::toString())
+Estimate CostEstimator::convertToBase(const Estimate & num, int base)
+{
+    double digits = 1;
+    if (num.sign != 0 && num.exponent > 0) {
+        digits = floor(num.exponent * LN_10 / log((double)base)) + 1;
+    }
+    mCost.operations += digits;
+    if (digits > mCost.peakDigits) mCost.peakDigits = digits;
+    return num;
+}
+
+// Angles in degrees and gradians are multiplied by pi / 180 and pi / 200
+Estimate CostEstimator::toRadians(const Estimate & angle)
+{
+    switch (mParser.mContext.angleUnit()) {
+    case ParserContext::DEGREES:
+        mCost.operations += 2;
+        return Estimate(angle.exponent + log10(PI / 180), angle.sign);
+    case ParserContext::GRADIANS:
+        mCost.operations += 2;
+        return Estimate(angle.exponent + log10(PI / 200), angle.sign);
+    default:
+        return angle;
+    }
+}
+
+// Returns number of iterations of Taylor series of sine or cosine for
+// \a angle (see BigDecimal::sin() and BigDecimal::cos())
+double CostEstimator::sineIterations(const Estimate & angle, bool cosine)
+{
+    // Angle is reduced to [0, 2*pi)
+    double x = fabs(angle.value());
+    if (x > 2 * PI || x != x) x = 2 * PI;
+    if (x == 0) return cosine ? 1 : 0;
+
+    const double sqrLog = 2 * log10(x);
+    double fraction = cosine ? 0 : log10(x);
+    double count = cosine ? 1 : 2;
+    double iterations = 0;
+    while (fraction > -Constants::WORKING_PRECISION) {
+        ++iterations;
+        fraction += sqrLog - log10(count * count + count);
+        count += 2;
+        fraction += sqrLog - log10(count * count + count);
+        count += 2;
+    }
+    return iterations;
+}
+
+// Returns number of operations of arctangent of \a num including
+// reduction of argument (see BigDecimal::arctan())
+double CostEstimator::arctanOperations(double num)
+{
+    double x = fabs(num);
+    double operations = 0;
+    if (x != x) x = 1;
+    while (x > 0.5) {
+        x = (x > 1E100) ? 1 : x / (sqrt(x * x + 1) + 1);
+        operations += 4;
+    }
+    if (x == 0) return operations;
+
+    const double sqrLog = 2 * log10(x);
+    double numerator = log10(x), denominator = 1;
+    while (numerator - log10(denominator) > -Constants::WORKING_PRECISION) {
+        ++operations;
+        numerator += sqrLog;
+        denominator += 2;
+    }
+    return operations;
+}
+
+
+//****************************************************************************
+// Parser
+//****************************************************************************
+
+/*!
+    Estimates cost of evaluation of the expression without evaluating it.
+
+    Numbers of operations and sizes of intermediate results are estimated
+    from magnitudes of numbers and values of variables and from working
+    precision. For example, "fact(100000)" takes about 110000 operations,
+    "hex(1E+100)" takes 84 operations and has 84 digits.
+
+    \exception ParserException The expression has syntax errors or unknown
+        functions.
+    \sa CostEstimate
+*/
+CostEstimate Parser::estimateCost()
+{
+    compile();
+    return CostEstimator(*this).estimate();
+}
@@ -0,0 +1,37 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef COSTESTIMATE_H
+#define COSTESTIMATE_H
+
+
+/// Estimated cost of evaluation of an expression (see Parser::estimateCost()).
+struct CostEstimate
+{
+    /// Constructs estimate of an empty evaluation.
+    CostEstimate() : operations(0), peakDigits(0), exponent(0), overflow(false) { }
+
+    double operations;      ///< Number of operations (in units of OperationBudget).
+    double peakDigits;      ///< Maximum number of digits of intermediate results.
+    double exponent;        ///< Decimal exponent of the result.
+    bool overflow;          ///< True if an intermediate result is likely to overflow.
+};
+
+
+#endif // COSTESTIMATE_H
@@ -0,0 +1,374 @@
+/* ------------------------------------------------------------------ */
+/* Decimal digit block conversion module                              */
+/* ------------------------------------------------------------------ */
+/* This module is used by decNumberFromString and decNumberToString   */
+/* to scan, pack, and lay out the digits of a coefficient a block at  */
+/* a time rather than one character at a time.                        */
+/*                                                                    */
+/* Three code levels are provided:                                    */
+/*                                                                    */
+/*   DECDIGITS_SCALAR -- portable C, one digit per step               */
+/*   DECDIGITS_SSE2   -- 16-byte digit scans, 8 digits per step for   */
+/*                       packing and layout                           */
+/*   DECDIGITS_AVX2   -- 32-byte digit scans, 16 digits (two Units)   */
+/*                       per step for layout                          */
+/*                                                                    */
+/* The best level supported by the processor is selected while the  */
+/* program is loaded, before any thread can be started; until then   */
+/* (for example from other static initializers) the scalar code is   */
+/* used.  decDigitsSelect can be used to force a lower level (for    */
+/* testing and measurement) but must not be called while other       */
+/* threads may be converting numbers.                                 */
+/* ------------------------------------------------------------------ */
+
+#include "decNumber.h"             // base number library
+#include "decNumberLocal.h"        // decNumber local types, etc.
+#include "decDigits.h"             // this module
+
+#if DECSIMD
+  #include <emmintrin.h>           // SSE2
+  #include <immintrin.h>           // AVX2
+  #if defined(_MSC_VER)
+    #include <intrin.h>            // for __cpuid
+    #define DECTARGET(isa)
+  #else
+    #define DECTARGET(isa) __attribute__((target(isa)))
+  #endif
+#endif
+
+/* Local routines */
+static Int   decSpanScalar(const char *);
+static Unit  decToUnitScalar(const char *);
+static char *decFromUnitsScalar(const Unit *, Int, char *);
+#if DECSIMD
+static Int   decSpanSSE2(const char *);
+static Unit  decToUnitSSE2(const char *);
+static char *decFromUnitsSSE2(const Unit *, Int, char *);
+static Int   decSpanAVX2(const char *);
+static Unit  decToUnitAVX2(const char *);
+static char *decFromUnitsAVX2(const Unit *, Int, char *);
+#endif
+
+/* Selected code (statically initialized, so always valid) */
+static Int    decLevel=DECDIGITS_SCALAR;
+static Int   (*decSpan)(const char *)=decSpanScalar;
+static Unit  (*decToUnit)(const char *)=decToUnitScalar;
+static char *(*decFromUnits)(const Unit *, Int, char *)=decFromUnitsScalar;
+
+/* Selects the best code level once, at load time */
+static const Int decLevelInit=decDigitsSelect(DECDIGITS_AVX2);
+
+/* ------------------------------------------------------------------ */
+/* decDigitsSpan -- count leading digits                              */
+/*                                                                    */
+/*   chars is the string to scan ('\0' terminated)                    */
+/*                                                                    */
+/* Returns the number of characters before the first non-digit.       */
+/* ------------------------------------------------------------------ */
+int32_t decDigitsSpan(const char *chars) {
+  return decSpan(chars);
+  } // decDigitsSpan
+
+/* ------------------------------------------------------------------ */
+/* decDigitsToUnit -- pack DECDPUN digits into a Unit                 */
+/*                                                                    */
+/*   chars is the first of DECDPUN characters which must all be       */
+/*         digits (most significant first)                            */
+/*                                                                    */
+/* Returns the Unit.  No more than DECDPUN characters are read.        */
+/* ------------------------------------------------------------------ */
+decNumberUnit decDigitsToUnit(const char *chars) {
+  return decToUnit(chars);
+  } // decDigitsToUnit
+
+/* ------------------------------------------------------------------ */
+/* decDigitsFromUnits -- lay out whole Units as digits                */
+/*                                                                    */
+/*   up    is the most significant Unit to lay out                    */
+/*   count is the number of Units to lay out (from up downwards)      */
+/*   chars is where to lay out count*DECDPUN digits                   */
+/*                                                                    */
+/* Returns chars stepped past the last digit; no terminator is added. */
+/* ------------------------------------------------------------------ */
+char * decDigitsFromUnits(const decNumberUnit *up, int32_t count,
+                          char *chars) {
+  return decFromUnits(up, count, chars);
+  } // decDigitsFromUnits
+
+/* ------------------------------------------------------------------ */
+/* decDigitsSupported -- best code level supported by the processor   */
+/* ------------------------------------------------------------------ */
+int32_t decDigitsSupported(void) {
+  #if DECSIMD
+    #if defined(_MSC_VER)
+    int info[4];
+    Int level=DECDIGITS_SCALAR;
+    __cpuid(info, 0);
+    Int maxleaf=info[0];
+    __cpuid(info, 1);
+    if (info[3] & (1<<26)) level=DECDIGITS_SSE2;       // SSE2
+    if (maxleaf>=7 && (info[2] & (1<<27))              // OSXSAVE
+     && (info[2] & (1<<28))                            // AVX
+     && (_xgetbv(0) & 6)==6) {                         // YMM enabled
+      __cpuidex(info, 7, 0);
+      if (info[1] & (1<<5)) level=DECDIGITS_AVX2;      // AVX2
+      }
+    return level;
+    #else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return DECDIGITS_AVX2;
+    if (__builtin_cpu_supports("sse2")) return DECDIGITS_SSE2;
+    return DECDIGITS_SCALAR;
+    #endif
+  #else
+  return DECDIGITS_SCALAR;
+  #endif
+  } // decDigitsSupported
+
+/* ------------------------------------------------------------------ */
+/* decDigitsSelect -- select code level                               */
+/*                                                                    */
+/*   level is the wanted level (DECDIGITS_SCALAR, ..SSE2 or ..AVX2)   */
+/*                                                                    */
+/* Returns the selected level, which is the lower of level and the    */
+/* best level supported by the processor.                             */
+/* ------------------------------------------------------------------ */
+int32_t decDigitsSelect(int32_t level) {
+  Int supported=decDigitsSupported();
+  if (level>supported) level=supported;
+  switch (level) {
+    #if DECSIMD
+    case DECDIGITS_AVX2:
+      decSpan=decSpanAVX2;
+      decToUnit=decToUnitAVX2;
+      decFromUnits=decFromUnitsAVX2;
+      break;
+    case DECDIGITS_SSE2:
+      decSpan=decSpanSSE2;
+      decToUnit=decToUnitSSE2;
+      decFromUnits=decFromUnitsSSE2;
+      break;
+    #endif
+    default:
+      level=DECDIGITS_SCALAR;
+      decSpan=decSpanScalar;
+      decToUnit=decToUnitScalar;
+      decFromUnits=decFromUnitsScalar;
+      break;
+    }
+  decLevel=level;
+  return level;
+  } // decDigitsSelect
+
+/* ------------------------------------------------------------------ */
+/* decDigitsSelected -- currently selected code level                 */
+/* ------------------------------------------------------------------ */
+int32_t decDigitsSelected(void) {
+  return decLevel;
+  } // decDigitsSelected
+
+/* ================================================================== */
+/* Scalar code                                                        */
+/* ================================================================== */
+
+static Int decSpanScalar(const char *chars) {
+  const char *c;
+  for (c=chars; *c>='0' && *c<='9'; c++);
+  return (Int)(c-chars);
+  } // decSpanScalar
+
+static Unit decToUnitScalar(const char *chars) {
+  uInt out=0;
+  Int  n;
+  for (n=0; n<DECDPUN; n++) out=X10(out)+(uInt)(chars[n]-'0');
+  return (Unit)out;
+  } // decToUnitScalar
+
+static char *decFromUnitsScalar(const Unit *up, Int count, char *chars) {
+  for (; count>0; count--, up--, chars+=DECDPUN) {
+    uInt u=*up;
+    Int  n;
+    for (n=DECDPUN-1; n>=0; n--) {
+      uInt q=u/10;
+      chars[n]=(char)('0'+(u-X10(q)));
+      u=q;
+      }
+    }
+  return chars;
+  } // decFromUnitsScalar
+
+#if DECSIMD
+/* ================================================================== */
+/* SIMD code (DECDPUN==9 only)                                        */
+/* ================================================================== */
+
+// Constants for laying out eight digits at a time; the value is
+// split into two four-digit halves, and each half is divided by
+// 1000, 100, 10, and 1 using 16-bit multiplications by reciprocals
+// (pre-scaled by 4) followed by shifts
+#define DIV10000    0xd1b71759     // 2**45/10000, rounded up
+#define DIVPOWERS   (short)32768, 13108, 5243, 8389, \
+                    (short)32768, 13108, 5243, 8389
+#define SHIFTPOWERS (short)(1<<15), 1<<13, 1<<11, 1<<7, \
+                    (short)(1<<15), 1<<13, 1<<11, 1<<7
+
+/* ------------------------------------------------------------------ */
+/* SSE2                                                               */
+/* ------------------------------------------------------------------ */
+
+// Returns mask of bytes which are not digits
+DECTARGET("sse2")
+static inline uInt decNonDigitsSSE2(__m128i x) {
+  __m128i lo=_mm_cmplt_epi8(x, _mm_set1_epi8('0'));
+  __m128i hi=_mm_cmpgt_epi8(x, _mm_set1_epi8('9'));
+  return (uInt)_mm_movemask_epi8(_mm_or_si128(lo, hi));
+  } // decNonDigitsSSE2
+
+// Returns index of the lowest set bit of non-zero mask
+static inline Int decLowestBit(uInt mask) {
+  #if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (Int)index;
+  #else
+  return __builtin_ctz(mask);
+  #endif
+  } // decLowestBit
+
+// Aligned loads are used so that no load crosses into a page beyond
+// the terminator
+DECTARGET("sse2")
+static Int decSpanSSE2(const char *chars) {
+  Int skip=(Int)((size_t)chars & 15);    // bytes before chars in block
+  const __m128i *p=(const __m128i *)(chars-skip);
+  uInt mask=decNonDigitsSSE2(_mm_load_si128(p))>>skip;
+  Int  count=16-skip;              // digits so far if mask is 0
+  if (mask!=0) return decLowestBit(mask);
+  for (;; count+=16) {
+    p++;
+    mask=decNonDigitsSSE2(_mm_load_si128(p));
+    if (mask!=0) return count+decLowestBit(mask);
+    }
+  } // decSpanSSE2
+
+DECTARGET("sse2")
+static Unit decToUnitSSE2(const char *chars) {
+  // chars[1..8] -> eight 16-bit digits -> four 2-digit -> two 4-digit
+  __m128i x=_mm_loadl_epi64((const __m128i *)(chars+1));
+  x=_mm_sub_epi8(x, _mm_set1_epi8('0'));
+  x=_mm_unpacklo_epi8(x, _mm_setzero_si128());
+  x=_mm_madd_epi16(x, _mm_set_epi16(1, 10, 1, 10, 1, 10, 1, 10));
+  x=_mm_packs_epi32(x, x);
+  x=_mm_madd_epi16(x, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+  uInt hi=(uInt)_mm_cvtsi128_si32(x);
+  uInt lo=(uInt)_mm_cvtsi128_si32(_mm_srli_si128(x, 4));
+  return (Unit)((uInt)(chars[0]-'0')*100000000+hi*10000+lo);
+  } // decToUnitSSE2
+
+// Returns eight 16-bit digits of value<10**8, most significant first
+DECTARGET("sse2")
+static inline __m128i decEightDigitsSSE2(uInt value) {
+  const __m128i div10000=_mm_set1_epi32((int)DIV10000);
+  const __m128i mul10000=_mm_set1_epi32(10000);
+  const __m128i divpowers=_mm_set_epi16(DIVPOWERS);
+  const __m128i shiftpowers=_mm_set_epi16(SHIFTPOWERS);
+  const __m128i ten=_mm_set1_epi16(10);
+  __m128i abcdefgh=_mm_cvtsi32_si128((int)value);
+  __m128i abcd=_mm_srli_epi64(_mm_mul_epu32(abcdefgh, div10000), 45);
+  __m128i efgh=_mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, mul10000));
+  __m128i v1=_mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+  __m128i v2=_mm_unpacklo_epi16(v1, v1);
+  v2=_mm_unpacklo_epi32(v2, v2);   // abcd*4 x4, efgh*4 x4
+  __m128i v4=_mm_mulhi_epu16(_mm_mulhi_epu16(v2, divpowers), shiftpowers);
+  __m128i v6=_mm_slli_epi64(_mm_mullo_epi16(v4, ten), 16);
+  return _mm_sub_epi16(v4, v6);    // a, b, c, ... h
+  } // decEightDigitsSSE2
+
+DECTARGET("sse2")
+static char *decFromUnitsSSE2(const Unit *up, Int count, char *chars) {
+  const __m128i zeros=_mm_set1_epi8('0');
+  for (; count>0; count--, up--, chars+=DECDPUN) {
+    uInt u=*up;
+    uInt top=u/100000000;
+    __m128i digits=decEightDigitsSSE2(u-top*100000000);
+    digits=_mm_add_epi8(_mm_packus_epi16(digits, _mm_setzero_si128()), zeros);
+    chars[0]=(char)('0'+top);
+    _mm_storel_epi64((__m128i *)(chars+1), digits);
+    }
+  return chars;
+  } // decFromUnitsSSE2
+
+/* ------------------------------------------------------------------ */
+/* AVX2                                                               */
+/* ------------------------------------------------------------------ */
+
+DECTARGET("avx2")
+static Int decSpanAVX2(const char *chars) {
+  const __m256i lo=_mm256_set1_epi8('0');
+  const __m256i hi=_mm256_set1_epi8('9');
+  Int skip=(Int)((size_t)chars & 31);    // bytes before chars in block
+  const __m256i *p=(const __m256i *)(chars-skip);
+  __m256i x=_mm256_load_si256(p);
+  uInt mask=(uInt)_mm256_movemask_epi8(_mm256_or_si256(
+    _mm256_cmpgt_epi8(x, hi), _mm256_cmpgt_epi8(lo, x)))>>skip;
+  Int  count=32-skip;              // digits so far if mask is 0
+  if (mask!=0) return decLowestBit(mask);
+  for (;; count+=32) {
+    p++;
+    x=_mm256_load_si256(p);
+    mask=(uInt)_mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_cmpgt_epi8(x, hi), _mm256_cmpgt_epi8(lo, x)));
+    if (mask!=0) return count+decLowestBit(mask);
+    }
+  } // decSpanAVX2
+
+DECTARGET("avx2")
+static Unit decToUnitAVX2(const char *chars) {
+  // chars[1..8] -> four 2-digit (multiply-add bytes) -> two 4-digit
+  __m128i x=_mm_loadl_epi64((const __m128i *)(chars+1));
+  x=_mm_sub_epi8(x, _mm_set1_epi8('0'));
+  x=_mm_maddubs_epi16(x, _mm_set_epi8(1, 10, 1, 10, 1, 10, 1, 10,
+                                      1, 10, 1, 10, 1, 10, 1, 10));
+  x=_mm_madd_epi16(x, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+  uInt hi=(uInt)_mm_cvtsi128_si32(x);
+  uInt lo=(uInt)_mm_extract_epi32(x, 1);
+  return (Unit)((uInt)(chars[0]-'0')*100000000+hi*10000+lo);
+  } // decToUnitAVX2
+
+DECTARGET("avx2")
+static char *decFromUnitsAVX2(const Unit *up, Int count, char *chars) {
+  const __m256i div10000=_mm256_set1_epi32((int)DIV10000);
+  const __m256i mul10000=_mm256_set1_epi32(10000);
+  const __m256i divpowers=_mm256_set_epi16(DIVPOWERS, DIVPOWERS);
+  const __m256i shiftpowers=_mm256_set_epi16(SHIFTPOWERS, SHIFTPOWERS);
+  const __m256i ten=_mm256_set1_epi16(10);
+  const __m256i zeros=_mm256_set1_epi8('0');
+  // two Units per step; the 128-bit lanes hold one Unit each
+  for (; count>1; count-=2, up-=2, chars+=2*DECDPUN) {
+    uInt u1=*up, u2=*(up-1);
+    uInt top1=u1/100000000, top2=u2/100000000;
+    __m256i abcdefgh=_mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_cvtsi32_si128((int)(u1-top1*100000000))),
+      _mm_cvtsi32_si128((int)(u2-top2*100000000)), 1);
+    __m256i abcd=_mm256_srli_epi64(_mm256_mul_epu32(abcdefgh, div10000), 45);
+    __m256i efgh=_mm256_sub_epi32(abcdefgh, _mm256_mul_epu32(abcd, mul10000));
+    __m256i v1=_mm256_slli_epi64(_mm256_unpacklo_epi16(abcd, efgh), 2);
+    __m256i v2=_mm256_unpacklo_epi16(v1, v1);
+    v2=_mm256_unpacklo_epi32(v2, v2);
+    __m256i v4=_mm256_mulhi_epu16(_mm256_mulhi_epu16(v2, divpowers),
+                                  shiftpowers);
+    __m256i v6=_mm256_slli_epi64(_mm256_mullo_epi16(v4, ten), 16);
+    __m256i digits=_mm256_sub_epi16(v4, v6);
+    digits=_mm256_add_epi8(_mm256_packus_epi16(digits,
+                           _mm256_setzero_si256()), zeros);
+    chars[0]=(char)('0'+top1);
+    _mm_storel_epi64((__m128i *)(chars+1), _mm256_castsi256_si128(digits));
+    chars[DECDPUN]=(char)('0'+top2);
+    _mm_storel_epi64((__m128i *)(chars+DECDPUN+1),
+                     _mm256_extracti128_si256(digits, 1));
+    }
+  if (count>0) chars=decFromUnitsSSE2(up, count, chars);
+  return chars;
+  } // decFromUnitsAVX2
+
+#endif // DECSIMD
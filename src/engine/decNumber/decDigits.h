@@ -0,0 +1,44 @@
+/* ------------------------------------------------------------------ */
+/* Decimal digit block conversion module header                       */
+/* ------------------------------------------------------------------ */
+/* Converts between ASCII digit strings and decNumber Units a block   */
+/* of digits at a time.  With DECDPUN==9 on x86 processors, SSE2 or   */
+/* AVX2 code is selected at run time (8 or 16 digits per step);       */
+/* otherwise, and on other processors, portable scalar code is used.  */
+/* The results are identical whichever code is selected.              */
+/* ------------------------------------------------------------------ */
+
+#if !defined(DECDIGITS)
+  #define DECDIGITS
+
+  #if !defined(DECNUMBER)
+    #include "decNumber.h"
+  #endif
+
+  /* Conditional code flag -- set this to 0 to use scalar code only   */
+  #if !defined(DECSIMD)
+    #if DECDPUN==9 && (defined(__x86_64__) || defined(_M_X64)        \
+                    || defined(__i386__)   || defined(_M_IX86))
+      #define DECSIMD 1
+    #else
+      #define DECSIMD 0
+    #endif
+  #endif
+
+  /* Code levels (see decDigitsSelect)                                */
+  #define DECDIGITS_SCALAR 0
+  #define DECDIGITS_SSE2   1
+  #define DECDIGITS_AVX2   2
+
+  /* ---------------------------------------------------------------- */
+  /* Routines                                                         */
+  /* ---------------------------------------------------------------- */
+  int32_t decDigitsSpan(const char *);
+  decNumberUnit decDigitsToUnit(const char *);
+  char *  decDigitsFromUnits(const decNumberUnit *, int32_t, char *);
+
+  int32_t decDigitsSupported(void);
+  int32_t decDigitsSelect(int32_t);
+  int32_t decDigitsSelected(void);
+
+#endif
@@ -168,6 +168,7 @@
 #include <ctype.h>                 // for lower
 #include "decNumber.h"             // base number library
 #include "decNumberLocal.h"        // decNumber local types, etc.
+#include "decDigits.h"             // digit block conversion
 
 /* Constants */
 // Public lookup table used by the D2U macro
@@ -497,8 +498,10 @@ decNumber * decNumberFromString(decNumber *dn, const char chars[],
   do {                             // status & malloc protection
     for (c=chars;; c++) {          // -> input character
       if (*c>='0' && *c<='9') {    // test for Arabic digit
-        last=c;
-        d++;                       // count of real digits
+        Int run=decDigitsSpan(c);  // digits in this run [>0]
+        last=c+run-1;
+        d+=run;                    // count of real digits
+        c=last;                    // step over the run
         continue;                  // still in decimal part
         }
       if (*c=='.' && dotchar==NULL) { // first '.'
@@ -651,6 +654,17 @@ decNumber * decNumberFromString(decNumber *dn, const char chars[],
     cut=d-(int32_t)(up-res)*DECDPUN;// digits in top unit
     for (c=cfirst;; c++) {         // along the digits
       if (*c=='.') continue;       // ignore '.' [don't decrement cut]
+      // whole unit ahead with no '.' in it: convert as one block
+      if (cut==DECDPUN && last-c>=DECDPUN-1
+       && (dotchar==NULL || dotchar<c || dotchar>c+DECDPUN-1)) {
+        out=(Int)decDigitsToUnit(c);
+        c+=DECDPUN-1;              // -> last digit of the unit
+        if (c==last) break;        // done [lsu written below]
+        *up=(Unit)out;             // write unit
+        up--;                      // prepare for unit below..
+        out=0;                     // ..
+        continue;
+        }
       out=X10(out)+(Int)*c-(Int)'0';
       if (c==last) break;          // done [never get to trailing '.']
       cut--;
@@ -3652,11 +3666,11 @@ static void decToString(const decNumber *dn, char *string, Flag format) {
   cut--;                           // power of ten for digit
 
   if (exp==0) {                    // simple integer [common fastpath]
-    for (;up>=dn->lsu; up--) {     // each Unit from msu
-      u=*up;                       // contains DECDPUN digits to lay out
-      for (; cut>=0; c++, cut--) TODIGIT(u, cut, c, pow);
-      cut=DECDPUN-1;               // next Unit has all digits
-      }
+    u=*up;                         // msu may have fewer digits
+    for (; cut>=0; c++, cut--) TODIGIT(u, cut, c, pow);
+    // lay out the remaining (whole) Units in blocks
+    if (up>dn->lsu)
+      c=decDigitsFromUnits(up-1, (Int)(up-dn->lsu), c);
     *c='\0';                       // terminate the string
     return;}
 
@@ -3708,10 +3722,20 @@ static void decToString(const decNumber *dn, char *string, Flag format) {
     Int n=pre;
     for (; pre>0; pre--, c++, cut--) {
       if (cut<0) {                 // need new Unit
+        Int whole;                 // whole Units to lay out in blocks
         if (up==dn->lsu) break;    // out of input digits (pre>digits)
         up--;
         cut=DECDPUN-1;
         u=*up;
+        whole=pre/DECDPUN;         // whole Units before the '.'
+        if (whole>up-dn->lsu) whole=(Int)(up-dn->lsu); // [keep lsu]
+        if (whole>0) {
+          c=decDigitsFromUnits(up, whole, c);
+          pre-=whole*DECDPUN;
+          up-=whole;
+          u=*up;
+          if (pre==0) break;       // '.' reached at a Unit boundary
+          }
         }
       TODIGIT(u, cut, c, pow);
       }
@@ -3719,10 +3743,10 @@ static void decToString(const decNumber *dn, char *string, Flag format) {
       *c='.'; c++;
       for (;; c++, cut--) {
         if (cut<0) {               // need new Unit
-          if (up==dn->lsu) break;  // out of input digits
-          up--;
-          cut=DECDPUN-1;
-          u=*up;
+          // lay out the remaining (whole) Units in blocks
+          if (up>dn->lsu)
+            c=decDigitsFromUnits(up-1, (Int)(up-dn->lsu), c);
+          break;
           }
         TODIGIT(u, cut, c, pow);
         }
@@ -3735,10 +3759,10 @@ static void decToString(const decNumber *dn, char *string, Flag format) {
     for (; pre<0; pre++, c++) *c='0';   // add any 0's after '.'
     for (; ; c++, cut--) {
       if (cut<0) {                 // need new Unit
-        if (up==dn->lsu) break;    // out of input digits
-        up--;
-        cut=DECDPUN-1;
-        u=*up;
+        // lay out the remaining (whole) Units in blocks
+        if (up>dn->lsu)
+          c=decDigitsFromUnits(up-1, (Int)(up-dn->lsu), c);
+        break;
         }
       TODIGIT(u, cut, c, pow);
       }
@@ -4835,8 +4859,15 @@ static decNumber * decDivideOp(decNumber *res,
 /* of the operand coefficients.                                       */
 /* Static buffers are larger than needed just for multiply, to allow  */
 /* for calls from other operations (notably exp).                     */
+/*                                                                    */
+/* If 128-bit ints are available and DECDPUN is 9, a similar wide     */
+/* path (WIDEMUL) pairs units into 18-digit items and accumulates     */
+/* their products in 128-bit ints, which quarters the number of       */
+/* partial products and needs a single carry resolution for any       */
+/* practical length.                                                  */
 /* ------------------------------------------------------------------ */
 #define FASTMUL (DECUSE64 && DECDPUN<5)
+#define WIDEMUL (DECUSE64 && DECUSE128 && DECDPUN==9)
 static decNumber * decMultiplyOp(decNumber *res, const decNumber *lhs,
                                  const decNumber *rhs, decContext *set,
                                  uInt *status) {
@@ -4893,6 +4924,32 @@ static decNumber * decMultiplyOp(decNumber *res, const decNumber *lhs,
     Int    p;                      // ..
   #endif
 
+  #if WIDEMUL
+    // two units make one base 10**18 item; (10**18-1)**2 can be added
+    // to itself 340.3 times in a uHuge, so a margin is left for the
+    // carries arriving from the item below
+    #define WIDEBASE 1000000000000000000ULL // base
+    #define WIDEDIGS                     18 // digits in base
+    #define WIDELAZY                    300 // carry resolution point
+    uLong  wlhibuff[(DECBUFFER*2+1)/16+1];  // buffer (+1 for DECBUFFER==0)
+    uLong *wlhi=wlhibuff;                   // -> lhs array
+    uLong *alloclhi=NULL;                   // -> allocated buffer, iff allocated
+    uLong  wrhibuff[(DECBUFFER*2+1)/16+1];  // buffer (+1 for DECBUFFER==0)
+    uLong *wrhi=wrhibuff;                   // -> rhs array
+    uLong *allocrhi=NULL;                   // -> allocated buffer, iff allocated
+    uHuge  waccbuff[(DECBUFFER*2+1)/8+2];   // buffer (+1 for DECBUFFER==0)
+    uHuge *wacc=waccbuff;          // -> accumulator array for exact result
+    uLong *lip, *rip;              // item pointers
+    uLong *lmsi, *rmsi;            // most significant items
+    Int    ilhs, irhs, iacc;       // item counts in the arrays
+    Int    lazy;                   // lazy carry counter
+    uHuge  hcarry;                 // uHuge carry
+    Int    count;                  // work
+    const  Unit *cup;              // ..
+    Unit  *up;                     // ..
+    uHuge *hp;                     // ..
+  #endif
+
   #if DECSUBSET
     decNumber *alloclhs=NULL;      // -> allocated buffer, iff allocated
     decNumber *allocrhs=NULL;      // -> allocated buffer, iff allocated
@@ -5072,6 +5129,83 @@ static decNumber * decMultiplyOp(decNumber *res, const decNumber *lhs,
      else { // here to use units directly, without chunking ['old code']
     #endif
 
+    #if WIDEMUL                    // wide path can be used
+    #define NEEDTWO (DECDPUN*2)    // within two decUnitAddSub calls
+    if (rhs->digits>NEEDTWO) {     // use wide path...
+      // calculate the number of elements in each array
+      ilhs=(lhs->digits+WIDEDIGS-1)/WIDEDIGS; // [ceiling]
+      irhs=(rhs->digits+WIDEDIGS-1)/WIDEDIGS; // ..
+      iacc=ilhs+irhs;
+
+      // allocate buffers if required, as usual
+      needbytes=ilhs*sizeof(uLong);
+      if (needbytes>(Int)sizeof(wlhibuff)) {
+        alloclhi=(uLong *)malloc(needbytes);
+        wlhi=alloclhi;}
+      needbytes=irhs*sizeof(uLong);
+      if (needbytes>(Int)sizeof(wrhibuff)) {
+        allocrhi=(uLong *)malloc(needbytes);
+        wrhi=allocrhi;}
+      needbytes=iacc*sizeof(uHuge);
+      if (needbytes>(Int)sizeof(waccbuff)) {
+        allocacc=(uHuge *)malloc(needbytes);
+        wacc=(uHuge *)allocacc;}
+      if (wlhi==NULL||wrhi==NULL||wacc==NULL) {
+        *status|=DEC_Insufficient_storage;
+        break;}
+
+      acc=(Unit *)wacc;       // -> target Unit array
+
+      // assemble the paired copies of the left and right sides
+      for (count=D2U(lhs->digits), cup=lhs->lsu, lip=wlhi; count>0;
+           lip++, cup+=2, count-=2)
+        *lip=*cup+(count>1 ? (uLong)*(cup+1)*(DECDPUNMAX+1) : 0);
+      lmsi=lip-1;     // save -> msi
+      for (count=D2U(rhs->digits), cup=rhs->lsu, rip=wrhi; count>0;
+           rip++, cup+=2, count-=2)
+        *rip=*cup+(count>1 ? (uLong)*(cup+1)*(DECDPUNMAX+1) : 0);
+      rmsi=rip-1;     // save -> msi
+
+      // zero the accumulator
+      for (hp=wacc; hp<wacc+iacc; hp++) *hp=0;
+
+      /* Start the multiplication */
+      lazy=WIDELAZY;                         // carry delay count
+      for (rip=wrhi; rip<=rmsi; rip++) {     // over each item in rhs
+        hp=wacc+(rip-wrhi);                  // where to add the lhs
+        for (lip=wlhi; lip<=lmsi; lip++, hp++) { // over each item in lhs
+          *hp+=(uHuge)(*lip)*(*rip);         // [this should in-line]
+          } // lip loop
+        lazy--;
+        if (lazy>0 && rip!=rmsi) continue;
+        lazy=WIDELAZY;                       // reset delay count
+        // spin up the accumulator resolving overflows
+        for (hp=wacc; hp<wacc+iacc; hp++) {
+          if (*hp<WIDEBASE) continue;        // it fits
+          if ((*hp>>64)==0) {                // 64-bit divide suffices
+            uLong item=(uLong)*hp;
+            hcarry=item/WIDEBASE;
+            }
+           else hcarry=*hp/WIDEBASE;         // [slow divide]
+          *(hp+1)+=hcarry;                   // add to item above
+          *hp-=hcarry*WIDEBASE;              // [inline]
+          } // carry resolution
+        } // rip loop
+
+      // The multiplication is complete; convert back into units.
+      // This can be done in-place in the accumulator as each 16-byte
+      // item becomes two units, written at or below the item read.
+      for (hp=wacc, up=acc; hp<wacc+iacc; hp++) {
+        uLong item=(uLong)*hp;               // decapitate to uLong
+        uLong part=item/(DECDPUNMAX+1);
+        *up=(Unit)(item-(part*(DECDPUNMAX+1))); up++;
+        *up=(Unit)part; up++;
+        } // hp
+      accunits=up-acc;                       // count of units
+      }
+     else { // here to use units directly, without pairing ['old code']
+    #endif
+
       // if accumulator will be too long for local storage, then allocate
       acc=accbuff;                 // -> assume buffer for accumulator
       needbytes=(D2U(lhs->digits)+D2U(rhs->digits))*sizeof(Unit);
@@ -5109,6 +5243,9 @@ static decNumber * decMultiplyOp(decNumber *res, const decNumber *lhs,
     #if FASTMUL
       } // unchunked units
     #endif
+    #if WIDEMUL
+      } // unpaired units
+    #endif
     // common end-path
     #if DECTRACE
       decDumpAr('*', acc, accunits);         // Show exact result
@@ -5141,7 +5278,7 @@ static decNumber * decMultiplyOp(decNumber *res, const decNumber *lhs,
   if (allocrhs!=NULL) free(allocrhs);   // ..
   if (alloclhs!=NULL) free(alloclhs);   // ..
   #endif
-  #if FASTMUL
+  #if FASTMUL || WIDEMUL
   if (allocrhi!=NULL) free(allocrhi);   // ..
   if (alloclhi!=NULL) free(alloclhi);   // ..
   #endif
@@ -1,10 +1,12 @@
 
 HEADERS += \
         decNumber/decContext.h \
+        decNumber/decDigits.h \
         decNumber/decNumber.h \
         decNumber/decNumberLocal.h \
         decNumber/stdint.h
 
 SOURCES += \
         decNumber/decContext.cpp \
+        decNumber/decDigits.cpp \
         decNumber/decNumber.cpp
@@ -40,6 +40,19 @@
   #define DECUSE64  1         /* 1=use int64s, 0=int32 & smaller only */
   #endif
 
+  /* Conditional code flag -- set this to 1 to process coefficients   */
+  /* in 18-digit units with 128-bit intermediates where it pays off   */
+  /* (currently the multiplication inner loop).  Needs DECDPUN==9,    */
+  /* DECUSE64 and a compiler providing unsigned __int128; selected by */
+  /* the MAXCALC_WIDE_UNITS build option.                              */
+  #if !defined(DECUSE128)
+    #if defined(MAXCALC_WIDE_UNITS) && defined(__SIZEOF_INT128__)
+      #define DECUSE128 1     /* 1=use int128s, 0=int64 & smaller only */
+    #else
+      #define DECUSE128 0
+    #endif
+  #endif
+
   /* Conditional code flag -- set this to 0 to exclude printf calls   */
   #if !defined(DECPRINT)
   #define DECPRINT  0         /* 1=allow printf calls; 0=no printf    */
@@ -96,6 +109,9 @@
   #define Long   int64_t
   #define uLong  uint64_t
   #endif
+  #if DECUSE128
+  #define uHuge  unsigned __int128
+  #endif
 
   /* Development-use definitions                                      */
   typedef long int LI;        /* for printf arguments only            */
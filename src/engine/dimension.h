@@ -0,0 +1,139 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef DIMENSION_H
+#define DIMENSION_H
+
+// Local
+#include "exceptions.h"
+
+/*!
+    \class Dimension
+    \brief Represents physical dimension of a quantity.
+
+    Dimension is a compact vector of exponents of base dimensions (angle,
+    length, mass, temperature and time). For example, velocity has
+    dimension length^1 * time^-1. Dimension of a number without units has
+    all exponents equal to zero.
+
+    Exponents are limited to MAX_EXPONENT; operations producing larger
+    exponents throw ArithmeticException.
+
+    \sa Quantity
+    \ingroup MaxCalcEngine
+*/
+class Dimension
+{
+public:
+    /// Base dimensions.
+    enum BaseDimension { ANGLE, LENGTH, MASS, TEMPERATURE, TIME, BASE_COUNT };
+
+    /// Maximum absolute value of exponent.
+    enum { MAX_EXPONENT = 127 };
+
+    /// Constructs dimension of a number without units.
+    Dimension()
+    {
+        for (int i = 0; i < BASE_COUNT; ++i) mExponents[i] = 0;
+    }
+
+    /// Constructs dimension with specified exponents of base dimensions.
+    Dimension(int angle, int length, int mass, int temperature, int time)
+    {
+        mExponents[ANGLE] = (signed char)angle;
+        mExponents[LENGTH] = (signed char)length;
+        mExponents[MASS] = (signed char)mass;
+        mExponents[TEMPERATURE] = (signed char)temperature;
+        mExponents[TIME] = (signed char)time;
+    }
+
+    /// Returns exponent of base dimension \a base.
+    int exponent(BaseDimension base) const { return mExponents[base]; }
+
+    /// Returns true if all exponents are zero (number without units).
+    bool isNone() const
+    {
+        for (int i = 0; i < BASE_COUNT; ++i) {
+            if (mExponents[i] != 0) return false;
+        }
+        return true;
+    }
+
+    /// Returns dimension of product of quantities.
+    Dimension operator*(const Dimension & dim) const
+    {
+        Dimension result;
+        for (int i = 0; i < BASE_COUNT; ++i) {
+            result.mExponents[i] = checkedExponent(mExponents[i] + dim.mExponents[i]);
+        }
+        return result;
+    }
+
+    /// Returns dimension of quotient of quantities.
+    Dimension operator/(const Dimension & dim) const
+    {
+        Dimension result;
+        for (int i = 0; i < BASE_COUNT; ++i) {
+            result.mExponents[i] = checkedExponent(mExponents[i] - dim.mExponents[i]);
+        }
+        return result;
+    }
+
+    /// Returns dimension of quantity raised to \a power.
+    Dimension pow(int power) const
+    {
+        Dimension result;
+        for (int i = 0; i < BASE_COUNT; ++i) {
+            if (mExponents[i] == 0) continue;
+            if (power > MAX_EXPONENT || power < -MAX_EXPONENT) {
+                throw ArithmeticException(ArithmeticException::ARITHMETIC_OVERFLOW);
+            }
+            result.mExponents[i] = checkedExponent(mExponents[i] * power);
+        }
+        return result;
+    }
+
+    bool operator==(const Dimension & dim) const
+    {
+        for (int i = 0; i < BASE_COUNT; ++i) {
+            if (mExponents[i] != dim.mExponents[i]) return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const Dimension & dim) const
+    {
+        return !(*this == dim);
+    }
+
+private:
+    /// Returns \a exponent or throws ArithmeticException if it is too large.
+    static signed char checkedExponent(int exponent)
+    {
+        if (exponent > MAX_EXPONENT || exponent < -MAX_EXPONENT) {
+            throw ArithmeticException(ArithmeticException::ARITHMETIC_OVERFLOW);
+        }
+        return (signed char)exponent;
+    }
+
+    signed char mExponents[BASE_COUNT];     ///< Exponents of base dimensions.
+};
+
+
+#endif // DIMENSION_H
@@ -12,13 +12,25 @@ HEADERS += \
         pch.h \
         bigdecimal.h \
         complex.h \
+        costestimate.h \
         constants.h \
         bigdecimalformat.h \
         complexformat.h \
+        dimension.h \
+        mappedfile.h \
+        mutex.h \
+        operationbudget.h \
+        quantity.h \
+        shareddata.h \
+        thread.h \
         unicode.h \
         parsercontext.h \
         parser.h \
+        syntaxwalker.h \
+        asyncparser.h \
+        functionsampler.h \
         variables.h \
+        workspace.h \
         unitconversion.h \
         exceptions.h \
         commandparser.h
@@ -26,11 +38,20 @@ HEADERS += \
 SOURCES += \
         bigdecimal.cpp \
         complex.cpp \
+        costestimate.cpp \
         constants.cpp \
+        mappedfile.cpp \
+        mutex.cpp \
+        operationbudget.cpp \
         unicode.cpp \
         parsercontext.cpp \
         parser.cpp \
+        asyncparser.cpp \
+        functionsampler.cpp \
+        thread.cpp \
+        quantity.cpp \
         variables.cpp \
+        workspace.cpp \
         unitconversion.cpp \
         commandparser.cpp
 
@@ -46,5 +67,7 @@ CONFIG(release, debug|release) {
 }
 
 maxcalc_unicode:DEFINES += MAXCALC_UNICODE
+maxcalc_utf8:DEFINES += MAXCALC_UTF8
 maxcalc_gettext:DEFINES += MAXCALC_GETTEXT
+maxcalc_wide_units:DEFINES += MAXCALC_WIDE_UNITS
 win32:DEFINES += _CRT_SECURE_NO_WARNINGS
@@ -76,7 +76,8 @@ public:
         INVALID_UNIT_CONVERSION_SYNTAX,     ///< Invalid unit conversion syntax.
         UNKNOWN_UNIT,                       ///< Unknown unit in unit conversion.
         UNKNOWN_UNIT_CONVERSION,            ///< Unknown unit conversion.
-        INVALID_UNIT_CONVERSION_ARGUMENT    ///< Invalid unit conversion argument (complex number).
+        INVALID_UNIT_CONVERSION_ARGUMENT,   ///< Invalid unit conversion argument (complex number).
+        INCOMPATIBLE_UNITS                  ///< Operation on quantities with incompatible units.
     };
 
 protected:
@@ -144,6 +145,10 @@ public:
         case INVALID_UNIT_CONVERSION_ARGUMENT:
             str = format(_("Complex argument in unit conversion '%1'"), &mWhat);
             break;
+        case INCOMPATIBLE_UNITS:
+            if (mWhat == _T("")) str = _("Incompatible units");
+            else str = format(_("Incompatible units '%1'"), &mWhat);
+            break;
         case INVALID_EXPRESSION:
         default:
             str = _("Error in expression");
@@ -316,4 +321,108 @@ public:
 };
 
 
+//------------------------------------------------------------------------------
+/// Exception thrown when evaluation is interrupted by its limits.
+/// \sa OperationBudget
+class EvaluationLimitException : public MaxCalcException
+{
+public:
+    /// Reasons for exception.
+    enum Reasons
+    {
+        CANCELLED,                          ///< Evaluation is cancelled by CancellationToken.
+        TIMEOUT,                            ///< Time limit is exceeded.
+        OPERATION_BUDGET_EXCEEDED           ///< Operation budget is exceeded.
+    };
+
+protected:
+    /// Reason for exception.
+    Reasons mReason;
+
+public:
+    /// Constructs new exception with specified reason.
+    EvaluationLimitException(const Reasons reason)
+    {
+        mReason = reason;
+    }
+
+    /// Returns reason of exception.
+    Reasons reason() const throw()
+    {
+        return mReason;
+    }
+
+    virtual const tstring toString() const throw()
+    {
+        tstring str;
+        switch (mReason)
+        {
+        case CANCELLED:
+            str = _("Evaluation is cancelled");
+            break;
+        case TIMEOUT:
+            str = _("Evaluation time limit is exceeded");
+            break;
+        case OPERATION_BUDGET_EXCEEDED:
+        default:
+            str = _("Operation budget is exceeded");
+            break;
+        }
+        return str;
+    }
+};
+
+
+//------------------------------------------------------------------------------
+/// Workspace file exception.
+class WorkspaceException : public MaxCalcException
+{
+public:
+    /// Reasons for exception.
+    enum Reasons
+    {
+        CANNOT_OPEN_FILE,                   ///< File cannot be opened.
+        CANNOT_WRITE_FILE,                  ///< File cannot be written.
+        INVALID_FILE                        ///< File is not a valid workspace.
+    };
+
+protected:
+    /// Reason for exception.
+    Reasons mReason;
+
+public:
+    /// Constructs new workspace exception with specified reason and file name.
+    WorkspaceException(const Reasons reason, const tstring & fileName) :
+            MaxCalcException(fileName)
+    {
+        mReason = reason;
+    }
+
+    /// Returns reason of exception.
+    Reasons reason() const throw()
+    {
+        return mReason;
+    }
+
+    virtual const tstring toString() const throw()
+    {
+        tstring str;
+        switch (mReason)
+        {
+        case CANNOT_OPEN_FILE:
+            str = format(_("Cannot open file '%1'"), &mWhat);
+            break;
+        case CANNOT_WRITE_FILE:
+            str = format(_("Cannot write file '%1'"), &mWhat);
+            break;
+        case INVALID_FILE:
+        default:
+            str = format(_("Invalid workspace file '%1'"), &mWhat);
+            break;
+        }
+        return str;
+    }
+};
+
+
 #endif // EXCEPTION_H
@@ -0,0 +1,335 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "functionsampler.h"
+#include "parser.h"
+#include "thread.h"
+#include "exceptions.h"
+// STL
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+// Number of intervals of the first pass is resolution divided by this
+static const int INITIAL_INTERVALS_DIVISOR = 4;
+// Minimum number of intervals of the first pass
+static const size_t MIN_INITIAL_INTERVALS = 16;
+// Intervals are not refined below 1/MAX_OVERSAMPLING of resolution
+static const int MAX_OVERSAMPLING = 8;
+// Minimum number of points evaluated by one thread at once
+static const size_t MIN_CHUNK_POINTS = 8;
+// Time limit of evaluation of the function at one point in milliseconds
+static const unsigned long EVALUATION_TIME_LIMIT = 500;
+
+
+/*!
+    \class FunctionSampler
+    \brief Samples values of an expression in one variable for plotting.
+
+    Each thread has a Parser which splits the expression into tokens once
+    and keeps them; for each value of the variable the parser walks the
+    tokens and evaluates the expression again with SAMPLING_PRECISION
+    working precision (results are converted to double anyway). Each
+    evaluation is limited by EVALUATION_TIME_LIMIT, so a point which is too
+    expensive is left undefined instead of blocking the pass.
+
+    sample() evaluates the function adaptively: the first pass samples
+    the range uniformly, and each following pass evaluates midpoints of
+    intervals where the graph is not straight enough for the given
+    resolution or where the function becomes undefined. So smooth parts
+    of the graph get few points, while bends and discontinuities get up
+    to MAX_OVERSAMPLING points per unit of resolution. Points of each pass
+    are evaluated by a pool of threads; the callback gets points after
+    each pass, so the graph can be drawn progressively.
+
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    \class FunctionSampler::Chunk
+    \brief Evaluates the function in a thread.
+
+    Chunk evaluates every stride-th point starting from the given one, so
+    that expensive regions of the range are shared between threads.
+*/
+class FunctionSampler::Chunk : public Thread
+{
+public:
+    /// Constructs chunk evaluating \a expr in a copy of \a context.
+    Chunk(const tstring & expr, const ParserContext & context, Variables::Symbol symbol)
+        : mSymbol(symbol), mPoints(0), mCount(0), mStride(1)
+    {
+        mParser.setContext(context);
+        mParser.context().setTimeLimit(EVALUATION_TIME_LIMIT);
+        mParser.setExpression(expr);
+        // Variable gets exact value of double
+        mStream.precision(17);
+    }
+
+    /// Sets \a count points to be evaluated (every \a stride-th one of \a points).
+    void setPoints(Point * points, size_t count, size_t stride, CancellationToken * token)
+    {
+        mPoints = points;
+        mCount = count;
+        mStride = stride;
+        mParser.context().setCancellationToken(token);
+    }
+
+    void evaluateAll();
+
+protected:
+    /// Evaluates points in the thread.
+    void run() { evaluateAll(); }
+
+private:
+    Parser mParser;
+    Variables::Symbol mSymbol;
+    Point * mPoints;
+    size_t mCount;
+    size_t mStride;
+    ostringstream mStream;
+
+    void evaluate(Point & point);
+};
+
+/*!
+    Evaluates points set by setPoints() until the token is cancelled.
+*/
+void FunctionSampler::Chunk::evaluateAll()
+{
+    CancellationToken * token = mParser.context().cancellationToken();
+    for (size_t i = 0; i < mCount; i += mStride) {
+        if (token && token->isCancelled()) return;
+        evaluate(mPoints[i]);
+    }
+}
+
+/*!
+    Evaluates function at \a point.x; point is undefined if evaluation fails,
+    exceeds its time limit or its result is not real.
+*/
+void FunctionSampler::Chunk::evaluate(Point & point)
+{
+    mStream.str("");
+    mStream << point.x;
+    mParser.context().variables().setValue(mSymbol, BigDecimal(mStream.str()));
+
+    point.defined = false;
+    try {
+        Complex result = mParser.parse().result();
+        if (result.im.isZero()) {
+            point.y = result.re.toDouble();
+            point.defined = fabs(point.y) <= DBL_MAX;
+        }
+    } catch (MaxCalcException &) {
+        // Function is undefined at this point
+    }
+}
+
+/*!
+    Constructs a new sampler of \a expr as a function of \a variable in a
+    copy of \a context; \a jobs threads evaluate the function (by default
+    Thread::idealThreadCount()).
+
+    The expression is evaluated once for zero value of the variable to
+    find errors which don't depend on its value.
+
+    \exception ParserException Expression is invalid.
+*/
+FunctionSampler::FunctionSampler(const tstring & expr, const tstring & variable,
+                                 const ParserContext & context, int jobs)
+    : mEvaluations(0)
+{
+    ParserContext base(context);
+    base.setWorkingPrecision(SAMPLING_PRECISION);
+    base.setCancellationToken(0);
+    Variables::Symbol symbol = base.variables().intern(variable);
+    base.variables().setValue(symbol, 0);
+
+    Parser test(expr, base);
+    test.context().setTimeLimit(EVALUATION_TIME_LIMIT);
+    try {
+        test.parse();
+    } catch (ParserException &) {
+        throw;
+    } catch (MaxCalcException &) {
+        // Function may be defined at other points
+    }
+
+    if (jobs < 1) jobs = Thread::idealThreadCount();
+    for (int i = 0; i < jobs; ++i) {
+        mChunks.push_back(new Chunk(expr, base, symbol));
+        mChunks.back()->setPoints(0, 0, 1, 0);
+    }
+}
+
+/*!
+    Waits for the threads and destroys the sampler.
+*/
+FunctionSampler::~FunctionSampler()
+{
+    for (size_t i = 0; i < mChunks.size(); ++i) {
+        delete mChunks[i];
+    }
+}
+
+/*!
+    Samples the function between \a from and \a to for a graph which is
+    \a resolution pixels wide. \a callback (if it is given) receives points
+    after each pass. Sampling stops at the next point when \a token is
+    cancelled; points sampled so far are returned then.
+
+    Returns points sorted by x.
+*/
+const vector<FunctionSampler::Point> & FunctionSampler::sample(double from,
+    double to, int resolution, Callback * callback, CancellationToken * token)
+{
+    mPoints.clear();
+    mEvaluations = 0;
+    if (!(from < to) || resolution < 1) return mPoints;
+
+    // First pass samples range uniformly
+    size_t intervals = max(MIN_INITIAL_INTERVALS,
+        (size_t)(resolution / INITIAL_INTERVALS_DIVISOR));
+    mPoints.assign(intervals + 1, Point());
+    for (size_t i = 0; i <= intervals; ++i) {
+        mPoints[i].x = from + (to - from) * i / intervals;
+    }
+    mPoints.back().x = to;
+    evaluate(mPoints, token);
+
+    if (callback && !(token && token->isCancelled())) {
+        callback->pointsSampled(mPoints, false);
+    }
+
+    // Next passes refine the graph until it is smooth for the resolution
+    double minWidth = (to - from) / ((double)resolution * MAX_OVERSAMPLING);
+    while (!(token && token->isCancelled())) {
+        bool refined = refine(tolerance(resolution), minWidth, token);
+        if (token && token->isCancelled()) break;
+        if (callback) callback->pointsSampled(mPoints, !refined);
+        if (!refined) break;
+    }
+
+    return mPoints;
+}
+
+/*!
+    Evaluates function at x of \a points by the threads; \a token stops
+    evaluation when it is cancelled.
+*/
+void FunctionSampler::evaluate(vector<Point> & points, CancellationToken * token)
+{
+    size_t jobs = min(mChunks.size(), (points.size() + MIN_CHUNK_POINTS - 1) / MIN_CHUNK_POINTS);
+    if (jobs <= 1) {
+        // Few points are evaluated in this thread
+        mChunks[0]->setPoints(&points[0], points.size(), 1, token);
+        mChunks[0]->evaluateAll();
+    } else {
+        for (size_t i = 0; i < jobs; ++i) {
+            mChunks[i]->setPoints(&points[i], points.size() - i, jobs, token);
+            mChunks[i]->start();
+        }
+        for (size_t i = 0; i < jobs; ++i) {
+            mChunks[i]->wait();
+        }
+    }
+    mEvaluations += points.size();
+}
+
+/*!
+    Returns maximum deviation of the graph from a straight segment (in units
+    of y) for given \a resolution. Scale of y is range of the middle 90% of
+    values, so poles and outliers don't make it too coarse.
+*/
+double FunctionSampler::tolerance(int resolution) const
+{
+    vector<double> values;
+    values.reserve(mPoints.size());
+    for (size_t i = 0; i < mPoints.size(); ++i) {
+        if (mPoints[i].defined) values.push_back(mPoints[i].y);
+    }
+    if (values.size() < 2) return 0;
+
+    size_t low = values.size() / 20;
+    size_t high = values.size() - 1 - low;
+    nth_element(values.begin(), values.begin() + low, values.end());
+    double min = values[low];
+    nth_element(values.begin(), values.begin() + high, values.end());
+    double max = values[high];
+    return (max - min) / resolution;
+}
+
+/*!
+    Evaluates midpoints of intervals which need refinement and inserts them
+    into sampled points. An interval is refined if the function is defined
+    only at one of its ends or if a point deviates from the segment between
+    its neighbors by more than \a tolerance; intervals narrower than twice
+    \a minWidth are not refined.
+
+    Returns false if there was nothing to refine.
+*/
+bool FunctionSampler::refine(double tolerance, double minWidth, CancellationToken * token)
+{
+    size_t count = mPoints.size();
+    vector<char> flags(count - 1, 0);
+
+    for (size_t i = 0; i + 1 < count; ++i) {
+        if (mPoints[i].defined != mPoints[i + 1].defined) flags[i] = 1;
+    }
+    for (size_t i = 1; i + 1 < count; ++i) {
+        const Point & prev = mPoints[i - 1];
+        const Point & cur = mPoints[i];
+        const Point & next = mPoints[i + 1];
+        if (!prev.defined || !cur.defined || !next.defined) continue;
+        double t = (cur.x - prev.x) / (next.x - prev.x);
+        double line = prev.y + t * (next.y - prev.y);
+        if (fabs(cur.y - line) > tolerance) flags[i - 1] = flags[i] = 1;
+    }
+
+    vector<Point> midpoints;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        if (flags[i] && mPoints[i + 1].x - mPoints[i].x >= 2 * minWidth) {
+            Point point = Point();
+            point.x = (mPoints[i].x + mPoints[i + 1].x) / 2;
+            midpoints.push_back(point);
+        } else {
+            flags[i] = 0;
+        }
+    }
+    if (midpoints.empty()) return false;
+
+    evaluate(midpoints, token);
+    if (token && token->isCancelled()) return false;
+
+    // Merge midpoints into sorted points
+    vector<Point> points;
+    points.reserve(count + midpoints.size());
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        points.push_back(mPoints[i]);
+        if (i + 1 < count && flags[i]) points.push_back(midpoints[next++]);
+    }
+    mPoints.swap(points);
+    return true;
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef FUNCTIONSAMPLER_H
+#define FUNCTIONSAMPLER_H
+
+// Local
+#include "parsercontext.h"
+#include "operationbudget.h"
+#include "variables.h"
+#include "unicode.h"
+// STL
+#include <vector>
+
+
+class FunctionSampler
+{
+public:
+
+    /// Point of the graph of a function.
+    struct Point
+    {
+        double x;           ///< Value of the variable.
+        double y;           ///< Value of the function (if defined).
+        bool defined;       ///< False if function has no real value at x.
+    };
+
+    /// Receives points during sampling; called in the thread of sample().
+    class Callback
+    {
+    public:
+        virtual ~Callback() { }
+        /// Called after each pass with all \a points sampled so far (sorted by x).
+        virtual void pointsSampled(const std::vector<Point> & points, bool finished) = 0;
+    };
+
+    /// Working precision of sampling in decimal digits.
+    static const int SAMPLING_PRECISION = 17;
+
+    FunctionSampler(const tstring & expr, const tstring & variable,
+                    const ParserContext & context, int jobs = 0);
+    ~FunctionSampler();
+
+    const std::vector<Point> & sample(double from, double to, int resolution,
+        Callback * callback = 0, CancellationToken * token = 0);
+
+    /// Returns points sampled by the last sample().
+    const std::vector<Point> & points() const { return mPoints; }
+    /// Returns number of evaluations of the function by the last sample().
+    size_t evaluations() const { return mEvaluations; }
+
+private:
+    class Chunk;
+
+    std::vector<Chunk *> mChunks;       ///< Threads evaluating the function.
+    std::vector<Point> mPoints;         ///< Sampled points sorted by x.
+    size_t mEvaluations;                ///< Number of evaluations.
+
+    void evaluate(std::vector<Point> & points, CancellationToken * token);
+    bool refine(double tolerance, double minWidth, CancellationToken * token);
+    double tolerance(int resolution) const;
+
+    // Samplers are not copyable
+    FunctionSampler(const FunctionSampler &);
+    FunctionSampler & operator=(const FunctionSampler &);
+};
+
+
+#endif // FUNCTIONSAMPLER_H
@@ -0,0 +1,142 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "mappedfile.h"
+// Memory-mapped files
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/*!
+    \class MappedFile
+    \brief Read-only file mapped into memory.
+
+    Pages of the file are read by the system on first access, so opening
+    even a large file is fast. discard() lets the system drop pages which
+    are not needed any more, so memory used for reading a file sequentially
+    doesn't depend on its size.
+
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Constructs an object without file.
+*/
+MappedFile::MappedFile() : mData(0), mSize(0)
+{
+#if defined(_WIN32)
+    mFile = INVALID_HANDLE_VALUE;
+    mMapping = 0;
+#endif
+}
+
+/*!
+    Unmaps the file.
+*/
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+    if (mData != 0) UnmapViewOfFile(mData);
+    if (mMapping != 0) CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+#else
+    if (mData != 0) munmap((void *)mData, mSize);
+#endif
+}
+
+/*!
+    Maps file at \a path. Empty file is opened, but data() is 0.
+
+    Returns false if the file cannot be opened or mapped.
+*/
+bool MappedFile::open(const std::string & path)
+{
+#if defined(_WIN32)
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (mFile == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || (ULONGLONG)size.QuadPart > (size_t)-1) {
+        return false;
+    }
+    mSize = (size_t)size.QuadPart;
+    // Empty file cannot be mapped
+    if (mSize == 0) return true;
+    mMapping = CreateFileMappingA(mFile, 0, PAGE_READONLY, 0, 0, 0);
+    if (mMapping == 0) return false;
+    mData = (const unsigned char *)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    return mData != 0;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    bool result = false;
+    if (fstat(fd, &info) == 0) {
+        mSize = (size_t)info.st_size;
+        // Empty file cannot be mapped
+        result = (mSize == 0);
+        if (mSize != 0) {
+            void * data = mmap(0, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                mData = (const unsigned char *)data;
+                result = true;
+            }
+        }
+    }
+    close(fd);
+    return result;
+#endif
+}
+
+/*!
+    Tells the system that the file will be read sequentially, so it can
+    read ahead.
+*/
+void MappedFile::sequentialAccess()
+{
+#if !defined(_WIN32)
+    if (mData != 0) madvise((void *)mData, mSize, MADV_SEQUENTIAL);
+#endif
+}
+
+/*!
+    Tells the system that \a size bytes starting from \a offset will not be
+    accessed any more, so their pages may be dropped from memory. They are
+    read again if they are accessed.
+*/
+void MappedFile::discard(size_t offset, size_t size)
+{
+#if !defined(_WIN32)
+    if (mData == 0) return;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    // Only whole pages of the range are discarded
+    size_t start = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t end = (offset + size) / pageSize * pageSize;
+    if (offset + size >= mSize) end = mSize;
+    if (start < end) madvise((void *)(mData + start), end - start, MADV_DONTNEED);
+#else
+    (void)offset;
+    (void)size;
+#endif
+}
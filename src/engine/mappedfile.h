@@ -0,0 +1,61 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+// STL
+#include <string>
+#include <cstddef>
+
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string & path);
+
+    /// Returns contents of the file (0 if it is empty or not opened).
+    const unsigned char * data() const { return mData; }
+    /// Returns size of the file.
+    size_t size() const { return mSize; }
+
+    void sequentialAccess();
+    void discard(size_t offset, size_t size);
+
+private:
+#if defined(_WIN32)
+    HANDLE mFile;
+    HANDLE mMapping;
+#endif
+    const unsigned char * mData;
+    size_t mSize;
+
+    // Mapped files are not copyable
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+};
+
+
+#endif // MAPPEDFILE_H
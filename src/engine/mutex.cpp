@@ -0,0 +1,150 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "mutex.h"
+
+
+/*!
+    \class Mutex
+    \brief Platform independent mutex.
+
+    Engine uses it to protect data shared by all parsers (like the cache of
+    unit expressions). Use MutexLocker to lock a mutex within a scope.
+
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Constructs a new unlocked mutex.
+*/
+Mutex::Mutex()
+{
+#if defined(_WIN32)
+    InitializeCriticalSection(&mMutex);
+#else
+    pthread_mutex_init(&mMutex, 0);
+#endif
+}
+
+/*!
+    Destroys the mutex. It must not be locked.
+*/
+Mutex::~Mutex()
+{
+#if defined(_WIN32)
+    DeleteCriticalSection(&mMutex);
+#else
+    pthread_mutex_destroy(&mMutex);
+#endif
+}
+
+/*!
+    Locks the mutex. Blocks if it is locked by another thread.
+*/
+void Mutex::lock()
+{
+#if defined(_WIN32)
+    EnterCriticalSection(&mMutex);
+#else
+    pthread_mutex_lock(&mMutex);
+#endif
+}
+
+/*!
+    Unlocks the mutex.
+*/
+void Mutex::unlock()
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(&mMutex);
+#else
+    pthread_mutex_unlock(&mMutex);
+#endif
+}
+
+/*!
+    \class WaitCondition
+    \brief Platform independent condition variable.
+
+    Threads wait() for a condition with a locked Mutex and are woken up by
+    wakeOne() or wakeAll() when the condition may have changed.
+
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Constructs a new condition.
+*/
+WaitCondition::WaitCondition()
+{
+#if defined(_WIN32)
+    InitializeConditionVariable(&mCondition);
+#else
+    pthread_cond_init(&mCondition, 0);
+#endif
+}
+
+/*!
+    Destroys the condition. No threads may wait for it.
+*/
+WaitCondition::~WaitCondition()
+{
+#if !defined(_WIN32)
+    pthread_cond_destroy(&mCondition);
+#endif
+}
+
+/*!
+    Unlocks \a mutex, waits for the condition and locks \a mutex again.
+
+    Waiting may end spuriously, so the condition must be checked in a loop.
+*/
+void WaitCondition::wait(Mutex & mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableCS(&mCondition, &mutex.mMutex, INFINITE);
+#else
+    pthread_cond_wait(&mCondition, &mutex.mMutex);
+#endif
+}
+
+/*!
+    Wakes up one of waiting threads.
+*/
+void WaitCondition::wakeOne()
+{
+#if defined(_WIN32)
+    WakeConditionVariable(&mCondition);
+#else
+    pthread_cond_signal(&mCondition);
+#endif
+}
+
+/*!
+    Wakes up all waiting threads.
+*/
+void WaitCondition::wakeAll()
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&mCondition);
+#else
+    pthread_cond_broadcast(&mCondition);
+#endif
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+class Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+private:
+#if defined(_WIN32)
+    CRITICAL_SECTION mMutex;
+#else
+    pthread_mutex_t mMutex;
+#endif
+
+    // Mutexes are not copyable
+    Mutex(const Mutex &);
+    Mutex & operator=(const Mutex &);
+
+    friend class WaitCondition;
+};
+
+
+class WaitCondition
+{
+public:
+    WaitCondition();
+    ~WaitCondition();
+
+    void wait(Mutex & mutex);
+    void wakeOne();
+    void wakeAll();
+
+private:
+#if defined(_WIN32)
+    CONDITION_VARIABLE mCondition;
+#else
+    pthread_cond_t mCondition;
+#endif
+
+    // Conditions are not copyable
+    WaitCondition(const WaitCondition &);
+    WaitCondition & operator=(const WaitCondition &);
+};
+
+
+/// Locks mutex for the lifetime of the object.
+class MutexLocker
+{
+public:
+    /// Locks \a mutex.
+    explicit MutexLocker(Mutex & mutex) : mMutex(mutex) { mMutex.lock(); }
+    /// Unlocks the mutex.
+    ~MutexLocker() { mMutex.unlock(); }
+
+private:
+    Mutex & mMutex;
+
+    MutexLocker(const MutexLocker &);
+    MutexLocker & operator=(const MutexLocker &);
+};
+
+
+#endif // MUTEX_H
@@ -0,0 +1,165 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "operationbudget.h"
+#include "exceptions.h"
+// Time measurement
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+// Thread-local storage
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Number of operations between checks of time limit
+static const unsigned long TIME_CHECK_INTERVAL = 16;
+
+// Budget of evaluation in the current thread
+static THREAD_LOCAL OperationBudget * sCurrentBudget = 0;
+
+
+/*!
+    \class CancellationToken
+    \brief Flag which cancels evaluation from another thread.
+
+    The token is given to ParserContext::setCancellationToken(); calling
+    cancel() from any thread interrupts evaluation with
+    EvaluationLimitException(CANCELLED) at its next long operation.
+
+    \sa OperationBudget
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Cancels evaluations which use this token.
+*/
+void CancellationToken::cancel()
+{
+#if defined(_WIN32)
+    InterlockedExchange(&mCancelled, 1);
+#else
+    __sync_lock_test_and_set(&mCancelled, 1);
+#endif
+}
+
+/*!
+    Makes token not cancelled, so it can be used again.
+*/
+void CancellationToken::reset()
+{
+#if defined(_WIN32)
+    InterlockedExchange(&mCancelled, 0);
+#else
+    __sync_lock_test_and_set(&mCancelled, 0);
+#endif
+}
+
+
+/*!
+    \class OperationBudget
+    \brief Limits of evaluation in the current thread.
+
+    Parser::parse() creates a budget from limits of ParserContext for the
+    duration of evaluation. Long loops of the engine (series of
+    trigonometric functions, factorial, base conversion, power) call
+    charge() for each step; it throws EvaluationLimitException when the
+    evaluation is cancelled, the number of charged operations exceeds the
+    budget or the time limit is exceeded. Without a budget charge() does
+    nothing.
+
+    Budgets may be nested; the innermost one is charged.
+
+    \sa CancellationToken, ParserContext
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Makes a budget of at most \a operations operations and \a timeLimit
+    milliseconds (0 means no limit) cancelled by \a token (may be 0)
+    current for this thread until it is destroyed.
+*/
+OperationBudget::OperationBudget(const CancellationToken * token,
+                                 unsigned long operations,
+                                 unsigned long timeLimit) :
+    mToken(token), mLimit(operations), mSpent(0), mTimeLimit(timeLimit),
+    mStartTime(timeLimit != 0 ? currentTime() : 0),
+    mNextTimeCheck(TIME_CHECK_INTERVAL), mPrevious(sCurrentBudget)
+{
+    sCurrentBudget = this;
+}
+
+/*!
+    Restores previous budget of this thread.
+*/
+OperationBudget::~OperationBudget()
+{
+    sCurrentBudget = mPrevious;
+}
+
+/*!
+    Charges budget of the current thread for \a operations long operations.
+
+    \exception EvaluationLimitException Evaluation is cancelled or its
+        limits are exceeded.
+*/
+void OperationBudget::charge(unsigned long operations)
+{
+    if (sCurrentBudget != 0) sCurrentBudget->spend(operations);
+}
+
+/*!
+    Adds \a operations to spent operations and checks limits.
+*/
+void OperationBudget::spend(unsigned long operations)
+{
+    mSpent += operations;
+
+    if (mToken != 0 && mToken->isCancelled()) {
+        throw EvaluationLimitException(EvaluationLimitException::CANCELLED);
+    }
+    if (mLimit != 0 && mSpent > mLimit) {
+        throw EvaluationLimitException(EvaluationLimitException::OPERATION_BUDGET_EXCEEDED);
+    }
+    // Time is checked less often than the flag
+    if (mTimeLimit != 0 && mSpent >= mNextTimeCheck) {
+        mNextTimeCheck = mSpent + TIME_CHECK_INTERVAL;
+        if (currentTime() - mStartTime > mTimeLimit) {
+            throw EvaluationLimitException(EvaluationLimitException::TIMEOUT);
+        }
+    }
+}
+
+/*!
+    Returns time in milliseconds from unspecified moment.
+*/
+unsigned long OperationBudget::currentTime()
+{
+#if defined(_WIN32)
+    return GetTickCount();
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+#endif
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef OPERATIONBUDGET_H
+#define OPERATIONBUDGET_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+
+class CancellationToken
+{
+public:
+    /// Constructs token which is not cancelled.
+    CancellationToken() : mCancelled(0) { }
+
+    void cancel();
+    void reset();
+    /// Returns true if cancel() was called.
+    bool isCancelled() const { return mCancelled != 0; }
+
+private:
+    volatile long mCancelled;
+
+    CancellationToken(const CancellationToken &);
+    CancellationToken & operator=(const CancellationToken &);
+};
+
+
+class OperationBudget
+{
+public:
+    OperationBudget(const CancellationToken * token, unsigned long operations,
+                    unsigned long timeLimit);
+    ~OperationBudget();
+
+    static void charge(unsigned long operations = 1);
+
+private:
+    const CancellationToken * mToken;   ///< Token or 0.
+    unsigned long mLimit;               ///< Maximum number of operations or 0.
+    unsigned long mSpent;               ///< Number of charged operations.
+    unsigned long mTimeLimit;           ///< Time limit in milliseconds or 0.
+    unsigned long mStartTime;           ///< Time of construction in milliseconds.
+    unsigned long mNextTimeCheck;       ///< Number of operations when time is checked.
+    OperationBudget * mPrevious;        ///< Budget which was current before this one.
+
+    void spend(unsigned long operations);
+    static unsigned long currentTime();
+
+    OperationBudget(const OperationBudget &);
+    OperationBudget & operator=(const OperationBudget &);
+};
+
+
+#endif // OPERATIONBUDGET_H
@@ -19,11 +19,16 @@
 
 // Local
 #include "parser.h"
+#include "syntaxwalker.h"
 #include "exceptions.h"
 
 
 using std::vector;
 
+// Minimum estimated number of long operations of evaluation which gets
+// provisional result in parseProgressive()
+static const double PROGRESSIVE_MIN_OPERATIONS = 5000;
+
 /*!
     \class Parser
     \brief Main class of MaxCalcEngine which is used for parsing and
@@ -39,10 +44,22 @@ using std::vector;
     class for storing numbers and making calculations. Number format is
     determined by ComplexFormat class.
 
+    Numbers can have units ("5[km] / 2[h]"). During calculation they are
+    represented by Quantity, so units are combined by multiplication and
+    division and checked by addition and subtraction. Result and variables
+    are stored as numbers in units of the calculated quantity. Arithmetic
+    on scales of units is memoized in ScaleCache, so repeated calculations
+    with units cost about the same as without them.
+
     \sa ParserContext, Complex, ComplexFormat.
     \ingroup MaxCalcEngine
 */
 
+/*!
+    \class Parser::ProgressCallback
+    \brief Receives provisional result of Parser::parseProgressive().
+*/
+
 
 //****************************************************************************
 // Constructors
@@ -65,6 +82,7 @@ Parser::Parser()
 Parser::Parser(const tstring & expr, const ParserContext & context)
 {
     mExpr = expr;
+    mSource = expr;
     strToLower(mExpr);
     mContext = context;
     reset();
@@ -78,20 +96,60 @@ Parser::Parser(const tstring & expr, const ParserContext & context)
 /*!
     Performs calculation of given expression.
 
+    Evaluation is limited by cancellation token, operation budget and time
+    limit of the context, and is done with its working precision.
+
     \exception ParserException parse() throws many exceptions based on ParserException.
+    \exception EvaluationLimitException Evaluation is cancelled or exceeds its limits.
 */
 ParserContext & Parser::parse()
 {
+    OperationBudget budget(mContext.cancellationToken(),
+        mContext.operationBudget(), mContext.timeLimit());
+    WorkingPrecision precision(mContext.workingPrecision());
+
+    compile();
+    syntaxAnalysis();
+    return mContext;
+}
+
+/*!
+    Performs calculation of given expression progressively.
+
+    If evaluation is estimated to be long (see estimateCost()), the
+    expression is calculated first in a copy of the context with
+    PROVISIONAL_PRECISION working precision; its result is passed to
+    \a callback. Then the expression is calculated as by parse(). The
+    first pass is usually many times faster than the second one, so an
+    approximate result can be shown at once and replaced later.
+
+    \exception ParserException parse() throws many exceptions based on ParserException.
+    \exception EvaluationLimitException Evaluation is cancelled or exceeds its limits.
+*/
+ParserContext & Parser::parseProgressive(ProgressCallback & callback)
+{
+    bool progressive = false;
     try {
-        lexicalAnalysis();
-        syntaxAnalysis();
-    } catch (...) {
-        reset();
-        throw;
+        int precision = mContext.workingPrecision();
+        progressive = (precision == 0 || precision > PROVISIONAL_PRECISION) &&
+            estimateCost().operations >= PROGRESSIVE_MIN_OPERATIONS;
+    } catch (ParserException &) {
+        // Error is reported by parse()
     }
 
-    reset();
-    return mContext;
+    if (progressive) {
+        Parser provisional(mSource, mContext);
+        provisional.mContext.setWorkingPrecision(PROVISIONAL_PRECISION);
+        try {
+            callback.provisionalResult(provisional.parse().result());
+        } catch (EvaluationLimitException &) {
+            throw;
+        } catch (MaxCalcException &) {
+            // Calculation with full precision may succeed
+        }
+    }
+
+    return parse();
 }
 
 
@@ -106,6 +164,67 @@ void Parser::reset()
 {
     mCurChar = mExpr.begin();
     mTokens.clear();
+    mCompiled = false;
+    mSymbolsId = 0;
+}
+
+/*!
+    Prepares tokens of the expression for syntax analysis.
+
+    Tokens are kept between calls, so expression is analyzed only once;
+    identifiers are resolved again if symbol table of the context is replaced.
+
+    \exception ParserException Lexical analysis of the expression failed.
+*/
+void Parser::compile()
+{
+    if (!mCompiled) {
+        try {
+            lexicalAnalysis();
+        } catch (...) {
+            reset();
+            throw;
+        }
+        mCompiled = true;
+    }
+
+    if (mSymbolsId != mContext.variables().symbolsId()) {
+        for (list<Token>::iterator iter = mTokens.begin(); iter != mTokens.end(); ++iter) {
+            iter->hasSymbol = false;
+        }
+        mSymbolsId = mContext.variables().symbolsId();
+    }
+}
+
+/*!
+    Returns symbol of variable named by identifier \a token.
+
+    Name is interned on first use; following evaluations of the expression
+    use the stored symbol. Only assignments intern names, see findSymbol().
+*/
+Variables::Symbol Parser::symbol(Token & token)
+{
+    if (!token.hasSymbol) {
+        token.symbol = mContext.variables().intern(token.str);
+        token.hasSymbol = true;
+    }
+    return token.symbol;
+}
+
+/*!
+    Finds symbol of variable named by identifier \a token without interning
+    the name, so reading unknown variables doesn't add names.
+
+    Returns false if there is no such name.
+*/
+bool Parser::findSymbol(Token & token, Variables::Symbol & symbol)
+{
+    if (!token.hasSymbol) {
+        if (!mContext.variables().find(token.str, token.symbol)) return false;
+        token.hasSymbol = true;
+    }
+    symbol = token.symbol;
+    return true;
 }
 
 
@@ -166,7 +285,8 @@ bool Parser::analyzeAssignment()
 }
 
 /*!
-    Lexical analysis of unit conversions (syntax "[unit1 -> unit2]").
+    Lexical analysis of units and unit conversions (syntax "[unit]",
+    "[-> unit2]" or "[unit1 -> unit2]").
 
     \exception IncorrectUnitConversionSyntaxException Incorrect conversion syntax.
 */
@@ -178,12 +298,9 @@ bool Parser::analyzeUnitConversions()
 
         skipSpaces();
 
-        tstring unit = _T("");
-        while (mCurChar != mExpr.end() && isUnitChar(*mCurChar))
-            unit += *mCurChar++;
-        if (unit == _T(""))
-            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-        mTokens.push_back(Token(UNIT, unit));
+        tstring unit = readUnit();
+        if (unit != _T(""))
+            mTokens.push_back(Token(UNIT, unit));
 
         skipSpaces();
 
@@ -195,22 +312,19 @@ bool Parser::analyzeUnitConversions()
             } else {
                 throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
             }
-        } else {
-            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-        }
 
-        skipSpaces();
+            skipSpaces();
 
-        unit = _T("");
-        while (mCurChar != mExpr.end() && isUnitChar(*mCurChar)) {
-            unit += *mCurChar++;
-        }
-        if (unit == _T("")) {
+            unit = readUnit();
+            if (unit == _T("")) {
+                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
+            }
+            mTokens.push_back(Token(UNIT, unit));
+
+            skipSpaces();
+        } else if (unit == _T("")) {
             throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
         }
-        mTokens.push_back(Token(UNIT, unit));
-
-        skipSpaces();
 
         if (mCurChar != mExpr.end() && _T(']') == *mCurChar) {
             mTokens.push_back(Token(CLOSING_SQUARE_BRACKET, _T("]")));
@@ -383,375 +497,263 @@ bool Parser::skipSpaces()
 */
 void Parser::syntaxAnalysis()
 {
-    mCurToken = mTokens.begin();
-
-    Complex result = parseAssign();
-
-    if (mTokens.end() == mCurToken) mContext.setResult(result);
-    else if (CLOSING_BRACKET == mCurToken->token) throw ParserException(ParserException::TOO_MANY_CLOSING_BRACKETS);
-    else throw ParserException(ParserException::INVALID_EXPRESSION);
-}
-
-/*!
-    Parses variable assignment.
-
-    \exception IncorrectVariableNameException Incorrect var name
-*/
-Complex Parser::parseAssign()
-{
-    if (mCurToken != mTokens.end() &&
-        (mCurToken->token == IDENTIFIER || mCurToken->token == IMAGINARY_ONE)) {
-        tstring name = mCurToken->str;
-        ++mCurToken;
-        if (mCurToken != mTokens.end() && mCurToken->token == ASSIGN) {
-            if (name == _T("e") || name == _T("pi") || name == _T("res") ||
-                name == _T("result") || name == _T("i") || name == _T("j") ||
-                name == _T("exit") || name == _T("quit") ||
-                name == _T("help")) {
-                throw ParserException(ParserException::INVALID_VARIABLE_NAME);
-            }
-
-            tchar op = mCurToken->str[0];
-            Complex var;
-            if (op != _T('=')) {
-                var = mContext.variables()[name];
-            }
-            ++mCurToken;
-            Complex value = parseAssign();
-            switch (op)  {
-            case _T('='):
-                var = value;
-                break;
-            case _T('+'):
-                var += value;
-                break;
-            case _T('-'):
-                var -= value;
-                break;
-            case _T('*'):
-                var *= value;
-                break;
-            case _T('/'):
-                var /= value;
-                break;
-            case _T('^'):
-                var = Complex::pow(var, value);
-                break;
-            }
-            mContext.variables().add(name, var);
-            return var;
+    mContext.setResult(SyntaxWalker<Parser>(*this, *this).walk().value);
+}
+
+/*!
+    Returns built-in function \a name with \a argCount arguments.
+
+    \exception UnknownFunctionException Unknown function.
+*/
+Parser::Function Parser::findFunction(const tstring & name, size_t argCount)
+{
+    static const struct
+    {
+        const tchar * name;
+        Function function;
+    } functions[] = {
+        { _T("abs"), ABS },
+        { _T("sqr"), SQR },
+        { _T("sqrt"), SQRT },
+        { _T("pow"), POW },
+        { _T("fact"), FACTORIAL },
+        { _T("factorial"), FACTORIAL },
+        { _T("sin"), SIN },
+        { _T("cos"), COS },
+        { _T("tan"), TAN },
+        { _T("tg"), TAN },
+        { _T("cot"), COT },
+        { _T("ctg"), COT },
+        { _T("asin"), ARCSIN },
+        { _T("arcsin"), ARCSIN },
+        { _T("acos"), ARCCOS },
+        { _T("arccos"), ARCCOS },
+        { _T("atan"), ARCTAN },
+        { _T("arctan"), ARCTAN },
+        { _T("atg"), ARCTAN },
+        { _T("arctg"), ARCTAN },
+        { _T("acot"), ARCCOT },
+        { _T("arccot"), ARCCOT },
+        { _T("actg"), ARCCOT },
+        { _T("arcctg"), ARCCOT },
+        { _T("sinh"), SINH },
+        { _T("cosh"), COSH },
+        { _T("tanh"), TANH },
+        { _T("th"), TANH },
+        { _T("coth"), COTH },
+        { _T("cth"), COTH },
+        { _T("asinh"), ARCSINH },
+        { _T("arcsinh"), ARCSINH },
+        { _T("acosh"), ARCCOSH },
+        { _T("arccosh"), ARCCOSH },
+        { _T("atanh"), ARCTANH },
+        { _T("arctanh"), ARCTANH },
+        { _T("ath"), ARCTANH },
+        { _T("arcth"), ARCTANH },
+        { _T("acoth"), ARCCOTH },
+        { _T("arccoth"), ARCCOTH },
+        { _T("acth"), ARCCOTH },
+        { _T("arccth"), ARCCOTH },
+        { _T("ln"), LN },
+        { _T("log2"), LOG2 },
+        { _T("log10"), LOG10 },
+        { _T("exp"), EXP },
+        { _T("bin"), BIN },
+        { _T("oct"), OCT },
+        { _T("dec"), DEC },
+        { _T("hex"), HEX },
+    };
+
+    for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); ++i) {
+        if (name == functions[i].name) {
+            // TODO: correctly report known function with incorrect number
+            // of arguments
+            if (argCount != (functions[i].function == POW ? 2 : 1)) break;
+            return functions[i].function;
         }
-        --mCurToken;
     }
 
-    return parseAddSub();
+    throw ParserException(ParserException::UNKNOWN_FUNCTION, name);
 }
 
+
+//****************************************************************************
+// Evaluation of syntax
+//****************************************************************************
+
 /*!
-    Parses addition and subtraction.
+    Returns number given by \a digits (imaginary if \a imaginary is true;
+    \a digits are 0 for imaginary one).
+
+    \exception IncorrectNumberException Cannot parse the number.
 */
-Complex Parser::parseAddSub()
+Quantity Parser::number(const tstring * digits, bool imaginary)
 {
-    Complex result = parseMulDiv();
-
-    while (mCurToken != mTokens.end()) {
-        if (PLUS == mCurToken->token) {
-            ++mCurToken;
-            result += parseMulDiv();
-        } else if (MINUS == mCurToken->token) {
-            ++mCurToken;
-            result -= parseMulDiv();
-        } else {
-            break;
-        }
-    }
-    return result;
+    BigDecimal result = digits ? BigDecimal(*digits) : BigDecimal(1);
+    return imaginary ? Complex(0, result) : Complex(result);
 }
 
 /*!
-    Parses multiplication and division.
+    Returns pi.
 */
-Complex Parser::parseMulDiv()
+Quantity Parser::pi()
 {
-    Complex result = parsePower();
-
-    while (mCurToken != mTokens.end()) {
-        if (MULTIPLY == mCurToken->token) {
-            ++mCurToken;
-            result *= parsePower();
-        } else if (DIVIDE == mCurToken->token) {
-            ++mCurToken;
-            result /= parsePower();
-        } else {
-            break;
-        }
-    }
-
-    return result;
+    return Complex(BigDecimal::PI);
 }
 
 /*!
-    Parses power ('^') operator.
+    Returns e.
 */
-Complex Parser::parsePower()
+Quantity Parser::e()
 {
-    Complex result = parseUnitConversions();
-
-    while (mCurToken != mTokens.end()) {
-        if (POWER == mCurToken->token) {
-            ++mCurToken;
-            result = Complex::pow(result, parseUnitConversions());
-        } else {
-            break;
-        }
-    }
-
-    return result;
+    return Complex(BigDecimal::E);
 }
 
 /*!
-    Parses unit conversions.
+    Returns result of previous calculation.
 
-    \exception IncorrectUnitConversionSyntaxException Incorrect conversion syntax.
-    \exception IncorrectUnitConversionSyntaxException Incorrect conversion arg.
+    \exception ResultDoesNotExistException No result of prev. calculation.
 */
-Complex Parser::parseUnitConversions()
+Quantity Parser::previousResult()
 {
-    Complex result = parseUnaryPlusMinus();
-
-    while (mCurToken != mTokens.end()) {
-        if (OPENING_SQUARE_BRACKET == mCurToken->token) {
-            ++mCurToken;
-            if (mCurToken == mTokens.end() || mCurToken->token != UNIT) {
-                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-            }
-            tstring unit1 = mCurToken->str;
-            ++mCurToken;
-            if (mCurToken == mTokens.end() || mCurToken->token != ARROW) {
-                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-            }
-            ++mCurToken;
-            if (mCurToken == mTokens.end() || mCurToken->token != UNIT) {
-                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-            }
-            tstring unit2 = mCurToken->str;
-            ++mCurToken;
-            if (mCurToken == mTokens.end() || mCurToken->token != CLOSING_SQUARE_BRACKET) {
-                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
-            }
-            ++mCurToken;
-
-            if (!result.im.isZero()) {
-                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_ARGUMENT,
-                        _T("[") + unit1 + _T("->") + unit2 + _T("]"));
-            }
-
-            result = mUnitConversion.convert(result.re, unit1, unit2);
-        } else {
-            break;
-        }
+    if (!mContext.resultExists()) {
+        throw ParserException(ParserException::NO_PREVIOUS_RESULT);
     }
-
-    return result;
+    return mContext.result();
 }
 
 /*!
-    Parses unary plus and minus operators.
+    Returns value of variable \a name.
+
+    \exception UnknownVariableException Variable doesn't have a value.
 */
-Complex Parser::parseUnaryPlusMinus()
+Quantity Parser::variable(Token & name)
 {
-    bool negative = false;
-
-    while (mCurToken != mTokens.end()) {
-        if (PLUS == mCurToken->token) {
-            ++mCurToken;
-        } else if (MINUS == mCurToken->token) {
-            ++mCurToken;
-            negative = !negative;
-        } else {
-            break;
-        }
+    // Variables::value() will throw UnknownVariableException if
+    // variable doesn't have a value
+    Variables::Symbol varSymbol;
+    if (!findSymbol(name, varSymbol)) {
+        throw ParserException(ParserException::UNKNOWN_VARIABLE, name.str);
     }
-
-    return negative ? -parseBrackets() : parseBrackets();
+    return mContext.variables().value(varSymbol);
+}
+
+/*!
+    Assigns \a value to variable \a name.
+*/
+void Parser::assign(Token & name, const Quantity & value)
+{
+    // Variables keep only value of the quantity
+    mContext.variables().setValue(symbol(name), value.value, name.str);
+}
+
+/*!
+    Calculates built-in \a function of \a args.
+*/
+Quantity Parser::function(Function function, vector<Quantity> & args)
+{
+    switch (function) {
+    case ABS: return Quantity::abs(args[0]);
+    case SQR: return Quantity::sqr(args[0]);
+    case SQRT: return Quantity::sqrt(args[0]);
+    case POW: return Quantity::pow(args[0], args[1]);
+    case FACTORIAL: return Complex(Complex::factorial(dimensionless(args[0])));
+    case SIN: return Complex::sin(toRadians(args[0]));
+    case COS: return Complex::cos(toRadians(args[0]));
+    case TAN: return Complex::tan(toRadians(args[0]));
+    case COT: return Complex::cot(toRadians(args[0]));
+    case ARCSIN: return fromRadians(Complex::arcsin(dimensionless(args[0])));
+    case ARCCOS: return fromRadians(Complex::arccos(dimensionless(args[0])));
+    case ARCTAN: return fromRadians(Complex::arctan(dimensionless(args[0])));
+    case ARCCOT: return fromRadians(Complex::arccot(dimensionless(args[0])));
+    case SINH: return Complex::sinh(toRadians(args[0]));
+    case COSH: return Complex::cosh(toRadians(args[0]));
+    case TANH: return Complex::tanh(toRadians(args[0]));
+    case COTH: return Complex::coth(toRadians(args[0]));
+    case ARCSINH: return fromRadians(Complex::arcsinh(dimensionless(args[0])));
+    case ARCCOSH: return fromRadians(Complex::arccosh(dimensionless(args[0])));
+    case ARCTANH: return fromRadians(Complex::arctanh(dimensionless(args[0])));
+    case ARCCOTH: return fromRadians(Complex::arccoth(dimensionless(args[0])));
+    case LN: return Complex::ln(dimensionless(args[0]));
+    case LOG2: return Complex::log2(dimensionless(args[0]));
+    case LOG10: return Complex::log10(dimensionless(args[0]));
+    case EXP: return Complex::exp(dimensionless(args[0]));
+    case BIN: args[0].value.setBase(2); return args[0];
+    case OCT: args[0].value.setBase(8); return args[0];
+    case DEC: args[0].value.setBase(10); return args[0];
+    case HEX: args[0].value.setBase(16); return args[0];
+    }
+    return args[0];
 }
 
 /*!
-    Parses brackets.
-
-    \exception NoClosingBracketException Closing bracket is missing.
+    Negates \a value.
 */
-Complex Parser::parseBrackets()
+void Parser::negate(Quantity & value)
 {
-    if (mCurToken != mTokens.end() && OPENING_BRACKET == mCurToken->token) {
-        ++mCurToken;
-        Complex result = parseAddSub();
-        if (mTokens.end() == mCurToken || CLOSING_BRACKET != mCurToken->token) {
-            throw ParserException(ParserException::NO_CLOSING_BRACKET);
-        }
-        ++mCurToken;
-        return result;
-    }
-
-    return parseFunctions();
+    value = -value;
 }
 
 /*!
-    Parses built-in functions.
-
-    \exception UnknownFunctionException Unknown function found.
+    Multiplies \a result by \a q.
 */
-Complex Parser::parseFunctions()
+void Parser::multiply(Quantity & result, const Quantity & q)
 {
-    if (mCurToken != mTokens.end() && IDENTIFIER == mCurToken->token) {
-        tstring name = mCurToken->str;
-        ++mCurToken;
-
-        vector<Complex> args;
-
-        if (!parseFunctionArguments(args)) {
-            // Go back if it is not a function
-            --mCurToken;
-        } else {
-            // Process functions
-            if (name == _T("abs") && args.size() == 1) return Complex::abs(args[0]);
-            else if (name == _T("sqr") && args.size() == 1) return Complex::sqr(args[0]);
-            else if (name == _T("sqrt") && args.size() == 1) return Complex::sqrt(args[0]);
-            else if (name == _T("pow") && args.size() == 2) return Complex::pow(args[0], args[1]);
-            else if ((name == _T("fact") || name == _T("factorial")) && args.size() == 1) return Complex::factorial(args[0]);
-            else if (name == _T("sin") && args.size() == 1) return Complex::sin(toRadians(args[0]));
-            else if (name == _T("cos") && args.size() == 1) return Complex::cos(toRadians(args[0]));
-            else if ((name == _T("tan") || name == _T("tg")) && args.size() == 1) return Complex::tan(toRadians(args[0]));
-            else if ((name == _T("cot") || name == _T("ctg")) && args.size() == 1) return Complex::cot(toRadians(args[0]));
-            else if ((name == _T("asin") || name == _T("arcsin")) && args.size() == 1) return fromRadians(Complex::arcsin(args[0]));
-            else if ((name == _T("acos") || name == _T("arccos")) && args.size() == 1) return fromRadians(Complex::arccos(args[0]));
-            else if ((name == _T("atan") || name == _T("arctan") || name == _T("atg") || name == _T("arctg")) && args.size() == 1) return fromRadians(Complex::arctan(args[0]));
-            else if ((name == _T("acot") || name == _T("arccot") || name == _T("actg") || name == _T("arcctg")) && args.size() == 1) return fromRadians(Complex::arccot(args[0]));
-            else if (name == _T("sinh") && args.size() == 1) return Complex::sinh(toRadians(args[0]));
-            else if (name == _T("cosh") && args.size() == 1) return Complex::cosh(toRadians(args[0]));
-            else if ((name == _T("tanh") || name == _T("th")) && args.size() == 1) return Complex::tanh(toRadians(args[0]));
-            else if ((name == _T("coth") || name == _T("cth")) && args.size() == 1) return Complex::coth(toRadians(args[0]));
-            else if ((name == _T("asinh") || name == _T("arcsinh")) && args.size() == 1) return fromRadians(Complex::arcsinh(args[0]));
-            else if ((name == _T("acosh") || name == _T("arccosh")) && args.size() == 1) return fromRadians(Complex::arccosh(args[0]));
-            else if ((name == _T("atanh") || name == _T("arctanh") || name == _T("ath") || name == _T("arcth")) && args.size() == 1) return fromRadians(Complex::arctanh(args[0]));
-            else if ((name == _T("acoth") || name == _T("arccoth") || name == _T("acth") || name == _T("arccth")) && args.size() == 1) return fromRadians(Complex::arccoth(args[0]));
-            else if (name == _T("ln") && args.size() == 1) return Complex::ln(args[0]);
-            else if (name == _T("log2") && args.size() == 1) return Complex::log2(args[0]);
-            else if (name == _T("log10") && args.size() == 1) return Complex::log10(args[0]);
-            else if (name == _T("exp") && args.size() == 1) return Complex::exp(args[0]);
-            else if (name == _T("bin") && args.size() == 1) { return args[0].setBase(2); }
-            else if (name == _T("oct") && args.size() == 1) { return args[0].setBase(8); }
-            else if (name == _T("dec") && args.size() == 1) { return args[0].setBase(10); }
-            else if (name == _T("hex") && args.size() == 1) { return args[0].setBase(16); }
-            else throw ParserException(ParserException::UNKNOWN_FUNCTION, name);
-
-            // TODO: correctly report known function with incorrect number
-            // of arguments
-        }
-    }
-
-    return parseConstsVars();
+    result.multiply(q, mScales);
 }
 
 /*!
-    Parses constants and variables.
-
-    \exception ResultDoesNotExistException No result of prev. calculation.
+    Divides \a result by \a q.
 */
-Complex Parser::parseConstsVars()
-{
-    if (mCurToken != mTokens.end() && IDENTIFIER == mCurToken->token) {
-        if (_T("pi") == mCurToken->str) {
-            ++mCurToken;
-            return BigDecimal::PI;
-        } else if (_T("e") == mCurToken->str) {
-            ++mCurToken;
-            return BigDecimal::E;
-        } else if (_T("res") == mCurToken->str || _T("result") == mCurToken->str) {
-            ++mCurToken;
-            if (mContext.resultExists()) return mContext.result();
-            else throw ParserException(ParserException::NO_PREVIOUS_RESULT);
-        } else {
-            // Variables.operator[] will throw UnknownVariableException if
-            // curToken_->str doesn't exist
-            Complex value = mContext.variables()[mCurToken->str];
-            ++mCurToken;
-            return value;
-        }
-    }
-
-    return parseNumbers();
+void Parser::divide(Quantity & result, const Quantity & q)
+{
+    result.divide(q, mScales);
 }
 
 /*!
-    Parses numbers (including complex numbers and exponential notation).
-
-    \exception IncorrectNumberException Cannot parse the number.
-    \exception IncorrectExpressionException Parsing hasn't completed on number.
+    Raises \a value to \a power.
 */
-Complex Parser::parseNumbers()
+Quantity Parser::power(const Quantity & value, const Quantity & power)
 {
-    BigDecimal result;
-    bool thereIsResult = false;
-    bool isComplex = false;
-
-    if (mCurToken != mTokens.end() && IMAGINARY_ONE == mCurToken->token) {
-        result = 1;
-        isComplex = true;
-        thereIsResult = true;
-        ++mCurToken;
-    }
-
-    if (mCurToken != mTokens.end() && NUMBER == mCurToken->token) {
-        result = BigDecimal(mCurToken->str);
-        thereIsResult = true;
-        ++mCurToken;
-    }
-    
-    if (mCurToken != mTokens.end() && IMAGINARY_ONE == mCurToken->token) {
-        if (!isComplex) {
-            isComplex = true;
-            thereIsResult = true;
-            ++mCurToken;
-        } else {
-            throw ParserException(ParserException::INVALID_NUMBER);
-        }
-    }
-    
-    if (thereIsResult) {
-        return isComplex ? Complex(0, result) : result;
-    }
-
-    throw ParserException(ParserException::INVALID_EXPRESSION);
+    return Quantity::pow(value, power);
 }
 
 /*!
-    Parses function arguments including opening and closing brackets.
+    Converts \a value by unit conversion.
 
-    \exception NoClosingBracketException Closing bracket is missing.
-*/
-bool Parser::parseFunctionArguments(vector<Complex> & args)
-{
-    if (mCurToken != mTokens.end() && OPENING_BRACKET == mCurToken->token) {
-        ++mCurToken;
-        
-        // Parse arguments
-        args.push_back(parseAddSub());
-        while (mCurToken != mTokens.end() && mCurToken->token == SEMICOLON) {
-            ++mCurToken;
-            args.push_back(parseAddSub());
-        }
+    "[unit1]" gives unit to a number or converts quantity to the unit.
+    "[-> unit2]" converts quantity to the unit. "[unit1 -> unit2]" converts
+    a number from unit1 to unit2 (result is a number without units) or
+    converts quantity in unit1 to unit2.
 
-        // Check for closing bracket
-        if (mCurToken == mTokens.end() || mCurToken->token != CLOSING_BRACKET) {
-            throw ParserException(ParserException::NO_CLOSING_BRACKET);
+    \exception IncorrectUnitConversionSyntaxException Incorrect conversion arg.
+*/
+void Parser::convert(Quantity & value, const tstring & unit1, const tstring & unit2)
+{
+    if (unit2.empty()) {
+        // [unit]
+        UnitConversion::NormalizedUnit unit = UnitConversion::normalize(unit1);
+        if (value.isDimensionless()) value = Quantity(value.value, unit);
+        else value = convertQuantity(value, unit);
+    } else if (unit1.empty()) {
+        // [-> unit]
+        value = convertQuantity(value, UnitConversion::normalize(unit2));
+    } else if (value.isDimensionless()) {
+        // [unit1 -> unit2] for a number
+        if (!value.value.im.isZero()) {
+            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_ARGUMENT,
+                    _T("[") + unit1 + _T("->") + unit2 + _T("]"));
         }
-
-        ++mCurToken;
-
-        return true;
+        UnitConversion::Converter converter(unit1, unit2);
+        value.value = converter.convert(value.value.re);
     } else {
-        return false;
+        // [unit1 -> unit2] for a quantity
+        UnitConversion::NormalizedUnit unit = UnitConversion::normalize(unit1);
+        if (value.dimension != unit.dimension) {
+            throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+                value.unitString() + _T(" -> ") + unit.name);
+        }
+        value = convertQuantity(value, UnitConversion::normalize(unit2));
     }
 }
 
@@ -770,6 +772,7 @@ void Parser::setExpression(const tstring & expr)
 {
     reset();
     mExpr = expr;
+    mSource = expr;
     strToLower(mExpr);
 }
 
@@ -802,7 +805,28 @@ bool Parser::isIdentifierChar(tchar c, bool firstChar)
 */
 bool Parser::isUnitChar(tchar c)
 {
-    return (istalpha(c) || c == _T('/'));
+    return (istalpha(c) || istdigit(c) || c == _T('/') || c == _T('*') || c == _T('^'));
+}
+
+/*!
+    Reads unit expression (like "kn*m" or "m*s^-2") starting at current character.
+
+    Minus is accepted only right after '^', so it does not consume arrow.
+    Unit is taken from the expression as entered because SI prefixes are
+    case-sensitive.
+*/
+tstring Parser::readUnit()
+{
+    tstring::const_iterator start = mCurChar;
+    while (mCurChar != mExpr.end()) {
+        if (isUnitChar(*mCurChar) ||
+            (_T('-') == *mCurChar && mCurChar != start && *(mCurChar - 1) == _T('^'))) {
+            ++mCurChar;
+        } else {
+            break;
+        }
+    }
+    return mSource.substr(start - mExpr.begin(), mCurChar - start);
 }
 
 /*!
@@ -822,11 +846,23 @@ bool Parser::isImaginaryOne(tchar c)
 }
 
 /*!
-    Converts \a angle from current unit (ParserContext::angleUnit()) to radians.
+    Converts angle \a q from current unit (ParserContext::angleUnit()) to radians.
+
+    Angle with units (like "90[deg]") is converted from its unit.
+
+    \exception ParserException \a angle has units which are not angle units.
 */
-Complex Parser::toRadians(Complex angle)
+Complex Parser::toRadians(const Quantity & q)
 {
-    if (mContext.angleUnit() != ParserContext::RADIANS) {
+    Complex angle = q.value;
+    if (!q.isDimensionless()) {
+        if (q.dimension != UnitConversion::dimension(UnitConversion::RADIAN)) {
+            throw ParserException(ParserException::INCOMPATIBLE_UNITS, q.unitString());
+        }
+        // Scale of angle unit is its size in radians
+        angle.re *= q.scale;
+        if (!angle.im.isZero()) angle.im *= q.scale;
+    } else if (mContext.angleUnit() != ParserContext::RADIANS) {
         int divider = 1;
         if (mContext.angleUnit() == ParserContext::DEGREES) {
             divider = 180;
@@ -861,3 +897,101 @@ Complex Parser::fromRadians(Complex angle)
     return angle;
 }
 
+
+//****************************************************************************
+// Quantities
+//****************************************************************************
+
+/*!
+    Adds \a q to \a result (or subtracts if \a subtract is true).
+
+    \a q is converted to units of \a result. Quantities in affine units
+    (like Celsius) can be added only to quantities in the same unit: it is
+    not known whether the other quantity is a temperature or a difference of
+    temperatures.
+
+    \exception ParserException Dimensions of quantities are different or
+    one of quantities is in affine unit and units are different.
+*/
+void Parser::add(Quantity & result, const Quantity & q, bool subtract)
+{
+    bool affine = (result.tableUnit != 0 && UnitConversion::isAffine(result.tableUnit->unit)) ||
+                  (q.tableUnit != 0 && UnitConversion::isAffine(q.tableUnit->unit));
+    if (result.dimension != q.dimension || (affine && result.tableUnit != q.tableUnit)) {
+        throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+            result.unitString() + (subtract ? _T(" - ") : _T(" + ")) + q.unitString());
+    }
+
+    if (q.isDimensionless() || q.isInUnit(result.unitName) || result.scale == q.scale) {
+        if (subtract) result.value -= q.value;
+        else result.value += q.value;
+        return;
+    }
+
+    const BigDecimal & factor = mScales.quotient(q.scale, result.scale);
+    Complex value = q.value;
+    value.re *= factor;
+    if (!value.im.isZero()) value.im *= factor;
+    if (subtract) result.value -= value;
+    else result.value += value;
+}
+
+/*!
+    Converts \a q to \a unit.
+
+    Quantities in units of the table are converted by UnitConversion (so
+    conversion is exact and can be non-linear, like for temperatures);
+    quantities in derived units and unit expressions are multiplied by a
+    memoized factor between scales, unless the other unit is non-linear.
+
+    \exception ParserException Dimension of \a q and \a unit are different.
+*/
+Quantity Parser::convertQuantity(const Quantity & q, const UnitConversion::NormalizedUnit & unit)
+{
+    if (q.dimension != unit.dimension) {
+        throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+                              q.unitString() + _T(" -> ") + unit.name);
+    }
+
+    if (q.isInUnit(unit.name)) return q;
+
+    Quantity result(q.value, unit);
+
+    bool affine = (q.tableUnit != 0 && UnitConversion::isAffine(q.tableUnit->unit)) ||
+                  (unit.unit != 0 && UnitConversion::isAffine(unit.unit->unit));
+
+    if ((q.tableUnit != 0 && unit.unit != 0) || affine) {
+        // Derived unit is proportional to base units
+        UnitConversion::NormalizedUnit from;
+        from.name = q.unitString();
+        from.unit = q.tableUnit;
+        from.scale = q.scale;
+        from.dimension = q.dimension;
+        UnitConversion::Converter converter(from, unit);
+        if (!converter.isLinear() && !q.value.im.isZero()) {
+            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_ARGUMENT,
+                _T("[") + from.name + _T("->") + unit.name + _T("]"));
+        }
+        result.value.re = converter.convert(q.value.re);
+        if (!q.value.im.isZero()) result.value.im = converter.convert(q.value.im);
+    } else if (q.scale != result.scale) {
+        const BigDecimal & factor = mScales.quotient(q.scale, result.scale);
+        result.value.re *= factor;
+        if (!result.value.im.isZero()) result.value.im *= factor;
+    }
+
+    return result;
+}
+
+/*!
+    Returns value of \a q which must not have units.
+
+    \exception ParserException \a q has units.
+*/
+const Complex & Parser::dimensionless(const Quantity & q)
+{
+    if (!q.isDimensionless()) {
+        throw ParserException(ParserException::INCOMPATIBLE_UNITS, q.unitString());
+    }
+    return q.value;
+}
@@ -22,7 +22,9 @@
 
 // Local
 #include "parsercontext.h"
+#include "costestimate.h"
 #include "complex.h"
+#include "quantity.h"
 #include "unitconversion.h"
 #include "unicode.h"
 // STL
@@ -37,6 +39,18 @@ class Parser
 {
 public:
 
+    /// Receives provisional result of parseProgressive().
+    class ProgressCallback
+    {
+    public:
+        virtual ~ProgressCallback() { }
+        /// Called when provisional \a result is calculated with low precision.
+        virtual void provisionalResult(const Complex & result) = 0;
+    };
+
+    /// Working precision of provisional result of parseProgressive().
+    static const int PROVISIONAL_PRECISION = 20;
+
     ///////////////////////////////////////////////////////////////////////////
     // Constructors
 
@@ -47,6 +61,8 @@ public:
     // Public functions
 
     ParserContext & parse();
+    ParserContext & parseProgressive(ProgressCallback & callback);
+    CostEstimate estimateCost();
 
     ///////////////////////////////////////////////////////////////////////////
     // Accessors
@@ -59,18 +75,25 @@ public:
 
 private:
 
+    friend class CostEstimator;
+    template <class Semantics> friend class SyntaxWalker;
+
     ///////////////////////////////////////////////////////////////////////////
     // Private variables
 
-    tstring mExpr;                          ///< Expression to be parsed.
+    tstring mExpr;                          ///< Expression to be parsed (in lower case).
+    tstring mSource;                        ///< Expression as entered (units are case-sensitive).
     ParserContext mContext;                 ///< Parser context.
-    UnitConversion mUnitConversion;         ///< Unit conversion.
+    ScaleCache mScales;                     ///< Memoized arithmetic on scales of units.
+    bool mCompiled;                         ///< True if tokens of expression are ready.
+    unsigned mSymbolsId;                    ///< Symbol table of resolved identifiers.
 
 
     ///////////////////////////////////////////////////////////////////////////
     // Utility functions
 
     void reset();
+    void compile();
 
 
     ///////////////////////////////////////////////////////////////////////////
@@ -104,14 +127,16 @@ private:
     {
         /// Constructs new Token from given \a token_ and \a str_
         Token(const Tokens token_, const tstring & str_)
-        { token = token_; str = str_; }
+        { token = token_; str = str_; hasSymbol = false; }
 
         /// Constructs new Token from given \a token_ and \a char_
         Token(const Tokens token_, const tchar char_)
-        { token = token_; str = char_; }
+        { token = token_; str = char_; hasSymbol = false; }
 
         Tokens token;                   ///< Token.
         tstring str;                    ///< String corresponding to token.
+        bool hasSymbol;                 ///< True if identifier is resolved to symbol.
+        Variables::Symbol symbol;       ///< Symbol of variable (if hasSymbol).
     };
 
     list<Token> mTokens;           ///< List of tokens
@@ -126,30 +151,83 @@ private:
     bool skipSpaces();
     bool isIdentifierChar(tchar c, bool firstChar);
     bool isUnitChar(tchar c);
+    tstring readUnit();
     bool isDecimalSeparator(tchar c);
     bool isImaginaryOne(tchar c);
 
 
     ///////////////////////////////////////////////////////////////////////////
-    // Syntax analyzer
+    // Syntax analyzer (see SyntaxWalker)
+
+    /// Enum of built-in functions.
+    enum Function
+    {
+        ABS,
+        SQR,
+        SQRT,
+        POW,
+        FACTORIAL,
+        SIN,
+        COS,
+        TAN,
+        COT,
+        ARCSIN,
+        ARCCOS,
+        ARCTAN,
+        ARCCOT,
+        SINH,
+        COSH,
+        TANH,
+        COTH,
+        ARCSINH,
+        ARCCOSH,
+        ARCTANH,
+        ARCCOTH,
+        LN,
+        LOG2,
+        LOG10,
+        EXP,
+        BIN,
+        OCT,
+        DEC,
+        HEX,
+    };
 
-    list<Token>::const_iterator mCurToken; ///< Current token in the list of tokens
+    Variables::Symbol symbol(Token & token);
+    bool findSymbol(Token & token, Variables::Symbol & symbol);
+    static Function findFunction(const tstring & name, size_t argCount);
 
     void syntaxAnalysis();
-    Complex parseAssign();
-    Complex parseAddSub();
-    Complex parseMulDiv();
-    Complex parsePower();
-    Complex parseUnitConversions();
-    Complex parseUnaryPlusMinus();
-    Complex parseBrackets();
-    Complex parseFunctions();
-    Complex parseConstsVars();
-    Complex parseNumbers();
-
-    bool parseFunctionArguments(vector<Complex> & args);
-    Complex toRadians(Complex angle);
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Evaluation of syntax (semantics of SyntaxWalker)
+
+    typedef Quantity Value;
+
+    Quantity number(const tstring * digits, bool imaginary);
+    Quantity pi();
+    Quantity e();
+    Quantity previousResult();
+    Quantity variable(Token & name);
+    void assign(Token & name, const Quantity & value);
+    Quantity function(Function function, vector<Quantity> & args);
+    void negate(Quantity & value);
+    void add(Quantity & result, const Quantity & q, bool subtract);
+    void multiply(Quantity & result, const Quantity & q);
+    void divide(Quantity & result, const Quantity & q);
+    Quantity power(const Quantity & value, const Quantity & power);
+    void convert(Quantity & value, const tstring & unit1, const tstring & unit2);
+
+    Complex toRadians(const Quantity & q);
     Complex fromRadians(Complex angle);
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Quantities
+
+    Quantity convertQuantity(const Quantity & q, const UnitConversion::NormalizedUnit & unit);
+    static const Complex & dimensionless(const Quantity & q);
 };
 
 
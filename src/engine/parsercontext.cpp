@@ -31,6 +31,12 @@
      * Number format.
      * Variables.
      * Angle unit.
+     * Limits of evaluation: cancellation token, operation budget and
+       time limit (see OperationBudget).
+
+    Copying of context doesn't depend on number of variables: variables are
+    shared by copies until they are changed (see Variables). So contexts can
+    be cheaply forked from a common base context, e.g. one per session.
 
     \sa Parser, ComplexFormat, Variables
     \ingroup MaxCalcEngine
@@ -44,8 +50,13 @@ ParserContext::ParserContext(const ComplexFormat & numberFormat)
 {
     mResult = Complex();
     mResultExists = false;
+    mResultVersion = 0;
     mNumberFormat = numberFormat;
     mAngleUnit = RADIANS;
+    mCancellationToken = 0;
+    mOperationBudget = 0;
+    mTimeLimit = 0;
+    mWorkingPrecision = 0;
 }
 
 /*!
@@ -65,5 +76,6 @@ void ParserContext::setResult(const Complex & result)
 {
     mResult = result;
     mResultExists = true;
+    ++mResultVersion;
 }
 
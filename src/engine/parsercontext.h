@@ -24,6 +24,7 @@
 #include "complex.h"
 #include "complexformat.h"
 #include "exceptions.h"
+#include "operationbudget.h"
 #include "variables.h"
 
 
@@ -51,6 +52,8 @@ public:
 
     /// Returns true if there is result of previous calculation.
     bool resultExists() const { return mResultExists; }
+    /// Returns number of changes of result; it changes when result is set.
+    unsigned long resultVersion() const { return mResultVersion; }
 
     /// Gets number format.
     ComplexFormat & numberFormat() { return mNumberFormat; }
@@ -67,6 +70,26 @@ public:
     /// Sets angle unit.
     void setAngleUnit(const AngleUnit unit) { mAngleUnit = unit; }
 
+    /// Gets token which cancels evaluation (0 if there is no token).
+    CancellationToken * cancellationToken() const { return mCancellationToken; }
+    /// Sets token which cancels evaluation; it is not owned by the context.
+    void setCancellationToken(CancellationToken * token) { mCancellationToken = token; }
+
+    /// Gets maximum number of long operations per evaluation (0 means no limit).
+    unsigned long operationBudget() const { return mOperationBudget; }
+    /// Sets maximum number of long operations per evaluation (0 means no limit).
+    void setOperationBudget(unsigned long operations) { mOperationBudget = operations; }
+
+    /// Gets time limit of evaluation in milliseconds (0 means no limit).
+    unsigned long timeLimit() const { return mTimeLimit; }
+    /// Sets time limit of evaluation in milliseconds (0 means no limit).
+    void setTimeLimit(unsigned long milliseconds) { mTimeLimit = milliseconds; }
+
+    /// Gets precision of calculations in decimal digits (0 means full precision).
+    int workingPrecision() const { return mWorkingPrecision; }
+    /// Sets precision of calculations in decimal digits (0 means full precision).
+    void setWorkingPrecision(int digits) { mWorkingPrecision = digits; }
+
 private:
 
     ///////////////////////////////////////////////////////////////////////////
@@ -74,9 +97,14 @@ private:
 
     Complex mResult;                ///< Result of last calculation.
     bool mResultExists;             ///< Determines if result exists.
+    unsigned long mResultVersion;   ///< Number of changes of result.
     ComplexFormat mNumberFormat;    ///< Number format used for conversions.
     Variables mVars;                ///< Variables.
     AngleUnit mAngleUnit;           ///< Angle unit.
+    CancellationToken * mCancellationToken; ///< Token which cancels evaluation.
+    unsigned long mOperationBudget; ///< Maximum number of long operations.
+    unsigned long mTimeLimit;       ///< Time limit of evaluation in milliseconds.
+    int mWorkingPrecision;          ///< Precision of calculations or 0.
 };
 
 
@@ -0,0 +1,321 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "quantity.h"
+#include "exceptions.h"
+// STL
+#include <sstream>
+
+
+/*!
+    \class Quantity
+    \brief Represents a number with units.
+
+    Quantity is a Complex value together with dimension and scale of its
+    unit. Scale is the size of the unit in base units of the dimension (SI
+    units for lengths, masses and times, radians for angles and kelvins for
+    temperatures), so 5 km is stored as value 5, dimension length and scale
+    1000.
+
+    Multiplication and division combine dimensions and scales, so value is
+    always expressed in the unit of the quantity. Units which cancel out are
+    folded into the value. Quantity created from a unit (a name from the
+    tables or a unit expression like "kn*m") also keeps name of the unit
+    and its unit of the tables, which allows exact (and non-linear)
+    conversions of quantities in units of the tables.
+
+    Parser uses Quantity for all calculations. Addition and conversion of
+    quantities are done in Parser. Scales are combined through ScaleCache,
+    so formulas with units evaluated many times do not repeat arithmetic
+    on scales.
+
+    \sa Dimension, ScaleCache, UnitConversion, Parser
+    \ingroup MaxCalcEngine
+*/
+
+
+//****************************************************************************
+// Constructors
+//****************************************************************************
+
+/*!
+    Constructs a new quantity equal to zero without units.
+*/
+Quantity::Quantity() : scale(1), tableUnit(0)
+{
+}
+
+/*!
+    Constructs a new quantity without units from \a value_.
+*/
+Quantity::Quantity(const Complex & value_) : value(value_), scale(1), tableUnit(0)
+{
+}
+
+/*!
+    Constructs a new quantity from \a value_ in \a unit_.
+*/
+Quantity::Quantity(const Complex & value_, const UnitConversion::NormalizedUnit & unit_)
+    : value(value_), dimension(unit_.dimension), scale(unit_.scale),
+      unitName(unit_.name), tableUnit(unit_.unit)
+{
+}
+
+
+//****************************************************************************
+// Functions
+//****************************************************************************
+
+/*!
+    Returns name of the unit of quantity.
+
+    Derived units are written in base units (like "m*s^-1"); quantity
+    without units has unit "1".
+*/
+tstring Quantity::unitString() const
+{
+    if (!unitName.empty()) return unitName;
+    if (isDimensionless()) return _T("1");
+
+    static const tchar * const BASE_UNITS[Dimension::BASE_COUNT] =
+        { _T("rad"), _T("m"), _T("kg"), _T("k"), _T("s") };
+
+    tstringstream result;
+    for (int i = 0; i < Dimension::BASE_COUNT; ++i) {
+        int exponent = dimension.exponent((Dimension::BaseDimension)i);
+        if (exponent == 0) continue;
+        if (!result.str().empty()) result << _T('*');
+        result << BASE_UNITS[i];
+        if (exponent != 1) result << _T('^') << exponent;
+    }
+    return result.str();
+}
+
+/*!
+    Returns quantity with negated value.
+*/
+Quantity Quantity::operator-() const
+{
+    Quantity result(*this);
+    result.value = -value;
+    return result;
+}
+
+/*!
+    Multiplies quantity by \a q combining their dimensions.
+
+    Product of scales is taken from \a cache.
+*/
+void Quantity::multiply(const Quantity & q, ScaleCache & cache)
+{
+    value *= q.value;
+
+    if (q.isDimensionless()) return;
+    if (isDimensionless()) {
+        dimension = q.dimension;
+        scale = q.scale;
+        unitName = q.unitName;
+        tableUnit = q.tableUnit;
+        return;
+    }
+
+    dimension = dimension * q.dimension;
+    scale = cache.product(scale, q.scale);
+    setDerivedUnit();
+    normalize();
+}
+
+/*!
+    Divides quantity by \a q combining their dimensions.
+
+    Quotient of scales is taken from \a cache.
+*/
+void Quantity::divide(const Quantity & q, ScaleCache & cache)
+{
+    value /= q.value;
+
+    if (q.isDimensionless()) return;
+
+    dimension = dimension / q.dimension;
+    scale = cache.quotient(scale, q.scale);
+    setDerivedUnit();
+    normalize();
+}
+
+/*!
+    Returns absolute value of \a q in the same unit.
+*/
+Quantity Quantity::abs(const Quantity & q)
+{
+    Quantity result(q);
+    result.value = Complex::abs(q.value);
+    return result;
+}
+
+/*!
+    Returns \a q squared (square of absolute value of complex number).
+*/
+Quantity Quantity::sqr(const Quantity & q)
+{
+    Quantity result(q);
+    result.value = Complex::sqr(q.value);
+    if (!q.isDimensionless()) {
+        result.dimension = q.dimension.pow(2);
+        result.scale = q.scale * q.scale;
+        result.setDerivedUnit();
+    }
+    return result;
+}
+
+/*!
+    Returns square root of \a q.
+
+    \exception ParserException Dimension of \a q is not a square.
+*/
+Quantity Quantity::sqrt(const Quantity & q)
+{
+    Quantity result(q);
+    result.value = Complex::sqrt(q.value);
+    if (!q.isDimensionless()) {
+        int exponents[Dimension::BASE_COUNT];
+        for (int i = 0; i < Dimension::BASE_COUNT; ++i) {
+            exponents[i] = q.dimension.exponent((Dimension::BaseDimension)i);
+            if (exponents[i] % 2 != 0) {
+                throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+                                      q.unitString());
+            }
+        }
+        result.dimension = Dimension(exponents[0] / 2, exponents[1] / 2,
+            exponents[2] / 2, exponents[3] / 2, exponents[4] / 2);
+        result.scale = BigDecimal::sqrt(q.scale);
+        result.setDerivedUnit();
+    }
+    return result;
+}
+
+/*!
+    Raises \a q to \a power.
+
+    Quantity with units can be raised only to integer power.
+
+    \exception ParserException \a power has units or is not an integer.
+*/
+Quantity Quantity::pow(const Quantity & q, const Quantity & power)
+{
+    if (!power.isDimensionless()) {
+        throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+                              power.unitString());
+    }
+    if (q.isDimensionless()) return Complex::pow(q.value, power.value);
+
+    if (!power.value.im.isZero() || !power.value.re.fractional().isZero()) {
+        throw ParserException(ParserException::INCOMPATIBLE_UNITS,
+                              q.unitString());
+    }
+
+    int exponent = power.value.re.toInt();
+    Quantity result(q);
+    result.value = Complex::pow(q.value, power.value);
+    if (exponent != 1) {
+        result.dimension = q.dimension.pow(exponent);
+        result.scale = BigDecimal::pow(q.scale, exponent);
+        result.setDerivedUnit();
+        result.normalize();
+    }
+    return result;
+}
+
+/*!
+    Folds scale into value when units cancel out.
+*/
+void Quantity::normalize()
+{
+    if (dimension.isNone()) {
+        if (scale != 1) value *= Complex(scale);
+        scale = 1;
+        setDerivedUnit();
+    }
+}
+
+/*!
+    Forgets name of the unit when scale and dimension no longer correspond
+    to it.
+*/
+void Quantity::setDerivedUnit()
+{
+    unitName.clear();
+    tableUnit = 0;
+}
+
+
+/*!
+    \class ScaleCache
+    \brief Memoizes products and quotients of scales of quantities.
+
+    Scales of derived units (like km/h) are products and quotients of scales
+    of units in the table. Formulas are usually evaluated with the same units
+    many times, so each product or quotient is calculated once and then
+    found by comparison of scales. Results are calculated with full
+    precision, so they don't depend on working precision of the evaluation
+    which calculated them first.
+
+    ScaleCache is not thread-safe; each Parser has its own cache.
+
+    \sa Quantity
+    \ingroup MaxCalcEngine
+*/
+
+// Limit of memoized results (the cache is cleared when it is reached)
+static const size_t MAX_CACHED_SCALES = 256;
+
+/*!
+    Returns product of \a scale1 and \a scale2.
+*/
+const BigDecimal & ScaleCache::product(const BigDecimal & scale1, const BigDecimal & scale2)
+{
+    std::pair<BigDecimal, BigDecimal> key(scale1, scale2);
+    Results::const_iterator i = mProducts.find(key);
+    if (i != mProducts.end()) return i->second;
+
+    if (mProducts.size() >= MAX_CACHED_SCALES) mProducts.clear();
+    WorkingPrecision precision(0);
+    BigDecimal & result = mProducts[key];
+    result = scale1 * scale2;
+    return result;
+}
+
+/*!
+    Returns quotient of \a scale1 and \a scale2.
+
+    It is also the factor for conversion of values from scale \a scale1 to
+    scale \a scale2.
+*/
+const BigDecimal & ScaleCache::quotient(const BigDecimal & scale1, const BigDecimal & scale2)
+{
+    std::pair<BigDecimal, BigDecimal> key(scale1, scale2);
+    Results::const_iterator i = mQuotients.find(key);
+    if (i != mQuotients.end()) return i->second;
+
+    if (mQuotients.size() >= MAX_CACHED_SCALES) mQuotients.clear();
+    WorkingPrecision precision(0);
+    BigDecimal & result = mQuotients[key];
+    result = scale1 / scale2;
+    return result;
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef QUANTITY_H
+#define QUANTITY_H
+
+// Local
+#include "complex.h"
+#include "dimension.h"
+#include "unitconversion.h"
+#include "unicode.h"
+// STL
+#include <map>
+#include <utility>
+
+
+/*!
+    Memoized products and quotients of scales of quantities.
+*/
+class ScaleCache
+{
+public:
+    const BigDecimal & product(const BigDecimal & scale1, const BigDecimal & scale2);
+    const BigDecimal & quotient(const BigDecimal & scale1, const BigDecimal & scale2);
+
+private:
+    typedef std::map<std::pair<BigDecimal, BigDecimal>, BigDecimal> Results;
+
+    Results mProducts;          ///< Memoized products.
+    Results mQuotients;         ///< Memoized quotients.
+};
+
+
+class Quantity
+{
+public:
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    Quantity();
+    Quantity(const Complex & value_);
+    Quantity(const Complex & value_, const UnitConversion::NormalizedUnit & unit_);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Members
+
+    Complex value;                          ///< Value in units of the quantity.
+    Dimension dimension;                    ///< Dimension.
+    BigDecimal scale;                       ///< Size of unit in base units.
+    tstring unitName;                       ///< Name of the unit; empty for derived units.
+    const UnitConversion::UnitDef * tableUnit; ///< Unit of the table if unit is its name; 0 otherwise.
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Functions
+
+    /// Returns true if quantity is a number without units.
+    bool isDimensionless() const { return dimension.isNone(); }
+    /// Returns true if quantity is in the unit named \a name.
+    bool isInUnit(const tstring & name) const { return !unitName.empty() && unitName == name; }
+
+    tstring unitString() const;
+
+    Quantity operator-() const;
+    void multiply(const Quantity & q, ScaleCache & cache);
+    void divide(const Quantity & q, ScaleCache & cache);
+
+    static Quantity abs(const Quantity & q);
+    static Quantity sqr(const Quantity & q);
+    static Quantity sqrt(const Quantity & q);
+    static Quantity pow(const Quantity & q, const Quantity & power);
+
+private:
+    void normalize();
+    void setDerivedUnit();
+};
+
+
+#endif // QUANTITY_H
@@ -0,0 +1,138 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef SHAREDDATA_H
+#define SHAREDDATA_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+
+/*!
+    \class SharedData
+    \brief Base class of data shared by several objects with reference counting.
+
+    Reference counter is changed atomically, so objects sharing the data
+    can be copied and destroyed in different threads.
+
+    \sa SharedDataPointer
+    \ingroup MaxCalcEngine
+*/
+class SharedData
+{
+public:
+    /// Constructs data which is not referenced yet.
+    SharedData() : mRefs(0) { }
+    /// Copy of data is not referenced by anybody.
+    SharedData(const SharedData &) : mRefs(0) { }
+
+    /// Increments reference counter.
+    void ref() const
+    {
+#if defined(_WIN32)
+        InterlockedIncrement(&mRefs);
+#else
+        __sync_add_and_fetch(&mRefs, 1);
+#endif
+    }
+
+    /// Decrements reference counter; returns false if data is not referenced any more.
+    bool deref() const
+    {
+#if defined(_WIN32)
+        return InterlockedDecrement(&mRefs) != 0;
+#else
+        return __sync_sub_and_fetch(&mRefs, 1) != 0;
+#endif
+    }
+
+    /// Returns true if data is referenced by more than one object.
+    bool isShared() const { return mRefs != 1; }
+
+private:
+    mutable volatile long mRefs;
+
+    SharedData & operator=(const SharedData &);
+};
+
+
+/*!
+    \class SharedDataPointer
+    \brief Pointer to implicitly shared data with copy-on-write.
+
+    Copying the pointer only increments reference counter of the data.
+    Non-const access through data() makes a private copy of the data if it
+    is shared (T must be derived from SharedData and be copy-constructible).
+
+    \ingroup MaxCalcEngine
+*/
+template <class T>
+class SharedDataPointer
+{
+public:
+    /// Constructs null pointer.
+    SharedDataPointer() : d(0) { }
+    /// Takes ownership of \a data.
+    explicit SharedDataPointer(T * data) : d(data) { if (d) d->ref(); }
+    /// Shares data of \a ptr.
+    SharedDataPointer(const SharedDataPointer & ptr) : d(ptr.d) { if (d) d->ref(); }
+    /// Releases the data.
+    ~SharedDataPointer() { if (d && !d->deref()) delete d; }
+
+    /// Shares data of \a ptr.
+    SharedDataPointer & operator=(const SharedDataPointer & ptr)
+    {
+        if (ptr.d != d) {
+            if (ptr.d) ptr.d->ref();
+            T * old = d;
+            d = ptr.d;
+            if (old && !old->deref()) delete old;
+        }
+        return *this;
+    }
+
+    /// Returns true if pointer is null.
+    bool isNull() const { return d == 0; }
+
+    /// Returns data for reading.
+    const T * constData() const { return d; }
+    /// Returns data for reading.
+    const T * operator->() const { return d; }
+    /// Returns data for reading.
+    const T & operator*() const { return *d; }
+
+    /// Returns data for writing; copies it first if it is shared.
+    T * data()
+    {
+        if (d && d->isShared()) {
+            T * copy = new T(*d);
+            copy->ref();
+            if (!d->deref()) delete d;
+            d = copy;
+        }
+        return d;
+    }
+
+private:
+    T * d;
+};
+
+
+#endif // SHAREDDATA_H
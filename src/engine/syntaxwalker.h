@@ -0,0 +1,366 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef SYNTAXWALKER_H
+#define SYNTAXWALKER_H
+
+// Local
+#include "parser.h"
+#include "exceptions.h"
+// STL
+#include <list>
+#include <vector>
+
+
+/*!
+    Recursive descendant syntax analyzer of Parser.
+
+    SyntaxWalker walks through tokens of the expression according to the
+    grammar (see "doc/MaxCalc Parser specification.odt") and reports syntax
+    errors; meaning of the syntax is given by \a Semantics. Parser
+    calculates values of quantities, CostEstimator estimates cost of their
+    calculation, so both always accept the same expressions.
+
+    \a Semantics defines type \c Value and these functions:
+    \code
+    Value number(const tstring * digits, bool imaginary);
+    Value pi();
+    Value e();
+    Value previousResult();
+    Value variable(Parser::Token & name);
+    void assign(Parser::Token & name, const Value & value);
+    Value function(Parser::Function function, std::vector<Value> & args);
+    void negate(Value & value);
+    void add(Value & result, const Value & value, bool subtract);
+    void multiply(Value & result, const Value & value);
+    void divide(Value & result, const Value & value);
+    Value power(const Value & value, const Value & power);
+    void convert(Value & value, const tstring & unit1, const tstring & unit2);
+    \endcode
+*/
+template <class Semantics>
+class SyntaxWalker
+{
+public:
+    typedef typename Semantics::Value Value;
+
+    /// Constructs walker through tokens of \a parser giving them \a semantics.
+    SyntaxWalker(Parser & parser, Semantics & semantics)
+        : mSemantics(semantics), mTokens(parser.mTokens) { }
+
+    Value walk();
+
+private:
+    typedef std::list<Parser::Token>::iterator TokenIterator;
+
+    Semantics & mSemantics;             ///< Meaning of the syntax.
+    std::list<Parser::Token> & mTokens; ///< Tokens of the expression.
+    TokenIterator mCurToken;            ///< Current token.
+
+    /// Returns true if current token is \a token.
+    bool isToken(Parser::Tokens token) const
+    { return mCurToken != mTokens.end() && mCurToken->token == token; }
+
+    Value walkAssign();
+    Value walkAddSub();
+    Value walkMulDiv();
+    Value walkPower();
+    Value walkUnitConversions();
+    Value walkUnaryPlusMinus();
+    Value walkBrackets();
+    Value walkFunctions();
+    Value walkConstsVars();
+    Value walkNumbers();
+    bool walkFunctionArguments(std::vector<Value> & args);
+};
+
+/// Walks through the whole expression and returns its value.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walk()
+{
+    mCurToken = mTokens.begin();
+
+    Value value = walkAssign();
+
+    if (mTokens.end() != mCurToken) {
+        if (Parser::CLOSING_BRACKET == mCurToken->token) {
+            throw ParserException(ParserException::TOO_MANY_CLOSING_BRACKETS);
+        }
+        throw ParserException(ParserException::INVALID_EXPRESSION);
+    }
+    return value;
+}
+
+/// Walks through variable assignment (including compound ones like "+=").
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkAssign()
+{
+    if (isToken(Parser::IDENTIFIER) || isToken(Parser::IMAGINARY_ONE)) {
+        TokenIterator nameToken = mCurToken;
+        const tstring & name = mCurToken->str;
+        ++mCurToken;
+        if (isToken(Parser::ASSIGN)) {
+            if (name == _T("e") || name == _T("pi") || name == _T("res") ||
+                name == _T("result") || name == _T("i") || name == _T("j") ||
+                name == _T("exit") || name == _T("quit") ||
+                name == _T("help")) {
+                throw ParserException(ParserException::INVALID_VARIABLE_NAME);
+            }
+
+            tchar op = mCurToken->str[0];
+            Value var;
+            if (op != _T('=')) var = mSemantics.variable(*nameToken);
+            ++mCurToken;
+            Value value = walkAssign();
+            switch (op) {
+            case _T('='):
+                var = value;
+                break;
+            case _T('+'):
+                mSemantics.add(var, value, false);
+                break;
+            case _T('-'):
+                mSemantics.add(var, value, true);
+                break;
+            case _T('*'):
+                mSemantics.multiply(var, value);
+                break;
+            case _T('/'):
+                mSemantics.divide(var, value);
+                break;
+            case _T('^'):
+                var = mSemantics.power(var, value);
+                break;
+            }
+            mSemantics.assign(*nameToken, var);
+            return var;
+        }
+        --mCurToken;
+    }
+
+    return walkAddSub();
+}
+
+/// Walks through addition and subtraction.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkAddSub()
+{
+    Value result = walkMulDiv();
+
+    while (isToken(Parser::PLUS) || isToken(Parser::MINUS)) {
+        bool subtract = (Parser::MINUS == mCurToken->token);
+        ++mCurToken;
+        mSemantics.add(result, walkMulDiv(), subtract);
+    }
+
+    return result;
+}
+
+/// Walks through multiplication and division.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkMulDiv()
+{
+    Value result = walkPower();
+
+    while (isToken(Parser::MULTIPLY) || isToken(Parser::DIVIDE)) {
+        bool division = (Parser::DIVIDE == mCurToken->token);
+        ++mCurToken;
+        if (division) mSemantics.divide(result, walkPower());
+        else mSemantics.multiply(result, walkPower());
+    }
+
+    return result;
+}
+
+/// Walks through power ('^') operator.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkPower()
+{
+    Value result = walkUnitConversions();
+
+    while (isToken(Parser::POWER)) {
+        ++mCurToken;
+        result = mSemantics.power(result, walkUnitConversions());
+    }
+
+    return result;
+}
+
+/*!
+    Walks through units and unit conversions: "[unit]", "[-> unit]" and
+    "[unit1 -> unit2]" (empty unit is passed for missing one).
+*/
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkUnitConversions()
+{
+    Value result = walkUnaryPlusMinus();
+
+    while (isToken(Parser::OPENING_SQUARE_BRACKET)) {
+        ++mCurToken;
+        tstring unit1;
+        if (isToken(Parser::UNIT)) {
+            unit1 = mCurToken->str;
+            ++mCurToken;
+        }
+        tstring unit2;
+        if (isToken(Parser::ARROW)) {
+            ++mCurToken;
+            if (!isToken(Parser::UNIT)) {
+                throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
+            }
+            unit2 = mCurToken->str;
+            ++mCurToken;
+        } else if (unit1.empty()) {
+            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
+        }
+        if (!isToken(Parser::CLOSING_SQUARE_BRACKET)) {
+            throw ParserException(ParserException::INVALID_UNIT_CONVERSION_SYNTAX);
+        }
+        ++mCurToken;
+
+        mSemantics.convert(result, unit1, unit2);
+    }
+
+    return result;
+}
+
+/// Walks through unary plus and minus operators.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkUnaryPlusMinus()
+{
+    bool negative = false;
+
+    while (isToken(Parser::PLUS) || isToken(Parser::MINUS)) {
+        if (Parser::MINUS == mCurToken->token) negative = !negative;
+        ++mCurToken;
+    }
+
+    Value result = walkBrackets();
+    if (negative) mSemantics.negate(result);
+    return result;
+}
+
+/// Walks through brackets.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkBrackets()
+{
+    if (isToken(Parser::OPENING_BRACKET)) {
+        ++mCurToken;
+        Value result = walkAddSub();
+        if (!isToken(Parser::CLOSING_BRACKET)) {
+            throw ParserException(ParserException::NO_CLOSING_BRACKET);
+        }
+        ++mCurToken;
+        return result;
+    }
+
+    return walkFunctions();
+}
+
+/// Walks through built-in functions (see Parser::findFunction()).
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkFunctions()
+{
+    if (isToken(Parser::IDENTIFIER)) {
+        TokenIterator nameToken = mCurToken;
+        ++mCurToken;
+
+        std::vector<Value> args;
+        if (walkFunctionArguments(args)) {
+            return mSemantics.function(
+                Parser::findFunction(nameToken->str, args.size()), args);
+        }
+        // Go back if it is not a function
+        --mCurToken;
+    }
+
+    return walkConstsVars();
+}
+
+/// Walks through constants and variables.
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkConstsVars()
+{
+    if (isToken(Parser::IDENTIFIER)) {
+        TokenIterator nameToken = mCurToken;
+        ++mCurToken;
+        const tstring & name = nameToken->str;
+        if (_T("pi") == name) return mSemantics.pi();
+        if (_T("e") == name) return mSemantics.e();
+        if (_T("res") == name || _T("result") == name) return mSemantics.previousResult();
+        return mSemantics.variable(*nameToken);
+    }
+
+    return walkNumbers();
+}
+
+/// Walks through numbers (including complex numbers and exponential notation).
+template <class Semantics>
+typename SyntaxWalker<Semantics>::Value SyntaxWalker<Semantics>::walkNumbers()
+{
+    const tstring * digits = 0;
+    bool imaginary = false;
+
+    if (isToken(Parser::IMAGINARY_ONE)) {
+        imaginary = true;
+        ++mCurToken;
+    }
+
+    if (isToken(Parser::NUMBER)) {
+        digits = &mCurToken->str;
+        ++mCurToken;
+    }
+
+    if (isToken(Parser::IMAGINARY_ONE)) {
+        if (imaginary) {
+            throw ParserException(ParserException::INVALID_NUMBER);
+        }
+        imaginary = true;
+        ++mCurToken;
+    }
+
+    if (digits == 0 && !imaginary) {
+        throw ParserException(ParserException::INVALID_EXPRESSION);
+    }
+    return mSemantics.number(digits, imaginary);
+}
+
+/// Walks through function arguments including opening and closing brackets.
+template <class Semantics>
+bool SyntaxWalker<Semantics>::walkFunctionArguments(std::vector<Value> & args)
+{
+    if (!isToken(Parser::OPENING_BRACKET)) return false;
+    ++mCurToken;
+
+    args.push_back(walkAddSub());
+    while (isToken(Parser::SEMICOLON)) {
+        ++mCurToken;
+        args.push_back(walkAddSub());
+    }
+
+    if (!isToken(Parser::CLOSING_BRACKET)) {
+        throw ParserException(ParserException::NO_CLOSING_BRACKET);
+    }
+    ++mCurToken;
+
+    return true;
+}
+
+
+#endif // SYNTAXWALKER_H
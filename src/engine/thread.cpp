@@ -0,0 +1,119 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "thread.h"
+// STL
+#include <cassert>
+#include <new>
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+/*!
+    \class Thread
+    \brief Platform independent thread.
+
+    Subclasses implement run(), which is executed in a new thread after
+    start() is called. wait() blocks until run() returns; it is also called
+    by the destructor, so a thread never outlives its Thread object.
+
+    \ingroup MaxCalcEngine
+*/
+
+/*!
+    Constructs a new thread which is not started yet.
+*/
+Thread::Thread() : mRunning(false)
+{
+}
+
+/*!
+    Waits for the thread to finish and destroys the object.
+*/
+Thread::~Thread()
+{
+    wait();
+}
+
+/*!
+    Starts executing run() in a new thread.
+
+    \exception std::bad_alloc Thread cannot be created.
+*/
+void Thread::start()
+{
+    assert(!mRunning);
+#if defined(_WIN32)
+    mHandle = (HANDLE)_beginthreadex(0, 0, threadProc, this, 0, 0);
+    if (mHandle == 0) throw std::bad_alloc();
+#else
+    if (pthread_create(&mThread, 0, threadProc, this) != 0) {
+        throw std::bad_alloc();
+    }
+#endif
+    mRunning = true;
+}
+
+/*!
+    Waits until run() returns. Returns immediately if thread is not started.
+*/
+void Thread::wait()
+{
+    if (!mRunning) return;
+#if defined(_WIN32)
+    WaitForSingleObject(mHandle, INFINITE);
+    CloseHandle(mHandle);
+#else
+    pthread_join(mThread, 0);
+#endif
+    mRunning = false;
+}
+
+/*!
+    Returns number of threads which can run simultaneously on this computer.
+*/
+int Thread::idealThreadCount()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
+
+#if defined(_WIN32)
+unsigned __stdcall Thread::threadProc(void * param)
+{
+    static_cast<Thread *>(param)->run();
+    return 0;
+}
+#else
+void * Thread::threadProc(void * param)
+{
+    static_cast<Thread *>(param)->run();
+    return 0;
+}
+#endif
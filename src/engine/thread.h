@@ -0,0 +1,61 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+class Thread
+{
+public:
+    Thread();
+    virtual ~Thread();
+
+    void start();
+    void wait();
+
+    static int idealThreadCount();
+
+protected:
+    /// Function executed in the thread; must be implemented by subclasses.
+    virtual void run() = 0;
+
+private:
+#if defined(_WIN32)
+    HANDLE mHandle;
+    static unsigned __stdcall threadProc(void * param);
+#else
+    pthread_t mThread;
+    static void * threadProc(void * param);
+#endif
+    bool mRunning;
+
+    // Threads are not copyable
+    Thread(const Thread &);
+    Thread & operator=(const Thread &);
+};
+
+
+#endif // THREAD_H
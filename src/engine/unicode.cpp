@@ -29,14 +29,120 @@
 #include <cstdlib>
 #include <cassert>
 #include <cwctype>
-#else
+#endif
+#if !defined(MAXCALC_UNICODE) || defined(MAXCALC_UTF8)
 #include <cctype>
 #endif
 
 
 using namespace std;
 
-#if defined(MAXCALC_UNICODE)
+#if defined(MAXCALC_UNICODE) && defined(MAXCALC_UTF8)
+
+// Replacement character for invalid UTF-8 sequences
+static const wchar_t REPLACEMENT_CHAR = 0xFFFD;
+
+/*!
+    Converts UTF-8 encoded \a std::string to \a std::wstring.
+
+    Invalid sequences are replaced with U+FFFD. If wchar_t is 16-bit,
+    characters outside of BMP are converted to surrogate pairs.
+
+    \ingroup MaxCalcEngine
+*/
+wstring stringToWideString(const string & from)
+{
+    wstring str;
+    str.reserve(from.length());
+
+    size_t pos = 0;
+    while (pos < from.length()) {
+        unsigned char c = from[pos++];
+        unsigned long code;
+        int extraBytes;
+        if (c < 0x80) {
+            str += (wchar_t)c;
+            continue;
+        } else if ((c & 0xE0) == 0xC0) {
+            code = c & 0x1F;
+            extraBytes = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            code = c & 0x0F;
+            extraBytes = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            code = c & 0x07;
+            extraBytes = 3;
+        } else {
+            str += REPLACEMENT_CHAR;
+            continue;
+        }
+
+        for (; extraBytes > 0 && pos < from.length() &&
+               ((unsigned char)from[pos] & 0xC0) == 0x80; --extraBytes) {
+            code = (code << 6) | ((unsigned char)from[pos++] & 0x3F);
+        }
+
+        if (extraBytes > 0 || code > 0x10FFFF) {
+            str += REPLACEMENT_CHAR;
+        } else if (sizeof(wchar_t) == 2 && code >= 0x10000) {
+            code -= 0x10000;
+            str += (wchar_t)(0xD800 + (code >> 10));
+            str += (wchar_t)(0xDC00 + (code & 0x3FF));
+        } else {
+            str += (wchar_t)code;
+        }
+    }
+
+    return str;
+}
+
+/*!
+    Converts \a std::wstring to UTF-8 encoded \a std::string.
+
+    If wchar_t is 16-bit, surrogate pairs are combined.
+
+    \ingroup MaxCalcEngine
+*/
+string wideStringToString(const wstring & from)
+{
+    string str;
+    str.reserve(from.length());
+
+    for (size_t pos = 0; pos < from.length(); ++pos) {
+        unsigned long code = (unsigned long)from[pos];
+        if (sizeof(wchar_t) == 2 && code >= 0xD800 && code < 0xDC00 &&
+            pos + 1 < from.length()) {
+            unsigned long low = (unsigned long)from[pos + 1];
+            if (low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                ++pos;
+            }
+        }
+        if (code > 0x10FFFF) {
+            code = REPLACEMENT_CHAR;
+        }
+
+        if (code < 0x80) {
+            str += (char)code;
+        } else if (code < 0x800) {
+            str += (char)(0xC0 | (code >> 6));
+            str += (char)(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            str += (char)(0xE0 | (code >> 12));
+            str += (char)(0x80 | ((code >> 6) & 0x3F));
+            str += (char)(0x80 | (code & 0x3F));
+        } else {
+            str += (char)(0xF0 | (code >> 18));
+            str += (char)(0x80 | ((code >> 12) & 0x3F));
+            str += (char)(0x80 | ((code >> 6) & 0x3F));
+            str += (char)(0x80 | (code & 0x3F));
+        }
+    }
+
+    return str;
+}
+
+#elif defined(MAXCALC_UNICODE)
 
 /*!
     Converts \a std::string to \a std::wstring.
@@ -28,12 +28,17 @@
 #undef _T
 #endif
 
-#if defined(MAXCALC_UNICODE)
+// With MAXCALC_UNICODE strings are wide unless MAXCALC_UTF8 is also defined.
+// In UTF-8 mode engine keeps all strings in UTF-8 encoded std::string and
+// only GUI converts them to wide strings.
+
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
 
 using std::string;
 using std::wstring;
 using std::wstringstream;
 using std::wostream;
+using std::wistream;
 
 ///////////////////////////////////////////////////////////////////////////
 // Unicode identifiers
@@ -45,6 +50,7 @@ typedef wchar_t tchar;
 typedef wstring tstring;
 typedef wstringstream tstringstream;
 typedef wostream tostream;
+typedef wistream tistream;
 
 // Character case conversion functions
 #define totlower(c) towlower(c)         ///< Converts \a c to lower case
@@ -58,23 +64,20 @@ typedef wostream tostream;
 // IO
 #define tcout wcout                     ///< Standard output stream
 #define tcin wcin                       ///< Standard input stream
+#define tcerr wcerr                     ///< Standard error stream
 
 // String functions
 #define tstrcmp wcscmp
 
-
-// String conversion functions
-wstring stringToWideString(const string & from);
-string wideStringToString(const wstring & from);
-
-#else // #if defined(MAXCALC_UNICODE)
+#else // #if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
 
 ///////////////////////////////////////////////////////////////////////////
-// Non-Unicode identifiers
+// Non-Unicode and UTF-8 identifiers
 
 using std::string;
 using std::stringstream;
 using std::ostream;
+using std::istream;
 
 #define _T(x) x                         ///< String literal
 
@@ -83,6 +86,7 @@ typedef char tchar;
 typedef string tstring;
 typedef stringstream tstringstream;
 typedef ostream tostream;
+typedef istream tistream;
 
 
 // Character case conversion functions
@@ -90,17 +94,36 @@ typedef ostream tostream;
 #define totupper(c) toupper(c)          ///< Converts \a c to upper case
 
 // Character handling functions
+#if defined(MAXCALC_UTF8)
+// Bytes of multibyte UTF-8 sequences are treated as letters
+#define istdigit(c) isdigit((unsigned char)(c))     ///< Determines if \a c is a digit
+#define istalpha(c) (isalpha((unsigned char)(c)) || (unsigned char)(c) >= 0x80) ///< Determines if \a c is a letter
+#define istspace(c) isspace((unsigned char)(c))     ///< Determines if \a c is a space char
+#else
 #define istdigit(c) isdigit(c)          ///< Determines if \a c is a digit
 #define istalpha(c) isalpha(c)          ///< Determines if \a c is a digit or letter
 #define istspace(c) isspace(c)          ///< Determines if \a c is a space char
+#endif
 
 // IO
 #define tcout cout                      ///< Standard output stream
 #define tcin cin                        ///< Standard input stream
+#define tcerr cerr                      ///< Standard error stream
 
 // String functions
 #define tstrcmp strcmp
 
+#endif // #if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+
+#if defined(MAXCALC_UNICODE)
+
+using std::wstring;
+
+// String conversion functions
+// (in UTF-8 mode narrow strings are always UTF-8 encoded)
+wstring stringToWideString(const string & from);
+string wideStringToString(const wstring & from);
+
 #endif // #if defined(MAXCALC_UNICODE)
 
 
@@ -129,7 +152,7 @@ tstring & trim(tstring & str);
 #include <libintl.h>
 #endif
 
-#if defined(MAXCALC_UNICODE)
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
 #define _(str) stringToWideString(gettext(str)).c_str()
 #else
 #define _(str) gettext(str)
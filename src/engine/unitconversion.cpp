@@ -20,6 +20,11 @@
 // Local
 #include "unitconversion.h"
 #include "exceptions.h"
+#include "mutex.h"
+
+// STL
+#include <cassert>
+#include <vector>
 
 
 /*!
@@ -32,6 +37,18 @@
     This class also stores all unit conversion tables.
     List of units can be retrieved using units() function.
 
+    Each category has a base unit. When the tables are loaded, factors of
+    all units relative to their base units are derived from simple
+    conversions, and a matrix with factors for every pair of units of the
+    same category is built from them, so any conversion needs one hash
+    lookup per unit name and one multiplication.
+
+    Besides names from the tables, units may be given by unit expressions:
+    products, quotients and integer powers of units with optional SI
+    prefixes (e.g. "kn*m", "mg/l", "m^3/s"). Each distinct expression is
+    normalized once into scale and dimension by normalize(); results are
+    kept in a cache shared by all threads.
+
     \ingroup MaxCalcEngine
 */
 
@@ -168,26 +185,42 @@ const UnitConversion::SimpleConversion UnitConversion::mSimpleConversions[] =
     { KNOT,                 MILE_PER_HOUR,      "1.1507794480235425117314881094408653463771574007794480235425117314881094408653463771574007794480235425117314881094408653463771574007794480235425117314881094" },
     { KNOT,                 FOOT_PER_HOUR,      "2025.3718285214348206474190726159230096237970253718285214348206474190726159230096237970253718285214348206474190726159230096237970253718285214348206474190726" },
     { KNOT,                 KILOMETER_PER_HOUR, "1.852" },
+
+    //---------------------------------------------------------------------
+    // Volume
+    { CUBIC_METER,  LITER,          "1000" },
+
+    //---------------------------------------------------------------------
+    // Force
+    { POUND_FORCE,  NEWTON,         "4.4482216152605" },
+
+    //---------------------------------------------------------------------
+    // Pressure
+    { BAR,          PASCAL,         "100000" },
+    { ATMOSPHERE,   PASCAL,         "101325" },
+    { ATMOSPHERE,   BAR,            "1.01325" },
+
+    //---------------------------------------------------------------------
+    // Energy
+    { CALORIE,      JOULE,          "4.184" },
+    { KILOWATT_HOUR, JOULE,         "3600000" },
     { NO_UNIT,              NO_UNIT,            0 }
 };
 
 /*!
-    Arbitrary unit conversions which are performed by calling a conversion
-    function.
+    Affine unit conversions: number in unit2 is number in unit1 multiplied by
+    factor plus offset. Backward conversions use inverse maps.
 
-    Conversion functions have one argument - number to be converted.
+    All coefficients are exact decimals.
 */
-const UnitConversion::ArbitraryConversion UnitConversion::mArbitraryConversions[] =
+const UnitConversion::AffineConversion UnitConversion::mAffineConversions[] =
 {
     //---------------------------------------------------------------------
     // Termperature
-    { CELSIUS,              FAHRENHEIT,         UnitConversion::ctof },
-    { CELSIUS,              KELVIN,             UnitConversion::ctok },
-    { FAHRENHEIT,           CELSIUS,            UnitConversion::ftoc },
-    { FAHRENHEIT,           KELVIN,             UnitConversion::ftok },
-    { KELVIN,               CELSIUS,            UnitConversion::ktoc },
-    { KELVIN,               FAHRENHEIT,         UnitConversion::ktof },
-    { NO_UNIT,              NO_UNIT,            0 }
+    { CELSIUS,      KELVIN,         "1",    "273.15" },
+    { CELSIUS,      FAHRENHEIT,     "1.8",  "32" },
+    { KELVIN,       FAHRENHEIT,     "1.8",  "-459.67" },
+    { NO_UNIT,      NO_UNIT,        0,      0 }
 };
 
 /*!
@@ -239,9 +272,405 @@ const UnitConversion::UnitDef UnitConversion::mUnits[] =
     { _T("km/h"),       KILOMETER_PER_HOUR, VELOCITY,_T("Kilometer per Hour") },
     { _T("knot"),       KNOT,               VELOCITY,_T("Knot") },
 
+    // Volume
+    { _T("l"),          LITER,              VOLUME, _T("Liter") },
+    { _T("m^3"),        CUBIC_METER,        VOLUME, _T("Cubic Meter") },
+
+    // Force
+    { _T("n"),          NEWTON,             FORCE,  _T("Newton") },
+    { _T("lbf"),        POUND_FORCE,        FORCE,  _T("Pound-force") },
+
+    // Pressure
+    { _T("pa"),         PASCAL,             PRESSURE, _T("Pascal") },
+    { _T("bar"),        BAR,                PRESSURE, _T("Bar") },
+    { _T("atm"),        ATMOSPHERE,         PRESSURE, _T("Atmosphere") },
+
+    // Energy
+    { _T("j"),          JOULE,              ENERGY, _T("Joule") },
+    { _T("cal"),        CALORIE,            ENERGY, _T("Calorie") },
+    { _T("kwh"),        KILOWATT_HOUR,      ENERGY, _T("Kilowatt-hour") },
+
     { _T(""),           NO_UNIT,            NO_TYPE, _T("") }
 };
 
+/*!
+    Base units and dimensions of categories.
+*/
+const UnitConversion::Category UnitConversion::mCategories[] =
+{
+    // Type         Base unit           Angle, length, mass, temperature, time
+    { ANGLE,        RADIAN,             Dimension(1, 0, 0, 0, 0) },
+    { LENGTH,       METER,              Dimension(0, 1, 0, 0, 0) },
+    { MASS,         KILOGRAM,           Dimension(0, 0, 1, 0, 0) },
+    { TEMPERATURE,  KELVIN,             Dimension(0, 0, 0, 1, 0) },
+    { TIME,         SECOND,             Dimension(0, 0, 0, 0, 1) },
+    { VELOCITY,     METER_PER_SECOND,   Dimension(0, 1, 0, 0, -1) },
+    { VOLUME,       CUBIC_METER,        Dimension(0, 3, 0, 0, 0) },
+    { FORCE,        NEWTON,             Dimension(0, 1, 1, 0, -2) },
+    { PRESSURE,     PASCAL,             Dimension(0, -1, 1, 0, -2) },
+    { ENERGY,       JOULE,              Dimension(0, 2, 1, 0, -2) },
+    { NO_TYPE,      NO_UNIT,            Dimension() }
+};
+
+/*!
+    Name index and conversion matrix.
+
+    Must be defined after all tables it is built from.
+*/
+const UnitConversion::Tables UnitConversion::mTables;
+
+/*!
+    SI prefixes which may precede unit names in unit expressions.
+
+    Unit names are case-insensitive but prefixes are not: "M" is mega and
+    "m" is milli (see findAtom()). "da" must be listed before "d".
+*/
+const UnitConversion::Prefix UnitConversion::mPrefixes[] =
+{
+    { _T("P"),          "1e15" },
+    { _T("T"),          "1e12" },
+    { _T("G"),          "1e9" },
+    { _T("M"),          "1e6" },
+    { _T("da"),         "1e1" },
+    { _T("h"),          "1e2" },
+    { _T("k"),          "1e3" },
+    { _T("d"),          "1e-1" },
+    { _T("c"),          "1e-2" },
+    { _T("m"),          "1e-3" },
+    { _T("u"),          "1e-6" },
+    { _T("n"),          "1e-9" },
+    { _T("p"),          "1e-12" },
+    { _T("f"),          "1e-15" },
+    { _T("a"),          "1e-18" },
+    { 0,                0 }
+};
+
+
+/*!
+    Hash table of normalized unit expressions.
+
+    The cache is only a memo: entries are copied in and out, so they can be
+    dropped at any time. Number of entries is limited by MAX_ENTRIES; when
+    it is reached, the cache is cleared, so clients of a long-running
+    process can not exhaust memory with distinct expressions and any
+    expression can still be normalized again.
+*/
+class UnitConversion::Cache
+{
+public:
+    Cache();
+    ~Cache();
+
+    bool find(const tstring & name, NormalizedUnit & unit);
+    void insert(const NormalizedUnit & unit);
+
+private:
+    // Maximum number of cached expressions
+    enum { MAX_ENTRIES = 4096 };
+
+    std::vector<NormalizedUnit *> mSlots;
+    size_t mCount;
+    Mutex mMutex;
+
+    void clear();
+    void place(NormalizedUnit * unit);
+
+    Cache(const Cache &);
+    Cache & operator=(const Cache &);
+};
+
+/*!
+    Cache of normalized unit expressions.
+*/
+UnitConversion::Cache UnitConversion::mCache;
+
+
+/*!
+    Constructs an empty cache.
+*/
+UnitConversion::Cache::Cache() : mSlots(64, (NormalizedUnit *)0), mCount(0)
+{
+}
+
+/*!
+    Deletes all cached units.
+*/
+UnitConversion::Cache::~Cache()
+{
+    clear();
+}
+
+/*!
+    Copies normalized unit expression \a name to \a unit. Returns false if
+    it is not cached.
+*/
+bool UnitConversion::Cache::find(const tstring & name, NormalizedUnit & unit)
+{
+    MutexLocker locker(mMutex);
+
+    const size_t mask = mSlots.size() - 1;
+    size_t slot = Tables::hash(name) & mask;
+    for (const NormalizedUnit * nu = mSlots[slot]; nu != 0; nu = mSlots[slot]) {
+        if (nu->name == name) {
+            unit = *nu;
+            return true;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return false;
+}
+
+/*!
+    Adds copy of \a unit to the cache (unless another thread has added it
+    meanwhile). All entries are dropped if the cache is full.
+*/
+void UnitConversion::Cache::insert(const NormalizedUnit & unit)
+{
+    MutexLocker locker(mMutex);
+
+    const size_t mask = mSlots.size() - 1;
+    size_t slot = Tables::hash(unit.name) & mask;
+    for (const NormalizedUnit * nu = mSlots[slot]; nu != 0; nu = mSlots[slot]) {
+        if (nu->name == unit.name) return;
+        slot = (slot + 1) & mask;
+    }
+
+    if (mCount >= MAX_ENTRIES) clear();
+
+    // Keep load factor below 1/2
+    if ((mCount + 1) * 2 > mSlots.size()) {
+        std::vector<NormalizedUnit *> old(mSlots.size() * 2, (NormalizedUnit *)0);
+        old.swap(mSlots);
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (old[i] != 0) place(old[i]);
+        }
+    }
+
+    place(new NormalizedUnit(unit));
+    ++mCount;
+}
+
+/*!
+    Deletes all entries; mutex must be locked.
+*/
+void UnitConversion::Cache::clear()
+{
+    for (size_t i = 0; i < mSlots.size(); ++i) {
+        delete mSlots[i];
+        mSlots[i] = 0;
+    }
+    mCount = 0;
+}
+
+/*!
+    Puts \a unit into the first free slot; mutex must be locked.
+*/
+void UnitConversion::Cache::place(NormalizedUnit * unit)
+{
+    const size_t mask = mSlots.size() - 1;
+    size_t slot = Tables::hash(unit->name) & mask;
+    while (mSlots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    mSlots[slot] = unit;
+}
+
+
+/*!
+    Builds name index and conversion matrix.
+*/
+UnitConversion::Tables::Tables()
+{
+    for (size_t i = 0; i < NAME_SLOTS; ++i) {
+        mNames[i] = 0;
+    }
+    for (const UnitDef * ud = mUnits; ud->unit != NO_UNIT; ++ud) {
+        addName(ud);
+    }
+
+    for (int u1 = 0; u1 < UNIT_COUNT; ++u1) {
+        for (int u2 = 0; u2 < UNIT_COUNT; ++u2) {
+            mConversions[u1][u2].exists = false;
+        }
+    }
+    buildMatrix();
+}
+
+/*!
+    Returns hash of unit \a name (FNV-1a).
+*/
+size_t UnitConversion::Tables::hash(const tstring & name)
+{
+    size_t result = 2166136261U;
+    for (tstring::const_iterator i = name.begin(); i != name.end(); ++i) {
+        result = (result ^ (size_t)*i) * 16777619U;
+    }
+    return result;
+}
+
+/*!
+    Adds \a unit to hash table of unit names.
+*/
+void UnitConversion::Tables::addName(const UnitDef * unit)
+{
+    size_t slot = hash(unit->name) & (NAME_SLOTS - 1);
+    for (size_t probes = 0; mNames[slot] != 0; ++probes) {
+        // Table must be large enough to have free slots
+        assert(probes < NAME_SLOTS);
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+    mNames[slot] = unit;
+}
+
+/*!
+    Finds unit with given \a name.
+
+    \returns Unit definition or 0 if there is no such unit.
+*/
+const UnitConversion::UnitDef * UnitConversion::Tables::find(const tstring & name) const
+{
+    size_t slot = hash(name) & (NAME_SLOTS - 1);
+    for (const UnitDef * ud = mNames[slot]; ud != 0; ud = mNames[slot]) {
+        if (ud->name == name) return ud;
+        slot = (slot + 1) & (NAME_SLOTS - 1);
+    }
+    return 0;
+}
+
+/*!
+    Fills conversion matrix, scales and dimensions of units.
+
+    Maps of units to base units are found by breadth-first search over
+    simple and affine conversions, so they are composed with as few
+    operations as possible. Pairs listed in conversion tables use listed
+    coefficients directly (or their inverses); other pairs of the same
+    category are converted through the base unit.
+
+    Factors of maps to base units are also kept as scales of units. Scale of
+    a unit with an affine map (like Fahrenheit) is the slope of the map; such
+    units are marked as affine.
+*/
+void UnitConversion::Tables::buildMatrix()
+{
+    // Maps of units to base units of their categories
+    Affine toBase[UNIT_COUNT];
+    // Search level at which map was found (-1 if not found yet)
+    int level[UNIT_COUNT];
+
+    for (int u = 0; u < UNIT_COUNT; ++u) {
+        level[u] = -1;
+    }
+    for (const Category * cat = mCategories; cat->type != NO_TYPE; ++cat) {
+        level[cat->baseUnit] = 0;
+    }
+
+    for (int curLevel = 1; ; ++curLevel) {
+        bool found = false;
+        for (const SimpleConversion * sc = mSimpleConversions; sc->unit1 != NO_UNIT; ++sc) {
+            if (level[sc->unit2] == curLevel - 1 && level[sc->unit1] == -1) {
+                const Affine & next = toBase[sc->unit2];
+                toBase[sc->unit1] = Affine(sc->multiplier * next.factor, next.offset);
+                level[sc->unit1] = curLevel;
+                found = true;
+            } else if (level[sc->unit1] == curLevel - 1 && level[sc->unit2] == -1) {
+                const Affine & next = toBase[sc->unit1];
+                toBase[sc->unit2] = Affine(next.factor / sc->multiplier, next.offset);
+                level[sc->unit2] = curLevel;
+                found = true;
+            }
+        }
+        for (const AffineConversion * ac = mAffineConversions; ac->unit1 != NO_UNIT; ++ac) {
+            Affine map(ac->factor, ac->offset);
+            if (level[ac->unit2] == curLevel - 1 && level[ac->unit1] == -1) {
+                toBase[ac->unit1] = map.then(toBase[ac->unit2]);
+                level[ac->unit1] = curLevel;
+                found = true;
+            } else if (level[ac->unit1] == curLevel - 1 && level[ac->unit2] == -1) {
+                toBase[ac->unit2] = map.inverse().then(toBase[ac->unit1]);
+                level[ac->unit2] = curLevel;
+                found = true;
+            }
+        }
+        if (!found) break;
+    }
+
+    // Pairs converted through base units
+    for (const UnitDef * ud1 = mUnits; ud1->unit != NO_UNIT; ++ud1) {
+        for (const UnitDef * ud2 = mUnits; ud2->unit != NO_UNIT; ++ud2) {
+            if (ud1->type != ud2->type || level[ud1->unit] == -1 ||
+                level[ud2->unit] == -1) {
+                continue;
+            }
+            const Affine & map1 = toBase[ud1->unit];
+            const Affine & map2 = toBase[ud2->unit];
+            Conversion & conv = mConversions[ud1->unit][ud2->unit];
+            conv.exists = true;
+            if (ud1->unit == ud2->unit) {
+                conv.map = Affine();
+            } else if (map1.isLinear() && map2.isLinear()) {
+                conv.map = Affine(map1.factor / map2.factor, 0);
+            } else {
+                conv.map = map1.then(map2.inverse());
+            }
+        }
+    }
+
+    // Listed pairs
+    for (const SimpleConversion * sc = mSimpleConversions; sc->unit1 != NO_UNIT; ++sc) {
+        mConversions[sc->unit1][sc->unit2].exists = true;
+        mConversions[sc->unit1][sc->unit2].map = Affine(sc->multiplier, 0);
+        mConversions[sc->unit2][sc->unit1].exists = true;
+        mConversions[sc->unit2][sc->unit1].map = Affine(BigDecimal(1) / sc->multiplier, 0);
+    }
+    for (const AffineConversion * ac = mAffineConversions; ac->unit1 != NO_UNIT; ++ac) {
+        Affine map(ac->factor, ac->offset);
+        mConversions[ac->unit1][ac->unit2].exists = true;
+        mConversions[ac->unit1][ac->unit2].map = map;
+        mConversions[ac->unit2][ac->unit1].exists = true;
+        mConversions[ac->unit2][ac->unit1].map = map.inverse();
+    }
+
+    // Maps to base units (their factors are scales)
+    for (int u = 0; u < UNIT_COUNT; ++u) {
+        mToBase[u] = toBase[u];
+    }
+
+    // Dimensions
+    for (const UnitDef * ud = mUnits; ud->unit != NO_UNIT; ++ud) {
+        for (const Category * cat = mCategories; cat->type != NO_TYPE; ++cat) {
+            if (cat->type == ud->type) mDimensions[ud->unit] = cat->dimension;
+        }
+    }
+}
+
+
+/*!
+    Returns \a x * factor + offset (with one rounding).
+*/
+BigDecimal UnitConversion::Affine::apply(const BigDecimal & x) const
+{
+    if (offset.isZero()) return x * factor;
+    return BigDecimal::FMA(x * factor, offset);
+}
+
+/*!
+    Returns composition of maps: \a next applied after this map.
+*/
+UnitConversion::Affine UnitConversion::Affine::then(const Affine & next) const
+{
+    if (offset.isZero()) return Affine(next.factor * factor, next.offset);
+    return Affine(next.factor * factor, BigDecimal::FMA(next.factor * offset, next.offset));
+}
+
+/*!
+    Returns inverse map: (x - offset) / factor.
+*/
+UnitConversion::Affine UnitConversion::Affine::inverse() const
+{
+    if (offset.isZero()) return Affine(BigDecimal(1) / factor, 0);
+    return Affine(BigDecimal(1) / factor, -offset / factor);
+}
+
 
 /*!
     Converts \a number from \a unit1 to \a unit2.
@@ -250,48 +679,343 @@ const UnitConversion::UnitDef UnitConversion::mUnits[] =
 
     \throw UnknownUnitException \a unit1 or \a unit2 is an unknown unit.
     \throw UnknownUnitConversionException There's no conversion \a unit1->unit2.
+    \sa Converter
 */
 BigDecimal UnitConversion::convert(const BigDecimal number,
                                    const tstring & unit1,
                                    const tstring & unit2)
 {
-    Unit u1 = NO_UNIT;
-    Unit u2 = NO_UNIT;
+    return Converter(unit1, unit2).convert(number);
+}
 
-    // Find unit1 and unit2 in mUnits array and assign u1 and u2
-    for (const UnitDef * ud = mUnits; ud->unit != NO_UNIT && (u1 == NO_UNIT || u2 == NO_UNIT); ++ud) {
-        if (unit1 == ud->name) u1 = ud->unit;
-        if (unit2 == ud->name) u2 = ud->unit;
+/*!
+    Returns array of units.
+*/
+const UnitConversion::UnitDef * UnitConversion::units()
+{
+    return mUnits;
+}
+
+/*!
+    Returns definition of unit with given \a name or 0 if there is no such unit.
+*/
+const UnitConversion::UnitDef * UnitConversion::findUnit(const tstring & name)
+{
+    return mTables.find(name);
+}
+
+/*!
+    Returns scale of \a unit: size of the unit in base units of its category.
+*/
+const BigDecimal & UnitConversion::scale(Unit unit)
+{
+    return mTables.scale(unit);
+}
+
+/*!
+    Returns dimension of \a unit.
+*/
+const Dimension & UnitConversion::dimension(Unit unit)
+{
+    return mTables.dimension(unit);
+}
+
+/*!
+    Returns true if zero of \a unit is not zero of the base unit of its
+    category (like Celsius and Fahrenheit), so quantities in the unit are
+    not proportional to quantities in base units.
+*/
+bool UnitConversion::isAffine(Unit unit)
+{
+    return mTables.isAffine(unit);
+}
+
+
+/*!
+    Normalizes unit expression \a expr into scale and dimension.
+
+    \a expr is either a unit name from the tables or a product of factors
+    separated by '*' or '/'. Each factor is a unit name with optional SI
+    prefix and integer power, e.g. "kn*m", "mg/l", "m^3/s", "s^-2".
+
+    Recently used expressions are cached, so they are usually parsed once
+    and subsequent calls cost one hash lookup. Scale is calculated with full
+    precision even if working precision of the thread is reduced, since it
+    is shared by all evaluations.
+
+    \throw UnknownUnitException \a expr is not a valid unit expression.
+*/
+UnitConversion::NormalizedUnit UnitConversion::normalize(const tstring & expr)
+{
+    NormalizedUnit result;
+    if (mCache.find(expr, result)) return result;
+
+    // Parse without holding the lock
+    WorkingPrecision precision(0);
+    result.name = expr;
+    const Prefix * prefix = 0;
+    result.unit = findAtom(expr, prefix);
+    if (result.unit != 0 && prefix == 0) {
+        result.scale = mTables.scale(result.unit->unit);
+        result.dimension = mTables.dimension(result.unit->unit);
+    } else {
+        result.unit = 0;
+        parseExpression(expr, result);
     }
 
-    // Check that units are found
-    if (u1 == NO_UNIT) throw ParserException(ParserException::UNKNOWN_UNIT, unit1);
-    if (u2 == NO_UNIT) throw ParserException(ParserException::UNKNOWN_UNIT, unit2);
+    mCache.insert(result);
+    return result;
+}
 
-    // No conversion
-    if (u1 == u2) return number;
+/*!
+    Parses unit expression \a expr which is not a unit name into \a result.
 
-    // Look up simple conversions table
-    for (const SimpleConversion * sc = mSimpleConversions; sc->unit1 != NO_UNIT; ++sc) {
-        if (u1 == sc->unit1 && u2 == sc->unit2) return number * sc->multiplier;
-        if (u1 == sc->unit2 && u2 == sc->unit1) return number / sc->multiplier;
+    \throw UnknownUnitException \a expr is not a valid unit expression.
+*/
+void UnitConversion::parseExpression(const tstring & expr, NormalizedUnit & result)
+{
+    result.scale = 1;
+    result.dimension = Dimension();
+
+    size_t pos = 0;
+    bool divide = false;
+    while (true) {
+        // Unit name
+        size_t start = pos;
+        while (pos < expr.length() && istalpha(expr[pos])) ++pos;
+        if (pos == start) throw ParserException(ParserException::UNKNOWN_UNIT, expr);
+
+        BigDecimal scale;
+        Dimension dimension;
+        parseAtom(expr.substr(start, pos - start), scale, dimension);
+
+        // Power
+        int power = 1;
+        if (pos < expr.length() && expr[pos] == _T('^')) {
+            ++pos;
+            bool negative = false;
+            if (pos < expr.length() && expr[pos] == _T('-')) {
+                negative = true;
+                ++pos;
+            }
+            start = pos;
+            power = 0;
+            while (pos < expr.length() && istdigit(expr[pos]) && power < 100) {
+                power = power * 10 + (expr[pos] - _T('0'));
+                ++pos;
+            }
+            if (pos == start || power == 0 || power >= 100) {
+                throw ParserException(ParserException::UNKNOWN_UNIT, expr);
+            }
+            if (negative) power = -power;
+        }
+        if (divide) power = -power;
+
+        result.dimension = result.dimension * dimension.pow(power);
+        if (!(scale == 1)) {
+            for (int i = 0; i < power; ++i) result.scale *= scale;
+            for (int i = 0; i > power; --i) result.scale /= scale;
+        }
+
+        if (pos == expr.length()) break;
+        if (expr[pos] == _T('*')) divide = false;
+        else if (expr[pos] == _T('/')) divide = true;
+        else throw ParserException(ParserException::UNKNOWN_UNIT, expr);
+        ++pos;
+    }
+}
+
+/*!
+    Finds unit of the tables named \a atom with optional SI prefix; the
+    prefix is stored into \a prefix (0 if there is no prefix).
+
+    Unit names are case-insensitive, prefixes are case-sensitive. A unit
+    name written in any case wins over a prefix, so "MM" and "Mm" are
+    millimeters, "min" is minute and "G" is gram; a prefix is used only if
+    \a atom is not a unit name, so "MPa" is megapascal and "mPa" is
+    millipascal.
+
+    Returns 0 if \a atom is an unknown unit.
+*/
+const UnitConversion::UnitDef * UnitConversion::findAtom(const tstring & atom,
+                                                         const Prefix *& prefix)
+{
+    tstring name = atom;
+    strToLower(name);
+
+    prefix = 0;
+    const UnitDef * ud = mTables.find(name);
+    if (ud != 0) return ud;
+
+    for (prefix = mPrefixes; prefix->name != 0; ++prefix) {
+        size_t length = tstring(prefix->name).length();
+        if (atom.length() > length && atom.compare(0, length, prefix->name) == 0) {
+            ud = mTables.find(name.substr(length));
+            if (ud != 0) return ud;
+        }
     }
 
-    // Look up arbitrary conversions table
-    for (const ArbitraryConversion * ac = mArbitraryConversions; ac->unit1 != NO_UNIT; ++ac) {
-        if (u1 == ac->unit1 && u2 == ac->unit2) return ac->convert(number);
+    prefix = 0;
+    return 0;
+}
+
+/*!
+    Finds scale and dimension of unit \a atom with optional SI prefix.
+
+    \throw UnknownUnitException \a atom is an unknown unit.
+*/
+void UnitConversion::parseAtom(const tstring & atom, BigDecimal & scale,
+                               Dimension & dimension)
+{
+    const Prefix * prefix = 0;
+    const UnitDef * ud = findAtom(atom, prefix);
+    if (ud == 0) throw ParserException(ParserException::UNKNOWN_UNIT, atom);
+
+    scale = mTables.scale(ud->unit);
+    if (prefix != 0) scale = prefix->factor * scale;
+    dimension = mTables.dimension(ud->unit);
+
+    // Units which are not proportional to base units (like Celsius) can not be
+    // combined with others
+    if (ud->type == TEMPERATURE && ud->unit != KELVIN) {
+        throw ParserException(ParserException::UNKNOWN_UNIT, atom);
     }
+}
+
+
+/*!
+    \class UnitConversion::Converter
+    \brief Converts numbers from one unit to another.
+
+    Units are looked up once, when Converter is constructed, so converting
+    many numbers between the same units costs one multiplication (or one
+    fused multiply-add for affine conversions) per number. Units may be unit expressions
+    (see normalize()); such units are converted by the ratio of their
+    scales if they have the same dimension.
+
+    Converter can be used from several threads simultaneously.
+
+    \ingroup MaxCalcEngine
+*/
 
-    // There is no such conversion
-    throw ParserException(ParserException::UNKNOWN_UNIT_CONVERSION,
-                          unit1 + _T(" -> ") + unit2);
+/*!
+    Constructs a new Converter from \a unit1 to \a unit2.
+
+    \throw UnknownUnitException \a unit1 or \a unit2 is an unknown unit.
+    \throw UnknownUnitConversionException There's no conversion \a unit1->unit2.
+*/
+UnitConversion::Converter::Converter(const tstring & unit1, const tstring & unit2)
+{
+    init(normalize(unit1), normalize(unit2));
 }
 
 /*!
-    Returns array of units.
+    Constructs a new Converter from \a unit1 to \a unit2 which are already
+    looked up.
+
+    \throw UnknownUnitConversionException There's no conversion \a unit1->unit2.
 */
-const UnitConversion::UnitDef * UnitConversion::units()
+UnitConversion::Converter::Converter(const UnitDef * unit1, const UnitDef * unit2)
 {
-    return mUnits;
+    init(unit1, unit2);
 }
 
+/*!
+    Constructs a new Converter from \a unit1 to \a unit2 which are already
+    normalized.
+
+    \throw UnknownUnitConversionException There's no conversion \a unit1->unit2.
+*/
+UnitConversion::Converter::Converter(const NormalizedUnit & unit1, const NormalizedUnit & unit2)
+{
+    init(unit1, unit2);
+}
+
+/*!
+    Finds conversion from \a unit1 to \a unit2 which may be unit expressions.
+
+    Unit expressions are proportional to base units, so if one of the units
+    is affine (like Celsius), the number is converted through the base unit.
+*/
+void UnitConversion::Converter::init(const NormalizedUnit & unit1, const NormalizedUnit & unit2)
+{
+    if (unit1.unit != 0 && unit2.unit != 0) {
+        init(unit1.unit, unit2.unit);
+        return;
+    }
+
+    if (unit1.dimension != unit2.dimension) {
+        throw ParserException(ParserException::UNKNOWN_UNIT_CONVERSION,
+                              unit1.name + _T(" -> ") + unit2.name);
+    }
+
+    bool affine1 = (unit1.unit != 0 && mTables.isAffine(unit1.unit->unit));
+    bool affine2 = (unit2.unit != 0 && mTables.isAffine(unit2.unit->unit));
+    if (affine1 || affine2) {
+        Affine map1 = affine1 ? mTables.toBase(unit1.unit->unit) : Affine(unit1.scale, 0);
+        Affine map2 = affine2 ? mTables.toBase(unit2.unit->unit) : Affine(unit2.scale, 0);
+        mIdentity = false;
+        mMap = map1.then(map2.inverse());
+        return;
+    }
+
+    mIdentity = (unit1.scale == unit2.scale);
+    mMap = Affine(unit1.scale / unit2.scale, 0);
+}
+
+/*!
+    Finds conversion from \a unit1 to \a unit2 in the matrix.
+*/
+void UnitConversion::Converter::init(const UnitDef * unit1, const UnitDef * unit2)
+{
+    // No conversion
+    if (unit1->unit == unit2->unit) {
+        mIdentity = true;
+        return;
+    }
+
+    const Conversion & conversion = mTables.conversion(unit1->unit, unit2->unit);
+    if (!conversion.exists) {
+        // There is no such conversion
+        throw ParserException(ParserException::UNKNOWN_UNIT_CONVERSION,
+                              unit1->name + _T(" -> ") + unit2->name);
+    }
+    mIdentity = false;
+    mMap = conversion.map;
+}
+
+/*!
+    Converts \a number.
+*/
+BigDecimal UnitConversion::Converter::convert(const BigDecimal & number) const
+{
+    if (mIdentity) return number;
+    return mMap.apply(number);
+}
+
+/*!
+    Converts \a count \a numbers and stores them into \a results.
+
+    \a results may be the same array as \a numbers.
+*/
+void UnitConversion::Converter::convert(const BigDecimal * numbers,
+                                        BigDecimal * results,
+                                        size_t count) const
+{
+    if (mIdentity) {
+        if (results != numbers) {
+            for (size_t i = 0; i < count; ++i) results[i] = numbers[i];
+        }
+    } else if (mMap.isLinear()) {
+        const BigDecimal & factor = mMap.factor;
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = numbers[i] * factor;
+        }
+    } else {
+        const BigDecimal & factor = mMap.factor;
+        const BigDecimal & offset = mMap.offset;
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = BigDecimal::FMA(numbers[i] * factor, offset);
+        }
+    }
+}
@@ -22,6 +22,7 @@
 
 // Local
 #include "bigdecimal.h"
+#include "dimension.h"
 #include "unicode.h"
 
 
@@ -44,13 +45,24 @@ public:
         // Time
         MICROSECOND, MILLISECOND, SECOND, MINUTE, HOUR, DAY, WEEK,
         // Velocity
-        MILE_PER_HOUR, METER_PER_SECOND, FOOT_PER_HOUR, KILOMETER_PER_HOUR, KNOT
+        MILE_PER_HOUR, METER_PER_SECOND, FOOT_PER_HOUR, KILOMETER_PER_HOUR, KNOT,
+        // Volume
+        LITER, CUBIC_METER,
+        // Force
+        NEWTON, POUND_FORCE,
+        // Pressure
+        PASCAL, BAR, ATMOSPHERE,
+        // Energy
+        JOULE, CALORIE, KILOWATT_HOUR,
+        // Number of units (not a unit)
+        UNIT_COUNT
     };
 
     /*! Types of unit conversions. */
     enum Type
     {
-        NO_TYPE, ANGLE, LENGTH, MASS, TEMPERATURE, TIME, VELOCITY
+        NO_TYPE, ANGLE, LENGTH, MASS, TEMPERATURE, TIME, VELOCITY, VOLUME,
+        FORCE, PRESSURE, ENERGY
     };
 
     /*! Unit definition for table of units. */
@@ -62,6 +74,15 @@ public:
         tstring desc;   ///< Description (full name of the unit).
     };
 
+    /*! Unit expression (like "kn*m") normalized to scale and dimension. */
+    struct NormalizedUnit
+    {
+        tstring name;           ///< Unit expression.
+        const UnitDef * unit;   ///< Unit of the table if expression is its name; 0 otherwise.
+        BigDecimal scale;       ///< Size of the unit in base units.
+        Dimension dimension;    ///< Dimension of the unit.
+    };
+
 private:
     static const UnitDef mUnits[];
 
@@ -73,31 +94,134 @@ private:
         const BigDecimal multiplier;
     };
 
-    /*! Represents arbitrary unit conversion (call conversion functions). */
-    struct ArbitraryConversion
+    /*! Represents affine unit conversion (unit2 = unit1 * factor + offset). */
+    struct AffineConversion
     {
         const Unit unit1;
         const Unit unit2;
-        BigDecimal (*convert)(const BigDecimal & arg);
+        const BigDecimal factor;
+        const BigDecimal offset;
     };
 
     static const SimpleConversion mSimpleConversions[];
-    static const ArbitraryConversion mArbitraryConversions[];
+    static const AffineConversion mAffineConversions[];
+
+    /*! Affine map x -> x * factor + offset with exact coefficients. */
+    struct Affine
+    {
+        BigDecimal factor;
+        BigDecimal offset;
+
+        Affine() : factor(1), offset(0) { }
+        Affine(const BigDecimal & factor_, const BigDecimal & offset_)
+            : factor(factor_), offset(offset_) { }
+
+        bool isLinear() const { return offset.isZero(); }
+        BigDecimal apply(const BigDecimal & x) const;
+        Affine then(const Affine & next) const;
+        Affine inverse() const;
+    };
 
-    // Arbitrary conversions functions.
-    static BigDecimal ctof(const BigDecimal & arg) { return arg * 1.8 + 32; }
-    static BigDecimal ctok(const BigDecimal & arg) { return arg + 273.15; }
-    static BigDecimal ftoc(const BigDecimal & arg) { return (arg + 459.67) * 5.0 / 9.0 - 273.15; }
-    static BigDecimal ftok(const BigDecimal & arg) { return (arg + 459.67) * 5.0 / 9.0; }
-    static BigDecimal ktoc(const BigDecimal & arg) { return arg - 273.15; }
-    static BigDecimal ktof(const BigDecimal & arg) { return (arg - 273.15) * 1.8 + 32; }
+    /*! Base unit of a category; all factors are derived through it. */
+    struct Category
+    {
+        const Type type;
+        const Unit baseUnit;
+        const Dimension dimension;
+    };
+
+    static const Category mCategories[];
+
+    /*! SI prefix of units in unit expressions. */
+    struct Prefix
+    {
+        const tchar * name;
+        const BigDecimal factor;
+    };
+
+    static const Prefix mPrefixes[];
+
+    /*! Conversion between two units (element of conversion matrix). */
+    struct Conversion
+    {
+        bool exists;
+        Affine map;
+    };
+
+    /*! Unit name index and conversion matrix built once from the tables. */
+    class Tables
+    {
+    public:
+        Tables();
+
+        const UnitDef * find(const tstring & name) const;
+        static size_t hash(const tstring & name);
+        const Conversion & conversion(Unit unit1, Unit unit2) const
+        {
+            return mConversions[unit1][unit2];
+        }
+        const Affine & toBase(Unit unit) const { return mToBase[unit]; }
+        const BigDecimal & scale(Unit unit) const { return mToBase[unit].factor; }
+        const Dimension & dimension(Unit unit) const { return mDimensions[unit]; }
+        bool isAffine(Unit unit) const { return !mToBase[unit].isLinear(); }
+
+    private:
+        // Size of hash table of unit names (power of two)
+        enum { NAME_SLOTS = 64 };
+
+        const UnitDef * mNames[NAME_SLOTS];
+        Conversion mConversions[UNIT_COUNT][UNIT_COUNT];
+        Affine mToBase[UNIT_COUNT];
+        Dimension mDimensions[UNIT_COUNT];
+
+        void addName(const UnitDef * unit);
+        void buildMatrix();
+    };
+
+    static const Tables mTables;
+
+    /*! Thread-safe cache of normalized unit expressions. */
+    class Cache;
+    static Cache mCache;
+
+    static const UnitDef * findAtom(const tstring & atom, const Prefix *& prefix);
+    static void parseExpression(const tstring & expr, NormalizedUnit & result);
+    static void parseAtom(const tstring & atom, BigDecimal & scale, Dimension & dimension);
 
 public:
+    /*! Conversion from one unit to another resolved once. */
+    class Converter
+    {
+    public:
+        Converter(const tstring & unit1, const tstring & unit2);
+        Converter(const UnitDef * unit1, const UnitDef * unit2);
+        Converter(const NormalizedUnit & unit1, const NormalizedUnit & unit2);
+
+        /// Returns true if conversion is multiplication by a factor.
+        bool isLinear() const { return mMap.isLinear(); }
+
+        BigDecimal convert(const BigDecimal & number) const;
+        void convert(const BigDecimal * numbers, BigDecimal * results,
+                     size_t count) const;
+
+    private:
+        bool mIdentity;     // Units are the same
+        Affine mMap;        // Conversion
+
+        void init(const UnitDef * unit1, const UnitDef * unit2);
+        void init(const NormalizedUnit & unit1, const NormalizedUnit & unit2);
+    };
+
     static BigDecimal convert(const BigDecimal number,
                               const tstring & unit1,
                               const tstring & unit2);
 
     static const UnitDef * units();
+    static const UnitDef * findUnit(const tstring & name);
+    static const BigDecimal & scale(Unit unit);
+    static const Dimension & dimension(Unit unit);
+    static bool isAffine(Unit unit);
+    static NormalizedUnit normalize(const tstring & expr);
 };
 
 
@@ -20,10 +20,19 @@
 // Local
 #include "variables.h"
 #include "exceptions.h"
+#include "mutex.h"
 
 
 using namespace std;
 
+// Last identifier of symbol table
+static unsigned sLastSymbolsId = 0;
+static Mutex sSymbolsIdMutex;
+// Last version of variables (changed atomically)
+static volatile long sLastVersion = 0;
+// Guards unpacking of values in slots shared by copies of variables
+static Mutex sUnpackMutex;
+
 /*!
     \struct Variable
     \brief Represents a variable as a (name, value) pair.
@@ -45,6 +54,30 @@ using namespace std;
     To retrieve all variables there is const_iterator class and begin(),
     and end() functions which return const_iterator.
 
+    Names are interned: each name gets a symbol (index of a slot in array
+    of values) once, and the symbol stays valid until the object is
+    assigned another list of variables (removed variables keep their
+    slots). Parser resolves variable names to symbols once per expression,
+    so accessing a variable by symbol costs one array access.
+    symbolsId() identifies the symbol table symbols belong to.
+
+    Copies of variables share their data, so copying is O(1) regardless of
+    number of variables. Slots are stored in chunks of CHUNK_SIZE slots, and
+    a copy which changes a variable copies only the table of chunks and the
+    chunk with that variable. Names interned by a copy are stored in a new
+    layer on top of the shared names. So contexts forked from a large
+    common base store only their own changes.
+
+    Each change of a variable gets a new version; version() returns version
+    of the last change of all variables and version(Symbol) of one variable.
+    Versions are unique across all copies of variables, so a view can keep
+    versions of the values it shows and update only changed ones, even if
+    variables are replaced by a changed copy.
+
+    Values added by addPacked() are kept packed (see Complex::pack()) in a
+    Storage, e.g. a memory-mapped file, and unpacked on first access, so
+    loading a large workspace doesn't parse all its numbers.
+
     \ingroup MaxCalcEngine
 */
 
@@ -53,8 +86,66 @@ using namespace std;
     \brief Constant iterator for Variables class.
     
     This iterator is used to retrieve variables. It can be done by using
-    begin() and end() functions in Variables class.
+    begin() and end() functions in Variables class. Variables are iterated
+    in alphabetical order of their lowercase names.
+*/
+
+/*!
+    Constructs an empty list of variables.
+*/
+Variables::Variables() :
+    mChunks(new Chunks), mNames(new Names), mSymbolCount(0), mCount(0),
+    mSymbolsId(newSymbolsId()), mVersion(0)
+{
+}
+
+/*!
+    Constructs a copy of \a vars with a new symbol table identifier.
+
+    Data of \a vars is shared, so this is O(1).
+*/
+Variables::Variables(const Variables & vars) :
+    mChunks(vars.mChunks), mNames(vars.mNames), mSymbolCount(vars.mSymbolCount),
+    mCount(vars.mCount), mSymbolsId(newSymbolsId()), mVersion(vars.mVersion)
+{
+}
+
+/*!
+    Replaces variables with \a vars. Symbols of this object become invalid.
 */
+Variables & Variables::operator=(const Variables & vars)
+{
+    if (this != &vars) {
+        mChunks = vars.mChunks;
+        mNames = vars.mNames;
+        mSymbolCount = vars.mSymbolCount;
+        mCount = vars.mCount;
+        mSymbolsId = newSymbolsId();
+        mVersion = vars.mVersion;
+    }
+    return *this;
+}
+
+/*!
+    Returns a new unique identifier of symbol table.
+*/
+unsigned Variables::newSymbolsId()
+{
+    MutexLocker locker(sSymbolsIdMutex);
+    return ++sLastSymbolsId;
+}
+
+/*!
+    Returns a new unique version of variables.
+*/
+long Variables::newVersion()
+{
+#if defined(_WIN32)
+    return InterlockedIncrement(&sLastVersion);
+#else
+    return __sync_add_and_fetch(&sLastVersion, 1);
+#endif
+}
 
 /*!
     Adds new variable with specified \a name and \a value.
@@ -62,9 +153,48 @@ using namespace std;
 */
 void Variables::add(const tstring & name, const Complex & value)
 {
-    tstring lowerName = name;
-    strToLower(lowerName);
-    mVars[lowerName] = Variable(name, value);
+    Slot & slot = writableSlot(intern(name));
+    slot.var.name = name;
+    if (!slot.defined) {
+        slot.defined = true;
+        ++mCount;
+    }
+    slot.var.value = value;
+    slot.packed = 0;
+    slot.version = mVersion = newVersion();
+}
+
+/*!
+    Adds new variable with specified \a name and \a packed value stored in
+    \a storage. If the variable already exists its value is replaced.
+
+    The value is unpacked on first access; \a storage is kept while values
+    in it may be accessed.
+
+    \sa Complex::pack()
+*/
+void Variables::addPacked(const tstring & name, const unsigned char * packed,
+                          const SharedDataPointer<Storage> & storage)
+{
+    Symbol symbol = intern(name);
+    Chunk * chunk = mChunks.data()->chunks[symbol / CHUNK_SIZE].data();
+
+    // Chunk keeps one storage, values from another one are unpacked
+    if (chunk->storage.constData() != storage.constData()) {
+        for (int i = 0; i < CHUNK_SIZE; ++i) {
+            if (chunk->entries[i].packed != 0) unpack(chunk->entries[i]);
+        }
+        chunk->storage = storage;
+    }
+
+    Slot & slot = chunk->entries[symbol % CHUNK_SIZE];
+    slot.var.name = name;
+    if (!slot.defined) {
+        slot.defined = true;
+        ++mCount;
+    }
+    slot.packed = packed;
+    slot.version = mVersion = newVersion();
 }
 
 /*!
@@ -73,9 +203,7 @@ void Variables::add(const tstring & name, const Complex & value)
 */
 void Variables::add(const Variable & var)
 {
-    tstring lowerName = var.name;
-    strToLower(lowerName);
-    mVars[lowerName] = var;
+    add(var.name, var.value);
 }
 
 /*!
@@ -85,9 +213,17 @@ void Variables::add(const Variable & var)
 */
 void Variables::remove(tstring name)
 {
-    if (!mVars.erase(strToLower(name))) {
+    const Symbol * symbol = findSymbol(strToLower(name));
+    if (symbol == 0 || !slot(*symbol).defined) {
         throw ParserException(ParserException::UNKNOWN_VARIABLE, name);
     }
+
+    Slot & removed = writableSlot(*symbol);
+    removed.defined = false;
+    removed.var.value = 0;
+    removed.packed = 0;
+    removed.version = mVersion = newVersion();
+    --mCount;
 }
 
 /*!
@@ -97,18 +233,32 @@ void Variables::remove(tstring name)
 */
 Complex Variables::operator[] (tstring name)
 {
-    VarsMap::const_iterator iter = mVars.find(strToLower(name));
+    const Symbol * symbol = findSymbol(strToLower(name));
 
-    if (iter == mVars.end()) throw ParserException(ParserException::UNKNOWN_VARIABLE, name);
-    else return iter->second.value;
+    if (symbol == 0 || !slot(*symbol).defined) {
+        throw ParserException(ParserException::UNKNOWN_VARIABLE, name);
+    }
+    return loadedSlot(*symbol).var.value;
 }
 
 /*!
-    Removes all variables.
+    Removes all variables. Symbols stay valid.
 */
 void Variables::removeAll()
 {
-    mVars.clear();
+    if (mCount == 0) return;
+
+    mVersion = newVersion();
+    for (Symbol symbol = 0; symbol < mSymbolCount; ++symbol) {
+        if (slot(symbol).defined) {
+            Slot & removed = writableSlot(symbol);
+            removed.defined = false;
+            removed.var.value = 0;
+            removed.packed = 0;
+            removed.version = mVersion;
+        }
+    }
+    mCount = 0;
 }
 
 /*!
@@ -116,23 +266,175 @@ void Variables::removeAll()
 */
 size_t Variables::count()
 {
-    return mVars.size();
+    return mCount;
 }
 
 /*!
-    Returns const_iterator pointing to the beginning of variables' map.
+    Returns const_iterator pointing to the first variable.
 */
 Variables::const_iterator Variables::begin()
 {
-    return const_iterator(mVars.begin());
+    flattenNames();
+    return const_iterator(mNames->symbols.begin(), mNames->symbols.end(), this);
 }
 
 /*!
-    Returns const_iterator pointing to the next element after the end of
-    variables' map.
+    Returns const_iterator pointing to the next element after the last
+    variable.
 */
 Variables::const_iterator Variables::end()
 {
-    return const_iterator(mVars.end());
+    flattenNames();
+    return const_iterator(mNames->symbols.end(), mNames->symbols.end(), this);
+}
+
+/*!
+    Returns symbol of variable with specified \a name.
+
+    Symbol is created if there is no such name yet; variable doesn't get
+    a value (and is not listed) until it is set.
+*/
+Variables::Symbol Variables::intern(const tstring & name)
+{
+    tstring lowerName = name;
+    strToLower(lowerName);
+
+    const Symbol * found = findSymbol(lowerName);
+    if (found != 0) return *found;
+
+    // Names shared with copies are not changed; new names go to a new layer
+    if (mNames->isShared()) {
+        Names * layer = new Names;
+        layer->parent = mNames;
+        layer->depth = mNames->depth + 1;
+        mNames = SharedDataPointer<Names>(layer);
+        if (layer->depth > MAX_NAME_LAYERS) flattenNames();
+    }
+
+    Symbol symbol = mSymbolCount++;
+    if (symbol % CHUNK_SIZE == 0) {
+        mChunks.data()->chunks.push_back(SharedDataPointer<Chunk>(new Chunk));
+    }
+    writableSlot(symbol).var.name = name;
+    mNames.data()->symbols.insert(SymbolsMap::value_type(lowerName, symbol));
+    return symbol;
+}
+
+/*!
+    Finds symbol of variable with specified \a name without interning it.
+
+    Returns false if there is no such name; \a symbol is not changed then.
+*/
+bool Variables::find(const tstring & name, Symbol & symbol) const
+{
+    tstring lowerName = name;
+    strToLower(lowerName);
+
+    const Symbol * found = findSymbol(lowerName);
+    if (found == 0) return false;
+    symbol = *found;
+    return true;
+}
+
+/*!
+    Returns value of variable \a symbol.
+
+    \exception UnknownVariableException Variable doesn't have a value.
+*/
+const Complex & Variables::value(Symbol symbol) const
+{
+    const Slot & s = slot(symbol);
+    if (!s.defined) {
+        throw ParserException(ParserException::UNKNOWN_VARIABLE, s.var.name);
+    }
+    if (s.packed != 0) unpack(s);
+    return s.var.value;
 }
 
+/*!
+    Sets value of variable \a symbol.
+*/
+void Variables::setValue(Symbol symbol, const Complex & value)
+{
+    Slot & s = writableSlot(symbol);
+    if (!s.defined) {
+        s.defined = true;
+        ++mCount;
+    }
+    s.var.value = value;
+    s.packed = 0;
+    s.version = mVersion = newVersion();
+}
+
+/*!
+    Sets value of variable \a symbol and changes its name to \a name (which
+    may differ from the interned name only in case).
+*/
+void Variables::setValue(Symbol symbol, const Complex & value, const tstring & name)
+{
+    setValue(symbol, value);
+    writableSlot(symbol).var.name = name;
+}
+
+/*!
+    Unpacks value of \a slot.
+
+    Slot may be shared with copies of variables used in other threads, so
+    value is unpacked under a lock and becomes visible before the packed
+    value is cleared.
+
+    \exception ArithmeticException(CONVERSION_IMPOSSIBLE) Packed value is
+        invalid.
+*/
+void Variables::unpack(const Slot & slot)
+{
+    MutexLocker locker(sUnpackMutex);
+    if (slot.packed == 0) return;
+
+    slot.var.value = Complex::unpack(slot.packed);
+#if defined(_WIN32)
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+    slot.packed = 0;
+}
+
+/*!
+    Returns slot of \a symbol for writing.
+
+    Table of chunks and the chunk with the slot are copied first if they
+    are shared with copies of variables.
+*/
+Variables::Slot & Variables::writableSlot(Symbol symbol)
+{
+    return mChunks.data()->chunks[symbol / CHUNK_SIZE].data()->entries[symbol % CHUNK_SIZE];
+}
+
+/*!
+    Returns pointer to symbol of \a lowerName or 0 if there is no such name.
+*/
+const Variables::Symbol * Variables::findSymbol(const tstring & lowerName) const
+{
+    for (const Names * names = mNames.constData(); names != 0;
+         names = names->parent.constData()) {
+        SymbolsMap::const_iterator iter = names->symbols.find(lowerName);
+        if (iter != names->symbols.end()) return &iter->second;
+    }
+    return 0;
+}
+
+/*!
+    Merges all layers of names into one.
+*/
+void Variables::flattenNames()
+{
+    if (mNames->depth == 1) return;
+
+    Names * names = new Names;
+    for (const Names * layer = mNames.constData(); layer != 0;
+         layer = layer->parent.constData()) {
+        names->symbols.insert(layer->symbols.begin(), layer->symbols.end());
+    }
+    mNames = SharedDataPointer<Names>(names);
+}
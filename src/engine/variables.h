@@ -22,9 +22,11 @@
 
 // Local
 #include "complex.h"
+#include "shareddata.h"
 #include "unicode.h"
 //STL
 #include <map>
+#include <vector>
 #include <iterator>
 
 
@@ -53,8 +55,24 @@ class Variables
 public:
     class const_iterator;
 
+    /// Interned variable name; index of variable's slot.
+    typedef size_t Symbol;
+
+    /// Storage of packed values; it is kept while its values are not unpacked.
+    class Storage : public SharedData
+    {
+    public:
+        virtual ~Storage() { }
+    };
+
+    Variables();
+    Variables(const Variables & vars);
+    Variables & operator=(const Variables & vars);
+
     void add(const tstring & name, const Complex & value);
     void add(const Variable & var);
+    void addPacked(const tstring & name, const unsigned char * packed,
+                   const SharedDataPointer<Storage> & storage);
     void remove(tstring name);
     void removeAll();
     Complex operator[] (tstring name);
@@ -62,35 +80,158 @@ public:
     const_iterator begin();
     const_iterator end();
 
+    Symbol intern(const tstring & name);
+    bool find(const tstring & name, Symbol & symbol) const;
+    const Complex & value(Symbol symbol) const;
+    void setValue(Symbol symbol, const Complex & value);
+    void setValue(Symbol symbol, const Complex & value, const tstring & name);
+    /// Returns true if variable \a symbol has a value.
+    bool isDefined(Symbol symbol) const { return slot(symbol).defined; }
+    /// Returns identifier of symbol table; symbols are valid while it is the same.
+    unsigned symbolsId() const { return mSymbolsId; }
+    /// Returns version of the last change of variables (0 if there were no changes).
+    long version() const { return mVersion; }
+    /// Returns version of the last change of variable \a symbol.
+    long version(Symbol symbol) const { return slot(symbol).version; }
+
 private:
-    typedef std::map<tstring, Variable> VarsMap;
-    VarsMap mVars;
+    typedef std::map<tstring, Symbol> SymbolsMap;
+
+    enum
+    {
+        CHUNK_SIZE = 16,        ///< Number of slots in a chunk.
+        MAX_NAME_LAYERS = 8     ///< Layers of names are merged when there are more.
+    };
+
+    /// Variable stored in a slot.
+    struct Slot
+    {
+        Slot() : packed(0), defined(false), version(0) { }
+
+        mutable Variable var;                   ///< Name and value.
+        mutable const unsigned char * packed;   ///< Packed value if it is not unpacked yet.
+        bool defined;                           ///< True if variable has a value.
+        long version;                           ///< Version of the last change.
+    };
+
+    /// Fixed-size block of slots shared by copies of variables.
+    struct Chunk : public SharedData
+    {
+        Slot entries[CHUNK_SIZE];
+        SharedDataPointer<Storage> storage;     ///< Storage of packed values.
+    };
+
+    /// Table of chunks shared by copies of variables.
+    struct Chunks : public SharedData
+    {
+        std::vector<SharedDataPointer<Chunk> > chunks;
+    };
+
+    /// Names interned since the parent layer was shared.
+    struct Names : public SharedData
+    {
+        Names() : depth(1) { }
+
+        SharedDataPointer<Names> parent;
+        SymbolsMap symbols;     ///< Symbols by lowercase names.
+        int depth;              ///< Number of layers including this one.
+    };
+
+    SharedDataPointer<Chunks> mChunks;  ///< Variables by symbols.
+    SharedDataPointer<Names> mNames;    ///< Symbols by lowercase names.
+    size_t mSymbolCount;                ///< Number of symbols.
+    size_t mCount;                      ///< Number of defined variables.
+    unsigned mSymbolsId;                ///< Identifier of symbol table.
+    long mVersion;                      ///< Version of the last change.
+
+    /// Returns slot of \a symbol for reading.
+    const Slot & slot(Symbol symbol) const
+    {
+        return mChunks->chunks[symbol / CHUNK_SIZE]->entries[symbol % CHUNK_SIZE];
+    }
+
+    /// Returns slot of \a symbol for reading with unpacked value.
+    const Slot & loadedSlot(Symbol symbol) const
+    {
+        const Slot & s = slot(symbol);
+        if (s.packed != 0) unpack(s);
+        return s;
+    }
+
+    Slot & writableSlot(Symbol symbol);
+    const Symbol * findSymbol(const tstring & lowerName) const;
+    void flattenNames();
+
+    static unsigned newSymbolsId();
+    static long newVersion();
+    static void unpack(const Slot & slot);
 
 public:
-    class const_iterator : public VarsMap::const_iterator
+    class const_iterator
     {
     public:
         /// Default constructor.
-        const_iterator() : VarsMap::const_iterator()
+        const_iterator() : mVars(0)
         {
         }
 
-        /// Constructs const_iterator from std::map<tstring, Variable> iterator.
-        const_iterator(const VarsMap::const_iterator & iter) :
-            VarsMap::const_iterator(iter)
+        /// Constructs const_iterator pointing to \a iter which skips undefined
+        /// variables.
+        const_iterator(const SymbolsMap::const_iterator & iter,
+                       const SymbolsMap::const_iterator & end,
+                       const Variables * vars) :
+            mIter(iter), mEnd(end), mVars(vars)
         {
+            skipUndefined();
         }
 
         /// Gets Variable associated with current value.
-        const Variable & operator* ()
+        const Variable & operator* () const
         {
-            return (VarsMap::const_iterator::operator*()).second;
+            return mVars->loadedSlot(mIter->second).var;
         }
 
         /// Gets Variable associated with current value.
-        const Variable * operator-> ()
+        const Variable * operator-> () const
+        {
+            return &mVars->loadedSlot(mIter->second).var;
+        }
+
+        /// Moves to the next variable.
+        const_iterator & operator++ ()
+        {
+            ++mIter;
+            skipUndefined();
+            return *this;
+        }
+
+        /// Moves to the next variable.
+        const_iterator operator++ (int)
+        {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        /// Returns lowercase name of current variable (variables are sorted by it).
+        const tstring & lowerName() const { return mIter->first; }
+
+        /// Returns version of the last change of current variable.
+        long version() const { return mVars->slot(mIter->second).version; }
+
+        /// Returns true if iterators point to the same variable.
+        bool operator== (const const_iterator & iter) const { return mIter == iter.mIter; }
+        /// Returns true if iterators point to different variables.
+        bool operator!= (const const_iterator & iter) const { return mIter != iter.mIter; }
+
+    private:
+        SymbolsMap::const_iterator mIter;
+        SymbolsMap::const_iterator mEnd;
+        const Variables * mVars;
+
+        void skipUndefined()
         {
-            return &((VarsMap::const_iterator::operator*()).second);
+            while (mIter != mEnd && !mVars->slot(mIter->second).defined) ++mIter;
         }
     };
 };
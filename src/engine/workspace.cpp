@@ -0,0 +1,274 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "workspace.h"
+#include "exceptions.h"
+#include "mappedfile.h"
+#include "mutex.h"
+// STL
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+// Process id
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/*!
+    \class Workspace
+    \brief Saves and loads variables and result of parser context.
+
+    Workspace file is binary; all integers are little-endian:
+    \li header: magic "MXCW", version, flags (1 if result is saved), number
+        of variables and size of string table (4-byte integers);
+    \li string table: for each variable offset of its value from the start of
+        the file and length of its name (4-byte integers), and the name
+        (UTF-8 or local 8-bit encoding);
+    \li values: the result (if it is saved) and values of variables packed
+        by Complex::pack().
+
+    Loaded file is memory-mapped and values of variables are unpacked on
+    first access (see Variables::addPacked()), so even large workspaces are
+    loaded quickly. Therefore a loaded file must not be modified while
+    variables loaded from it exist. save() writes a new file and replaces the
+    old one with it, so contexts which loaded the old file keep its contents.
+
+    \ingroup MaxCalcEngine
+*/
+
+// Workspace file constants
+static const char WORKSPACE_MAGIC[4] = { 'M', 'X', 'C', 'W' };
+static const unsigned WORKSPACE_VERSION = 1;
+static const unsigned RESULT_SAVED = 1;
+static const size_t HEADER_SIZE = 20;
+static const size_t ENTRY_HEADER_SIZE = 8;
+
+// Memory-mapped workspace file which keeps packed values of variables
+class WorkspaceStorage : public Variables::Storage
+{
+public:
+    MappedFile file;
+};
+
+// Converts file name or variable name to 8-bit string stored in files
+static string toFileString(const tstring & str)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return wideStringToString(str);
+#else
+    return str;
+#endif
+}
+
+// Converts 8-bit string stored in file to tstring
+static tstring fromFileString(const string & str)
+{
+#if defined(MAXCALC_UNICODE) && !defined(MAXCALC_UTF8)
+    return stringToWideString(str);
+#else
+    return str;
+#endif
+}
+
+// Appends 4-byte little-endian integer to buffer
+static void appendUInt(vector<unsigned char> & buffer, unsigned value)
+{
+    buffer.push_back((unsigned char)value);
+    buffer.push_back((unsigned char)(value >> 8));
+    buffer.push_back((unsigned char)(value >> 16));
+    buffer.push_back((unsigned char)(value >> 24));
+}
+
+// Reads 4-byte little-endian integer
+static unsigned readUInt(const unsigned char * data)
+{
+    return (unsigned)data[0] | ((unsigned)data[1] << 8) |
+        ((unsigned)data[2] << 16) | ((unsigned)data[3] << 24);
+}
+
+// Returns name of temporary file in the same directory as \a fileName which
+// is unique among threads and processes
+static string temporaryFileName(const string & fileName)
+{
+    static Mutex mutex;
+    static unsigned counter = 0;
+    unsigned number;
+    {
+        MutexLocker locker(mutex);
+        number = counter++;
+    }
+
+    ostringstream name;
+#if defined(_WIN32)
+    name << fileName << '.' << _getpid() << '.' << number << ".tmp";
+#else
+    name << fileName << '.' << getpid() << '.' << number << ".tmp";
+#endif
+    return name.str();
+}
+
+// Replaces file \a fileName with file \a tempName
+static bool replaceFile(const string & tempName, const string & fileName)
+{
+#if defined(_WIN32)
+    return MoveFileExA(tempName.c_str(), fileName.c_str(),
+        MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(tempName.c_str(), fileName.c_str()) == 0;
+#endif
+}
+
+// Appends packed number to buffer
+static void appendComplex(vector<unsigned char> & buffer, const Complex & num)
+{
+    unsigned char packed[Complex::MAX_PACKED_SIZE];
+    size_t size = num.pack(packed);
+    buffer.insert(buffer.end(), packed, packed + size);
+}
+
+/*!
+    Saves variables and result of \a context to file \a fileName.
+
+    Returns number of saved variables.
+
+    \exception WorkspaceException(CANNOT_WRITE_FILE) File cannot be written.
+*/
+size_t Workspace::save(ParserContext & context, const tstring & fileName)
+{
+    Variables & vars = context.variables();
+
+    // Offsets of values are known when size of string table is known
+    vector<string> names;
+    size_t tableSize = 0;
+    for (Variables::const_iterator iter = vars.begin(); iter != vars.end(); ++iter) {
+        names.push_back(toFileString(iter->name));
+        tableSize += ENTRY_HEADER_SIZE + names.back().length();
+    }
+
+    vector<unsigned char> header, table, values;
+    header.insert(header.end(), WORKSPACE_MAGIC, WORKSPACE_MAGIC + 4);
+    appendUInt(header, WORKSPACE_VERSION);
+    appendUInt(header, context.resultExists() ? RESULT_SAVED : 0);
+    appendUInt(header, (unsigned)names.size());
+    appendUInt(header, (unsigned)tableSize);
+
+    if (context.resultExists()) appendComplex(values, context.result());
+
+    size_t i = 0;
+    for (Variables::const_iterator iter = vars.begin(); iter != vars.end(); ++iter, ++i) {
+        appendUInt(table, (unsigned)(HEADER_SIZE + tableSize + values.size()));
+        appendUInt(table, (unsigned)names[i].length());
+        table.insert(table.end(), names[i].begin(), names[i].end());
+        appendComplex(values, iter->value);
+    }
+
+    // Loaded file may be mapped into memory, so it is replaced, not rewritten
+    string targetName = toFileString(fileName);
+    string tempName = temporaryFileName(targetName);
+    FILE * file = fopen(tempName.c_str(), "wb");
+    if (file == 0) {
+        throw WorkspaceException(WorkspaceException::CANNOT_WRITE_FILE, fileName);
+    }
+    bool written = fwrite(&header[0], 1, header.size(), file) == header.size() &&
+        (table.empty() || fwrite(&table[0], 1, table.size(), file) == table.size()) &&
+        (values.empty() || fwrite(&values[0], 1, values.size(), file) == values.size());
+    if (fclose(file) != 0 || !written || !replaceFile(tempName, targetName)) {
+        remove(tempName.c_str());
+        throw WorkspaceException(WorkspaceException::CANNOT_WRITE_FILE, fileName);
+    }
+
+    return names.size();
+}
+
+/*!
+    Replaces variables of \a context with variables from file \a fileName
+    saved by save(). Result is replaced if it was saved.
+
+    Values of variables are not unpacked until they are used. \a context is
+    not changed if the file cannot be loaded.
+
+    Returns number of loaded variables.
+
+    \exception WorkspaceException(CANNOT_OPEN_FILE) File cannot be opened.
+    \exception WorkspaceException(INVALID_FILE) File is not a valid workspace.
+*/
+size_t Workspace::load(ParserContext & context, const tstring & fileName)
+{
+    WorkspaceStorage * workspace = new WorkspaceStorage;
+    SharedDataPointer<Variables::Storage> storage(workspace);
+    if (!workspace->file.open(toFileString(fileName))) {
+        throw WorkspaceException(WorkspaceException::CANNOT_OPEN_FILE, fileName);
+    }
+
+    const unsigned char * data = workspace->file.data();
+    size_t size = workspace->file.size();
+    if (size < HEADER_SIZE || memcmp(data, WORKSPACE_MAGIC, 4) != 0 ||
+        readUInt(data + 4) != WORKSPACE_VERSION) {
+        throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+    }
+
+    unsigned flags = readUInt(data + 8);
+    size_t count = readUInt(data + 12);
+    size_t tableEnd = HEADER_SIZE + readUInt(data + 16);
+    if (tableEnd > size || tableEnd < HEADER_SIZE) {
+        throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+    }
+
+    // Values are checked here, so a corrupt file is rejected at once, but
+    // they are unpacked later
+    Variables vars;
+    size_t pos = HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        if (tableEnd - pos < ENTRY_HEADER_SIZE) {
+            throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+        }
+        size_t offset = readUInt(data + pos);
+        size_t length = readUInt(data + pos + 4);
+        pos += ENTRY_HEADER_SIZE;
+        if (length == 0 || tableEnd - pos < length || offset < tableEnd ||
+            offset >= size || Complex::packedSize(data + offset, size - offset) == 0) {
+            throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+        }
+        string name((const char *)data + pos, length);
+        pos += length;
+        vars.addPacked(fromFileString(name), data + offset, storage);
+    }
+
+    Complex result;
+    if (flags & RESULT_SAVED) {
+        try {
+            if (Complex::packedSize(data + tableEnd, size - tableEnd) == 0) {
+                throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+            }
+            result = Complex::unpack(data + tableEnd);
+        } catch (ArithmeticException &) {
+            throw WorkspaceException(WorkspaceException::INVALID_FILE, fileName);
+        }
+        context.setResult(result);
+    }
+    context.setVariables(vars);
+
+    return count;
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+// Local
+#include "parsercontext.h"
+#include "unicode.h"
+
+
+class Workspace
+{
+public:
+    static size_t save(ParserContext & context, const tstring & fileName);
+    static size_t load(ParserContext & context, const tstring & fileName);
+
+private:
+    Workspace();
+};
+
+
+#endif // WORKSPACE_H
@@ -19,6 +19,7 @@
 
 // Local
 #include "aboutbox.h"
+#include "mainwindow.h"
 // MaxCalc Engine
 #include "constants.h"
 #include "unicode.h"
@@ -44,22 +45,22 @@ AboutBox::AboutBox(QWidget * parent) : QDialog(parent)
 {
     setWindowTitle("About MaxCalc");
 
-    tstring labelText = _T("MaxCalc v");
-    labelText += Constants::VERSION;
-    labelText += _T(" (");
-    labelText += _T("built: ");
-    tstring date = stringToWideString(__DATE__);
-    labelText += date;
-    labelText += _T(")<br>");
-    labelText += Constants::COPYRIGHT;
-    labelText += _T("<br><a href='");
-    labelText += Constants::WEBSITE;
-    labelText += _T("'>");
-    labelText += Constants::WEBSITE;
-    labelText += _T("</a>");
+    QString website = MainWindow::toQString(Constants::WEBSITE);
+    QString labelText = "MaxCalc v";
+    labelText += MainWindow::toQString(Constants::VERSION);
+    labelText += " (";
+    labelText += "built: ";
+    labelText += __DATE__;
+    labelText += ")<br>";
+    labelText += MainWindow::toQString(Constants::COPYRIGHT);
+    labelText += "<br><a href='";
+    labelText += website;
+    labelText += "'>";
+    labelText += website;
+    labelText += "</a>";
 
     QTextBrowser * label = new QTextBrowser;
-    label->setHtml(QString::fromWCharArray(labelText.c_str()));
+    label->setHtml(labelText);
     label->setOpenExternalLinks(true);
     label->setFrameStyle(QFrame::NoFrame);
     QPalette p;
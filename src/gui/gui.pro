@@ -21,7 +21,11 @@ HEADERS += \
         inputbox.h \
         aboutbox.h \
         myaction.h \
-        outputsettings.h
+        outputsettings.h \
+        historymodel.h \
+        historydelegate.h \
+        variablesmodel.h \
+        plotwidget.h
 
 SOURCES += \
         main.cpp \
@@ -29,7 +33,11 @@ SOURCES += \
         inputbox.cpp \
         aboutbox.cpp \
         myaction.cpp \
-        outputsettings.cpp
+        outputsettings.cpp \
+        historymodel.cpp \
+        historydelegate.cpp \
+        variablesmodel.cpp \
+        plotwidget.cpp
 
 RESOURCES += resources.qrc
 
@@ -53,8 +61,10 @@ CONFIG(release, debug|release) {
 }
 
 win32:maxcalc_gettext:LIBS += -L../intl_win -lintl
+unix:LIBS += -lpthread
 
 maxcalc_unicode:DEFINES += MAXCALC_UNICODE
+maxcalc_utf8:DEFINES += MAXCALC_UTF8
 maxcalc_gettext:DEFINES += MAXCALC_GETTEXT
 maxcalc_portable:DEFINES += MAXCALC_PORTABLE
 win32:RC_FILE = resources.rc
@@ -0,0 +1,97 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "historydelegate.h"
+#include "historymodel.h"
+// Qt
+#include <QPainter>
+
+/// Indentation of results and errors
+static const QString indent = "    ";
+
+/*!
+    \class HistoryDelegate
+    \brief Paints entries of HistoryModel.
+
+    Expressions are painted in blue, results in dark green, provisional
+    results in gray and errors in red; all but expressions are indented.
+    Each entry is one line high, so the view can use uniform item sizes
+    and only visible rows are painted.
+
+    \ingroup MaxCalcGui
+*/
+
+/*!
+    Constructs a new history delegate.
+*/
+HistoryDelegate::HistoryDelegate(QObject * parent) : QItemDelegate(parent)
+{
+}
+
+/*!
+    Paints entry with given \a index.
+*/
+void HistoryDelegate::paint(QPainter * painter,
+    const QStyleOptionViewItem & option, const QModelIndex & index) const
+{
+    HistoryModel::EntryType type =
+        (HistoryModel::EntryType)index.data(HistoryModel::EntryTypeRole).toInt();
+
+    QStyleOptionViewItem opt = option;
+    QRect rect = opt.rect;
+    QColor color;
+    switch (type) {
+    case HistoryModel::RESULT_ENTRY:
+        color = Qt::darkGreen;
+        rect.setLeft(rect.left() + opt.fontMetrics.width(indent));
+        break;
+    case HistoryModel::ERROR_ENTRY:
+        color = Qt::red;
+        rect.setLeft(rect.left() + opt.fontMetrics.width(indent));
+        break;
+    case HistoryModel::PROVISIONAL_ENTRY:
+        color = Qt::gray;
+        rect.setLeft(rect.left() + opt.fontMetrics.width(indent));
+        break;
+    default:
+        color = Qt::blue;
+        break;
+    }
+    if (!(opt.state & QStyle::State_Selected)) {
+        opt.palette.setColor(QPalette::Text, color);
+    }
+
+    painter->save();
+    drawBackground(painter, opt, index);
+    drawDisplay(painter, opt, rect, index.data(Qt::DisplayRole).toString());
+    drawFocus(painter, opt, opt.rect);
+    painter->restore();
+}
+
+/*!
+    Returns size of entry with given \a index: one line of text.
+*/
+QSize HistoryDelegate::sizeHint(const QStyleOptionViewItem & option,
+    const QModelIndex & index) const
+{
+    QString text = index.data(Qt::DisplayRole).toString();
+    return QSize(option.fontMetrics.width(indent + text) + 2 * 3,
+        option.fontMetrics.height() + 2);
+}
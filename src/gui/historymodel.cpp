@@ -0,0 +1,376 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "historymodel.h"
+
+/// Indentation of results and errors in copied text
+static const QString indent = "    ";
+/// Runs of more digits than this are elided
+static const int elideDigits = 30;
+/// Number of leading characters of elided run of digits
+static const int leadingChars = 16;
+/// Number of trailing characters of elided run of digits
+static const int trailingChars = 8;
+
+/*!
+    \class HistoryModel
+    \brief List of expressions, results and errors shown in history view.
+
+    Provisional result of a long calculation is added as PROVISIONAL_ENTRY
+    and replaced in place by setEntry() or setResult() when the calculation
+    is finished.
+
+    Results added by appendResult() are formatted when their text is first
+    needed (usually when the entry is scrolled into view), so results which
+    are never shown are never formatted. Long numbers are shown elided:
+    runs of more than 30 digits are shortened to their leading and
+    trailing digits followed by the number of digits, and the full text is
+    shown when the entry is expanded by setExpanded().
+
+    Entries are kept in a ring buffer: when the number of entries reaches
+    limit(), the oldest entry is removed for each appended one, so memory
+    and time of append() do not grow during long sessions. Each entry is
+    a single line; its type is returned by EntryTypeRole, so views can
+    paint entries of each type differently (see HistoryDelegate).
+
+    The model doesn't depend on QtGui, so it is tested without a display.
+
+    \ingroup MaxCalcGui
+*/
+
+/*!
+    Constructs an empty history with the default limit.
+*/
+HistoryModel::HistoryModel(QObject * parent) : QAbstractListModel(parent),
+    mFirst(0), mCount(0), mLimit(DEFAULT_LIMIT)
+{
+}
+
+/*!
+    Returns number of entries.
+*/
+int HistoryModel::rowCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : mCount;
+}
+
+/*!
+    Returns shown (possibly elided) text of entry for display role, its full
+    text for tool tip role of elided entry and its type for EntryTypeRole.
+*/
+QVariant HistoryModel::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || index.row() >= mCount) return QVariant();
+    if (role == EntryTypeRole) return (int)entry(index.row()).type;
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) return QVariant();
+
+    const Entry & e = formattedEntry(index.row());
+    bool elided = !e.elidedText.isEmpty() && !e.expanded;
+    if (role == Qt::DisplayRole) return elided ? e.elidedText : e.text;
+    if (role == Qt::ToolTipRole && elided) return e.text;
+    return QVariant();
+}
+
+/*!
+    Converts engine string \a str to QString (as MainWindow::toQString(),
+    which is not available in tests of the model).
+*/
+static QString toQString(const tstring & str)
+{
+#if defined(MAXCALC_UTF8)
+    return QString::fromUtf8(str.data(), (int)str.length());
+#else
+    return QString::fromWCharArray(str.data(), (int)str.length());
+#endif
+}
+
+/*!
+    Returns \a text with runs of more than elideDigits digits replaced by
+    their leading and trailing characters and the number of digits of the
+    longest elided run appended; returns empty string if there are no long
+    runs of digits.
+*/
+static QString elide(const QString & text)
+{
+    QString result;
+    int maxDigits = 0;
+    int i = 0;
+    while (i < text.length()) {
+        if (!text.at(i).isDigit()) {
+            result += text.at(i++);
+            continue;
+        }
+
+        // Run of digits includes decimal separators
+        int start = i;
+        int digits = 0;
+        while (i < text.length() &&
+               (text.at(i).isDigit() || text.at(i) == '.' || text.at(i) == ',')) {
+            if (text.at(i).isDigit()) ++digits;
+            ++i;
+        }
+        if (digits > elideDigits) {
+            result += text.mid(start, leadingChars);
+            result += QChar(0x2026);
+            result += text.mid(i - trailingChars, trailingChars);
+            maxDigits = qMax(maxDigits, digits);
+        } else {
+            result += text.mid(start, i - start);
+        }
+    }
+
+    if (maxDigits == 0) return QString();
+    return result + HistoryModel::tr(" [%1 digits]").arg(maxDigits);
+}
+
+/*!
+    Returns entry in given \a row with formatted text.
+*/
+const HistoryModel::Entry & HistoryModel::formattedEntry(int row) const
+{
+    const Entry & e = entry(row);
+    if (!e.formatted) {
+        if (!e.pending.isNull()) {
+            e.text = toQString(e.pending->value.toTString(e.pending->format));
+            e.pending = SharedDataPointer<PendingResult>();
+        }
+        e.elidedText = elide(e.text);
+        e.formatted = true;
+    }
+    return e;
+}
+
+/*!
+    Returns new entry of given \a type with \a text.
+*/
+HistoryModel::Entry HistoryModel::textEntry(EntryType type, const QString & text)
+{
+    Entry e;
+    e.text = text;
+    e.formatted = false;
+    e.type = type;
+    e.expanded = false;
+    return e;
+}
+
+/*!
+    Returns new result entry with \a result to be formatted with \a format.
+*/
+HistoryModel::Entry HistoryModel::resultEntry(const Complex & result,
+                                              const ComplexFormat & format)
+{
+    PendingResult * pending = new PendingResult;
+    pending->value = result;
+    pending->format = format;
+
+    Entry e = textEntry(RESULT_ENTRY, QString());
+    e.pending = SharedDataPointer<PendingResult>(pending);
+    return e;
+}
+
+/*!
+    Appends entry of given \a type with \a text. Removes the oldest entry if
+    history is full.
+*/
+void HistoryModel::append(EntryType type, const QString & text)
+{
+    appendEntry(textEntry(type, text));
+}
+
+/*!
+    Appends \a result which is formatted with \a format when it is shown.
+    Removes the oldest entry if history is full.
+*/
+void HistoryModel::appendResult(const Complex & result, const ComplexFormat & format)
+{
+    appendEntry(resultEntry(result, format));
+}
+
+/*!
+    Appends \a newEntry. Removes the oldest entry if history is full.
+*/
+void HistoryModel::appendEntry(const Entry & newEntry)
+{
+    if (mLimit <= 0) return;
+
+    if (mCount == mLimit) {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        mFirst = (mFirst + 1) % mLimit;
+        --mCount;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), mCount, mCount);
+    // Buffer grows until it is full; then the oldest entry is overwritten
+    int index = (mFirst + mCount) % mLimit;
+    if (index == mEntries.size()) mEntries.append(newEntry);
+    else mEntries[index] = newEntry;
+    ++mCount;
+    endInsertRows();
+}
+
+/*!
+    Replaces entry in \a row by entry of given \a type with \a text.
+*/
+void HistoryModel::setEntry(int row, EntryType type, const QString & text)
+{
+    replaceEntry(row, textEntry(type, text));
+}
+
+/*!
+    Replaces entry in \a row by \a result which is formatted with \a format
+    when it is shown.
+*/
+void HistoryModel::setResult(int row, const Complex & result, const ComplexFormat & format)
+{
+    replaceEntry(row, resultEntry(result, format));
+}
+
+/*!
+    Replaces entry in \a row by \a newEntry.
+*/
+void HistoryModel::replaceEntry(int row, const Entry & newEntry)
+{
+    if (row < 0 || row >= mCount) return;
+    mEntries[(mFirst + row) % mEntries.size()] = newEntry;
+    emit dataChanged(index(row), index(row));
+}
+
+/*!
+    Returns full text of entry in \a row.
+*/
+QString HistoryModel::text(int row) const
+{
+    return formattedEntry(row).text;
+}
+
+/*!
+    Returns type of entry in \a row.
+*/
+HistoryModel::EntryType HistoryModel::entryType(int row) const
+{
+    return entry(row).type;
+}
+
+/*!
+    Returns true if entry in \a row contains long numbers which are elided
+    unless the entry is expanded.
+*/
+bool HistoryModel::isElided(int row) const
+{
+    return !formattedEntry(row).elidedText.isEmpty();
+}
+
+/*!
+    Returns true if full text of entry in \a row is shown.
+*/
+bool HistoryModel::isExpanded(int row) const
+{
+    return entry(row).expanded;
+}
+
+/*!
+    Shows full text of entry in \a row if \a expanded is true (elided text
+    otherwise).
+*/
+void HistoryModel::setExpanded(int row, bool expanded)
+{
+    if (row < 0 || row >= mCount) return;
+    Entry & e = mEntries[(mFirst + row) % mEntries.size()];
+    if (e.expanded == expanded) return;
+    e.expanded = expanded;
+    emit dataChanged(index(row), index(row));
+}
+
+/*!
+    Returns text of entries with given \a indexes in the order of rows; each
+    entry is on its own line and results and errors are indented.
+*/
+QString HistoryModel::toPlainText(const QModelIndexList & indexes) const
+{
+    QVector<int> rows;
+    rows.reserve(indexes.size());
+    foreach (const QModelIndex & index, indexes) {
+        if (index.isValid() && index.row() < mCount) rows.append(index.row());
+    }
+    qSort(rows);
+
+    QString result;
+    foreach (int row, rows) {
+        const Entry & e = entry(row);
+        if (e.type != EXPRESSION_ENTRY) result += indent;
+        result += text(row);
+        result += '\n';
+    }
+    return result;
+}
+
+/*!
+    Returns row of the first entry containing \a str (case-insensitive)
+    starting from row \a from, or -1 if there is no such entry. Search
+    goes to the end of history if \a forward is true (to the beginning
+    otherwise) and continues from the other end.
+*/
+int HistoryModel::find(const QString & str, int from, bool forward) const
+{
+    if (mCount == 0 || str.isEmpty()) return -1;
+    if (from < 0 || from >= mCount) from = forward ? 0 : mCount - 1;
+
+    int row = from;
+    for (int i = 0; i < mCount; ++i) {
+        if (text(row).contains(str, Qt::CaseInsensitive)) return row;
+        row = forward ? (row + 1) % mCount : (row + mCount - 1) % mCount;
+    }
+    return -1;
+}
+
+/*!
+    Sets maximum number of entries to \a limit. The oldest entries are
+    removed if there are more entries.
+*/
+void HistoryModel::setLimit(int limit)
+{
+    if (limit < 0) limit = 0;
+    if (limit == mLimit) return;
+
+    int count = qMin(mCount, limit);
+    QVector<Entry> entries;
+    entries.reserve(count);
+    for (int row = mCount - count; row < mCount; ++row) {
+        entries.append(entry(row));
+    }
+
+    mEntries = entries;
+    mFirst = 0;
+    mCount = count;
+    mLimit = limit;
+    reset();
+}
+
+/*!
+    Removes all entries.
+*/
+void HistoryModel::clear()
+{
+    mEntries.clear();
+    mFirst = 0;
+    mCount = 0;
+    reset();
+}
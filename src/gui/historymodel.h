@@ -0,0 +1,103 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef HISTORYMODEL_H
+#define HISTORYMODEL_H
+
+// MaxCalcEngine
+#include "complex.h"
+#include "complexformat.h"
+#include "shareddata.h"
+// Qt
+#include <QAbstractListModel>
+#include <QModelIndexList>
+#include <QString>
+#include <QVector>
+
+class HistoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /// Type of history entry.
+    enum EntryType { EXPRESSION_ENTRY, RESULT_ENTRY, ERROR_ENTRY, PROVISIONAL_ENTRY };
+    /// Role which returns EntryType of entry.
+    enum Roles { EntryTypeRole = Qt::UserRole };
+    /// Default maximum number of entries.
+    static const int DEFAULT_LIMIT = 10000;
+
+    HistoryModel(QObject * parent = 0);
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    void append(EntryType type, const QString & text);
+    void setEntry(int row, EntryType type, const QString & text);
+    void appendResult(const Complex & result, const ComplexFormat & format);
+    void setResult(int row, const Complex & result, const ComplexFormat & format);
+    QString text(int row) const;
+    EntryType entryType(int row) const;
+    bool isElided(int row) const;
+    bool isExpanded(int row) const;
+    void setExpanded(int row, bool expanded);
+    QString toPlainText(const QModelIndexList & indexes) const;
+    int find(const QString & str, int from, bool forward = true) const;
+
+    /// Returns maximum number of entries.
+    int limit() const { return mLimit; }
+    void setLimit(int limit);
+
+public slots:
+    void clear();
+
+private:
+    /// Result which is not formatted yet.
+    struct PendingResult : public SharedData
+    {
+        Complex value;              ///< Result.
+        ComplexFormat format;       ///< Format of result.
+    };
+
+    /// History entry; text is formatted and elided when it is first needed.
+    struct Entry
+    {
+        mutable QString text;           ///< Text of entry.
+        mutable QString elidedText;     ///< Text with long numbers elided (or empty).
+        mutable SharedDataPointer<PendingResult> pending;  ///< Unformatted result or null.
+        mutable bool formatted;         ///< True if text and elidedText are ready.
+        EntryType type;                 ///< Type of entry.
+        bool expanded;                  ///< True if full text is shown instead of elided one.
+    };
+
+    QVector<Entry> mEntries;    ///< Ring buffer of entries.
+    int mFirst;                 ///< Index of the first entry in mEntries.
+    int mCount;                 ///< Number of entries.
+    int mLimit;                 ///< Maximum number of entries.
+
+    /// Returns entry in given \a row.
+    const Entry & entry(int row) const { return mEntries[(mFirst + row) % mEntries.size()]; }
+    const Entry & formattedEntry(int row) const;
+    void appendEntry(const Entry & newEntry);
+    void replaceEntry(int row, const Entry & newEntry);
+    static Entry textEntry(EntryType type, const QString & text);
+    static Entry resultEntry(const Complex & result, const ComplexFormat & format);
+};
+
+
+#endif // HISTORYMODEL_H
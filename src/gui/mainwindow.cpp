@@ -29,6 +29,10 @@
 #include "myaction.h"
 #include "inputbox.h"
 #include "outputsettings.h"
+#include "historymodel.h"
+#include "historydelegate.h"
+#include "variablesmodel.h"
+#include "plotwidget.h"
 // STL
 #include <sstream>
 // Qt
@@ -36,23 +40,33 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QActionGroup>
-#include <QListWidget>
 #include <QSystemTrayIcon>
 #include <QSettings>
 #include <QDockWidget>
-#include <QTextEdit>
-#include <QListWidget>
+#include <QListView>
+#include <QInputDialog>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
+#include <QProgressBar>
+#include <QLabel>
+#include <QLineEdit>
+#include <QTimer>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QFile>
+#include <QClipboard>
 
-/// Indentation used for output
-static const QString indent = "    ";
 /// Version for saveState() / restoreState()
 static const int version = 201;
+/// Delay of preview after the last change of expression in milliseconds
+static const int previewDelay = 150;
+/// Precision of calculations for preview
+static const int previewWorkingPrecision = 32;
+/// Maximum precision of preview output
+static const int previewPrecision = 20;
+/// Time limit of preview evaluation in milliseconds
+static const unsigned long previewTimeLimit = 2000;
 
 /*!
     \class MainWindow
@@ -69,8 +83,10 @@ MainWindow::MainWindow() : QMainWindow(), mTrayIcon(0), mTrayContextMenu(0)
 {
     // Create Parser first, so that we can read its settings into it
     mParser = new Parser();
-    mOut = new std::wostringstream;
+    mOut = new tstringstream;
     mCmdParser = new CommandParser(*mOut, mParser->context());
+    mAsyncParser = new AsyncParser(this);
+    mPreviewParser = new AsyncParser(this);
 
     readSettings();
     createUi();
@@ -92,7 +108,9 @@ MainWindow::~MainWindow()
 {
     saveSettings();
 
-    // Delete parser
+    // Delete parser (running evaluation is cancelled)
+    delete mPreviewParser;
+    delete mAsyncParser;
     delete mCmdParser;
     delete mOut;
     delete mParser;
@@ -119,6 +137,10 @@ void MainWindow::readSettings()
                    settings->value("CloseToTray", false).toBool() : false;
     onAddRemoveTrayIcon(mCloseToTray || mMinimizeToTray);
     mShowVariables = settings->value("ShowVariables", true).toBool();
+    mShowPreview = settings->value("ShowPreview", true).toBool();
+    mShowPlot = settings->value("ShowPlot", false).toBool();
+    mHistoryLimit = settings->value("HistoryLimit",
+        HistoryModel::DEFAULT_LIMIT).toInt();
 #if defined(MAXCALC_SINGLE_INSTANCE_MODE)
     mSingleInstanceMode = settings->value("SingleInstanceMode", false).toBool();
 #endif
@@ -149,6 +171,9 @@ void MainWindow::saveSettings()
     settings->setValue("MinimizeToTray", mMinimizeToTray);
     settings->setValue("CloseToTray", mCloseToTray);
     settings->setValue("ShowVariables", mShowVariables);
+    settings->setValue("ShowPreview", mShowPreview);
+    settings->setValue("ShowPlot", mShowPlot);
+    settings->setValue("HistoryLimit", mHistoryModel->limit());
     settings->setValue("WindowGeometry", saveGeometry());
     settings->setValue("WindowState", saveState(version));
 #if defined(MAXCALC_SINGLE_INSTANCE_MODE)
@@ -182,12 +207,28 @@ void MainWindow::createUi()
     mCentralWidget = new QWidget();
     setCentralWidget(mCentralWidget);
 
-    // Create history box
-    mHistoryBox = new QTextEdit();
-    QFont font = mHistoryBox->currentFont();
+    // Create history view (only visible entries are painted, so long
+    // history doesn't slow down the window)
+    mHistoryModel = new HistoryModel(this);
+    mHistoryModel->setLimit(mHistoryLimit);
+    mHistoryView = new QListView();
+    mHistoryView->setModel(mHistoryModel);
+    mHistoryView->setItemDelegate(new HistoryDelegate(mHistoryView));
+    mHistoryView->setUniformItemSizes(true);
+    mHistoryView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    mHistoryView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    mHistoryView->setContextMenuPolicy(Qt::ActionsContextMenu);
+    QFont font = mHistoryView->font();
     font.setPixelSize(12);
-    mHistoryBox->setFont(font);
-    mHistoryBox->setReadOnly(true);
+    mHistoryView->setFont(font);
+    QAction * copyAction = new QAction(tr("&Copy"), mHistoryView);
+    copyAction->setShortcut(QKeySequence::Copy);
+    copyAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(copyAction, SIGNAL(triggered()), this, SLOT(onHistoryCopy()));
+    mHistoryView->addAction(copyAction);
+    // Long numbers are elided; double click shows them in full
+    connect(mHistoryView, SIGNAL(doubleClicked(const QModelIndex &)), this,
+        SLOT(onHistoryExpand(const QModelIndex &)));
 
     // Create input box
     mInputBox = new InputBox();
@@ -204,25 +245,75 @@ void MainWindow::createUi()
     mOkButton->setMinimumWidth(30);
     mOkButton->setMaximumWidth(30);
 
+    // Create preview of result (elided, so long results don't widen window)
+    mPreviewLabel = new QLabel();
+    font = mPreviewLabel->font();
+    font.setPixelSize(12);
+    mPreviewLabel->setFont(font);
+    QPalette palette = mPreviewLabel->palette();
+    palette.setColor(QPalette::WindowText, Qt::gray);
+    mPreviewLabel->setPalette(palette);
+    mPreviewLabel->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Preferred);
+    mPreviewLabel->setVisible(mShowPreview);
+    mPreviewTimer = new QTimer(this);
+    mPreviewTimer->setSingleShot(true);
+    mPreviewTimer->setInterval(previewDelay);
+
+    // Create busy indicator and Cancel button (shown during evaluation)
+    mBusyIndicator = new QProgressBar();
+    mBusyIndicator->setRange(0, 0);
+    mBusyIndicator->setTextVisible(false);
+    mBusyIndicator->setMaximumWidth(80);
+    mBusyIndicator->setVisible(false);
+    mCancelButton = new QPushButton();
+    mCancelButton->setText(tr("Cancel"));
+    mCancelButton->setVisible(false);
+
     // Create bottom layout (with input box and OK button)
     mBottomLayout = new QHBoxLayout();
     mBottomLayout->addWidget(mInputBox);
+    mBottomLayout->addWidget(mBusyIndicator);
+    mBottomLayout->addWidget(mCancelButton);
     mBottomLayout->addWidget(mOkButton);
 
     // Create main layout
     mLayout = new QVBoxLayout();
-    mLayout->addWidget(mHistoryBox);
+    mLayout->addWidget(mHistoryView);
     mLayout->addLayout(mBottomLayout);
+    mLayout->addWidget(mPreviewLabel);
     mCentralWidget->setLayout(mLayout);
 
     // Create functions and variables lists
-    mVariablesList = new QListWidget(this);
+    mVariablesModel = new VariablesModel(this);
+    mVariablesList = new QListView(this);
+    mVariablesList->setModel(mVariablesModel);
+    mVariablesList->setUniformItemSizes(true);
+    mVariablesList->setEditTriggers(QAbstractItemView::NoEditTriggers);
     mVariablesListDock = new QDockWidget(tr("Variables"), this);
     mVariablesListDock->setObjectName("VariablesDockWidget");
     mVariablesListDock->setWidget(mVariablesList);
     addDockWidget(Qt::RightDockWidgetArea, mVariablesListDock);
     mVariablesListDock->setVisible(mShowVariables);
 
+    // Create plot of expressions in x
+    QLabel * plotLabel = new QLabel(tr("y(x) ="));
+    mPlotInput = new QLineEdit();
+    QHBoxLayout * plotInputLayout = new QHBoxLayout();
+    plotInputLayout->addWidget(plotLabel);
+    plotInputLayout->addWidget(mPlotInput);
+    mPlotWidget = new PlotWidget();
+    mPlotWidget->setMinimumSize(200, 150);
+    QVBoxLayout * plotLayout = new QVBoxLayout();
+    plotLayout->addLayout(plotInputLayout);
+    plotLayout->addWidget(mPlotWidget);
+    QWidget * plotPanel = new QWidget();
+    plotPanel->setLayout(plotLayout);
+    mPlotDock = new QDockWidget(tr("Plot"), this);
+    mPlotDock->setObjectName("PlotDockWidget");
+    mPlotDock->setWidget(plotPanel);
+    addDockWidget(Qt::BottomDockWidgetArea, mPlotDock);
+    mPlotDock->setVisible(mShowPlot);
+
     // Connect
     connect(this, SIGNAL(expressionCalculated()), mInputBox,
         SLOT(addTextToHistory()));
@@ -230,8 +321,18 @@ void MainWindow::createUi()
         SLOT(onExpressionEntered()));
     connect(mInputBox, SIGNAL(returnPressed()), this,
         SLOT(onExpressionEntered()));
-    connect(mVariablesList, SIGNAL(itemActivated(QListWidgetItem *)),
-        this, SLOT(onVariableClicked(QListWidgetItem *)));
+    connect(mCancelButton, SIGNAL(clicked()), this,
+        SLOT(onCancelEvaluation()));
+    connect(mInputBox, SIGNAL(textChanged(const QString &)), this,
+        SLOT(onInputChanged()));
+    connect(mPreviewTimer, SIGNAL(timeout()), this, SLOT(onPreview()));
+    connect(this, SIGNAL(evaluationReady()), this,
+        SLOT(onEvaluationFinished()), Qt::QueuedConnection);
+    connect(this, SIGNAL(provisionalResultReady()), this,
+        SLOT(onProvisionalResult()), Qt::QueuedConnection);
+    connect(mVariablesList, SIGNAL(activated(const QModelIndex &)),
+        this, SLOT(onVariableClicked(const QModelIndex &)));
+    connect(mPlotInput, SIGNAL(returnPressed()), this, SLOT(onPlot()));
 
     // Set focus
     mInputBox->setFocus();
@@ -250,10 +351,21 @@ void MainWindow::createMainMenu()
     // Commands menu
 
     QMenu * commands = mMainMenu->addMenu(tr("&Commands"));
-    commands->addAction(tr("Clear &history"), mHistoryBox, SLOT(clear()),
+    commands->addAction(tr("Clear &history"), mHistoryModel, SLOT(clear()),
                         tr("Ctrl+H"));
+    commands->addAction(tr("&Find in history..."), this,
+                        SLOT(onHistoryFind()), tr("Ctrl+F"));
+    commands->addAction(tr("Find &next"), this,
+                        SLOT(onHistoryFindNext()), tr("Ctrl+G"));
+    commands->addAction(tr("History &limit..."), this,
+                        SLOT(onHistoryLimit()));
     commands->addAction(tr("&Delete all variables"), this,
                         SLOT(onDeleteAllVariables()), tr("Ctrl+D"));
+    commands->addAction(tr("&Plot expression"), this,
+                        SLOT(onPlotInput()), tr("Ctrl+P"));
+    mMenuCancelEvaluation = commands->addAction(tr("&Cancel evaluation"), this,
+                        SLOT(onCancelEvaluation()), tr("Ctrl+Break"));
+    mMenuCancelEvaluation->setEnabled(false);
     commands->addSeparator();
     commands->addAction(tr("&Quit"), QApplication::instance(), SLOT(quit()), tr("Ctrl+Q"));
 
@@ -286,6 +398,14 @@ void MainWindow::createMainMenu()
     settings->addAction(action);
     action->setText(tr("Show &variables"));
     connect(action, SIGNAL(toggled(bool)), this, SLOT(onSettingsVariables(bool)));
+    action = mPlotDock->toggleViewAction();
+    settings->addAction(action);
+    action->setText(tr("Show p&lot"));
+    connect(action, SIGNAL(toggled(bool)), this, SLOT(onSettingsPlot(bool)));
+    action = settings->addAction(tr("Show result &preview"));
+    action->setCheckable(true);
+    action->setChecked(mShowPreview);
+    connect(action, SIGNAL(toggled(bool)), this, SLOT(onSettingsPreview(bool)));
 
     if (QSystemTrayIcon::isSystemTrayAvailable()) {
         settings->addSeparator();
@@ -381,21 +501,33 @@ void MainWindow::createMainMenu()
             case UnitConversion::VELOCITY:
                 currentUnits = unitConversion->addMenu(tr("&Velocity"));
                 break;
+            case UnitConversion::VOLUME:
+                currentUnits = unitConversion->addMenu(tr("V&olume"));
+                break;
+            case UnitConversion::FORCE:
+                currentUnits = unitConversion->addMenu(tr("&Force"));
+                break;
+            case UnitConversion::PRESSURE:
+                currentUnits = unitConversion->addMenu(tr("&Pressure"));
+                break;
+            case UnitConversion::ENERGY:
+                currentUnits = unitConversion->addMenu(tr("&Energy"));
+                break;
             default:
                 currentUnits = unitConversion->addMenu(tr("&Unknown units"));
                 break;
             }
         }
 
-        QString firstName = QString::fromWCharArray(cur->name.c_str());
-        QString firstDesc = QString::fromWCharArray(cur->desc.c_str());
+        QString firstName = toQString(cur->name);
+        QString firstDesc = toQString(cur->desc);
         QString menu = QString("%1 (%2)").arg(firstDesc, firstName);
         firstLevelMenu = currentUnits->addMenu(menu);
         const UnitConversion::UnitDef * cur2;
         for (cur2 = firstLevelCur; cur2->type == type; ++cur2) {
             if (cur2 == cur) continue;
-            QString secondName = QString::fromWCharArray(cur2->name.c_str());
-            QString secondDesc = QString::fromWCharArray(cur2->desc.c_str());
+            QString secondName = toQString(cur2->name);
+            QString secondDesc = toQString(cur2->desc);
             QString conversion = QString("[%1->%2]").arg(firstName, secondName);
             menu = QString("%1 (%2)").arg(secondDesc, secondName);
             firstLevelMenu->addAction(new MyAction(firstLevelMenu, menu,
@@ -439,30 +571,11 @@ QAction * MainWindow::newFunctionAction(QObject * parent, const QString & title)
 
 /*!
     Updates list of varibables from \a mParser.
-     Also adds 'e' and 'pi' constants and 'res' variable at the beginning.
+    Only rows of changed variables are updated (see VariablesModel).
 */
 void MainWindow::updateVariablesList()
 {
-    mVariablesList->clear();
-
-    ComplexFormat & format = mParser->context().numberFormat();
-
-    mVariablesList->addItem("e = " +
-        QString::fromWCharArray(BigDecimal::E.toWideString(format).c_str()));
-    mVariablesList->addItem("pi = " +
-        QString::fromWCharArray(BigDecimal::PI.toWideString(format).c_str()));
-
-    if (mParser->context().resultExists()) {
-        mVariablesList->addItem("res = " +
-            QString::fromWCharArray(mParser->context().result().toWideString(format).c_str()));
-    }
-
-    Variables::const_iterator iter;
-    for (iter = mParser->context().variables().begin();
-        iter != mParser->context().variables().end(); ++iter) {
-        mVariablesList->addItem(QString::fromWCharArray(iter->name.c_str()) +
-            " = " + QString::fromWCharArray(iter->value.toWideString(format).c_str()));
-    }
+    mVariablesModel->update(mParser->context());
 }
 
 /*!
@@ -470,19 +583,21 @@ void MainWindow::updateVariablesList()
 */
 void MainWindow::onExpressionEntered()
 {
+    // Only one expression is evaluated at a time
+    if (!mEvaluation.isNull()) return;
+
     // Get expression from input box
     QString expr = mInputBox->text();
     expr = expr.trimmed();
     if (expr.isEmpty()) return;
 
+    // Preview is not needed when expression is evaluated
+    cancelPreview();
+
     // Add expression to history
-    mHistoryBox->moveCursor(QTextCursor::End);
-    mHistoryBox->setTextColor(Qt::blue);
-    mHistoryBox->insertPlainText(mInputBox->text() + "\n");
+    printToHistory(HistoryModel::EXPRESSION_ENTRY, mInputBox->text());
 
-    wchar_t * str = new wchar_t[expr.length() + 1];
-    expr.toWCharArray(str);
-    str[expr.length()] = L'\0';
+    tstring str = fromQString(expr);
 
     CommandParser::Result res = mCmdParser->parse(str);
 
@@ -496,23 +611,171 @@ void MainWindow::onExpressionEntered()
         // Add expression to input box history
         emit expressionCalculated();
         // Output result
-        printResult(QString::fromWCharArray(mOut->str().c_str()));
+        printResult(toQString(mOut->str()));
         mOut->str(_T(""));
         return;
     }
 
-    mParser->setExpression(str);
-    delete[] str;
+    // Expression is evaluated in the worker thread, so the window stays
+    // responsive; result is printed by onEvaluationFinished() (provisional
+    // result of long evaluation is printed by onProvisionalResult() first)
+    mEvaluation = mAsyncParser->evaluate(str, mParser->context(), true);
+    setBusy(true);
+}
 
-    try {
-        ParserContext & context = mParser->parse();
-        // Add expression to input box history
-        emit expressionCalculated();
-        // No error during parsing, output result (otherwise an exception will be caught)
-        printResult(QString::fromWCharArray(context.result().toWideString(context.numberFormat()).c_str()));
-    } catch (MaxCalcException & ex) {
-        printError(QString::fromStdWString(ex.toString()));
+/*!
+    Called in the worker thread when evaluation is finished; passes it to
+    the UI thread by a queued signal.
+*/
+void MainWindow::evaluationFinished(const EvaluationPointer & /*evaluation*/)
+{
+    emit evaluationReady();
+}
+
+/*!
+    Called in the worker thread when evaluation has provisional result;
+    passes it to the UI thread by a queued signal.
+*/
+void MainWindow::provisionalResultReady(const EvaluationPointer & /*evaluation*/)
+{
+    emit provisionalResultReady();
+}
+
+/*!
+    Prints provisional result of running evaluation into history; it is
+    replaced by the result or error when evaluation is finished.
+*/
+void MainWindow::onProvisionalResult()
+{
+    if (mEvaluation.isNull() || !mEvaluation->hasProvisionalResult() ||
+        mProvisionalEntry.isValid()) return;
+
+    // Last digits of provisional result may be wrong
+    ComplexFormat format = mParser->context().numberFormat();
+    format.precision = qMin(format.precision, Parser::PROVISIONAL_PRECISION - 4);
+    mHistoryModel->append(HistoryModel::PROVISIONAL_ENTRY,
+        toQString(mEvaluation->provisionalResult().toTString(format)) + " ...");
+    mProvisionalEntry = mHistoryModel->index(mHistoryModel->rowCount() - 1);
+    mHistoryView->scrollToBottom();
+}
+
+/*!
+    Shows finished preview; applies result and variables of finished
+    evaluation and prints the result or error.
+*/
+void MainWindow::onEvaluationFinished()
+{
+    if (!mPreview.isNull() && mPreview->isFinished()) showPreview();
+
+    if (mEvaluation.isNull() || !mEvaluation->isFinished()) return;
+    EvaluationPointer evaluation = mEvaluation;
+    mEvaluation = EvaluationPointer();
+    setBusy(false);
+
+    if (!evaluation->succeeded()) {
+        printError(toQString(evaluation->error()));
+        return;
+    }
+
+    // Settings could be changed during evaluation, so only result and
+    // variables are taken from its context
+    ParserContext context = evaluation->context();
+    mParser->context().setResult(context.result());
+    mParser->context().setVariables(context.variables());
+    // Add expression to input box history
+    emit expressionCalculated();
+    printResult(context.result());
+}
+
+/*!
+    Cancels running evaluation.
+*/
+void MainWindow::onCancelEvaluation()
+{
+    if (!mEvaluation.isNull()) mEvaluation->cancel();
+}
+
+/*!
+    Called when text of input box is changed; (re)starts preview timer,
+    so expression is evaluated when typing pauses.
+*/
+void MainWindow::onInputChanged()
+{
+    if (!mShowPreview || !mEvaluation.isNull()) return;
+
+    // Result of stale expression is not needed
+    if (!mPreview.isNull()) mPreview->cancel();
+    if (mInputBox->text().trimmed().isEmpty()) {
+        cancelPreview();
+        return;
     }
+    mPreviewTimer->start();
+}
+
+/*!
+    Evaluates expression in input box for preview.
+
+    Copy of the context is evaluated in background with reduced precision
+    and limited time, so assignments don't change variables and typing
+    is not slowed down.
+*/
+void MainWindow::onPreview()
+{
+    QString expr = mInputBox->text().trimmed();
+    // Commands are not previewed
+    if (expr.isEmpty() || expr.startsWith('#') || !mEvaluation.isNull()) return;
+
+    if (!mPreview.isNull()) mPreview->cancel();
+    ParserContext context = mParser->context();
+    context.setWorkingPrecision(previewWorkingPrecision);
+    context.setTimeLimit(previewTimeLimit);
+    mPreview = mPreviewParser->evaluate(fromQString(expr), context);
+}
+
+/*!
+    Shows result of finished preview. Errors are not shown, since
+    expression is usually incomplete while it is typed.
+*/
+void MainWindow::showPreview()
+{
+    EvaluationPointer preview = mPreview;
+    mPreview = EvaluationPointer();
+    if (preview->isCancelled()) return;
+
+    if (!preview->succeeded()) {
+        mPreviewLabel->clear();
+        return;
+    }
+    ComplexFormat format = mParser->context().numberFormat();
+    format.precision = qMin(format.precision, previewPrecision);
+    mPreviewLabel->setText("= " +
+        toQString(preview->context().result().toTString(format)));
+}
+
+/*!
+    Cancels preview and clears its result.
+*/
+void MainWindow::cancelPreview()
+{
+    mPreviewTimer->stop();
+    if (!mPreview.isNull()) {
+        mPreview->cancel();
+        mPreview = EvaluationPointer();
+    }
+    mPreviewLabel->clear();
+}
+
+/*!
+    Shows or hides busy indicator and Cancel button. Input box is read-only
+    during evaluation, so the expression is kept until it is evaluated.
+*/
+void MainWindow::setBusy(bool busy)
+{
+    mBusyIndicator->setVisible(busy);
+    mCancelButton->setVisible(busy);
+    mOkButton->setEnabled(!busy);
+    mMenuCancelEvaluation->setEnabled(busy);
+    mInputBox->setReadOnly(busy);
 }
 
 /*!
@@ -521,13 +784,26 @@ void MainWindow::onExpressionEntered()
 */
 void MainWindow::printResult(const QString & message)
 {
-    mHistoryBox->setTextColor(Qt::darkGreen);
-    QStringList strList = message.split("\n");
-    foreach (QString str, strList) {
-        if (str != "")
-            mHistoryBox->insertPlainText(indent + str + "\n");
+    printToHistory(HistoryModel::RESULT_ENTRY, message);
+    mInputBox->clear();
+    mInputBox->setFocus();
+    updateVariablesList();
+}
+
+/*!
+    Prints \a result of evaluation (replacing provisional result if it is
+    shown); it is formatted when its history entry is shown.
+*/
+void MainWindow::printResult(const Complex & result)
+{
+    const ComplexFormat & format = mParser->context().numberFormat();
+    if (mProvisionalEntry.isValid()) {
+        mHistoryModel->setResult(mProvisionalEntry.row(), result, format);
+        mProvisionalEntry = QPersistentModelIndex();
+    } else {
+        mHistoryModel->appendResult(result, format);
     }
-    mHistoryBox->ensureCursorVisible();
+    mHistoryView->scrollToBottom();
     mInputBox->clear();
     mInputBox->setFocus();
     updateVariablesList();
@@ -538,27 +814,115 @@ void MainWindow::printResult(const QString & message)
 */
 void MainWindow::printError(const QString & message)
 {
-    mHistoryBox->setTextColor(Qt::red);
+    printToHistory(HistoryModel::ERROR_ENTRY, message);
+    mInputBox->selectAll();
+    mInputBox->setFocus();
+}
+
+/*!
+    Adds non-empty lines of \a message to history as entries of given
+    \a type and scrolls history to the end. The first line replaces
+    provisional result if it is shown.
+*/
+void MainWindow::printToHistory(int type, const QString & message)
+{
     QStringList strList = message.split("\n");
     foreach (QString str, strList) {
-        if (str != "")
-            mHistoryBox->insertPlainText(indent + str + "\n");
+        if (str == "") continue;
+        if (mProvisionalEntry.isValid()) {
+            mHistoryModel->setEntry(mProvisionalEntry.row(),
+                (HistoryModel::EntryType)type, str);
+            mProvisionalEntry = QPersistentModelIndex();
+        } else {
+            mHistoryModel->append((HistoryModel::EntryType)type, str);
+        }
     }
-    mHistoryBox->ensureCursorVisible();
-    mInputBox->selectAll();
-    mInputBox->setFocus();
+    mProvisionalEntry = QPersistentModelIndex();
+    mHistoryView->scrollToBottom();
+}
+
+/*!
+    Copies selected history entries to clipboard.
+*/
+void MainWindow::onHistoryCopy()
+{
+    QModelIndexList indexes = mHistoryView->selectionModel()->selectedIndexes();
+    if (indexes.isEmpty()) return;
+    QApplication::clipboard()->setText(mHistoryModel->toPlainText(indexes));
+}
+
+/*!
+    Shows full or elided text of long numbers in history entry with given
+    \a index.
+*/
+void MainWindow::onHistoryExpand(const QModelIndex & index)
+{
+    int row = index.row();
+    if (!index.isValid() || !mHistoryModel->isElided(row)) return;
+    mHistoryModel->setExpanded(row, !mHistoryModel->isExpanded(row));
+}
+
+/*!
+    Commands -> Find in history command.
+*/
+void MainWindow::onHistoryFind()
+{
+    bool ok;
+    QString str = QInputDialog::getText(this, tr("Find in history"),
+        tr("Find:"), QLineEdit::Normal, mHistorySearch, &ok);
+    if (!ok || str.isEmpty()) return;
+    mHistorySearch = str;
+    findInHistory(str, mHistoryModel->rowCount() - 1);
+}
+
+/*!
+    Commands -> Find next command. Search goes from the current entry to
+    the beginning of history (to older entries).
+*/
+void MainWindow::onHistoryFindNext()
+{
+    if (mHistorySearch.isEmpty()) {
+        onHistoryFind();
+        return;
+    }
+    findInHistory(mHistorySearch, mHistoryView->currentIndex().row() - 1);
+}
+
+/*!
+    Selects and shows the first history entry containing \a str starting
+    from row \a from backwards.
+*/
+void MainWindow::findInHistory(const QString & str, int from)
+{
+    int row = mHistoryModel->find(str, from, false);
+    if (row < 0) {
+        QMessageBox::information(this, tr("Find in history"),
+            tr("'%1' is not found.").arg(str));
+        return;
+    }
+    QModelIndex index = mHistoryModel->index(row);
+    mHistoryView->setCurrentIndex(index);
+    mHistoryView->scrollTo(index);
+}
+
+/*!
+    Commands -> History limit command.
+*/
+void MainWindow::onHistoryLimit()
+{
+    bool ok;
+    int limit = QInputDialog::getInteger(this, tr("History limit"),
+        tr("Maximum number of history lines:"), mHistoryModel->limit(),
+        100, 10000000, 1000, &ok);
+    if (ok) mHistoryModel->setLimit(limit);
 }
 
 /*!
     Called when variable in the list is clicked.
 */
-void MainWindow::onVariableClicked(QListWidgetItem * item)
+void MainWindow::onVariableClicked(const QModelIndex & index)
 {
-    Q_ASSERT(item);
-    QString text = item->text();
-    int equalIndex = text.indexOf(" = ");
-    text.remove(equalIndex, text.length() - equalIndex);
-    mInputBox->insert(text);
+    mInputBox->insert(index.data(VariablesModel::NameRole).toString());
     mInputBox->setFocus();
 }
 
@@ -612,10 +976,32 @@ void MainWindow::onHelpReportIssue()
 */
 void MainWindow::onDeleteAllVariables()
 {
+    // Variables are replaced when running evaluation is finished
+    if (!mEvaluation.isNull()) return;
     mParser->context().variables().removeAll();
     updateVariablesList();
 }
 
+/*!
+    Plots expression entered into plot panel as a function of x.
+*/
+void MainWindow::onPlot()
+{
+    mPlotWidget->plot(mPlotInput->text(), mParser->context());
+}
+
+/*!
+    Commands -> Plot expression command; plots expression from input box.
+*/
+void MainWindow::onPlotInput()
+{
+    QString expression = mInputBox->text().trimmed();
+    if (expression.isEmpty()) return;
+    mPlotInput->setText(expression);
+    mPlotDock->setVisible(true);
+    onPlot();
+}
+
 /*!
     Unit conversion menu command handler.
 */
@@ -682,6 +1068,25 @@ void MainWindow::onSettingsVariables(bool active)
     if (isVisible() && !isMinimized()) mShowVariables = active;
 }
 
+/*!
+    Settings -> Show result preview command.
+*/
+void MainWindow::onSettingsPreview(bool active)
+{
+    mShowPreview = active;
+    mPreviewLabel->setVisible(active);
+    if (active) onInputChanged();
+    else cancelPreview();
+}
+
+/*!
+    Settings -> Show plot command.
+*/
+void MainWindow::onSettingsPlot(bool active)
+{
+    if (isVisible() && !isMinimized()) mShowPlot = active;
+}
+
 /*!
     Settings -> Minimize to tray command.
 */
@@ -828,3 +1233,37 @@ QSettings * MainWindow::getSettings()
         "maxcalc");
 #endif
 }
+
+/*!
+    Converts engine string \a str to QString.
+
+    Engine strings are converted only here and in fromQString(); in UTF-8
+    mode (MAXCALC_UTF8) no wide strings are involved at all.
+*/
+QString MainWindow::toQString(const tstring & str)
+{
+#if defined(MAXCALC_UTF8)
+    return QString::fromUtf8(str.data(), (int)str.length());
+#else
+    return QString::fromWCharArray(str.data(), (int)str.length());
+#endif
+}
+
+/*!
+    Converts \a str to engine string.
+
+    \sa toQString()
+*/
+tstring MainWindow::fromQString(const QString & str)
+{
+#if defined(MAXCALC_UTF8)
+    QByteArray utf8 = str.toUtf8();
+    return tstring(utf8.constData(), utf8.length());
+#else
+    if (str.isEmpty()) return tstring();
+    // Wide string never has more characters than UTF-16 QString
+    tstring result(str.length(), _T('\0'));
+    result.resize(str.toWCharArray(&result[0]));
+    return result;
+#endif
+}
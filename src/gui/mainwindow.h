@@ -20,28 +20,40 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+// MaxCalcEngine
+#include "unicode.h"
+#include "asyncparser.h"
+// STL
+#include <sstream>
 // Qt
 #include <QMainWindow>
 #include <QSystemTrayIcon>
+#include <QPersistentModelIndex>
 
 // Forward declarations
 class QWidget;
 class QVBoxLayout;
 class QHBoxLayout;
-class QTextEdit;
+class QListView;
+class HistoryModel;
+class VariablesModel;
 class QPushButton;
-class QListWidget;
-class QListWidgetItem;
+class QProgressBar;
+class QLabel;
+class QLineEdit;
+class QTimer;
+class QModelIndex;
 class QDockWidget;
 class QMenuBar;
 class QActionGroup;
 class InputBox;
+class PlotWidget;
 class Parser;
 class CommandParser;
 class QSettings;
 
 
-class MainWindow : public QMainWindow
+class MainWindow : public QMainWindow, private AsyncParser::Callback
 {
     Q_OBJECT
 
@@ -49,12 +61,18 @@ public:
     MainWindow();
     ~MainWindow();
     static QSettings * getSettings();
+    static QString toQString(const tstring & str);
+    static tstring fromQString(const QString & str);
 
 signals:
     /// Emitted when expression is calculated by parser.
     void expressionCalculated();
     /// Emitted when the window needs to be minimized to tray.
     void minimizeToTray();
+    /// Emitted in the worker thread when evaluation is finished.
+    void evaluationReady();
+    /// Emitted in the worker thread when evaluation has provisional result.
+    void provisionalResultReady();
 
 private:
 
@@ -63,10 +81,21 @@ private:
     QVBoxLayout * mLayout;
     QHBoxLayout * mBottomLayout;
     InputBox * mInputBox;
-    QTextEdit * mHistoryBox;
+    QListView * mHistoryView;
+    HistoryModel * mHistoryModel;
+    QString mHistorySearch;
     QPushButton * mOkButton;
-    QListWidget * mVariablesList;
+    QLabel * mPreviewLabel;
+    QTimer * mPreviewTimer;
+    QProgressBar * mBusyIndicator;
+    QPushButton * mCancelButton;
+    QAction * mMenuCancelEvaluation;
+    QListView * mVariablesList;
+    VariablesModel * mVariablesModel;
     QDockWidget * mVariablesListDock;
+    QLineEdit * mPlotInput;
+    PlotWidget * mPlotWidget;
+    QDockWidget * mPlotDock;
     QMenuBar * mMainMenu;
     QAction * mMenuSettingsRadians;
     QAction * mMenuSettingsDegrees;
@@ -80,6 +109,9 @@ private:
     bool mMinimizeToTray;
     bool mCloseToTray;
     bool mShowVariables;
+    bool mShowPreview;
+    bool mShowPlot;
+    int mHistoryLimit;
 #if defined(MAXCALC_SINGLE_INSTANCE_MODE)
     bool mSingleInstanceMode;
 #endif
@@ -87,7 +119,12 @@ private:
     // Parser
     CommandParser * mCmdParser;
     Parser * mParser;
-    std::wostringstream * mOut;
+    tstringstream * mOut;
+    AsyncParser * mAsyncParser;
+    EvaluationPointer mEvaluation;
+    QPersistentModelIndex mProvisionalEntry;
+    AsyncParser * mPreviewParser;
+    EvaluationPointer mPreview;
 
     // Private functions
     void readSettings();
@@ -98,7 +135,15 @@ private:
         const QString & shortcut, bool checked, QActionGroup * actionGroup);
     QAction * newFunctionAction(QObject * parent, const QString & title);
     void printResult(const QString & message);
+    void printResult(const Complex & result);
     void printError(const QString & message);
+    void printToHistory(int type, const QString & message);
+    void findInHistory(const QString & str, int from);
+    void setBusy(bool busy);
+    void cancelPreview();
+    void showPreview();
+    void evaluationFinished(const EvaluationPointer & evaluation);
+    void provisionalResultReady(const EvaluationPointer & evaluation);
 
 protected:
     // Overriden events
@@ -108,12 +153,24 @@ protected:
 private slots:
     void updateVariablesList();
     void onExpressionEntered();
-    void onVariableClicked(QListWidgetItem * item);
+    void onEvaluationFinished();
+    void onProvisionalResult();
+    void onCancelEvaluation();
+    void onInputChanged();
+    void onPreview();
+    void onHistoryCopy();
+    void onHistoryExpand(const QModelIndex & index);
+    void onHistoryFind();
+    void onHistoryFindNext();
+    void onHistoryLimit();
+    void onVariableClicked(const QModelIndex & index);
     void onHelpReadme();
     void onHelpAbout();
     void onHelpWebSite();
     void onHelpReportIssue();
     void onDeleteAllVariables();
+    void onPlot();
+    void onPlotInput();
     void onFunction(const QString & function);
     void onUnitConversion(const QString & conversion);
     void onSettingsRadians();
@@ -121,6 +178,8 @@ private slots:
     void onSettingsGradians();
     void onSettingsOutput();
     void onSettingsVariables(bool active);
+    void onSettingsPreview(bool active);
+    void onSettingsPlot(bool active);
     void onSettingsMinimizeToTray(bool active);
     void onSettingsCloseToTray(bool active);
 #if defined(MAXCALC_SINGLE_INSTANCE_MODE)
@@ -0,0 +1,422 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// MaxCalcEngine
+#include "thread.h"
+#include "exceptions.h"
+// Local
+#include "plotwidget.h"
+#include "mainwindow.h"
+// STL
+#include <algorithm>
+#include <cmath>
+// Qt
+#include <QPainter>
+#include <QPolygonF>
+#include <QTimer>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+/// Name of variable of plotted expressions
+static const tchar * variableName = _T("x");
+/// Default range of x
+static const double defaultRange = 10;
+/// Delay of sampling after the last change of view in milliseconds
+static const int resampleDelay = 100;
+/// Zoom factor of one step of mouse wheel
+static const double zoomStep = 1.25;
+/// Margin of fitted y range (relative to its size)
+static const double fitMargin = 0.1;
+
+/*!
+    \class PlotWidget
+    \brief Plots graph of an expression in one variable (x).
+
+    Expression is checked and sampled by FunctionSampler in a background
+    thread, so even an expensive expression doesn't block the UI; errors
+    and points are passed to the UI thread by a queued signal. The graph
+    is repainted after each pass of sampling, so a rough graph is
+    shown at once and refined later. The view is dragged by mouse and
+    zoomed by mouse wheel; points sampled for the previous view are shown
+    while the new view is sampled, so the widget stays responsive. Double
+    click restores the default view.
+
+    \ingroup MaxCalcGui
+*/
+
+// Thread which samples expression for the current view
+class PlotWidget::SamplingThread : public Thread
+{
+public:
+    SamplingThread(PlotWidget * widget)
+        : mWidget(widget), mSampler(0), mFrom(0), mTo(0), mResolution(0) { }
+    ~SamplingThread() { delete mSampler; }
+
+    // Sets expression sampled in a copy of context; the thread must be stopped
+    void setExpression(const tstring & expr, const ParserContext & context)
+    {
+        delete mSampler;
+        mSampler = 0;
+        mExpression = expr;
+        mContext = context;
+    }
+
+    void setRange(double from, double to, int resolution)
+    {
+        mFrom = from;
+        mTo = to;
+        mResolution = resolution;
+    }
+
+protected:
+    void run()
+    {
+        // Sampler evaluates the expression to check it, so it's created here
+        if (mSampler == 0) {
+            try {
+                mSampler = new FunctionSampler(mExpression, variableName, mContext);
+            } catch (MaxCalcException & ex) {
+                mWidget->samplingFailed(ex.toString());
+                return;
+            }
+        }
+        mSampler->sample(mFrom, mTo, mResolution, mWidget, &mWidget->mToken);
+    }
+
+private:
+    PlotWidget * mWidget;
+    FunctionSampler * mSampler;
+    tstring mExpression;
+    ParserContext mContext;
+    double mFrom;
+    double mTo;
+    int mResolution;
+};
+
+/*!
+    Constructs a new empty plot.
+*/
+PlotWidget::PlotWidget(QWidget * parent) : QWidget(parent),
+    mHasSampledPoints(false), mAutoScale(true), mDragging(false)
+{
+    mThread = new SamplingThread(this);
+    resetView();
+
+    mResampleTimer = new QTimer(this);
+    mResampleTimer->setSingleShot(true);
+    mResampleTimer->setInterval(resampleDelay);
+
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setCursor(Qt::OpenHandCursor);
+
+    connect(mResampleTimer, SIGNAL(timeout()), this, SLOT(resample()));
+    connect(this, SIGNAL(pointsReady()), this, SLOT(onPointsReady()),
+        Qt::QueuedConnection);
+}
+
+/*!
+    Stops sampling and destroys the plot.
+*/
+PlotWidget::~PlotWidget()
+{
+    stopSampling();
+    delete mThread;
+}
+
+/*!
+    Plots \a expression as a function of x; variables and settings are
+    taken from a copy of \a context. Empty expression clears the plot;
+    invalid one is replaced by error message when sampling finds the error.
+*/
+void PlotWidget::plot(const QString & expression, const ParserContext & context)
+{
+    stopSampling();
+    mPoints.clear();
+    mError = QString();
+    mExpression = expression.trimmed();
+    mThread->setExpression(MainWindow::fromQString(mExpression), context);
+
+    if (!mExpression.isEmpty()) {
+        mAutoScale = true;
+        resample();
+    }
+    update();
+}
+
+/*!
+    Cancels sampling and waits for the sampling thread.
+*/
+void PlotWidget::stopSampling()
+{
+    mResampleTimer->stop();
+    mToken.cancel();
+    mThread->wait();
+    mToken.reset();
+
+    MutexLocker locker(mMutex);
+    mHasSampledPoints = false;
+    mSampledError.clear();
+}
+
+/*!
+    Restarts sampling of visible range.
+*/
+void PlotWidget::resample()
+{
+    if (mExpression.isEmpty() || !mError.isEmpty() || width() < 1) return;
+    stopSampling();
+    mThread->setRange(mXMin, mXMax, width());
+    mThread->start();
+}
+
+/*!
+    Resamples plot when view stops changing.
+*/
+void PlotWidget::scheduleResample()
+{
+    if (!mExpression.isEmpty() && mError.isEmpty()) mResampleTimer->start();
+}
+
+/*!
+    Sets default range of x and fits y range to the graph.
+*/
+void PlotWidget::resetView()
+{
+    mXMin = -defaultRange;
+    mXMax = defaultRange;
+    mYMin = -defaultRange;
+    mYMax = defaultRange;
+    mAutoScale = true;
+    fitY();
+}
+
+/*!
+    Fits y range to the middle 90% of values of visible points, so poles
+    don't flatten the graph.
+*/
+void PlotWidget::fitY()
+{
+    std::vector<double> values;
+    for (size_t i = 0; i < mPoints.size(); ++i) {
+        const FunctionSampler::Point & point = mPoints[i];
+        if (point.defined && point.x >= mXMin && point.x <= mXMax) {
+            values.push_back(point.y);
+        }
+    }
+    if (values.empty()) return;
+
+    std::sort(values.begin(), values.end());
+    size_t low = values.size() / 20;
+    double min = values[low];
+    double max = values[values.size() - 1 - low];
+    double margin = (max - min) * fitMargin;
+    if (margin == 0) margin = (min == 0) ? 1 : std::fabs(min) * fitMargin;
+    mYMin = min - margin;
+    mYMax = max + margin;
+}
+
+/*!
+    Called in the sampling thread after each pass; stores \a points and
+    passes them to the UI thread by a queued signal.
+*/
+void PlotWidget::pointsSampled(const std::vector<FunctionSampler::Point> & points,
+                               bool /*finished*/)
+{
+    {
+        MutexLocker locker(mMutex);
+        mSampledPoints = points;
+        mHasSampledPoints = true;
+    }
+    emit pointsReady();
+}
+
+/*!
+    Called in the sampling thread if the expression is invalid; passes
+    error \a message to the UI thread like sampled points.
+*/
+void PlotWidget::samplingFailed(const tstring & message)
+{
+    {
+        MutexLocker locker(mMutex);
+        mSampledPoints.clear();
+        mSampledError = message;
+        mHasSampledPoints = true;
+    }
+    emit pointsReady();
+}
+
+/*!
+    Shows points of the last pass of sampling or error of the expression.
+*/
+void PlotWidget::onPointsReady()
+{
+    tstring error;
+    {
+        MutexLocker locker(mMutex);
+        if (!mHasSampledPoints) return;
+        mPoints.swap(mSampledPoints);
+        error.swap(mSampledError);
+        mHasSampledPoints = false;
+    }
+    if (!error.empty()) {
+        mError = MainWindow::toQString(error);
+    } else if (mAutoScale) {
+        fitY();
+    }
+    update();
+}
+
+/*!
+    Converts point of the graph to widget coordinates.
+*/
+QPointF PlotWidget::toScreen(double x, double y) const
+{
+    double sx = (x - mXMin) / (mXMax - mXMin) * width();
+    double sy = height() - (y - mYMin) / (mYMax - mYMin) * height();
+    // Points far outside the widget are moved closer to keep coordinates small
+    sy = std::max(-10.0 * height(), std::min(11.0 * height(), sy));
+    return QPointF(sx, sy);
+}
+
+/*!
+    Paints axes, visible range and the graph (or error message).
+*/
+void PlotWidget::paintEvent(QPaintEvent * /*event*/)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    if (!mError.isEmpty()) {
+        painter.setPen(Qt::red);
+        painter.drawText(rect(), Qt::AlignCenter | Qt::TextWordWrap, mError);
+        return;
+    }
+
+    // Axes
+    painter.setPen(Qt::gray);
+    QPointF origin = toScreen(0, 0);
+    if (mXMin < 0 && mXMax > 0) {
+        painter.drawLine(QPointF(origin.x(), 0), QPointF(origin.x(), height()));
+    }
+    if (mYMin < 0 && mYMax > 0) {
+        painter.drawLine(QPointF(0, origin.y()), QPointF(width(), origin.y()));
+    }
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+        tr("x: %1 .. %2, y: %3 .. %4").arg(mXMin, 0, 'g', 6).arg(mXMax, 0, 'g', 6)
+            .arg(mYMin, 0, 'g', 6).arg(mYMax, 0, 'g', 6));
+
+    // Graph is split at undefined points and at jumps higher than the view
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::blue, 1.5));
+    QPolygonF line;
+    for (size_t i = 0; i < mPoints.size(); ++i) {
+        const FunctionSampler::Point & point = mPoints[i];
+        if (!point.defined) {
+            if (line.size() > 1) painter.drawPolyline(line);
+            line.clear();
+            continue;
+        }
+        QPointF screen = toScreen(point.x, point.y);
+        if (!line.isEmpty() && std::fabs(screen.y() - line.last().y()) > height()) {
+            if (line.size() > 1) painter.drawPolyline(line);
+            line.clear();
+        }
+        line << screen;
+    }
+    if (line.size() > 1) painter.drawPolyline(line);
+}
+
+/*!
+    Resamples graph for the new width.
+*/
+void PlotWidget::resizeEvent(QResizeEvent * /*event*/)
+{
+    scheduleResample();
+}
+
+/*!
+    Starts dragging of the view.
+*/
+void PlotWidget::mousePressEvent(QMouseEvent * event)
+{
+    if (event->button() != Qt::LeftButton) return;
+    mDragging = true;
+    mDragPosition = event->pos();
+    setCursor(Qt::ClosedHandCursor);
+}
+
+/*!
+    Moves the view with mouse.
+*/
+void PlotWidget::mouseMoveEvent(QMouseEvent * event)
+{
+    if (!mDragging || width() < 1 || height() < 1) return;
+    QPoint delta = event->pos() - mDragPosition;
+    mDragPosition = event->pos();
+
+    double dx = delta.x() * (mXMax - mXMin) / width();
+    double dy = delta.y() * (mYMax - mYMin) / height();
+    mXMin -= dx;
+    mXMax -= dx;
+    mYMin += dy;
+    mYMax += dy;
+    mAutoScale = false;
+    update();
+    scheduleResample();
+}
+
+/*!
+    Stops dragging of the view.
+*/
+void PlotWidget::mouseReleaseEvent(QMouseEvent * event)
+{
+    if (event->button() != Qt::LeftButton) return;
+    mDragging = false;
+    setCursor(Qt::OpenHandCursor);
+}
+
+/*!
+    Restores the default view.
+*/
+void PlotWidget::mouseDoubleClickEvent(QMouseEvent * /*event*/)
+{
+    resetView();
+    update();
+    scheduleResample();
+}
+
+/*!
+    Zooms the view around mouse cursor.
+*/
+void PlotWidget::wheelEvent(QWheelEvent * event)
+{
+    if (width() < 1 || height() < 1) return;
+    double factor = std::pow(zoomStep, -event->delta() / 120.0);
+    double x = mXMin + (mXMax - mXMin) * event->pos().x() / width();
+    double y = mYMax - (mYMax - mYMin) * event->pos().y() / height();
+
+    mXMin = x + (mXMin - x) * factor;
+    mXMax = x + (mXMax - x) * factor;
+    mYMin = y + (mYMin - y) * factor;
+    mYMax = y + (mYMax - y) * factor;
+    mAutoScale = false;
+    event->accept();
+    update();
+    scheduleResample();
+}
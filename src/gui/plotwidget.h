@@ -0,0 +1,97 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef PLOTWIDGET_H
+#define PLOTWIDGET_H
+
+// MaxCalcEngine
+#include "functionsampler.h"
+#include "operationbudget.h"
+#include "mutex.h"
+// STL
+#include <vector>
+// Qt
+#include <QWidget>
+#include <QString>
+#include <QPoint>
+#include <QPointF>
+
+class QTimer;
+
+class PlotWidget : public QWidget, private FunctionSampler::Callback
+{
+    Q_OBJECT
+
+public:
+    PlotWidget(QWidget * parent = 0);
+    ~PlotWidget();
+
+    void plot(const QString & expression, const ParserContext & context);
+
+    /// Returns plotted expression.
+    QString expression() const { return mExpression; }
+
+signals:
+    /// Emitted in the sampling thread when new points are sampled or an error is found.
+    void pointsReady();
+
+protected:
+    // Overriden events
+    void paintEvent(QPaintEvent * event);
+    void resizeEvent(QResizeEvent * event);
+    void mousePressEvent(QMouseEvent * event);
+    void mouseMoveEvent(QMouseEvent * event);
+    void mouseReleaseEvent(QMouseEvent * event);
+    void mouseDoubleClickEvent(QMouseEvent * event);
+    void wheelEvent(QWheelEvent * event);
+
+private slots:
+    void onPointsReady();
+    void resample();
+
+private:
+    class SamplingThread;
+
+    QString mExpression;                ///< Plotted expression.
+    QString mError;                     ///< Error message shown instead of graph.
+    SamplingThread * mThread;           ///< Thread running the sampler.
+    CancellationToken mToken;           ///< Stops sampling.
+    QTimer * mResampleTimer;            ///< Delays sampling while view is changed.
+
+    Mutex mMutex;                       ///< Protects sampled points.
+    std::vector<FunctionSampler::Point> mSampledPoints;   ///< Points of the last pass.
+    tstring mSampledError;              ///< Error found by sampling thread.
+    bool mHasSampledPoints;             ///< True if points or error are not shown yet.
+
+    std::vector<FunctionSampler::Point> mPoints;    ///< Shown points.
+    double mXMin, mXMax, mYMin, mYMax;  ///< Visible range.
+    bool mAutoScale;                    ///< True if y range is fitted to the graph.
+    QPoint mDragPosition;               ///< Last mouse position while dragging.
+    bool mDragging;                     ///< True if view is being dragged.
+
+    void stopSampling();
+    void scheduleResample();
+    void resetView();
+    void fitY();
+    QPointF toScreen(double x, double y) const;
+    void pointsSampled(const std::vector<FunctionSampler::Point> & points, bool finished);
+    void samplingFailed(const tstring & message);
+};
+
+#endif // PLOTWIDGET_H
@@ -0,0 +1,186 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// MaxCalcEngine
+#include "bigdecimal.h"
+// Local
+#include "variablesmodel.h"
+#include "mainwindow.h"
+
+/*!
+    \class VariablesModel
+    \brief List of constants, result and variables shown in variables dock.
+
+    The list contains 'e' and 'pi' constants, 'res' (if there is a result)
+    and variables in alphabetical order. update() compares it with versions
+    of result and variables in the context (see Variables::version()) and
+    does nothing if they are not changed. Otherwise it walks through all
+    variables (O(n)), but formats values and signals changes only for rows
+    of added, removed or changed variables, which are the expensive part
+    of updating the list after a calculation.
+
+    \ingroup MaxCalcGui
+*/
+
+/*!
+    Constructs an empty list; it is filled by update().
+*/
+VariablesModel::VariablesModel(QObject * parent) : QAbstractListModel(parent),
+    mFormatted(false), mResultShown(false), mResultVersion(0), mVariablesVersion(0)
+{
+}
+
+/*!
+    Returns number of rows.
+*/
+int VariablesModel::rowCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : mRows.size();
+}
+
+/*!
+    Returns "name = value" text of row for display role and name for NameRole.
+*/
+QVariant VariablesModel::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || index.row() >= mRows.size()) return QVariant();
+    if (role == Qt::DisplayRole) return mRows[index.row()].text;
+    if (role == NameRole) return mRows[index.row()].name;
+    return QVariant();
+}
+
+/*!
+    Updates list from result and variables of \a context.
+*/
+void VariablesModel::update(ParserContext & context)
+{
+    bool formatChanged = !mFormatted || context.numberFormat() != mFormat;
+    if (formatChanged) {
+        mFormat = context.numberFormat();
+        mFormatted = true;
+    }
+
+    // Constants
+    if (mRows.isEmpty()) {
+        beginInsertRows(QModelIndex(), 0, 1);
+        mRows.append(newRow(_T("e"), BigDecimal::E.toTString(mFormat)));
+        mRows.append(newRow(_T("pi"), BigDecimal::PI.toTString(mFormat)));
+        endInsertRows();
+    } else if (formatChanged) {
+        mRows[0] = newRow(_T("e"), BigDecimal::E.toTString(mFormat));
+        mRows[1] = newRow(_T("pi"), BigDecimal::PI.toTString(mFormat));
+        emit dataChanged(index(0), index(1));
+    }
+
+    // Result
+    if (context.resultExists()) {
+        if (!mResultShown) {
+            beginInsertRows(QModelIndex(), 2, 2);
+            mRows.insert(2, newRow(_T("res"), context.result().toTString(mFormat)));
+            mResultShown = true;
+            endInsertRows();
+        } else if (formatChanged || context.resultVersion() != mResultVersion) {
+            mRows[2] = newRow(_T("res"), context.result().toTString(mFormat));
+            emit dataChanged(index(2), index(2));
+        }
+        mResultVersion = context.resultVersion();
+    } else if (mResultShown) {
+        beginRemoveRows(QModelIndex(), 2, 2);
+        mRows.remove(2);
+        mResultShown = false;
+        endRemoveRows();
+    }
+
+    updateVariables(context.variables(), formatChanged);
+}
+
+/*!
+    Updates rows of variables from \a vars. Variables and rows are both
+    sorted by lowercase names, so they are merged in one pass.
+*/
+void VariablesModel::updateVariables(Variables & vars, bool formatChanged)
+{
+    if (!formatChanged && vars.version() == mVariablesVersion) return;
+    mVariablesVersion = vars.version();
+
+    Variables::const_iterator iter;
+    int row = firstVariableRow();
+
+    // All variables are new (e.g. list is shown for the first time)
+    if (row == mRows.size()) {
+        QVector<Row> rows;
+        for (iter = vars.begin(); iter != vars.end(); ++iter) {
+            rows.append(newRow(iter->name, iter->value.toTString(mFormat),
+                iter.lowerName(), iter.version()));
+        }
+        if (!rows.isEmpty()) {
+            beginInsertRows(QModelIndex(), row, row + rows.size() - 1);
+            mRows += rows;
+            endInsertRows();
+        }
+        return;
+    }
+
+    for (iter = vars.begin(); iter != vars.end(); ++iter, ++row) {
+        const tstring & key = iter.lowerName();
+
+        // Variables before current one were removed
+        int removed = row;
+        while (removed < mRows.size() && mRows[removed].key < key) ++removed;
+        if (removed > row) {
+            beginRemoveRows(QModelIndex(), row, removed - 1);
+            mRows.remove(row, removed - row);
+            endRemoveRows();
+        }
+
+        if (row < mRows.size() && mRows[row].key == key) {
+            if (formatChanged || mRows[row].version != iter.version()) {
+                mRows[row] = newRow(iter->name, iter->value.toTString(mFormat),
+                    key, iter.version());
+                emit dataChanged(index(row), index(row));
+            }
+        } else {
+            beginInsertRows(QModelIndex(), row, row);
+            mRows.insert(row, newRow(iter->name, iter->value.toTString(mFormat),
+                key, iter.version()));
+            endInsertRows();
+        }
+    }
+
+    if (row < mRows.size()) {
+        beginRemoveRows(QModelIndex(), row, mRows.size() - 1);
+        mRows.resize(row);
+        endRemoveRows();
+    }
+}
+
+/*!
+    Returns row for variable \a name with formatted \a value, lowercase
+    name \a key and \a version.
+*/
+VariablesModel::Row VariablesModel::newRow(const tstring & name,
+    const tstring & value, const tstring & key, long version) const
+{
+    Row row;
+    row.key = key;
+    row.version = version;
+    row.name = MainWindow::toQString(name);
+    row.text = row.name + " = " + MainWindow::toQString(value);
+    return row;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef VARIABLESMODEL_H
+#define VARIABLESMODEL_H
+
+// MaxCalcEngine
+#include "parsercontext.h"
+// Qt
+#include <QAbstractListModel>
+#include <QString>
+#include <QVector>
+
+class VariablesModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /// Role which returns name of variable.
+    enum Roles { NameRole = Qt::UserRole };
+
+    VariablesModel(QObject * parent = 0);
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    void update(ParserContext & context);
+
+private:
+    /// Row of the list.
+    struct Row
+    {
+        tstring key;        ///< Lowercase name of variable (rows are sorted by it).
+        long version;       ///< Version of shown value of variable.
+        QString name;       ///< Name of variable.
+        QString text;       ///< Formatted name and value.
+    };
+
+    QVector<Row> mRows;             ///< Constants, result and variables.
+    ComplexFormat mFormat;          ///< Format of shown values.
+    bool mFormatted;                ///< True if rows were formatted.
+    bool mResultShown;              ///< True if there is 'res' row.
+    unsigned long mResultVersion;   ///< Version of shown result.
+    long mVariablesVersion;         ///< Version of shown variables.
+
+    /// Returns the first row of variables.
+    int firstVariableRow() const { return mResultShown ? 3 : 2; }
+    Row newRow(const tstring & name, const tstring & value, const tstring & key = tstring(),
+        long version = 0) const;
+    void updateVariables(Variables & vars, bool formatChanged);
+};
+
+#endif // VARIABLESMODEL_H
@@ -5,6 +5,11 @@
 # To build gui end test projects, unicode must be enabled.
 CONFIG += maxcalc_unicode
 
+# UTF-8 engine mode (requires Unicode support).
+# Engine keeps expressions, names and formatted numbers in UTF-8 encoded
+# narrow strings; only GUI converts them to wide strings.
+#CONFIG += maxcalc_utf8
+
 # GetText support.
 # This enables localization.
 #CONFIG += maxcalc_gettext
@@ -14,3 +19,8 @@ CONFIG += maxcalc_unicode
 # Non-portable version stores settings in data directory in user's folder.
 #CONFIG += maxcalc_portable
 
+# Wide decNumber units.
+# Long multiplications process 18-digit units with 128-bit intermediates
+# instead of 9-digit units with 64-bit ones.
+# Ignored if the compiler has no 128-bit integer type.
+CONFIG += maxcalc_wide_units
@@ -24,8 +24,10 @@
 // MaxCalcEngine
 #include "bigdecimal.h"
 #include "exceptions.h"
+#include "decNumber/decDigits.h"
 // STL
 #include <string>
+#include <cmath>
 
 
 void BigDecimalTest::bigDecimalFormatDefault()
@@ -300,6 +302,68 @@ void BigDecimalTest::toUInt()
     COMPARE(dec.toUInt(), 100u);
 }
 
+void BigDecimalTest::toDouble()
+{
+    COMPARE(BigDecimal(0).toDouble(), 0.0);
+    COMPARE(BigDecimal("-2.5").toDouble(), -2.5);
+    COMPARE(BigDecimal("1E+300").toDouble(), 1E+300);
+    COMPARE(BigDecimal("1E+1000").toDouble(), HUGE_VAL);
+    COMPARE(BigDecimal("-1E+1000").toDouble(), -HUGE_VAL);
+    COMPARE(BigDecimal("1E-1000").toDouble(), 0.0);
+
+    COMPARE(BigDecimal(0).adjustedExponent(), 0);
+    COMPARE(BigDecimal("123.4").adjustedExponent(), 2);
+    COMPARE(BigDecimal("-0.05").adjustedExponent(), -2);
+    COMPARE(BigDecimal("1E+1000").adjustedExponent(), 1000);
+}
+
+void BigDecimalTest::pack()
+{
+    const BigDecimal numbers[] = { 0, 1, -123456789, BigDecimal(1) / 3,
+        BigDecimal(-2) / 3, BigDecimal::PI, "1.5E-300", "-7E+999", "0.000",
+        "1234567890123456789012345678901234567890" };
+    unsigned char buffer[BigDecimal::MAX_PACKED_SIZE];
+
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++i) {
+        size_t size = numbers[i].pack(buffer);
+        VERIFY(size <= BigDecimal::MAX_PACKED_SIZE);
+        COMPARE(BigDecimal::packedSize(buffer, size), size);
+        COMPARE(BigDecimal::packedSize(buffer, size - 1), size_t(0));
+
+        size_t read = 0;
+        BigDecimal unpacked = BigDecimal::unpack(buffer, &read);
+        COMPARE(read, size);
+        VERIFY(unpacked == numbers[i]);
+        COMPARE(unpacked.toString(BigDecimalFormat(50)),
+            numbers[i].toString(BigDecimalFormat(50)));
+    }
+
+    // Two digits per byte
+    COMPARE(BigDecimal("1234567890").pack(buffer), size_t(7 + 5));
+
+    // Invalid digits and headers
+    BigDecimal(12).pack(buffer);
+    buffer[7] = 0x1A;
+    COMPARE(BigDecimal::packedSize(buffer, sizeof(buffer)), size_t(0));
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(0x1A)", ArithmeticException);
+    buffer[7] = 0x02;
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(leading zero)", ArithmeticException);
+    BigDecimal(123).pack(buffer);
+    buffer[8] = 0x31;
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(padding)", ArithmeticException);
+    buffer[8] = 0x30;
+    buffer[1] = buffer[2] = buffer[3] = 0xFF;
+    buffer[4] = 0x7F;
+    COMPARE(BigDecimal::packedSize(buffer, sizeof(buffer)), size_t(0));
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(huge exponent)", ArithmeticException);
+    buffer[4] = 0x80;
+    buffer[1] = buffer[2] = buffer[3] = 0;
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(tiny exponent)", ArithmeticException);
+    buffer[5] = 0;
+    COMPARE(BigDecimal::packedSize(buffer, sizeof(buffer)), size_t(0));
+    FAIL_TEST(BigDecimal::unpack(buffer), "unpack(0 digits)", ArithmeticException);
+}
+
 void BigDecimalTest::unaryOperators()
 {
     BigDecimal dec(10);
@@ -415,6 +479,188 @@ void BigDecimalTest::comparisonOperators()
     COMPARE(dec1 < dec2, false);
 }
 
+void BigDecimalTest::fusedOperators()
+{
+    BigDecimal a = BigDecimal(1) + BigDecimal("1E-100");
+    BigDecimal b = BigDecimal(1) - BigDecimal("1E-100");
+    BigDecimal one = 1;
+
+    // Products must be rounded only once together with the sum
+    VERIFY(a * b - 1 == BigDecimal("-1E-200"));
+    VERIFY(-1 + a * b == BigDecimal("-1E-200"));
+    VERIFY(BigDecimal(1) - a * b == BigDecimal("1E-200"));
+    VERIFY(a * b - one * one == BigDecimal("-1E-200"));
+    VERIFY(one * one - a * b == BigDecimal("1E-200"));
+    VERIFY(BigDecimal::sumOfProducts(a * b, -(one * one)) == BigDecimal("-1E-200"));
+    VERIFY(BigDecimal::sumOfProducts(a * b, one * one, -2) == BigDecimal("-1E-200"));
+
+    BigDecimal x = -1;
+    x += a * b;
+    VERIFY(x == BigDecimal("-1E-200"));
+    x = 1;
+    x -= a * b;
+    VERIFY(x == BigDecimal("1E-200"));
+
+    // Products without following addition
+    VERIFY(BigDecimal(BigDecimal(2) * 3) == 6);
+    VERIFY(BigDecimal(-(BigDecimal(2) * 3)) == -6);
+    VERIFY(BigDecimal(2) * 3 * 4 == 24);
+    VERIFY(BigDecimal(2) * 3 / 4 == BigDecimal("1.5"));
+    VERIFY(BigDecimal(2) * 3 % 4 == 2);
+
+    // Product of temporaries may be calculated after they are destroyed
+    BigDecimalProduct product = BigDecimal("1.5") * BigDecimal(4);
+    BigDecimal other = BigDecimal("123.25") * BigDecimal(8);
+    VERIFY(BigDecimal(product) == 6);
+    VERIFY(product + other == 992);
+
+    // Compound assignments return references
+    x = 1;
+    (x += 1) += 1;
+    VERIFY(x == 3);
+    (x *= 2) -= 1;
+    VERIFY(x == 5);
+    ++(++x);
+    VERIFY(x == 7);
+}
+
+// decNumber with enough space for products of 1000-digit numbers
+// (BigDecimal is limited to WORKING_PRECISION digits)
+struct LongDecNumber
+{
+    decNumber number;
+    decNumberUnit extraUnits[2000 / DECDPUN + 1];
+};
+
+// Creates context for exact calculations with numbers of given length
+static decContext longContext(int digits)
+{
+    decContext context;
+    decContextDefault(&context, DEC_INIT_BASE);
+    context.digits = 2 * digits + 2;
+    context.traps = 0;
+    return context;
+}
+
+// Fills num with a number of given length and digit pattern
+static std::string makeLongNumber(LongDecNumber & num, int digits, int seed,
+                                  decContext & context)
+{
+    std::string str;
+    for (int i = 0; i < digits; ++i) {
+        str += (char)('0' + (i * 7 + seed) % 10);
+    }
+    str[0] = (char)('1' + seed % 9);
+    decNumberFromString(&num.number, str.c_str(), &context);
+    return str;
+}
+
+void BigDecimalTest::longMultiplication()
+{
+    // Products of long operands are compared with sums of partial products
+    // with short (up to 18 digits) multipliers; both paths must be exact
+    const int lengths[] = { 19, 34, 35, 55, 64, 100, 136, 137, 500, 1000 };
+
+    for (unsigned n = 0; n < sizeof(lengths) / sizeof(lengths[0]); ++n) {
+        for (int seed = 1; seed < 4; ++seed) {
+            int rhsDigits = lengths[n] - seed;
+            decContext context = longContext(lengths[n]);
+            LongDecNumber lhs, rhs, result, expected, part, piece;
+
+            makeLongNumber(lhs, lengths[n], seed, context);
+            std::string rhsStr = makeLongNumber(rhs, rhsDigits, seed + 3, context);
+            if (seed == 2) {
+                decNumberMinus(&lhs.number, &lhs.number, &context);
+            }
+
+            decNumberMultiply(&result.number, &lhs.number, &rhs.number, &context);
+
+            decNumberZero(&expected.number);
+            for (int end = rhsDigits; end > 0; end -= 16) {
+                int begin = end > 16 ? end - 16 : 0;
+                decNumberFromString(&piece.number,
+                    rhsStr.substr(begin, end - begin).c_str(), &context);
+                piece.number.exponent = rhsDigits - end;
+                decNumberMultiply(&part.number, &lhs.number, &piece.number, &context);
+                decNumberAdd(&expected.number, &expected.number, &part.number, &context);
+            }
+
+            VERIFY(!(context.status & DEC_Errors));
+            VERIFY(!(context.status & DEC_Inexact));
+            decNumberCompareTotal(&part.number, &result.number, &expected.number, &context);
+            VERIFY(decNumberIsZero(&part.number));
+        }
+    }
+
+    // The same through BigDecimal
+    BigDecimal a("-98765432109876543210987654321098765432109876543210987654321");
+    BigDecimal b("12345678901234567890123456789012345678901234567890.1234567891");
+    BigDecimal expected = a * BigDecimal("0.1234567891");
+    BigDecimal shift = 1;
+    for (int i = 0; i < 5; ++i) {
+        expected += a * (BigDecimal(1234567890) * shift);
+        shift *= BigDecimal("1E10");
+    }
+    VERIFY(BigDecimal(a * b) == expected);
+}
+
+void BigDecimalTest::digitBlocks()
+{
+    // Every code level supported by the processor must give the same results
+    for (int level = DECDIGITS_SCALAR; level <= decDigitsSupported(); ++level) {
+        COMPARE(decDigitsSelect(level), level);
+
+        COMPARE(decDigitsSpan(""), 0);
+        COMPARE(decDigitsSpan("x0123"), 0);
+        COMPARE(decDigitsSpan("0123456789/:"), 10);
+
+        for (int length = 1; length <= 140; ++length) {
+            decContext context = longContext(length);
+            LongDecNumber num;
+            std::string digits;
+            for (int i = 0; i < length; ++i) {
+                digits += (char)('0' + (i * 7 + length) % 10);
+            }
+            digits[0] = (char)('1' + length % 9);
+
+            std::string expected = digits + "E+5";
+            COMPARE(decDigitsSpan(expected.c_str()), length);
+            COMPARE(decDigitsSpan(expected.c_str() + length / 2), length - length / 2);
+
+            // Integers, numbers with '.' at every position and negative
+            // numbers must survive the round trip unchanged
+            for (int dot = 0; dot <= length; ++dot) {
+                expected = digits;
+                if (dot < length) {
+                    expected.insert(dot, dot == 0 ? "0." : ".");
+                }
+                if (dot % 3 == 1) {
+                    expected.insert(0, "-");
+                }
+                std::string actual(expected.size() + 14, '\0');
+                decNumberFromString(&num.number, expected.c_str(), &context);
+                decNumberToString(&num.number, &actual[0], 0);
+                COMPARE(std::string(actual.c_str()), expected);
+            }
+
+            // Leading zeros and exponents
+            expected = "0.000" + digits;
+            std::string actual(expected.size() + 14, '\0');
+            decNumberFromString(&num.number, ("-00" + expected.substr(1)).c_str(), &context);
+            decNumberToString(&num.number, &actual[0], 0);
+            COMPARE(std::string(actual.c_str()), "-" + expected);
+            decNumberFromString(&num.number, (digits + "E+7").c_str(), &context);
+            decNumberToString(&num.number, &actual[0], 1);
+            COMPARE(std::string(actual.c_str()),
+                digits.substr(0, 1) + (length > 1 ? "." : "") + digits.substr(1) +
+                "E+" + BigDecimal(length + 6).toString());
+            VERIFY(!(context.status & DEC_Errors));
+        }
+    }
+
+    decDigitsSelect(DECDIGITS_AVX2);
+}
+
 void BigDecimalTest::round()
 {
     COMPARE_BIGDECIMAL(BigDecimal(0).round(), BigDecimal(0));
@@ -896,3 +1142,96 @@ void BigDecimalTest::consts()
     COMPARE_BIGDECIMAL(BigDecimal::E,
         BigDecimal("2.7182818284590452353602874713526624977572470936999595749669676277240766303535475945713821785251664274274663919320030599218174136"));
 }
+
+void BigDecimalTest::workingPrecision()
+{
+    BigDecimal full = BigDecimal::sin(1);
+    BigDecimal third = BigDecimal(1) / 3;
+    {
+        WorkingPrecision precision(20);
+        COMPARE(WorkingPrecision::digits(), 20);
+        COMPARE(BigDecimal(BigDecimal(1) / 3).toString(BigDecimalFormat(50)),
+            std::string("0.33333333333333333333"));
+        COMPARE_BIGDECIMAL_PRECISION(BigDecimal::sin(1), full, 18);
+        COMPARE_BIGDECIMAL_PRECISION(BigDecimal::arctan(1) * 4, BigDecimal::PI, 18);
+        {
+            // Precision of nested object is used
+            WorkingPrecision nested(0);
+            COMPARE(WorkingPrecision::digits(), Constants::WORKING_PRECISION);
+        }
+        COMPARE(WorkingPrecision::digits(), 20);
+    }
+    COMPARE(WorkingPrecision::digits(), Constants::WORKING_PRECISION);
+    COMPARE_BIGDECIMAL(BigDecimal(1) / 3, third);
+}
+
+// Measures multiplication of two numbers with given number of digits
+static void benchmarkMultiplication(int digits)
+{
+    decContext context = longContext(digits);
+    LongDecNumber lhs, rhs, result;
+    makeLongNumber(lhs, digits, 1, context);
+    makeLongNumber(rhs, digits, 2, context);
+
+    BENCHMARK(decNumberMultiply(&result.number, &lhs.number, &rhs.number, &context));
+
+    VERIFY(!(context.status & DEC_Errors));
+}
+
+void BigDecimalTest::multiplication34Benchmark()
+{
+    benchmarkMultiplication(34);
+}
+
+void BigDecimalTest::multiplication136Benchmark()
+{
+    benchmarkMultiplication(136);
+}
+
+void BigDecimalTest::multiplication1000Benchmark()
+{
+    benchmarkMultiplication(1000);
+}
+
+void BigDecimalTest::fromStringBenchmark()
+{
+    decContext context = longContext(1000);
+    LongDecNumber num;
+    std::string str = makeLongNumber(num, 1000, 1, context);
+    str.insert(500, ".");
+
+    BENCHMARK(decNumberFromString(&num.number, str.c_str(), &context));
+
+    VERIFY(!(context.status & DEC_Errors));
+}
+
+void BigDecimalTest::toStringBenchmark()
+{
+    decContext context = longContext(1000);
+    LongDecNumber num;
+    std::string str = makeLongNumber(num, 1000, 1, context);
+    num.number.exponent = -500;
+
+    BENCHMARK(decNumberToString(&num.number, &str[0], 0));
+
+    VERIFY(!(context.status & DEC_Errors));
+}
+
+void BigDecimalTest::fromTStringBenchmark()
+{
+    tstring str = _T("-1234.567890123456789012345E-45");
+
+    BENCHMARK(BigDecimal(str));
+
+    COMPARE(BigDecimal(str).toTString(), tstring(_T("-1.234567890123456789012345E-42")));
+}
+
+void BigDecimalTest::toTStringBenchmark()
+{
+    BigDecimal num = BigDecimal(-1) / 3;
+    tstring str;
+
+    BENCHMARK(str = num.toTString());
+
+    COMPARE(str, tstring(_T("-0.3333333333333333333333333")));
+}
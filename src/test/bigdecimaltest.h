@@ -46,12 +46,17 @@ private slots:
     void toWideString();
     void toInt();
     void toUInt();
+    void toDouble();
+    void pack();
+    void digitBlocks();
 
     // Operators
     void unaryOperators();
     void binaryArithmeticOperators();
     void binaryLogicalOperators();
     void comparisonOperators();
+    void fusedOperators();
+    void longMultiplication();
 
     // Functions
     void round();
@@ -81,6 +86,16 @@ private slots:
 
     // Misc
     void consts();
+    void workingPrecision();
+
+    // Benchmarks
+    void multiplication34Benchmark();
+    void multiplication136Benchmark();
+    void multiplication1000Benchmark();
+    void fromStringBenchmark();
+    void toStringBenchmark();
+    void fromTStringBenchmark();
+    void toTStringBenchmark();
 };
 
 #endif // BIGDECIMALTEST_H
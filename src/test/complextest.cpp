@@ -26,6 +26,7 @@
 #include "constants.h"
 // STL
 #include <string>
+#include <sstream>
 
 
 void ComplexTest::complexFormatDefault()
@@ -143,6 +144,43 @@ void ComplexTest::toWideString()
     COMPARE(Complex(L"-0.512", L"-0.256").toWideString(), std::wstring(L"-0.512 - 0.256i"));
 }
 
+void ComplexTest::toBuffer()
+{
+    tchar buffer[32];
+    ComplexFormat format(25, 10, ComplexFormat::GENERAL_FORMAT,
+        ComplexFormat::LOWER_CASE_EXPONENT, ComplexFormat::COMMA_SEPARATOR,
+        ComplexFormat::IMAGINARY_ONE_J);
+
+    COMPARE(Complex().toBuffer(buffer, 32), (size_t)1);
+    COMPARE(tstring(buffer), tstring(_T("0")));
+    COMPARE(Complex("-0.512", "0.256").toBuffer(buffer, 32), (size_t)15);
+    COMPARE(tstring(buffer), tstring(_T("-0.512 + 0.256i")));
+    COMPARE(Complex("0", "-0.5").toBuffer(buffer, 32, format), (size_t)8);
+    COMPARE(tstring(buffer), tstring(_T("0 - 0,5j")));
+    COMPARE(Complex("1E+100", "-2.5E-100").toBuffer(buffer, 32, format),
+        (size_t)18);
+    COMPARE(tstring(buffer), tstring(_T("1e+100 - 2,5e-100j")));
+
+    // Truncation
+    COMPARE(Complex("0.512", "0.256").toBuffer(buffer, 8), (size_t)14);
+    COMPARE(tstring(buffer), tstring(_T("0.512 +")));
+    COMPARE(Complex("0.512", "0.256").toBuffer(buffer, 3), (size_t)14);
+    COMPARE(tstring(buffer), tstring(_T("0.")));
+    COMPARE(Complex("0.512", "0.256").toBuffer(buffer, 15), (size_t)14);
+    COMPARE(tstring(buffer), tstring(_T("0.512 + 0.256i")));
+    COMPARE(Complex("0.512", "0.256").toBuffer(buffer, 14), (size_t)14);
+    COMPARE(tstring(buffer), tstring(_T("0.512 + 0.256")));
+    COMPARE(Complex(1, 1).toBuffer(0, 0), (size_t)6);
+
+    // Stream sink
+    std::basic_ostringstream<tchar> stream;
+    Complex("123.456", "-7").toStream(stream, format);
+    stream << _T(';');
+    Complex(BigDecimal(1) / 3, 1).toStream(stream, ComplexFormat(50));
+    COMPARE(stream.str(), tstring(_T("123,456 - 7j;")) +
+        Complex(BigDecimal(1) / 3, 1).toTString(ComplexFormat(50)));
+}
+
 void ComplexTest::unaryOperators()
 {
     Complex num(1, 1);
@@ -227,6 +265,31 @@ void ComplexTest::comparisonOperators()
     VERIFY(num1 != num2);
 }
 
+void ComplexTest::compoundOperators()
+{
+    Complex a = Complex(BigDecimal(1) + BigDecimal("1E-100"), 1);
+    Complex b = Complex(BigDecimal(1) - BigDecimal("1E-100"), -1);
+
+    // Parts of the product are rounded only once
+    VERIFY(a * b == Complex(BigDecimal("2") - BigDecimal("1E-200"), BigDecimal("-2E-100")));
+
+    Complex x = a;
+    x *= b;
+    VERIFY(x == a * b);
+    x = a;
+    x *= x;
+    VERIFY(x == a * a);
+    x = a;
+    x /= x;
+    VERIFY(x == Complex(1));
+
+    x = 1;
+    (x += Complex::i) *= Complex::i;
+    VERIFY(x == Complex(-1, 1));
+    (x -= 1) /= 2;
+    VERIFY(x == Complex(-1) + Complex::i / 2);
+}
+
 void ComplexTest::isZero()
 {
     VERIFY(Complex().isZero());
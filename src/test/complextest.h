@@ -43,11 +43,13 @@ private slots:
     // Conversions
     void toString();
     void toWideString();
+    void toBuffer();
 
     // Operators
     void unaryOperators();
     void binaryOperators();
     void comparisonOperators();
+    void compoundOperators();
 
     // Misc functions
     void isZero();
@@ -0,0 +1,219 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+// Local
+#include "historymodeltest.h"
+#include "utility.h"
+// MaxCalcGui
+#include "historymodel.h"
+
+// Number of entries appended in benchmark
+static const int BENCHMARK_ENTRIES = 100000;
+
+void HistoryModelTest::ringBuffer()
+{
+    HistoryModel model;
+    model.setLimit(3);
+    COMPARE(model.rowCount(), 0);
+
+    model.append(HistoryModel::EXPRESSION_ENTRY, "1+1");
+    model.append(HistoryModel::RESULT_ENTRY, "2");
+    COMPARE(model.rowCount(), 2);
+    COMPARE(model.text(0), QString("1+1"));
+    COMPARE(model.entryType(1), HistoryModel::RESULT_ENTRY);
+
+    // The oldest entries are removed when history is full
+    model.append(HistoryModel::EXPRESSION_ENTRY, "1/0");
+    model.append(HistoryModel::ERROR_ENTRY, "Division by zero");
+    model.append(HistoryModel::EXPRESSION_ENTRY, "2+2");
+    COMPARE(model.rowCount(), 3);
+    COMPARE(model.text(0), QString("1/0"));
+    COMPARE(model.text(1), QString("Division by zero"));
+    COMPARE(model.text(2), QString("2+2"));
+    COMPARE(model.data(model.index(1)).toString(), QString("Division by zero"));
+    COMPARE(model.data(model.index(1), HistoryModel::EntryTypeRole).toInt(),
+        (int)HistoryModel::ERROR_ENTRY);
+    VERIFY(!model.data(model.index(3)).isValid());
+
+    model.clear();
+    COMPARE(model.rowCount(), 0);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "3+3");
+    COMPARE(model.rowCount(), 1);
+    COMPARE(model.text(0), QString("3+3"));
+}
+
+void HistoryModelTest::limit()
+{
+    HistoryModel model;
+    COMPARE(model.limit(), (int)HistoryModel::DEFAULT_LIMIT);
+    model.setLimit(5);
+    for (int i = 0; i < 8; ++i) {
+        model.append(HistoryModel::EXPRESSION_ENTRY, QString::number(i));
+    }
+
+    // Decreasing limit keeps the newest entries
+    model.setLimit(2);
+    COMPARE(model.rowCount(), 2);
+    COMPARE(model.text(0), QString("6"));
+    COMPARE(model.text(1), QString("7"));
+
+    model.setLimit(4);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "8");
+    model.append(HistoryModel::EXPRESSION_ENTRY, "9");
+    model.append(HistoryModel::EXPRESSION_ENTRY, "10");
+    COMPARE(model.rowCount(), 4);
+    COMPARE(model.text(0), QString("7"));
+    COMPARE(model.text(3), QString("10"));
+
+    model.setLimit(0);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "11");
+    COMPARE(model.rowCount(), 0);
+}
+
+void HistoryModelTest::find()
+{
+    HistoryModel model;
+    model.setLimit(4);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "sin(pi)");
+    model.append(HistoryModel::RESULT_ENTRY, "0");
+    model.append(HistoryModel::EXPRESSION_ENTRY, "SIN(1)");
+    model.append(HistoryModel::RESULT_ENTRY, "0.841");
+    // Buffer wraps around
+    model.append(HistoryModel::EXPRESSION_ENTRY, "cos(0)");
+
+    COMPARE(model.find("sin", 0), 1);
+    COMPARE(model.find("sin", 2), 1);
+    COMPARE(model.find("sin", 3, false), 1);
+    COMPARE(model.find("0", 1), 2);
+    COMPARE(model.find("0", 1, false), 0);
+    COMPARE(model.find("cos", -1, false), 3);
+    COMPARE(model.find("tan", 0), -1);
+    COMPARE(model.find("", 0), -1);
+}
+
+void HistoryModelTest::copy()
+{
+    HistoryModel model;
+    model.append(HistoryModel::EXPRESSION_ENTRY, "2*2");
+    model.append(HistoryModel::RESULT_ENTRY, "4");
+    model.append(HistoryModel::EXPRESSION_ENTRY, "x");
+    model.append(HistoryModel::ERROR_ENTRY, "Unknown variable");
+
+    // Entries are copied in the order of rows, not of selection
+    QModelIndexList indexes;
+    indexes << model.index(3) << model.index(0) << model.index(1);
+    COMPARE(model.toPlainText(indexes), QString("2*2\n    4\n    Unknown variable\n"));
+    COMPARE(model.toPlainText(QModelIndexList()), QString());
+}
+
+void HistoryModelTest::setEntry()
+{
+    HistoryModel model;
+    model.setLimit(3);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "fact(20000)");
+    model.append(HistoryModel::PROVISIONAL_ENTRY, "1.8192063202303451348 ...");
+    COMPARE(model.entryType(1), HistoryModel::PROVISIONAL_ENTRY);
+
+    // Provisional result is replaced in place, even after ring buffer wraps
+    model.append(HistoryModel::EXPRESSION_ENTRY, "1+1");
+    model.append(HistoryModel::PROVISIONAL_ENTRY, "2 ...");
+    model.setEntry(2, HistoryModel::RESULT_ENTRY, "2");
+    COMPARE(model.rowCount(), 3);
+    COMPARE(model.entryType(2), HistoryModel::RESULT_ENTRY);
+    COMPARE(model.text(2), QString("2"));
+    COMPARE(model.text(1), QString("1+1"));
+
+    // Rows out of range are ignored
+    model.setEntry(3, HistoryModel::ERROR_ENTRY, "Error");
+    model.setEntry(-1, HistoryModel::ERROR_ENTRY, "Error");
+    COMPARE(model.rowCount(), 3);
+    COMPARE(model.text(0), QString("1.8192063202303451348 ..."));
+}
+
+void HistoryModelTest::elidedResults()
+{
+    HistoryModel model;
+    ComplexFormat format(50);
+    const char * digits = "1.2345678901234567890123456789012345678901234567891";
+    model.append(HistoryModel::EXPRESSION_ENTRY, "x");
+    model.appendResult(Complex(digits, "-2.5"), format);
+    model.appendResult(Complex("0.5"), format);
+    model.append(HistoryModel::EXPRESSION_ENTRY, "y");
+    model.append(HistoryModel::PROVISIONAL_ENTRY, "1.2345678901234567 ...");
+
+    // Long runs of digits are elided, short ones are not
+    QString elided = "1.23456789012345";
+    elided += QChar(0x2026);
+    elided += "34567891 - 2.5i [50 digits]";
+    QString full = QString(digits) + " - 2.5i";
+    COMPARE(model.entryType(1), HistoryModel::RESULT_ENTRY);
+    VERIFY(model.isElided(1));
+    VERIFY(!model.isExpanded(1));
+    COMPARE(model.data(model.index(1)).toString(), elided);
+    COMPARE(model.data(model.index(1), Qt::ToolTipRole).toString(), full);
+    COMPARE(model.text(1), full);
+    VERIFY(!model.isElided(2));
+    COMPARE(model.data(model.index(2)).toString(), QString("0.5"));
+    VERIFY(!model.data(model.index(2), Qt::ToolTipRole).isValid());
+
+    // Expanded entry shows full text
+    model.setExpanded(1, true);
+    VERIFY(model.isExpanded(1));
+    COMPARE(model.data(model.index(1)).toString(), full);
+    VERIFY(!model.data(model.index(1), Qt::ToolTipRole).isValid());
+    model.setExpanded(1, false);
+    COMPARE(model.data(model.index(1)).toString(), elided);
+
+    // Full text is searched and copied
+    COMPARE(model.find("0123456789012345678", 0), 1);
+    QModelIndexList indexes;
+    indexes << model.index(1);
+    COMPARE(model.toPlainText(indexes), QString("    ") + full + "\n");
+
+    // Provisional result is replaced in place; exponent is not elided
+    model.setResult(4, Complex(std::string(digits) + "E+2567"), format);
+    elided = "1.23456789012345";
+    elided += QChar(0x2026);
+    elided += "34567891E+2567 [50 digits]";
+    COMPARE(model.rowCount(), 5);
+    COMPARE(model.entryType(4), HistoryModel::RESULT_ENTRY);
+    COMPARE(model.data(model.index(4)).toString(), elided);
+}
+
+// Appends BENCHMARK_ENTRIES entries to history with given limit
+static int appendEntries(int limit)
+{
+    HistoryModel model;
+    model.setLimit(limit);
+    QString expression("sqrt(2)*sqrt(2)");
+    QString result("2.0000000000000000000000000000000000000000000000000");
+    for (int i = 0; i < BENCHMARK_ENTRIES; i += 2) {
+        model.append(HistoryModel::EXPRESSION_ENTRY, expression);
+        model.append(HistoryModel::RESULT_ENTRY, result);
+    }
+    return model.rowCount();
+}
+
+void HistoryModelTest::appendBenchmark()
+{
+    BENCHMARK(appendEntries(HistoryModel::DEFAULT_LIMIT));
+
+    COMPARE(appendEntries(HistoryModel::DEFAULT_LIMIT), (int)HistoryModel::DEFAULT_LIMIT);
+    COMPARE(appendEntries(BENCHMARK_ENTRIES), BENCHMARK_ENTRIES);
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ *  MaxCalc - a powerful scientific calculator.
+ *  Copyright (C) 2005, 2010 Michael Maximov (michael.maximov@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+#ifndef HISTORYMODELTEST_H
+#define HISTORYMODELTEST_H
+
+// Qt
+#include <QTest>
+
+class HistoryModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ringBuffer();
+    void limit();
+    void find();
+    void copy();
+    void setEntry();
+    void elidedResults();
+    void appendBenchmark();
+};
+
+#endif // HISTORYMODELTEST_H
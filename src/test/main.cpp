@@ -23,6 +23,7 @@
 #include "parsertest.h"
 #include "variablestest.h"
 #include "unitconversiontest.h"
+#include "historymodeltest.h"
 // Qt
 #include <QTest>
 
@@ -43,5 +44,8 @@ int main()
     UnitConversionTest unitConversionTest;
     QTest::qExec(&unitConversionTest);
 
+    HistoryModelTest historyModelTest;
+    QTest::qExec(&historyModelTest);
+
     return 0;
 }
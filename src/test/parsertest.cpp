@@ -22,11 +22,15 @@
 #include "utility.h"
 // Engine
 #include "parser.h"
+#include "asyncparser.h"
+#include "functionsampler.h"
 #include "exceptions.h"
 // STL
 #include <ctime>
 #include <cstdlib>
+#include <cmath>
 #include <sstream>
+#include <vector>
 
 void ParserTest::basic()
 {
@@ -270,6 +274,26 @@ void ParserTest::userVars()
     PARSER_FAIL_TEST(parser, _T("x = y+1 = 1"), "Incorrent expression", ParserException);
     PARSER_FAIL_TEST(parser, _T("x/2 = y = 1"), "Incorrent expression", ParserException);
 
+    // Expression is evaluated again with new values of variables
+    parser.setExpression(_T("z = z * 2 + y"));
+    FAIL_TEST(parser.parse(), "Unknown variable", ParserException);
+    parser.context().variables().add(_T("Z"), 1);
+    parser.parse();
+    COMPARE_COMPLEX(parser.context().result(), 3);
+    parser.parse();
+    COMPARE_COMPLEX(parser.context().result(), 7);
+    parser.context().variables().remove(_T("y"));
+    FAIL_TEST(parser.parse(), "Unknown variable", ParserException);
+    // Symbols are resolved again in a new context
+    ParserContext context;
+    context.variables().add(_T("y"), 10);
+    context.variables().add(_T("z"), 20);
+    parser.setContext(context);
+    parser.parse();
+    COMPARE_COMPLEX(parser.context().result(), 50);
+    COMPARE_COMPLEX(parser.context().variables()[_T("z")], 50);
+    COMPARE_COMPLEX(context.variables()[_T("z")], 20);
+
     tstring var = _T("");
     for (int i = 0; i < 100; ++i) {
         tstringstream ss;
@@ -299,6 +323,23 @@ void ParserTest::userVars()
     PARSER_TEST(parser, _T("x *= y += z ^= 2"), 48);
     PARSER_FAIL_TEST(parser, _T("new_var *= 2"), "Unknown variable", ParserException);
     PARSER_FAIL_TEST(parser, _T("x = new_var *= 2"), "Unknown variable", ParserException);
+
+    // Reading unknown variables doesn't add their names
+    Variables::Symbol symbol;
+    PARSER_FAIL_TEST(parser, _T("unknown_var + 1"), "Unknown variable", ParserException);
+    VERIFY(!parser.context().variables().find(_T("unknown_var"), symbol));
+    VERIFY(!parser.context().variables().find(_T("new_var"), symbol));
+
+    // Assignment changes name of variable
+    parser.context().variables().add(_T("Named"), 1);
+    PARSER_TEST(parser, _T("NAMED = 2"), 2);
+    VERIFY(parser.context().variables().find(_T("named"), symbol));
+    bool renamed = false;
+    for (Variables::const_iterator iter = parser.context().variables().begin();
+         iter != parser.context().variables().end(); ++iter) {
+        if (iter->name == _T("named")) renamed = true;
+    }
+    VERIFY(renamed);
 }
 
 void ParserTest::functions()
@@ -499,6 +540,100 @@ void ParserTest::unitConversions()
     PARSER_TEST(parser, _T("(2^1)[ft->in]"), "24");
 }
 
+void ParserTest::quantities()
+{
+    Parser parser;
+
+    // Syntax
+    PARSER_TEST(parser, _T("5[km]"), "5");
+    PARSER_TEST(parser, _T("  5  [  km  ]  "), "5");
+    PARSER_TEST(parser, _T("5[km][m]"), "5000");
+    PARSER_TEST(parser, _T("5[km][-> m]"), "5000");
+    PARSER_TEST(parser, _T("5[km][km->m]"), "5000");
+    PARSER_TEST(parser, _T("-5[km][m]"), "-5000");
+    PARSER_TEST(parser, _T("(1+i)[km][m]"), Complex(1000, 1000));
+    PARSER_FAIL_TEST(parser, _T("5[]"), "Incorrect syntax", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[->]"), "Incorrect syntax", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[km->]"), "Incorrect syntax", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[qwe]"), "Unknown unit", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[->m]"), "Conversion of number without units", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[km][s]"), "Incompatible units", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[km][s->m]"), "Incompatible units", ParserException);
+
+    // Addition and subtraction
+    PARSER_TEST(parser, _T("5[km] + 300[m]"), "5.3");
+    PARSER_TEST(parser, _T("300[m] + 5[km]"), "5300");
+    PARSER_TEST(parser, _T("1[h] - 30[min]"), "0.5");
+    PARSER_TEST(parser, _T("1[mile] - 1760[yd]"), "0");
+    PARSER_FAIL_TEST(parser, _T("5[km] + 2[s]"), "Incompatible units", ParserException);
+    PARSER_FAIL_TEST(parser, _T("5[km] - 2"), "Incompatible units", ParserException);
+    PARSER_FAIL_TEST(parser, _T("2 + 5[km]"), "Incompatible units", ParserException);
+
+    // Multiplication and division
+    PARSER_TEST(parser, _T("2 * 5[km] / 4"), "2.5");
+    PARSER_TEST(parser, _T("(100[km] / 2[h])[->km/h]"), "50");
+    PARSER_TEST(parser, _T("(100[km] / 2[h])[->m/s]"), "13.888888888888888888888888888888888888888888888889");
+    PARSER_TEST(parser, _T("(1[m] / 1[s])[->knot] - 1[m/s][->knot]"), "0");
+    PARSER_TEST(parser, _T("10[km] / 5[m]"), "2000");
+    PARSER_TEST(parser, _T("10[km] / 5[m] + 1"), "2001");
+    PARSER_TEST(parser, _T("2[h] * 30[km/h]"), "60");
+    PARSER_TEST(parser, _T("(2[h] * 30[km/h])[->mile]"), "37.282271534240038177046051061799093295156287282272");
+    PARSER_TEST(parser, _T("1[km] * 1[km] - 1000000[m] * 1[m]"), "0");
+    PARSER_FAIL_TEST(parser, _T("1[km] * 1[km] - 1[m]"), "Incompatible units", ParserException);
+
+    // Powers and functions
+    PARSER_TEST(parser, _T("2[m]^2 / 4[m]"), "1");
+    PARSER_FAIL_TEST(parser, _T("(3[m]^2)[->m]"), "Incompatible units", ParserException);
+    PARSER_TEST(parser, _T("sqrt(16[m] * 4[m])"), "8");
+    PARSER_TEST(parser, _T("sqrt(sqr(3[km]))[m]"), "3000");
+    PARSER_TEST(parser, _T("abs(-3[km])[m]"), "3000");
+    PARSER_TEST(parser, _T("sin(90[deg])"), "1");
+    PARSER_TEST(parser, _T("cos(200[grad])"), "-1");
+    PARSER_FAIL_TEST(parser, _T("2[m]^0.5"), "Fractional power of quantity", ParserException);
+    PARSER_FAIL_TEST(parser, _T("2^1[m]"), "Power with units", ParserException);
+    PARSER_FAIL_TEST(parser, _T("sqrt(2[m])"), "Square root of length", ParserException);
+    PARSER_FAIL_TEST(parser, _T("ln(2[m])"), "Logarithm of length", ParserException);
+    PARSER_FAIL_TEST(parser, _T("sin(2[m])"), "Sine of length", ParserException);
+
+    // Temperatures are converted exactly between units of the table
+    PARSER_TEST(parser, _T("20[c][->f]"), "68");
+    PARSER_TEST(parser, _T("(20[c] + 10[c])[f]"), "86");
+    PARSER_TEST(parser, _T("20[c] + 50[f][->c]"), "30");
+    PARSER_FAIL_TEST(parser, _T("10[c] + 50[f]"), "Addition of temperatures", ParserException);
+    PARSER_FAIL_TEST(parser, _T("10[c] - 5[k]"), "Subtraction of temperatures", ParserException);
+    PARSER_FAIL_TEST(parser, _T("10[c] + 5[k^1]"), "Addition of temperatures", ParserException);
+    PARSER_TEST(parser, _T("300[k] - 5[k]"), "295");
+
+    // Exponents of dimensions are limited
+    PARSER_FAIL_TEST(parser, _T("(2[m])^200 + 1[m]"), "Overflow of exponent", ArithmeticException);
+    PARSER_FAIL_TEST(parser, _T("(2[m])^100 * (2[m])^100"), "Overflow of exponent", ArithmeticException);
+    PARSER_FAIL_TEST(parser, _T("1[m^99*m^99*m^99 -> m^41]"), "Overflow of exponent", ArithmeticException);
+    PARSER_TEST(parser, _T("(1[m])^127 / (1[m])^127"), "1");
+
+    // Unit expressions
+    PARSER_TEST(parser, _T("1[kN*m][->J]"), "1000");
+    PARSER_TEST(parser, _T("(2[m^3] / 4[s])[->l/s]"), "500");
+    PARSER_TEST(parser, _T("(10[kg] * 9.8[m/s^2])[->n]"), "98");
+    PARSER_TEST(parser, _T("3[kg*m*s^-2] + 1[kn]"), "1003");
+    PARSER_TEST(parser, _T("5[mg/l->kg/m^3]"), "0.005");
+    PARSER_TEST(parser, _T("1[atm][->kpa]"), "101.325");
+    PARSER_FAIL_TEST(parser, _T("1[kn*m][->kg]"), "Incompatible units", ParserException);
+    PARSER_TEST(parser, _T("1[MPa->pa]"), "1000000");
+    PARSER_TEST(parser, _T("1[mPa->pa]"), "0.001");
+    PARSER_TEST(parser, _T("1[MJ->kj] + 1[mJ->kj]"), "1000.000001");
+    PARSER_TEST(parser, _T("10[MM->cm]"), "1");
+    PARSER_TEST(parser, _T("1[GJ][->kJ]"), "1000000");
+    PARSER_TEST(parser, _T("10[c->mk]"), "283150");
+    PARSER_TEST(parser, _T("10[c][->k^1]"), "283.15");
+    PARSER_TEST(parser, _T("(1[k^2] / 1[k])[->c]"), "-272.15");
+    PARSER_FAIL_TEST(parser, _T("1[m^]"), "Unknown unit", ParserException);
+
+    // Variables keep values of quantities
+    PARSER_TEST(parser, _T("x = 5[km] + 300[m]"), "5.3");
+    PARSER_TEST(parser, _T("x"), "5.3");
+    PARSER_TEST(parser, _T("x *= 2[km]"), "10.6");
+}
+
 void ParserTest::stress()
 {
     Parser parser;
@@ -527,3 +662,357 @@ void ParserTest::random()
         PARSER_FAIL_TEST(parser, expr, "Random input passed", MaxCalcException);
     }
 }
+
+// Checks that evaluation of expression in parser fails because of limits
+#define PARSER_LIMIT_TEST(parser, expression, limit) \
+    parser.setExpression(expression); \
+    try { \
+        parser.parse(); \
+        QFAIL("Limit is not checked"); \
+    } catch (EvaluationLimitException & ex) { \
+        COMPARE(ex.reason(), EvaluationLimitException::limit); \
+    }
+
+void ParserTest::limits()
+{
+    Parser parser;
+    parser.context().setOperationBudget(1000);
+    PARSER_TEST(parser, _T("sin(1)^2 + cos(1)^2 + fact(20)/fact(19) + 2^100/2^99"), 23);
+    PARSER_LIMIT_TEST(parser, _T("fact(100000)"), OPERATION_BUDGET_EXCEEDED);
+    // Budget is per evaluation
+    PARSER_TEST(parser, _T("fact(10)"), 3628800);
+
+    // Conversion to other bases is limited when it is done within a budget
+    BigDecimal big("1E+100");
+    big.setBase(16);
+    {
+        OperationBudget budget(0, 50, 0);
+        FAIL_TEST(big.toString(), "Limit is not checked", EvaluationLimitException);
+    }
+    COMPARE(big.toString().substr(0, 7), string("16#1249"));
+
+    // Limits are kept in copies of context
+    ParserContext context = parser.context();
+    context.setOperationBudget(0);
+    context.setTimeLimit(50);
+    tstring slow = _T("fact(200000)/fact(199999)");
+    for (int i = 0; i < 100; ++i) slow += _T(" + fact(200000)/fact(199999)");
+    Parser timed(slow, context);
+    time_t start = time(0);
+    PARSER_LIMIT_TEST(timed, slow, TIMEOUT);
+    VERIFY(time(0) - start < 2);
+
+    CancellationToken token;
+    token.cancel();
+    context.setTimeLimit(0);
+    context.setCancellationToken(&token);
+    Parser cancelled(_T(""), context);
+    PARSER_LIMIT_TEST(cancelled, _T("cos(2)"), CANCELLED);
+    // Short operations don't check the token
+    PARSER_TEST(cancelled, _T("1 + 2"), 3);
+    token.reset();
+    PARSER_TEST(cancelled, _T("fact(5)"), 120);
+}
+
+void ParserTest::costEstimate()
+{
+    Parser parser;
+    parser.setExpression(_T("fact(100000)"));
+    CostEstimate cost = parser.estimateCost();
+    VERIFY(cost.operations >= 110000 && cost.operations < 111000);
+    COMPARE(cost.exponent, 456573.0);
+    VERIFY(!cost.overflow);
+    // Estimate is enough for evaluation
+    parser.context().setOperationBudget((unsigned long)cost.operations);
+    parser.parse();
+    VERIFY(parser.context().resultExists());
+    parser.context().setOperationBudget((unsigned long)cost.operations / 2);
+    PARSER_LIMIT_TEST(parser, _T("fact(100000)"), OPERATION_BUDGET_EXCEEDED);
+    parser.context().setOperationBudget(0);
+
+    parser.setExpression(_T("fact(1000000)"));
+    VERIFY(parser.estimateCost().overflow);
+    parser.setExpression(_T("2^1E+10"));
+    VERIFY(parser.estimateCost().overflow);
+
+    // Conversion to other bases takes a step per digit
+    parser.setExpression(_T("hex(1E+100)"));
+    cost = parser.estimateCost();
+    VERIFY(cost.operations >= 84 && cost.operations < 90);
+    COMPARE(cost.peakDigits, 101.0);
+    parser.setExpression(_T("bin(x)"));
+    parser.context().variables().add(_T("x"), BigDecimal("1E+100"));
+    cost = parser.estimateCost();
+    VERIFY(cost.operations >= 333 && cost.operations < 340);
+    COMPARE(cost.peakDigits, 333.0);
+
+    // Nested functions cost more
+    parser.setExpression(_T("sin(1)"));
+    double sine = parser.estimateCost().operations;
+    parser.setExpression(_T("sin(cos(sin(1)))"));
+    VERIFY(parser.estimateCost().operations > 2 * sine);
+    parser.setExpression(_T("1 + 2*3"));
+    cost = parser.estimateCost();
+    VERIFY(cost.operations < sine);
+    COMPARE(cost.exponent, 0.0);
+    COMPARE(cost.peakDigits, 1.0);
+
+    // Estimation doesn't evaluate expressions
+    parser.setExpression(_T("y = 5"));
+    parser.estimateCost();
+    VERIFY(!parser.context().variables().isDefined(parser.context().variables().intern(_T("y"))));
+
+    parser.setExpression(_T("sin(1"));
+    FAIL_TEST(parser.estimateCost(), "Syntax error is not checked", ParserException);
+    parser.setExpression(_T("unknown(1)"));
+    FAIL_TEST(parser.estimateCost(), "Unknown function is not checked", ParserException);
+    // Estimate accepts the same grammar as evaluation
+    parser.setExpression(_T("sqrt(1; 2)"));
+    FAIL_TEST(parser.estimateCost(), "Number of arguments is not checked", ParserException);
+    parser.setExpression(_T("pi = 3"));
+    FAIL_TEST(parser.estimateCost(), "Reserved name is not checked", ParserException);
+}
+
+// Counts evaluations finished by AsyncParser
+class EvaluationCounter : public AsyncParser::Callback
+{
+public:
+    EvaluationCounter() : count(0), provisionalCount(0) { }
+    void evaluationFinished(const EvaluationPointer & evaluation)
+    {
+        if (evaluation->isFinished()) ++count;
+    }
+    void provisionalResultReady(const EvaluationPointer & evaluation)
+    {
+        if (evaluation->hasProvisionalResult()) ++provisionalCount;
+    }
+    int count;
+    int provisionalCount;
+};
+
+// Stores provisional results of Parser::parseProgressive()
+class ProvisionalResults : public Parser::ProgressCallback
+{
+public:
+    void provisionalResult(const Complex & result) { results.push_back(result); }
+    vector<Complex> results;
+};
+
+void ParserTest::asyncEvaluation()
+{
+    EvaluationCounter counter;
+    AsyncParser async(&counter);
+    ParserContext context;
+    context.variables().add(_T("x"), Complex(2));
+
+    EvaluationPointer first = async.evaluate(_T("y = x * 21"), context);
+    EvaluationPointer second = async.evaluate(_T("unknown(1)"), context);
+    second->wait();
+    VERIFY(first->isFinished());
+    VERIFY(first->succeeded());
+    COMPARE_COMPLEX(first->context().result(), 42);
+    VERIFY(!second->succeeded());
+    VERIFY(!second->isCancelled());
+    VERIFY(!second->error().empty());
+    // Context passed to evaluate() is not modified
+    VERIFY(!context.resultExists());
+    VERIFY(!context.variables().isDefined(context.variables().intern(_T("y"))));
+
+    // Running and queued evaluations are cancelled
+    tstring slow = _T("fact(200000)/fact(199999)");
+    for (int i = 0; i < 100; ++i) slow += _T(" + fact(200000)/fact(199999)");
+    time_t start = time(0);
+    EvaluationPointer running = async.evaluate(slow, context);
+    EvaluationPointer queued = async.evaluate(_T("1 + 2"), context);
+    async.cancelAll();
+    queued->wait();
+    VERIFY(running->isFinished());
+    VERIFY(running->isCancelled());
+    VERIFY(queued->isCancelled());
+    VERIFY(time(0) - start < 2);
+
+    // Parser works after cancellation
+    EvaluationPointer last = async.evaluate(_T("res * 2"), first->context());
+    last->wait();
+    COMPARE_COMPLEX(last->context().result(), 84);
+    VERIFY(counter.count >= 4);
+}
+
+void ParserTest::workingPrecision()
+{
+    Parser parser;
+    parser.setExpression(_T("sqrt(2) + sin(pi/6)"));
+    parser.context().setWorkingPrecision(20);
+    parser.parse();
+    COMPARE_COMPLEX_PRECISION(parser.context().result(),
+        Complex(_T("1.9142135623730950488")), 18);
+    VERIFY(parser.context().result().re.toString(BigDecimalFormat(50)).size() <= 22);
+    // Precision of the thread is restored after evaluation
+    COMPARE(WorkingPrecision::digits(), Constants::WORKING_PRECISION);
+
+    parser.context().setWorkingPrecision(0);
+    parser.parse();
+    VERIFY(parser.context().result().re.toString(BigDecimalFormat(50)).size() > 40);
+}
+
+void ParserTest::progressiveEvaluation()
+{
+    // Short evaluation doesn't get provisional result
+    Parser parser;
+    ProvisionalResults provisional;
+    parser.setExpression(_T("sqrt(2) + 1"));
+    parser.parseProgressive(provisional);
+    VERIFY(provisional.results.empty());
+    COMPARE_COMPLEX(parser.context().result(), Complex(BigDecimal::sqrt(2) + 1));
+
+    // Long evaluation gets provisional result calculated with low precision
+    parser.setExpression(_T("fact(20000)/fact(19999) + pi"));
+    parser.parseProgressive(provisional);
+    COMPARE(provisional.results.size(), size_t(1));
+    COMPARE_COMPLEX_PRECISION(provisional.results[0], Complex(BigDecimal::PI + 20000),
+        Parser::PROVISIONAL_PRECISION - 2);
+    COMPARE_COMPLEX(parser.context().result(), Complex(BigDecimal::PI + 20000));
+
+    // Errors are reported by full evaluation
+    parser.setExpression(_T("fact(20000)/(fact(19999) - fact(19999))"));
+    FAIL_TEST(parser.parseProgressive(provisional), "Division by zero is not detected",
+        ArithmeticException);
+
+    // Units normalized by provisional evaluation keep full precision
+    provisional.results.clear();
+    parser.setExpression(_T("fact(20000)/fact(19999)*0 + 1[dm/h->m/s]"));
+    parser.parseProgressive(provisional);
+    COMPARE(provisional.results.size(), size_t(1));
+    parser.setExpression(_T("1[dm/h->m/s]"));
+    parser.parse();
+    COMPARE(parser.context().result().re.toString(BigDecimalFormat(50)),
+        (BigDecimal(1) / 36000).toString(BigDecimalFormat(50)));
+
+    // Asynchronous evaluation
+    EvaluationCounter counter;
+    AsyncParser async(&counter);
+    EvaluationPointer evaluation = async.evaluate(_T("fact(20000)/fact(19999)"),
+        ParserContext(), true);
+    evaluation->wait();
+    VERIFY(evaluation->hasProvisionalResult());
+    COMPARE_COMPLEX_PRECISION(evaluation->provisionalResult(), 20000,
+        Parser::PROVISIONAL_PRECISION - 2);
+    COMPARE_COMPLEX(evaluation->context().result(), 20000);
+    COMPARE(counter.provisionalCount, 1);
+    evaluation = async.evaluate(_T("fact(20000)/fact(19999)"), ParserContext());
+    evaluation->wait();
+    VERIFY(!evaluation->hasProvisionalResult());
+}
+
+// Counts passes of FunctionSampler
+class SamplingPasses : public FunctionSampler::Callback
+{
+public:
+    SamplingPasses() : passes(0), finished(false) { }
+    void pointsSampled(const vector<FunctionSampler::Point> & points, bool last)
+    {
+        ++passes;
+        finished = last;
+        count = points.size();
+    }
+    int passes;
+    bool finished;
+    size_t count;
+};
+
+void ParserTest::functionSampling()
+{
+    ParserContext context;
+    FAIL_TEST(FunctionSampler(_T("x+"), _T("x"), context), "Invalid expression",
+        ParserException);
+    FAIL_TEST(FunctionSampler(_T("x*unknown"), _T("x"), context), "Unknown variable",
+        ParserException);
+
+    // Points are sorted and denser where graph bends more
+    FunctionSampler sampler(_T("sin(x^2)"), _T("x"), context, 4);
+    SamplingPasses passes;
+    const vector<FunctionSampler::Point> & points = sampler.sample(0, 6.25, 200, &passes);
+    VERIFY(passes.passes > 1);
+    VERIFY(passes.finished);
+    COMPARE(passes.count, points.size());
+    VERIFY(points.size() > 51);
+    COMPARE(sampler.evaluations(), points.size());
+    COMPARE(points.front().x, 0.0);
+    COMPARE(points.back().x, 6.25);
+    size_t first = 0, last = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        VERIFY(points[i].defined);
+        VERIFY(fabs(points[i].y - sin(points[i].x * points[i].x)) < 1e-12);
+        if (i > 0) VERIFY(points[i - 1].x < points[i].x);
+        if (points[i].x < 1) ++first;
+        if (points[i].x > 5.25) ++last;
+    }
+    VERIFY(last > 2 * first);
+
+    // Undefined points and discontinuities are refined; number of threads
+    // doesn't change result
+    FunctionSampler inverse(_T("1/x + sqrt(x + 0.5)"), _T("x"), context, 1);
+    vector<FunctionSampler::Point> single = inverse.sample(-1, 1, 100);
+    FunctionSampler parallel(_T("1/x + sqrt(x + 0.5)"), _T("x"), context, 3);
+    COMPARE(parallel.sample(-1, 1, 100).size(), single.size());
+    size_t undefined = 0, nearZero = 0, nearOne = 0;
+    for (size_t i = 0; i < single.size(); ++i) {
+        COMPARE(parallel.points()[i].defined, single[i].defined);
+        if (!single[i].defined) {
+            ++undefined;
+            VERIFY(single[i].x < -0.49 || single[i].x == 0);
+        }
+        if (fabs(single[i].x) < 0.1) ++nearZero;
+        if (single[i].x > 0.9) ++nearOne;
+    }
+    VERIFY(undefined > 0);
+    VERIFY(nearZero > nearOne);
+
+    // Cancelled sampling stops at once
+    CancellationToken token;
+    token.cancel();
+    passes = SamplingPasses();
+    sampler.sample(0, 6.25, 200, &passes, &token);
+    COMPARE(passes.passes, 0);
+    COMPARE(sampler.sample(1, 1, 200).size(), (size_t)0);
+}
+
+void ParserTest::parseBenchmark()
+{
+    Parser parser;
+    parser.setExpression(_T("x = 1.25*(2.5 + 3.75)/4.125 - 5.0625^2 + 6.03125*x1"));
+    parser.context().variables().add(_T("x1"), Complex(_T("0.5"), _T("2")));
+    tstring result;
+
+    BENCHMARK((parser.parse(), result = parser.context().result().toTString()));
+
+    COMPARE(result, tstring(_T("-20.71934185606060606060606 + 12.0625i")));
+}
+
+void ParserTest::variablesBenchmark()
+{
+    Parser parser;
+    parser.setExpression(_T("y = a*b + c*d - a*c + b*d - a/d"));
+    Variables & vars = parser.context().variables();
+    vars.add(_T("a"), Complex(_T("1.5")));
+    vars.add(_T("b"), Complex(_T("2")));
+    vars.add(_T("c"), Complex(_T("0.5"), _T("1")));
+    vars.add(_T("d"), Complex(_T("4")));
+    tstring result;
+
+    BENCHMARK((parser.parse(), result = parser.context().result().toTString()));
+
+    COMPARE(result, tstring(_T("11.875 + 2.5i")));
+}
+
+void ParserTest::quantityBenchmark()
+{
+    Parser parser;
+    parser.setExpression(_T("x = ((2.5[km] + 300[m]) / (1.5[h] - 20[min]))[->m/s] * x1"));
+    parser.context().variables().add(_T("x1"), Complex(_T("0.5"), _T("2")));
+    tstring result;
+
+    BENCHMARK((parser.parse(), result = parser.context().result().toTString()));
+
+    COMPARE(result, tstring(_T("0.3333333333333333333333333 + 1.333333333333333333333333i")));
+}
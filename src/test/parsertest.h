@@ -46,8 +46,20 @@ private slots:
     void fails();
     void realWorld();
     void unitConversions();
+    void quantities();
     void stress();
     void random();
+    void limits();
+    void costEstimate();
+    void asyncEvaluation();
+    void workingPrecision();
+    void progressiveEvaluation();
+    void functionSampling();
+
+    // Benchmarks
+    void parseBenchmark();
+    void variablesBenchmark();
+    void quantityBenchmark();
 };
 
 #endif // PARSERTEST_H
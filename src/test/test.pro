@@ -13,18 +13,22 @@ HEADERS += pch.h \
     complextest.h \
     parsertest.h \
     variablestest.h \
-    unitconversiontest.h
+    unitconversiontest.h \
+    historymodeltest.h \
+    ../gui/historymodel.h
 
 SOURCES += main.cpp \
     bigdecimaltest.cpp \
     complextest.cpp \
     parsertest.cpp \
     variablestest.cpp \
-    unitconversiontest.cpp
+    unitconversiontest.cpp \
+    historymodeltest.cpp \
+    ../gui/historymodel.cpp
 
 PRECOMPILED_HEADER = pch.h
 
-INCLUDEPATH += ../engine
+INCLUDEPATH += ../engine ../gui
 
 CONFIG(debug, debug|release) { 
     DEFINES += _DEBUG
@@ -42,7 +46,9 @@ CONFIG(release, debug|release) {
 }
 
 win32:maxcalc_gettext:LIBS += -L../intl_win -lintl
+unix:LIBS += -lpthread
 
 maxcalc_unicode:DEFINES += MAXCALC_UNICODE
+maxcalc_utf8:DEFINES += MAXCALC_UTF8
 maxcalc_gettext:DEFINES += MAXCALC_GETTEXT
 win32:DEFINES += _CRT_SECURE_NO_WARNINGS
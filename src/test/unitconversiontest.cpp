@@ -26,6 +26,8 @@
 // STL
 #include <string>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 
 using namespace std;
 
@@ -55,13 +57,14 @@ void UnitConversionTest::iterators()
         VERIFY(cur->type != UnitConversion::NO_TYPE);
     }
 
-    VERIFY(i == 32);
+    VERIFY(i == 42);
 }
 
 bool UnitConversionTest::isUnit(const tstring str)
 {
     for (tstring::const_iterator i = str.begin(); i != str.end(); ++i) {
-        if (!istalpha((const int)*i) && *i != _T('/')) {
+        if (!istalpha((const int)*i) && !istdigit((const int)*i) &&
+            *i != _T('/') && *i != _T('^')) {
             return false;
         }
     }
@@ -218,8 +221,18 @@ void UnitConversionTest::temperature()
     COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("c"), _T("k")), "274.15");
     COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("c"), _T("f")), "33.8");
     // f
-    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, _T("f"), _T("c")), "-17.22222222222222", 14);
-    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, _T("f"), _T("k")), "255.9277777777778", 14);
+    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, _T("f"), _T("c")),
+        "-17.222222222222222222222222222222222222222222222222", Constants::MAX_IO_PRECISION);
+    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, _T("f"), _T("k")),
+        "255.92777777777777777777777777777777777777777777778", Constants::MAX_IO_PRECISION);
+    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(212, _T("f"), _T("c")), 100, Constants::MAX_IO_PRECISION);
+    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(-40, _T("f"), _T("c")), -40, Constants::MAX_IO_PRECISION);
+
+    // Round trips through chains of conversions
+    BigDecimal value("36.6");
+    BigDecimal result = UnitConversion::convert(UnitConversion::convert(UnitConversion::convert(
+        value, _T("c"), _T("f")), _T("f"), _T("k")), _T("k"), _T("c"));
+    COMPARE_BIGDECIMAL_PRECISION(result, value, Constants::MAX_IO_PRECISION);
 }
 
 // Units: micros ms s min h d w
@@ -306,3 +319,199 @@ void UnitConversionTest::speed()
     COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("knot"), _T("km/h")), "1.852");
 }
 
+void UnitConversionTest::findUnit()
+{
+    VERIFY(UnitConversion::findUnit(_T("")) == 0);
+    VERIFY(UnitConversion::findUnit(_T("qwe")) == 0);
+    VERIFY(UnitConversion::findUnit(_T("M")) == 0);
+
+    for (const UnitConversion::UnitDef * cur = UnitConversion::units();
+         cur->unit != UnitConversion::NO_UNIT; ++cur) {
+        VERIFY(UnitConversion::findUnit(cur->name) == cur);
+    }
+}
+
+// Every pair of units of the same category is convertible and conversions
+// through a third unit give the same result
+void UnitConversionTest::matrix()
+{
+    const UnitConversion::UnitDef * units = UnitConversion::units();
+    for (const UnitConversion::UnitDef * u1 = units; u1->unit != UnitConversion::NO_UNIT; ++u1) {
+        for (const UnitConversion::UnitDef * u2 = units; u2->unit != UnitConversion::NO_UNIT; ++u2) {
+            if (u1->type != u2->type) {
+                FAIL_TEST(UnitConversion::convert(1, u1->name, u2->name),
+                    "Unknown conversion", ParserException);
+                continue;
+            }
+            if (u1->type == UnitConversion::TEMPERATURE) continue;
+
+            BigDecimal direct = UnitConversion::convert(3, u1->name, u2->name);
+            for (const UnitConversion::UnitDef * u3 = units; u3->unit != UnitConversion::NO_UNIT; ++u3) {
+                if (u3->type != u1->type) continue;
+                COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(
+                    UnitConversion::convert(3, u1->name, u3->name), u3->name, u2->name),
+                    direct, Constants::MAX_IO_PRECISION);
+            }
+        }
+    }
+}
+
+void UnitConversionTest::scales()
+{
+    // Scales of units are consistent with conversions
+    const UnitConversion::UnitDef * units = UnitConversion::units();
+    for (const UnitConversion::UnitDef * u1 = units; u1->unit != UnitConversion::NO_UNIT; ++u1) {
+        for (const UnitConversion::UnitDef * u2 = units; u2->unit != UnitConversion::NO_UNIT; ++u2) {
+            VERIFY((u1->type == u2->type) == (UnitConversion::dimension(u1->unit) ==
+                UnitConversion::dimension(u2->unit)));
+            if (u1->type != u2->type || u1->type == UnitConversion::TEMPERATURE) continue;
+
+            COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, u1->name, u2->name),
+                UnitConversion::scale(u1->unit) / UnitConversion::scale(u2->unit),
+                Constants::MAX_IO_PRECISION);
+        }
+    }
+
+    // Velocity is length per time
+    COMPARE_BIGDECIMAL(UnitConversion::scale(UnitConversion::KILOMETER_PER_HOUR),
+        UnitConversion::scale(UnitConversion::KILOMETER) / UnitConversion::scale(UnitConversion::HOUR));
+    VERIFY(UnitConversion::dimension(UnitConversion::KNOT) ==
+        UnitConversion::dimension(UnitConversion::MILE) / UnitConversion::dimension(UnitConversion::HOUR));
+
+    // Scales of temperatures are slopes of conversions
+    COMPARE_BIGDECIMAL(UnitConversion::scale(UnitConversion::KELVIN), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::scale(UnitConversion::CELSIUS), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::scale(UnitConversion::FAHRENHEIT), BigDecimal(5) / 9);
+}
+
+void UnitConversionTest::converter()
+{
+    FAIL_TEST(UnitConversion::Converter(_T("km/h"), _T("qwe")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::Converter(_T("km/h"), _T("km")), "Unknown conversion", ParserException);
+
+    BigDecimal numbers[] = { 0, 1, "-2.5", "1e100" };
+    BigDecimal results[4];
+    const char * units[][2] = { { "km/h", "knot" }, { "c", "f" }, { "f", "k" }, { "m", "m" } };
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); ++i) {
+        tstring unit1(units[i][0], units[i][0] + strlen(units[i][0]));
+        tstring unit2(units[i][1], units[i][1] + strlen(units[i][1]));
+        UnitConversion::Converter converter(unit1, unit2);
+        converter.convert(numbers, results, 4);
+        for (size_t j = 0; j < 4; ++j) {
+            COMPARE_BIGDECIMAL(results[j], UnitConversion::convert(numbers[j], unit1, unit2));
+            COMPARE_BIGDECIMAL(converter.convert(numbers[j]), results[j]);
+        }
+    }
+
+    // In place conversion
+    UnitConversion::Converter(_T("mile"), _T("km")).convert(numbers, numbers, 4);
+    COMPARE_BIGDECIMAL(numbers[2], "-4.02336");
+}
+
+void UnitConversionTest::unitExpressions()
+{
+    // Products, quotients and powers with SI prefixes
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("kn*m"), _T("j")), 1000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(5, _T("mg/l"), _T("kg/m^3")), "0.005");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(2, _T("m^3/s"), _T("l/min")), 120000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("kg*m/s^2"), _T("n")), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("kg*m*s^-2"), _T("n")), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(3, _T("kpa"), _T("bar")), "0.03");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("kwh"), _T("kj")), 3600);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("dam"), _T("cm")), 1000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("ul"), _T("mm^3")), 1);
+    COMPARE_BIGDECIMAL_PRECISION(UnitConversion::convert(1, _T("n"), _T("lbf")),
+        "0.2248089430997104829100394", 25);
+
+    // Prefixes are case-sensitive, unit names are not
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("MPa"), _T("pa")), 1000000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("mPa"), _T("pa")), "0.001");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("mm"), _T("m")), "0.001");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("MJ"), _T("j")), 1000000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("Pm"), _T("m")), "1e15");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("pm"), _T("m")), "1e-12");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("GJ"), _T("MJ")), 1000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("Pa"), _T("kPa")), "0.001");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(2, _T("G"), _T("kg")), "0.002");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("min"), _T("s")), 60);
+    // Unit names in any case win over prefixes
+    COMPARE_BIGDECIMAL(UnitConversion::convert(10, _T("MM"), _T("cm")), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("Mm"), _T("m")), "0.001");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1000, _T("MS"), _T("s")), 1);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(10, _T("Min"), _T("s")), 600);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("KM"), _T("m")), 1000);
+
+    // Affine units with unit expressions are converted through base units
+    COMPARE_BIGDECIMAL(UnitConversion::convert(10, _T("c"), _T("k")), "283.15");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(10, _T("c"), _T("mk")), 283150);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(10, _T("c"), _T("k^1")), "283.15");
+    COMPARE_BIGDECIMAL(UnitConversion::convert(283150, _T("mk"), _T("c")), 10);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(32, _T("f"), _T("mk")), 273150);
+    VERIFY(!UnitConversion::Converter(_T("c"), _T("mk")).isLinear());
+
+    // Normalized units
+    UnitConversion::NormalizedUnit nu = UnitConversion::normalize(_T("kn*m"));
+    COMPARE_BIGDECIMAL(nu.scale, 1000);
+    VERIFY(nu.dimension == UnitConversion::dimension(UnitConversion::JOULE));
+    VERIFY(nu.unit == 0);
+    COMPARE(UnitConversion::normalize(_T("kn*m")).name, nu.name);
+    VERIFY(UnitConversion::normalize(_T("km/h")).unit == UnitConversion::findUnit(_T("km/h")));
+    VERIFY(UnitConversion::normalize(_T("KM")).unit == UnitConversion::findUnit(_T("km")));
+
+    // Invalid expressions
+    FAIL_TEST(UnitConversion::normalize(_T("m^")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("m^0")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("m//s")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("m*")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("xm")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("Mx")), "Unknown unit", ParserException);
+    FAIL_TEST(UnitConversion::normalize(_T("c*m")), "Non-proportional unit", ParserException);
+    FAIL_TEST(UnitConversion::convert(1, _T("kn*m"), _T("kg")), "Unknown conversion", ParserException);
+
+    // Many distinct expressions don't break conversions when cache is full
+    for (int i = 1; i < 100; ++i) {
+        for (int j = 1; j < 100; ++j) {
+            tstringstream expr;
+            expr << _T("m^") << i << _T("/m^") << j;
+            UnitConversion::normalize(expr.str());
+        }
+    }
+    COMPARE_BIGDECIMAL(UnitConversion::convert(5, _T("km"), _T("m")), 5000);
+    COMPARE_BIGDECIMAL(UnitConversion::convert(1, _T("kn*m"), _T("j")), 1000);
+}
+
+void UnitConversionTest::convertBenchmark()
+{
+    tstring unit1 = _T("km/h");
+    tstring unit2 = _T("knot");
+    BigDecimal result;
+
+    BENCHMARK(result = UnitConversion::convert(100, unit1, unit2));
+
+    COMPARE_BIGDECIMAL_PRECISION(result, "53.99568034557235421166307", 25);
+}
+
+void UnitConversionTest::bulkConvertBenchmark()
+{
+    const size_t count = 1000;
+    std::vector<BigDecimal> numbers(count), results(count);
+    for (size_t i = 0; i < count; ++i) {
+        numbers[i] = BigDecimal((int)i) / 7;
+    }
+    UnitConversion::Converter converter(_T("km/h"), _T("knot"));
+
+    BENCHMARK(converter.convert(&numbers[0], &results[0], count));
+
+    COMPARE_BIGDECIMAL(results[700], UnitConversion::convert(100, _T("km/h"), _T("knot")));
+}
+
+void UnitConversionTest::unitExpressionBenchmark()
+{
+    tstring unit1 = _T("kn*m/s^2");
+    tstring unit2 = _T("j*min^-2");
+    BigDecimal result;
+
+    BENCHMARK(result = UnitConversion::convert(1, unit1, unit2));
+
+    COMPARE_BIGDECIMAL(result, 3600000);
+}
@@ -42,6 +42,15 @@ private slots:
     void temperature();
     void time();
     void speed();
+
+    void findUnit();
+    void matrix();
+    void scales();
+    void converter();
+    void unitExpressions();
+    void convertBenchmark();
+    void bulkConvertBenchmark();
+    void unitExpressionBenchmark();
 };
 
 #endif // UNITCONVERSIONTEST_H
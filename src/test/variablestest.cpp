@@ -22,11 +22,17 @@
 #include "utility.h"
 // MaxCalcEngine
 #include "variables.h"
+#include "parsercontext.h"
+#include "exceptions.h"
+#include "workspace.h"
 // STL
 #include <string>
 #include <cstdlib>
 #include <sstream>
 #include <ctime>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
@@ -46,7 +52,7 @@ void VariablesTest::basic()
 void VariablesTest::stress()
 {
     Variables vars;
-    wstring name;
+    tstring name;
     int rand1, rand2;
     tstringstream ss;
 
@@ -54,7 +60,7 @@ void VariablesTest::stress()
     for (int i = 0; i < 10000; ++i) {
         tstringstream ss;
         ss << i;
-        name = L"Variable#";
+        name = _T("Variable#");
         name += ss.str();
         while ((rand1 = rand()) == 0) {
         }
@@ -67,7 +73,7 @@ void VariablesTest::stress()
     for (int i = 2500; i < 7500; ++i) {
         tstringstream ss;
         ss << i;
-        name = L"Variable#";
+        name = _T("Variable#");
         name += ss.str();
         vars.remove(name);
     }
@@ -91,9 +97,285 @@ void VariablesTest::iterators()
     Variables::const_iterator iter;
     int i;
     for (iter = vars.begin(); iter != vars.end(); ++iter) {
-        wstringstream ss(iter->name.c_str());
+        tstringstream ss(iter->name.c_str());
         ss >> i;
         COMPARE_COMPLEX((*iter).value, Complex(i, 1000-i));
         COMPARE_COMPLEX(iter->value, Complex(i, 1000-i));
     }
 }
+
+void VariablesTest::symbols()
+{
+    Variables vars;
+    Variables::Symbol x = vars.intern(_T("X"));
+    Variables::Symbol y = vars.intern(_T("y"));
+    VERIFY(x != y);
+    COMPARE(vars.intern(_T("x")), x);
+
+    // Names are found without interning
+    Variables::Symbol found = 0;
+    VERIFY(vars.find(_T("Y"), found));
+    COMPARE(found, y);
+    VERIFY(!vars.find(_T("z"), found));
+    VERIFY(!vars.find(_T("z"), found));
+    COMPARE(found, y);
+
+    // Interned names are not variables until they get values
+    VERIFY(!vars.isDefined(x));
+    COMPARE(vars.count(), size_t(0));
+    VERIFY(vars.begin() == vars.end());
+    FAIL_TEST(vars.value(x), "Unknown variable", ParserException);
+
+    vars.setValue(y, 2);
+    vars.add(_T("Y"), 3);
+    COMPARE(vars.count(), size_t(1));
+    COMPARE_COMPLEX(vars.value(y), 3);
+    COMPARE_COMPLEX(vars[_T("y")], 3);
+
+    // Variables are listed in alphabetical order
+    vars.add(_T("b"), 1);
+    vars.add(_T("a"), 1);
+    tstring names;
+    for (Variables::const_iterator iter = vars.begin(); iter != vars.end(); ++iter) {
+        names += iter->name;
+    }
+    COMPARE(names, tstring(_T("abY")));
+
+    // Symbols stay valid after removal
+    vars.removeAll();
+    COMPARE(vars.count(), size_t(0));
+    COMPARE(vars.intern(_T("y")), y);
+    vars.setValue(y, 5);
+    COMPARE_COMPLEX(vars[_T("Y")], 5);
+    COMPARE(vars.begin()->name, tstring(_T("Y")));
+    vars.setValue(y, 5, _T("y"));
+    COMPARE(vars.begin()->name, tstring(_T("y")));
+
+    // Copies have their own symbol tables
+    Variables copy = vars;
+    VERIFY(copy.symbolsId() != vars.symbolsId());
+    COMPARE_COMPLEX(copy.value(y), 5);
+}
+
+void VariablesTest::copyOnWrite()
+{
+    Variables base;
+    for (int i = 0; i < 100; ++i) {
+        tstringstream ss;
+        ss << _T("c") << i;
+        base.add(ss.str(), i);
+    }
+
+    // Changes of a copy don't affect the original and vice versa
+    Variables copy = base;
+    copy.add(_T("c5"), -5);
+    copy.add(_T("x"), 1);
+    copy.remove(_T("c7"));
+    base.add(_T("c9"), -9);
+    COMPARE_COMPLEX(base[_T("c5")], 5);
+    COMPARE_COMPLEX(base[_T("c7")], 7);
+    FAIL_TEST(base[_T("x")], "Unknown variable", ParserException);
+    COMPARE(base.count(), size_t(100));
+    COMPARE_COMPLEX(copy[_T("c5")], -5);
+    COMPARE_COMPLEX(copy[_T("c9")], 9);
+    COMPARE_COMPLEX(copy[_T("x")], 1);
+    FAIL_TEST(copy[_T("c7")], "Unknown variable", ParserException);
+    COMPARE(copy.count(), size_t(100));
+
+    // Copies of copies keep names of all layers
+    Variables fork = base;
+    for (int i = 0; i < 20; ++i) {
+        tstringstream ss;
+        ss << _T("v") << i;
+        Variables next = fork;
+        next.add(ss.str(), i);
+        fork = next;
+    }
+    COMPARE(fork.count(), size_t(120));
+    COMPARE_COMPLEX(fork[_T("v0")], 0);
+    COMPARE_COMPLEX(fork[_T("v19")], 19);
+    COMPARE_COMPLEX(fork[_T("c99")], 99);
+    size_t listed = 0;
+    tstring prev;
+    for (Variables::const_iterator iter = fork.begin(); iter != fork.end(); ++iter) {
+        VERIFY(listed == 0 || prev < iter->name);
+        prev = iter->name;
+        ++listed;
+    }
+    COMPARE(listed, size_t(120));
+
+    // Contexts share variables
+    ParserContext context;
+    context.setVariables(base);
+    ParserContext session(context);
+    session.variables().add(_T("c1"), 10);
+    COMPARE_COMPLEX(context.variables()[_T("c1")], 1);
+    COMPARE_COMPLEX(session.variables()[_T("c1")], 10);
+}
+
+// Forks session context from base context and changes one variable
+static void forkSession(const ParserContext & base, Variables::Symbol symbol)
+{
+    ParserContext session(base);
+    session.variables().setValue(symbol, 1);
+}
+
+void VariablesTest::forkBenchmark()
+{
+    ParserContext base;
+    for (int i = 0; i < 500; ++i) {
+        tstringstream ss;
+        ss << _T("const") << i;
+        base.variables().add(ss.str(), Complex(BigDecimal(i) / 7, 1));
+    }
+    Variables::Symbol symbol = base.variables().intern(_T("const250"));
+
+    BENCHMARK(forkSession(base, symbol));
+
+    COMPARE_COMPLEX(base.variables().value(symbol), Complex(BigDecimal(250) / 7, 1));
+}
+
+void VariablesTest::workspace()
+{
+    const char * path = "variablestest.mxcw";
+    const tstring fileName = _T("variablestest.mxcw");
+    ParserContext context;
+    for (int i = 0; i < 100; ++i) {
+        tstringstream ss;
+        ss << _T("Var") << i;
+        context.variables().add(ss.str(), Complex(BigDecimal(i) / 7, -i));
+    }
+    context.variables().add(_T("big"), Complex("-1.5E-300", "1E+999"));
+    context.setResult(Complex(1, 2));
+    COMPARE(Workspace::save(context, fileName), size_t(101));
+
+    // Loaded variables replace current ones; values are unpacked on access
+    ParserContext loaded;
+    loaded.variables().add(_T("old"), 1);
+    COMPARE(Workspace::load(loaded, fileName), size_t(101));
+    Variables & vars = loaded.variables();
+    COMPARE(vars.count(), size_t(101));
+    FAIL_TEST(vars[_T("old")], "Unknown variable", ParserException);
+    VERIFY(vars[_T("var99")] == Complex(BigDecimal(99) / 7, -99));
+    VERIFY(vars[_T("BIG")] == Complex("-1.5E-300", "1E+999"));
+    COMPARE_COMPLEX(loaded.result(), Complex(1, 2));
+
+    Variables::const_iterator iter = vars.begin();
+    COMPARE(iter->name, tstring(_T("big")));
+    VERIFY((++iter)->value == Complex(0, 0));
+    COMPARE(iter->name, tstring(_T("Var0")));
+
+    // Copies share packed values; changes don't affect each other
+    Variables copy = vars;
+    Variables::Symbol symbol = copy.intern(_T("var50"));
+    copy.setValue(symbol, 5);
+    COMPARE_COMPLEX(copy.value(symbol), 5);
+    VERIFY(vars[_T("var50")] == Complex(BigDecimal(50) / 7, -50));
+    vars.remove(_T("var1"));
+    VERIFY(copy[_T("var1")] == Complex(BigDecimal(1) / 7, -1));
+
+    // Saving replaces the file, so loaded values are still read from the old one
+    ParserContext other;
+    other.variables().add(_T("x"), 1);
+    COMPARE(Workspace::save(other, fileName), size_t(1));
+    VERIFY(vars[_T("var2")] == Complex(BigDecimal(2) / 7, -2));
+    VERIFY(vars[_T("big")] == Complex("-1.5E-300", "1E+999"));
+    COMPARE(Workspace::save(context, fileName), size_t(101));
+
+    // Invalid files don't change context
+    FILE * file = fopen(path, "r+b");
+    VERIFY(file != 0);
+    fputs("MXCW\x02", file);
+    fclose(file);
+    FAIL_TEST(Workspace::load(loaded, fileName), "Invalid version", WorkspaceException);
+    COMPARE(loaded.variables().count(), size_t(100));
+    FAIL_TEST(Workspace::load(loaded, _T("nonexistent.mxcw")), "No file", WorkspaceException);
+
+    // Values are checked when the file is loaded, not when they are used
+    ParserContext corrupt;
+    const Complex value(123456789, 5);
+    corrupt.variables().add(_T("x"), value);
+    Workspace::save(corrupt, fileName);
+    unsigned char packed[2 * BigDecimal::MAX_PACKED_SIZE];
+    size_t packedSize = value.pack(packed);
+    file = fopen(path, "rb");
+    VERIFY(file != 0);
+    vector<unsigned char> data(4096);
+    data.resize(fread(&data[0], 1, data.size(), file));
+    fclose(file);
+    vector<unsigned char>::iterator found =
+        search(data.begin(), data.end(), packed, packed + packedSize);
+    VERIFY(found != data.end());
+    found[7] = 0x1A;
+    file = fopen(path, "wb");
+    fwrite(&data[0], 1, data.size(), file);
+    fclose(file);
+    FAIL_TEST(Workspace::load(loaded, fileName), "Invalid digit", WorkspaceException);
+    COMPARE(loaded.variables().count(), size_t(100));
+
+    found[7] = packed[7];
+    found[4] = 0x7F;
+    file = fopen(path, "wb");
+    fwrite(&data[0], 1, data.size(), file);
+    fclose(file);
+    FAIL_TEST(Workspace::load(loaded, fileName), "Invalid exponent", WorkspaceException);
+    COMPARE(loaded.variables().count(), size_t(100));
+    remove(path);
+}
+
+void VariablesTest::changeTracking()
+{
+    Variables vars;
+    COMPARE(vars.version(), 0L);
+    vars.add(_T("x"), 1);
+    vars.add(_T("y"), 2);
+    long version = vars.version();
+    Variables::Symbol x = vars.intern(_T("x"));
+    Variables::Symbol y = vars.intern(_T("y"));
+    VERIFY(version > 0);
+    VERIFY(vars.version(x) < vars.version(y));
+    COMPARE(vars.version(y), version);
+
+    // Changes of one variable don't change versions of others
+    long yVersion = vars.version(y);
+    vars.setValue(x, 3);
+    VERIFY(vars.version() > version);
+    COMPARE(vars.version(x), vars.version());
+    COMPARE(vars.version(y), yVersion);
+
+    // Copy keeps versions; changes of the copy get new versions
+    Variables copy(vars);
+    COMPARE(copy.version(), vars.version());
+    copy.setValue(y, 4);
+    vars.setValue(y, 5);
+    VERIFY(copy.version(y) != yVersion);
+    VERIFY(copy.version(y) != vars.version(y));
+    vars = copy;
+    COMPARE(vars.version(), copy.version());
+
+    // Iterator returns versions of variables in order of lowercase names
+    vars.add(_T("A"), 6);
+    Variables::const_iterator iter = vars.begin();
+    COMPARE(iter.lowerName(), tstring(_T("a")));
+    COMPARE(iter.version(), vars.version());
+    ++iter;
+    COMPARE(iter.lowerName(), tstring(_T("x")));
+    COMPARE(iter.version(), vars.version(x));
+
+    // Removal is a change too
+    version = vars.version();
+    vars.remove(_T("x"));
+    VERIFY(vars.version() > version);
+    COMPARE(vars.version(x), vars.version());
+    version = vars.version();
+    vars.removeAll();
+    VERIFY(vars.version() > version);
+    COMPARE(vars.version(y), vars.version());
+
+    // Result version changes when result is set
+    ParserContext context;
+    COMPARE(context.resultVersion(), 0UL);
+    context.setResult(1);
+    context.setResult(1);
+    COMPARE(context.resultVersion(), 2UL);
+}
@@ -31,6 +31,11 @@ private slots:
     void basic();
     void stress();
     void iterators();
+    void symbols();
+    void copyOnWrite();
+    void forkBenchmark();
+    void workspace();
+    void changeTracking();
 };
 
 #endif // VARIABLESTEST_H